@@ -1,5 +1,7 @@
 /*
   Beeper.cpp - Library for represents a sound output, such as the alarm or buzzer.  The sound is controlled by an EventQueue.
+  Events can be given a named pattern and priority, and the pattern is played from the Timer0 compare interrupt so its
+  cadence does not depend on how long loop() takes.  A beeper on TONE_PIN can also play pitches from Timer1.
   Created by Tom Wallace.
 */
 
@@ -7,35 +9,216 @@
 #include "Beeper.h"
 #include "EventQueue.h"
 #include "Loggable.h"
+#include <util/atomic.h>
 
-Beeper::Beeper(String beeperName, int outputPin, EventQueue * eventQueue) {
+// Frequencies in Hz, indexed by the NOTE_ defines
+const uint16_t NOTE_FREQUENCIES[] PROGMEM = {0, 2093, 523, 587, 659, 698, 784, 880, 988, 1047};
+
+// Patterns are note and milliseconds pairs, ending in a 0 duration, and repeat while the event is queued
+const uint16_t PULSE_STEPS[] PROGMEM = {NOTE_ON, 500, NOTE_REST, 500, 0, 0};
+const uint16_t DOUBLE_CHIRP_STEPS[] PROGMEM = {NOTE_ON, 100, NOTE_REST, 100, NOTE_ON, 100, NOTE_REST, 700, 0, 0};
+// Fast and even, unlike the three spaced beeps of a dry run, as a stalled loop is the most urgent
+const uint16_t STALL_STEPS[] PROGMEM = {
+	NOTE_ON, 60, NOTE_REST, 60, NOTE_ON, 60, NOTE_REST, 60, NOTE_ON, 60, NOTE_REST, 60, NOTE_ON, 60, NOTE_REST, 60,
+	NOTE_ON, 60, NOTE_REST, 700, 0, 0};
+const uint16_t MASH_HIGH_STEPS[] PROGMEM = {NOTE_C5, 120, NOTE_E5, 120, NOTE_G5, 120, NOTE_C6, 240, NOTE_REST, 900, 0, 0};
+const uint16_t KETTLE_FULL_STEPS[] PROGMEM = {NOTE_G5, 250, NOTE_E5, 250, NOTE_C5, 500, NOTE_REST, 1500, 0, 0};
+const uint16_t DRY_RUN_STEPS[] PROGMEM = {NOTE_C5, 150, NOTE_REST, 100, NOTE_C5, 150, NOTE_REST, 100, NOTE_C5, 150, NOTE_REST, 1350, 0, 0};
+
+Beeper * Beeper::_beepers[MAX_BEEPERS];
+int Beeper::_numBeepers = 0;
+
+Beeper::Beeper(const __FlashStringHelper * beeperName, int outputPin, EventQueue * eventQueue) {
 	_beeperName = beeperName;
 	_outputPin = outputPin;
-	_eventQueue = eventQueue;
+	_eventQueues[0] = eventQueue;
+	_numEventQueues = 1;
 
 	SOUND = HIGH;
 	SILENT = LOW;
+	_isTone = false;
 
 	pinMode(_outputPin, OUTPUT);
 	digitalWrite(_outputPin, SILENT);
 	_currentState = SILENT;
+
+	_numEvents = 0;
+	_currentPattern = BEEPER_STEADY;
+	_isPlaying = false;
+	_steps = NULL;
+	_stepIndex = 0;
+	_stepRemaining = 0;
+
+	if (_numBeepers < MAX_BEEPERS)
+		_beepers[_numBeepers++] = this;
+}
+
+// Also sounds for events on another queue, such as the buzzer playing melodies for the alarms
+void Beeper::AddEventQueue(EventQueue * eventQueue) {
+	if (_numEventQueues < MAX_EVENT_QUEUES)
+		_eventQueues[_numEventQueues++] = eventQueue;
+}
+
+// Plays notes as pitches by letting Timer1 toggle the pin in hardware, so the CPU is not involved while a tone plays
+void Beeper::EnableTone() {
+	if (_outputPin != TONE_PIN) {
+		Log(millis(), _beeperName, String(F("Tones are only available on pin ")) + String(TONE_PIN));
+		return;
+	}
+
+	// CTC mode with a prescaler of 8, output compare disconnected until a note plays
+	noInterrupts();
+	TCCR1A = 0;
+	TCCR1B = _BV(WGM12) | _BV(CS11);
+	interrupts();
+	_isTone = true;
+}
+
+// Sounds the pattern whenever the event is queued, ahead of any lower priority events
+void Beeper::SetEventPattern(const __FlashStringHelper * event, int pattern, int priority) {
+	if (_numEvents >= MAX_EVENT_PATTERNS)
+		return;
+
+	_events[_numEvents] = event;
+	_eventPatterns[_numEvents] = pattern;
+	_eventPriorities[_numEvents] = priority;
+	_numEvents++;
 }
 
 void Beeper::Update(long currentMillis) {
     
 	int OriginalState = _currentState;
     
-    if (_eventQueue->IsPopulated()) {
-		digitalWrite(_outputPin, SOUND);
+    if (IsPopulated()) {
+		// Anything queued without a pattern, such as a button click, sounds steady at the lowest priority
+		int pattern = BEEPER_STEADY;
+		int priority = -1;
+		for (int i = 0; i < _numEvents; i++) {
+			if (_eventPriorities[i] > priority && HasEvent(_events[i])) {
+				pattern = _eventPatterns[i];
+				priority = _eventPriorities[i];
+			}
+		}
+
+		if (_currentState != SOUND || pattern != _currentPattern)
+			Play(pattern);
 		_currentState = SOUND;
     } else {
-		digitalWrite(_outputPin, SILENT);
+		noInterrupts();
+		_isPlaying = false;
+		interrupts();
+		Output(NOTE_REST);
 		_currentState = SILENT;
     }
       
     // If state changed, then log
     if (_currentState != OriginalState) {
-      String state = _currentState == SOUND ? "SOUNDING" : "SILENT";
-      Log(currentMillis, _beeperName, "State has changed to " + state); 
+      String state = _currentState == SOUND ? F("SOUNDING") : F("SILENT");
+      Log(currentMillis, _beeperName, String(F("State has changed to ")) + state); 
     }
-}
\ No newline at end of file
+}
+
+// Hooks the Timer0 compare A interrupt, which fires about once a millisecond alongside the millis() overflow
+void Beeper::Begin() {
+	OCR0A = 0x80;
+	TIMSK0 |= _BV(OCIE0A);
+}
+
+void Beeper::TickAll() {
+	for (int i = 0; i < _numBeepers; i++)
+		_beepers[i]->Tick();
+}
+
+// Private - Returns if any watched queue has events
+bool Beeper::IsPopulated() {
+	for (int i = 0; i < _numEventQueues; i++) {
+		if (_eventQueues[i]->IsPopulated())
+			return true;
+	}
+	return false;
+}
+
+// Private - Returns if any watched queue has the event
+bool Beeper::HasEvent(String event) {
+	for (int i = 0; i < _numEventQueues; i++) {
+		if (_eventQueues[i]->HasEvent(event))
+			return true;
+	}
+	return false;
+}
+
+// Private - Starts a pattern from its first step
+void Beeper::Play(int pattern) {
+	const uint16_t * steps = NULL;
+	if (pattern == BEEPER_PULSE)
+		steps = PULSE_STEPS;
+	else if (pattern == BEEPER_DOUBLE_CHIRP)
+		steps = DOUBLE_CHIRP_STEPS;
+	else if (pattern == BEEPER_STALL)
+		steps = STALL_STEPS;
+	else if (pattern == BEEPER_MASH_HIGH)
+		steps = MASH_HIGH_STEPS;
+	else if (pattern == BEEPER_KETTLE_FULL)
+		steps = KETTLE_FULL_STEPS;
+	else if (pattern == BEEPER_DRY_RUN)
+		steps = DRY_RUN_STEPS;
+
+	noInterrupts();
+	_steps = steps;
+	_stepIndex = 0;
+	_stepRemaining = steps == NULL ? 0 : pgm_read_word(&steps[1]);
+	_isPlaying = true;
+	interrupts();
+
+	_currentPattern = pattern;
+	Output(steps == NULL ? NOTE_ON : pgm_read_word(&steps[0]));
+}
+
+// Private - Sounds the note, or silences the output for NOTE_REST.  Called from both loop() and the Timer0 interrupt, so the
+// read-modify-write of TCCR1A is kept atomic - restoring the state leaves interrupts off when already inside the interrupt
+void Beeper::Output(uint16_t note) {
+	if (!_isTone) {
+		digitalWrite(_outputPin, note == NOTE_REST ? SILENT : SOUND);
+		return;
+	}
+
+	if (note == NOTE_REST) {
+		// digitalWrite does not release a toggling compare output, so disconnect it first
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			TCCR1A &= ~_BV(COM1A0);
+			digitalWrite(_outputPin, SILENT);
+		}
+		return;
+	}
+
+	uint16_t frequency = pgm_read_word(&NOTE_FREQUENCIES[note]);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		OCR1A = (1000000UL / frequency) - 1;  // 16 MHz / (2 * 8 * frequency), less one for CTC
+		TCNT1 = 0;
+		TCCR1A |= _BV(COM1A0);
+	}
+}
+
+// Private - Called from the interrupt to advance the pattern by a millisecond
+void Beeper::Tick() {
+	if (!_isPlaying || _steps == NULL)
+		return;
+
+	if (_stepRemaining > 1) {
+		_stepRemaining--;
+		return;
+	}
+
+	_stepIndex++;
+	uint16_t duration = pgm_read_word(&_steps[(2 * _stepIndex) + 1]);
+	if (duration == 0) {
+		_stepIndex = 0;
+		duration = pgm_read_word(&_steps[1]);
+	}
+	_stepRemaining = duration;
+	Output(pgm_read_word(&_steps[2 * _stepIndex]));
+}
+
+ISR(TIMER0_COMPA_vect) {
+	Beeper::TickAll();
+}
@@ -1,5 +1,7 @@
 /*
   Beeper.h - Library for represents a sound output, such as the alarm or buzzer.  The sound is controlled by an EventQueue.
+  Events can be given a named pattern and priority, and the pattern is played from the Timer0 compare interrupt so its
+  cadence does not depend on how long loop() takes.  A beeper on TONE_PIN can also play pitches from Timer1.
   Created by Tom Wallace.
 */
 #ifndef Beeper_h
@@ -9,18 +11,76 @@
 #include "EventQueue.h"
 #include "Loggable.h"
 
+// Beeper patterns
+#define BEEPER_STEADY 0
+#define BEEPER_PULSE 1
+#define BEEPER_DOUBLE_CHIRP 2
+#define BEEPER_STALL 3
+#define BEEPER_MASH_HIGH 4
+#define BEEPER_KETTLE_FULL 5
+#define BEEPER_DRY_RUN 6
+
+// Notes for pattern steps - NOTE_ON is plain sound, or the default pitch on a tone beeper
+#define NOTE_REST 0
+#define NOTE_ON 1
+#define NOTE_C5 2
+#define NOTE_D5 3
+#define NOTE_E5 4
+#define NOTE_F5 5
+#define NOTE_G5 6
+#define NOTE_A5 7
+#define NOTE_B5 8
+#define NOTE_C6 9
+
+// OC1A - Timer1 toggles it directly for tones.  OC1B (water pump) and the Timer2 outputs (wort pump, right button) are left alone
+#define TONE_PIN 9
+
+#define MAX_BEEPERS 2
+#define MAX_EVENT_QUEUES 2
+#define MAX_EVENT_PATTERNS 4
+
 class Beeper : public Loggable {
   private: 
 	int _outputPin;
-	EventQueue * _eventQueue;
+	EventQueue * _eventQueues[MAX_EVENT_QUEUES];
+	int _numEventQueues;
 	int _currentState;
-	String _beeperName;
+	const __FlashStringHelper * _beeperName;
 	int SOUND;
 	int SILENT;
+	bool _isTone;
+
+	// Events with a pattern, highest priority wins
+	const __FlashStringHelper * _events[MAX_EVENT_PATTERNS];
+	int _eventPatterns[MAX_EVENT_PATTERNS];
+	int _eventPriorities[MAX_EVENT_PATTERNS];
+	int _numEvents;
+	int _currentPattern;
+
+	// Shared with the interrupt
+	volatile bool _isPlaying;
+	const uint16_t * volatile _steps;
+	volatile uint8_t _stepIndex;
+	volatile uint16_t _stepRemaining;
+
+	static Beeper * _beepers[MAX_BEEPERS];
+	static int _numBeepers;
+
+	bool IsPopulated();
+	bool HasEvent(String event);
+	void Play(int pattern);
+	void Output(uint16_t note);
+	void Tick();
 
   public: 
-	Beeper(String beeperName, int outputPin, EventQueue * eventQueue);
+	Beeper(const __FlashStringHelper * beeperName, int outputPin, EventQueue * eventQueue);
+	void AddEventQueue(EventQueue * eventQueue);
+	void EnableTone();
+	void SetEventPattern(const __FlashStringHelper * event, int pattern, int priority);
 	void Update(long currentMillis);
+
+	static void Begin();
+	static void TickAll();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,57 @@
+/*
+  Benchmark.cpp - Library for timing a function on the board and reporting the cost per call as a CSV line on the serial port,
+  so runs from different builds can be compared.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "Benchmark.h"
+
+// Set by avr-libc - the top of the heap, or 0 before anything has been allocated
+extern char * __brkval;
+extern char __heap_start;
+
+long Benchmark::_overheadMicros = 0;
+unsigned int Benchmark::_overheadIterations = 0;
+
+static void EmptyFunction() {
+}
+
+// Prints the CSV header and measures the cost of the timing loop itself, which Run takes off every result
+void Benchmark::Begin() {
+  _overheadIterations = 1000;
+  _overheadMicros = Time(EmptyFunction, _overheadIterations);
+  Serial.println(F("BENCH,name,iterations,ns_per_op,heap_growth_bytes,free_bytes"));
+}
+
+// Prints BENCH,name,iterations,ns per call,bytes the heap grew by,bytes free after the run
+void Benchmark::Run(String name, BenchmarkFunction function, unsigned int iterations) {
+  char * heapEnd = GetHeapEnd();
+  long micros = Time(function, iterations);
+  int heapGrowth = GetHeapEnd() - heapEnd;
+
+  long overhead = _overheadIterations == 0 ? 0 : _overheadMicros * (long)iterations / _overheadIterations;
+  long nanosPerOp = max(micros - overhead, 0L) * 1000 / (long)iterations;
+
+  Serial.println(String(F("BENCH,")) + name + F(",") + String(iterations) + F(",") + String(nanosPerOp) + F(",") + String(heapGrowth) + F(",") + String(GetFreeMemory()));
+  Serial.flush();  // So the next run is not slowed by the serial interrupt sending this line
+}
+
+// Private - micros() only counts in steps of 4, so enough iterations are needed to make that small
+long Benchmark::Time(BenchmarkFunction function, unsigned int iterations) {
+  unsigned long start = micros();
+  for (unsigned int i = 0; i < iterations; i++)
+    function();
+  return micros() - start;
+}
+
+// Private - Bytes between the top of the heap and the bottom of the stack
+int Benchmark::GetFreeMemory() {
+  char top;
+  return &top - GetHeapEnd();
+}
+
+// Private
+char * Benchmark::GetHeapEnd() {
+  return __brkval == 0 ? &__heap_start : __brkval;
+}
@@ -0,0 +1,27 @@
+/*
+  Benchmark.h - Library for timing a function on the board and reporting the cost per call as a CSV line on the serial port,
+  so runs from different builds can be compared.
+  Created by Tom Wallace.
+*/
+#ifndef Benchmark_h
+#define Benchmark_h
+
+#include "Arduino.h"
+
+typedef void (*BenchmarkFunction)();
+
+class Benchmark {
+  private:
+	static long _overheadMicros;
+	static unsigned int _overheadIterations;
+
+	static int GetFreeMemory();
+	static char * GetHeapEnd();
+	static long Time(BenchmarkFunction function, unsigned int iterations);
+
+  public: 
+	static void Begin();
+	static void Run(String name, BenchmarkFunction function, unsigned int iterations);
+};
+
+#endif
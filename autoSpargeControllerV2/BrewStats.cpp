@@ -0,0 +1,227 @@
+/*
+  BrewStats.cpp - Library for tracking the runtime counters of a brew session, such as pump duty, relay cycles and volume transferred.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+#include "SettingsStore.h"
+
+BrewStats::BrewStats(IPump * waterPump, IPump * wortPump, PressureSensor * boilPressureSensor) {
+  _waterPump = waterPump;
+  _wortPump = wortPump;
+  _boilPressureSensor = boilPressureSensor;  // NULL in builds without the pressure sensor
+
+  SESSION_END_DELAY = 120000;  // Milliseconds both pumps must be inactive before the session is over
+  _isSessionActive = false;
+  _sessionStartMillis = 0;
+  _lastActiveMillis = 0;
+  _previousMillis = 0;
+  _waterWasPumping = false;
+  _wortWasPumping = false;
+  _hasPeakGallons = false;
+  _peakGallons = 0;
+
+  SAVE_INTERVAL = 300000;  // Milliseconds between saves during a session, so a reboot loses at most 5 minutes of counts
+  _savedMillis = 0;
+  _store = NULL;
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+// The counters, for a SettingsStore to keep in EEPROM
+BrewCounters * BrewStats::GetCounters() {
+  return &_counters;
+}
+
+// Saves the counters through the store at the start and end of each session and every SAVE_INTERVAL during one
+void BrewStats::SetStore(SettingsStore * store) {
+  _store = store;
+}
+
+// Call once the store has loaded - picks up a session a reboot cut short, keeping its counters.  The sparge time carries on
+// from the last save, without the time the board was down, and the session ends as usual if no pump comes back on.
+void BrewStats::Resume(long currentMillis) {
+  if (!_counters.isSessionActive)
+    return;
+
+  _isSessionActive = true;
+  _sessionStartMillis = currentMillis - _counters.spargeMillis;
+  _lastActiveMillis = currentMillis;
+  _previousMillis = currentMillis;
+  _savedMillis = currentMillis;
+  _waterWasPumping = false;
+  _wortWasPumping = false;
+  _hasPeakGallons = false;
+  Log(currentMillis, F("Brew Stats"), F("Session resumed after a reboot"));
+}
+
+void BrewStats::Update(long currentMillis) {
+  bool isActive = _waterPump->GetIsActive() || _wortPump->GetIsActive();
+
+  if (!_isSessionActive) {
+    if (isActive)
+      StartSession(currentMillis);
+    return;
+  }
+
+  unsigned long elapsed = currentMillis - _previousMillis;
+  _previousMillis = currentMillis;
+
+  if (isActive) {
+    _lastActiveMillis = currentMillis;
+    _counters.spargeMillis = _lastActiveMillis - _sessionStartMillis;
+  } else if (currentMillis - _lastActiveMillis >= SESSION_END_DELAY) {
+    EndSession(currentMillis);
+    return;
+  }
+
+  // Pump duty and relay cycles
+  bool waterIsPumping = _waterPump->IsPumping();
+  bool wortIsPumping = _wortPump->IsPumping();
+  if (waterIsPumping)
+    _counters.waterOnMillis += elapsed;
+  if (wortIsPumping)
+    _counters.wortOnMillis += elapsed;
+  if (waterIsPumping && !_waterWasPumping)
+    _counters.waterCycles++;
+  if (wortIsPumping && !_wortWasPumping)
+    _counters.wortCycles++;
+  _waterWasPumping = waterIsPumping;
+  _wortWasPumping = wortIsPumping;
+
+  // Alarm time
+  if (_waterPump->IsAlarming())
+    _counters.mashHighAlarmMillis += elapsed;
+  if (_wortPump->IsAlarming())
+    _counters.boilAlarmMillis += elapsed;
+
+  // Volume transferred only counts rises above the highest volume seen, so sensor noise does not add up
+  if (_boilPressureSensor != NULL && _boilPressureSensor->IsConnected()) {
+    float gallons = _boilPressureSensor->GetGallons();
+    if (!_hasPeakGallons) {
+      _peakGallons = gallons;
+      _hasPeakGallons = true;
+    } else if (gallons > _peakGallons) {
+      _counters.gallonsTransferred += gallons - _peakGallons;
+      _peakGallons = gallons;
+    }
+  }
+
+  if (currentMillis - _savedMillis >= (unsigned long)SAVE_INTERVAL)
+    Save(currentMillis);
+}
+
+int BrewStats::GetStatCount() {
+  return 9;
+}
+
+String BrewStats::GetStatName(int index) {
+  switch (index) {
+    case 0: return F("Water Pump On");
+    case 1: return F("Water Cycles");
+    case 2: return F("Wort Pump On");
+    case 3: return F("Wort Cycles");
+    case 4: return F("Mash High Alarm");
+    case 5: return F("Boil Alarm");
+    case 6: return F("Gal Transferred");
+    case 7: return F("Avg Fill Rate");
+    case 8: return F("Sparge Time");
+  }
+  return "";
+}
+
+String BrewStats::GetStatValue(int index) {
+  float number = GetStatNumber(index);
+  switch (index) {
+    case 0: return String(number, 1) + F(" min");
+    case 1: return String((unsigned long)number);
+    case 2: return String(number, 1) + F(" min");
+    case 3: return String((unsigned long)number);
+    case 4: return String((unsigned long)number) + F(" sec");
+    case 5: return String((unsigned long)number) + F(" sec");
+    case 6: return String(number, 2) + F(" gal");
+    case 7: return String(number, 2) + F(" gal/min");
+    case 8: return String(number, 1) + F(" min");
+  }
+  return "";
+}
+
+// The stat as a plain number in the units GetStatValue shows, for reports
+float BrewStats::GetStatNumber(int index) {
+  switch (index) {
+    case 0: return _counters.waterOnMillis / 60000.0;
+    case 1: return _counters.waterCycles;
+    case 2: return _counters.wortOnMillis / 60000.0;
+    case 3: return _counters.wortCycles;
+    case 4: return _counters.mashHighAlarmMillis / 1000;
+    case 5: return _counters.boilAlarmMillis / 1000;
+    case 6: return _counters.gallonsTransferred;
+    case 7: {
+      float minutes = GetSpargeMinutes();
+      return minutes > 0 ? _counters.gallonsTransferred / minutes : 0;
+    }
+    case 8: return GetSpargeMinutes();
+  }
+  return 0;
+}
+
+// Counts finished sessions, so a watcher can tell when a new set of stats is final
+unsigned long BrewStats::GetSessionCount() {
+  return _counters.sessionCount;
+}
+
+// Sends every counter out to the serial port
+void BrewStats::Dump(long currentMillis) {
+  for (int i = 0; i < GetStatCount(); i++) {
+    Log(currentMillis, F("Brew Stats"), GetStatName(i) + F(" = ") + GetStatValue(i));
+  }
+}
+
+// Private - Clears the counters for a new brew session
+void BrewStats::StartSession(long currentMillis) {
+  _isSessionActive = true;
+  _sessionStartMillis = currentMillis;
+  _lastActiveMillis = currentMillis;
+  _previousMillis = currentMillis;
+  _savedMillis = currentMillis;
+  _waterWasPumping = false;
+  _wortWasPumping = false;
+  _hasPeakGallons = false;
+
+  _counters.spargeMillis = 0;
+  _counters.waterOnMillis = 0;
+  _counters.wortOnMillis = 0;
+  _counters.waterCycles = 0;
+  _counters.wortCycles = 0;
+  _counters.mashHighAlarmMillis = 0;
+  _counters.boilAlarmMillis = 0;
+  _counters.gallonsTransferred = 0;
+  _counters.isSessionActive = true;
+  Log(currentMillis, F("Brew Stats"), F("Session started"));
+  Save(currentMillis);
+}
+
+// Private - Closes the session and dumps the counters, which stay readable until the next session starts
+void BrewStats::EndSession(long currentMillis) {
+  _isSessionActive = false;
+  _counters.isSessionActive = false;
+  _counters.sessionCount++;
+  Log(currentMillis, F("Brew Stats"), F("Session ended"));
+  Dump(currentMillis);
+  Save(currentMillis);
+}
+
+// Private - Wall clock minutes from the first pump activation to the last
+float BrewStats::GetSpargeMinutes() {
+  return _counters.spargeMillis / 60000.0;
+}
+
+// Private
+void BrewStats::Save(long currentMillis) {
+  _savedMillis = currentMillis;
+  if (_store != NULL)
+    _store->Save(currentMillis);
+}
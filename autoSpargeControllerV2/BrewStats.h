@@ -0,0 +1,70 @@
+/*
+  BrewStats.h - Library for tracking the runtime counters of a brew session, such as pump duty, relay cycles and volume transferred.
+  Created by Tom Wallace.
+*/
+#ifndef BrewStats_h
+#define BrewStats_h
+
+#include "Arduino.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+#include "SettingsStore.h"
+
+// Bump when BrewCounters changes, so old records are ignored
+#define STATS_VERSION 2
+
+// The counters kept in EEPROM, so the last session's stats survive a reboot
+struct BrewCounters {
+  unsigned long waterOnMillis;
+  unsigned long wortOnMillis;
+  unsigned long waterCycles;
+  unsigned long wortCycles;
+  unsigned long mashHighAlarmMillis;
+  unsigned long boilAlarmMillis;
+  unsigned long spargeMillis;  // Wall clock from the first pump activation to the last
+  float gallonsTransferred;
+  unsigned long sessionCount;
+  bool isSessionActive;  // A session was running at the last save, so a reboot picks it back up
+};
+
+class BrewStats : public Loggable {
+  private:
+	long SESSION_END_DELAY;
+	IPump * _waterPump;
+	IPump * _wortPump;
+	PressureSensor * _boilPressureSensor;
+	bool _isSessionActive;
+	unsigned long _sessionStartMillis;
+	unsigned long _lastActiveMillis;
+	unsigned long _previousMillis;
+	bool _waterWasPumping;
+	bool _wortWasPumping;
+	bool _hasPeakGallons;
+	float _peakGallons;
+
+	long SAVE_INTERVAL;
+	unsigned long _savedMillis;
+	SettingsStore * _store;
+	BrewCounters _counters;
+
+	void StartSession(long currentMillis);
+	void EndSession(long currentMillis);
+	float GetSpargeMinutes();
+	void Save(long currentMillis);
+
+  public: 
+	BrewStats(IPump * waterPump, IPump * wortPump, PressureSensor * boilPressureSensor);
+	BrewCounters * GetCounters();
+	void SetStore(SettingsStore * store);
+	void Resume(long currentMillis);
+	void Update(long currentMillis);
+	int GetStatCount();
+	String GetStatName(int index);
+	String GetStatValue(int index);
+	float GetStatNumber(int index);
+	unsigned long GetSessionCount();
+	void Dump(long currentMillis);
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+  BufferedLcd.cpp - Library that gives the menus a 16x2 frame to draw into, and only sends the characters that changed to the LCD
+  shield through FastLcd, a run at a time within the time the bus scheduler allows.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "BufferedLcd.h"
+#include "FastLcd.h"
+
+BufferedLcd::BufferedLcd(FastLcd * lcd) {
+  _lcd = lcd;
+  _column = 0;
+  _row = 0;
+  _backlight = 0;
+  _shownBacklight = 0;
+
+  // The shield starts cleared
+  memset(_frame, ' ', sizeof(_frame));
+  memset(_shown, ' ', sizeof(_shown));
+}
+
+void BufferedLcd::clear() {
+  memset(_frame, ' ', sizeof(_frame));
+  _column = 0;
+  _row = 0;
+}
+
+void BufferedLcd::setCursor(uint8_t column, uint8_t row) {
+  _column = column;
+  _row = row;
+}
+
+void BufferedLcd::setBacklight(uint8_t color) {
+  _backlight = color;
+}
+
+// Characters past the end of a row are dropped, since the LCD would not show them
+size_t BufferedLcd::write(uint8_t value) {
+  if (_row < LCD_ROWS && _column < LCD_COLUMNS)
+    _frame[_row][_column] = value;
+  _column++;
+  return 1;
+}
+
+// Sends changed characters until maxMicros is used up - returns true once the LCD matches the frame.  The first run is always sent,
+// even with no time left, so a busy loop can slow the LCD down but never starve it
+bool BufferedLcd::Flush(unsigned long maxMicros) {
+  unsigned long startMicros = micros();
+  bool hasSent = false;
+
+  if (_backlight != _shownBacklight) {
+    _lcd->SetBacklight(_backlight);
+    _shownBacklight = _backlight;
+  }
+
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    uint8_t column = 0;
+    while (column < LCD_COLUMNS) {
+      if (_frame[row][column] == _shown[row][column]) {
+        column++;
+        continue;
+      }
+
+      if (hasSent && micros() - startMicros >= maxMicros)
+        return false;
+
+      // Send the whole run of changed characters in one go, since the LCD moves its cursor along with each one
+      uint8_t runStart = column;
+      while (column < LCD_COLUMNS && _frame[row][column] != _shown[row][column]) {
+        _shown[row][column] = _frame[row][column];
+        column++;
+      }
+      _lcd->SetCursor(runStart, row);
+      _lcd->Write(&_frame[row][runStart], column - runStart);
+      hasSent = true;
+    }
+  }
+  return true;
+}
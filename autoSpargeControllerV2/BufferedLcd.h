@@ -0,0 +1,35 @@
+/*
+  BufferedLcd.h - Library that gives the menus a 16x2 frame to draw into, and only sends the characters that changed to the LCD
+  shield through FastLcd, a run at a time within the time the bus scheduler allows.
+  Created by Tom Wallace.
+*/
+#ifndef BufferedLcd_h
+#define BufferedLcd_h
+
+#include "Arduino.h"
+#include "FastLcd.h"
+
+#define LCD_COLUMNS 16
+#define LCD_ROWS 2
+
+class BufferedLcd : public Print {
+  private:
+	FastLcd * _lcd;
+	uint8_t _frame[LCD_ROWS][LCD_COLUMNS];  // What the menus have drawn
+	uint8_t _shown[LCD_ROWS][LCD_COLUMNS];  // What is on the LCD
+	uint8_t _column;
+	uint8_t _row;
+	uint8_t _backlight;
+	uint8_t _shownBacklight;
+
+  public: 
+	BufferedLcd(FastLcd * lcd);
+	void clear();
+	void setCursor(uint8_t column, uint8_t row);
+	void setBacklight(uint8_t color);
+	virtual size_t write(uint8_t value);
+	using Print::write;
+	bool Flush(unsigned long maxMicros);
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+  BusScheduler.cpp - Library for sharing the I2C bus between its devices within a time budget for each pass through loop(),
+  and counting each device's transactions and latency.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "BusScheduler.h"
+#include "Loggable.h"
+
+BusScheduler::BusScheduler(unsigned long loopBudget, long reportInterval) {
+  _loopBudget = loopBudget;  // Microseconds of bus time for each pass through loop()
+  _reportInterval = reportInterval;  // Milliseconds between logging the counters
+  _tickStartMicros = 0;
+  _previousReportMillis = 0;
+  _numDevices = 0;
+}
+
+// Returns the index to record the device's transactions under
+int BusScheduler::AddDevice(const __FlashStringHelper * deviceName) {
+  if (_numDevices >= MAX_BUS_DEVICES)
+    return -1;
+
+  _deviceNames[_numDevices] = deviceName;
+  _transactions[_numDevices] = 0;
+  _totalMicros[_numDevices] = 0;
+  _maxMicros[_numDevices] = 0;
+  return _numDevices++;
+}
+
+// Starts the budget for this pass through loop() - call before the sensor transactions, which always run first
+void BusScheduler::Begin() {
+  _tickStartMicros = micros();
+}
+
+// Returns the bus time left for lower priority work, such as flushing the LCD
+unsigned long BusScheduler::GetRemainingMicros() {
+  unsigned long used = micros() - _tickStartMicros;
+  return used >= _loopBudget ? 0 : _loopBudget - used;
+}
+
+// Counts a transaction for the device that started at startMicros and has just finished
+void BusScheduler::Record(int device, unsigned long startMicros) {
+  if (device < 0 || device >= _numDevices)
+    return;
+
+  unsigned long latency = micros() - startMicros;
+  _transactions[device]++;
+  _totalMicros[device] += latency;
+  if (latency > _maxMicros[device])
+    _maxMicros[device] = latency;
+}
+
+// Logs the counters on the report interval
+void BusScheduler::Update(long currentMillis) {
+  if (currentMillis - _previousReportMillis < (unsigned long)_reportInterval)
+    return;
+  _previousReportMillis = currentMillis;
+
+  for (int i = 0; i < _numDevices; i++) {
+    unsigned long average = _transactions[i] > 0 ? _totalMicros[i] / _transactions[i] : 0;
+    Log(currentMillis, F("Bus Scheduler"), String(_deviceNames[i]) + F(" - ") + String(_transactions[i]) + F(" transactions, avg ") + String(average) + F(" us, max ") + String(_maxMicros[i]) + F(" us"));
+  }
+}
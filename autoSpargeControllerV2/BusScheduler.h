@@ -0,0 +1,36 @@
+/*
+  BusScheduler.h - Library for sharing the I2C bus between its devices within a time budget for each pass through loop(),
+  and counting each device's transactions and latency.
+  Created by Tom Wallace.
+*/
+#ifndef BusScheduler_h
+#define BusScheduler_h
+
+#include "Arduino.h"
+#include "Loggable.h"
+
+#define MAX_BUS_DEVICES 2  // The pressure sensor and the LCD
+
+class BusScheduler : public Loggable {
+  private:
+	unsigned long _loopBudget;
+	long _reportInterval;
+	unsigned long _tickStartMicros;
+	unsigned long _previousReportMillis;
+
+	const __FlashStringHelper * _deviceNames[MAX_BUS_DEVICES];
+	int _numDevices;
+	unsigned long _transactions[MAX_BUS_DEVICES];
+	unsigned long _totalMicros[MAX_BUS_DEVICES];
+	unsigned long _maxMicros[MAX_BUS_DEVICES];
+
+  public: 
+	BusScheduler(unsigned long loopBudget, long reportInterval);
+	int AddDevice(const __FlashStringHelper * deviceName);
+	void Begin();
+	unsigned long GetRemainingMicros();
+	void Record(int device, unsigned long startMicros);
+	void Update(long currentMillis);
+};
+
+#endif
@@ -8,7 +8,7 @@
 #include "EventQueue.h"
 #include "Loggable.h"
 
-Button::Button(String buttonName, int buttonPin, int inputType, int lightPin, EventQueue * buzzerEventQueue) {
+Button::Button(const __FlashStringHelper * buttonName, int buttonPin, int inputType, int lightPin, EventQueue * buzzerEventQueue) {
     ButtonName = buttonName;  // Name of the button for logging
     ButtonPin = buttonPin;  // The pin number attached to the button
     LightPin = lightPin;  // The pin the button light is attached to
@@ -20,6 +20,7 @@ Button::Button(String buttonName, int buttonPin, int inputType, int lightPin, Ev
     EligibleToBeClicked = true;  // Used with delay to prevent "burst" clicking
     EligibleToBeClickedMillis = 0;  // To determine when to set the EligibleToBeClicked flag
     MatchingFunctionOn = false; // Used to pair the button with a pump function
+    IsDepressed = false; // Level read by the last Update
 	
 	BUTTON_BEEP_LENGTH = 10;  // Length of beep when button pressed
 	HAS_BEEN_CLICKED_DELAY = 500; // Length of delay before button is eligible for clicking again (prevents burst by holding button down)
@@ -29,15 +30,27 @@ bool Button::IsCurrentlyDepressed() {
     return (digitalRead(ButtonPin) == LOW);
 }
 
+// The level the last Update acted on, rather than a fresh read of the pin
+bool Button::WasDepressed() {
+    return IsDepressed;
+}
+
 bool Button::GetMatchingFunctionOn() {
     return MatchingFunctionOn;
 }
 
+// Turns the matching function on or off as if the button had been clicked, such as for a command from the serial port
+void Button::SetMatchingFunctionOn(bool isOn) {
+    MatchingFunctionOn = isOn;
+}
+
 void Button::Update(long currentMillis) {    
+    IsDepressed = IsCurrentlyDepressed();
+
     // Determine if button has been clicked
-    if (IsCurrentlyDepressed() && EligibleToBeClicked) {
+    if (IsDepressed && EligibleToBeClicked) {
       // Log click
-      Log(currentMillis, ButtonName, "currently pushed.");
+      Log(currentMillis, ButtonName, F("currently pushed."));
       
       EligibleToBeClicked = false;
       EligibleToBeClickedMillis = currentMillis + HAS_BEEN_CLICKED_DELAY;
@@ -51,7 +64,7 @@ void Button::Update(long currentMillis) {
     }
 
     // Determine when button is eligible to be clicked again to prevent button bursting
-    if (!IsCurrentlyDepressed() && (currentMillis > EligibleToBeClickedMillis)) {
+    if (!IsDepressed && (currentMillis > EligibleToBeClickedMillis)) {
       EligibleToBeClicked = true;
     }
 
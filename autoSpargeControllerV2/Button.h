@@ -14,18 +14,21 @@ class Button : public Loggable {
 	int BUTTON_BEEP_LENGTH;
 	int HAS_BEEN_CLICKED_DELAY;
 	EventQueue * _buzzerEventQueue;
-	String ButtonName;
+	const __FlashStringHelper * ButtonName;
 	int ButtonPin;
 	int LightPin;
 	long TurnOffClickSoundMillis;
 	bool EligibleToBeClicked;
 	long EligibleToBeClickedMillis;
 	bool MatchingFunctionOn;
+	bool IsDepressed;
 
   public: 
-	Button(String buttonName, int buttonPin, int inputType, int lightPin, EventQueue * buzzerEventQueue);
+	Button(const __FlashStringHelper * buttonName, int buttonPin, int inputType, int lightPin, EventQueue * buzzerEventQueue);
 	bool IsCurrentlyDepressed();
+	bool WasDepressed();
 	bool GetMatchingFunctionOn();
+	void SetMatchingFunctionOn(bool isOn);
 	void Update(long currentMillis);
 };
 
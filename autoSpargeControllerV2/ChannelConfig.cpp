@@ -0,0 +1,53 @@
+/*
+  ChannelConfig.cpp - Library for describing probe and pump channels in a table, and building them from it.
+  Created by Tom Wallace.
+*/
+#include "Arduino.h"
+#include "ChannelConfig.h"
+#include "DebouncedProbe.h"
+#include "EventQueue.h"
+#include "IProbe.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "MajorityProbe.h"
+#include "Probe.h"
+#include "WaterPump.h"
+#include "WortPump.h"
+
+ProbeConfig ReadProbeConfig(const ProbeConfig * row) {
+  ProbeConfig config;
+  memcpy_P(&config, row, sizeof(config));
+  return config;
+}
+
+PumpConfig ReadPumpConfig(const PumpConfig * row) {
+  PumpConfig config;
+  memcpy_P(&config, row, sizeof(config));
+  return config;
+}
+
+// Channels are built once at start up and never freed, so the heap does not fragment
+// The raw input is handed back through input, for anything that must see the same reads as the filter
+IProbe * BuildProbe(const ProbeConfig & config, IProbe ** input) {
+  const __FlashStringHelper * name = FPSTR(config.name);
+
+  // The raw input only logs through the filter that wraps it, so shares its name
+  Probe * rawInput = new Probe(name, config.pin, INPUT);
+  rawInput->SetIsLogging(false);
+  *input = rawInput;
+
+  if (config.filter == PROBE_MAJORITY)
+    return new MajorityProbe(name, rawInput, config.confirmTime, MAJORITY_VOTES, MAJORITY_SAMPLES, config.filterTime);
+
+  return new DebouncedProbe(name, rawInput, config.confirmTime, config.filterTime);
+}
+
+IPump * BuildPump(const PumpConfig & config, IProbe ** probes, EventQueue * alarmEventQueue) {
+  IProbe * probe = probes[config.probe];
+  IProbe * alarmProbe = config.alarmProbe == NO_CHANNEL ? probe : probes[config.alarmProbe];
+
+  if (config.type == PUMP_WATER)
+    return new WaterPump(FPSTR(config.name), config.pin, config.timing, alarmEventQueue, FPSTR(config.alarmEvent), probe, alarmProbe);
+
+  return new WortPump(FPSTR(config.name), config.pin, config.timing, alarmEventQueue, FPSTR(config.alarmEvent), probe);
+}
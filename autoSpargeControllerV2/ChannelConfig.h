@@ -0,0 +1,53 @@
+/*
+  ChannelConfig.h - Library for describing probe and pump channels in a table, and building them from it.
+  Created by Tom Wallace.
+*/
+#ifndef ChannelConfig_h
+#define ChannelConfig_h
+
+#include "Arduino.h"
+#include "EventQueue.h"
+#include "IProbe.h"
+#include "IPump.h"
+
+// Probe filters
+#define PROBE_DEBOUNCE 0
+#define PROBE_MAJORITY 1
+
+// Votes a majority filtered probe needs out of its samples
+#define MAJORITY_VOTES 4
+#define MAJORITY_SAMPLES 5
+
+// Pump types
+#define PUMP_WATER 0
+#define PUMP_WORT 1
+
+// Used in place of a probe index when a pump has no alarm probe
+#define NO_CHANNEL -1
+
+// The tables are kept in flash with PROGMEM, names too, so a row is read out with ReadProbeConfig or ReadPumpConfig
+struct ProbeConfig {
+  const char * name;  // PROGMEM
+  int pin;
+  int filter;
+  long confirmTime;  // Milliseconds the input must stay touching before the probe touches, so a splash does not stop a pump
+  long filterTime;  // Dwell for a debounced probe, sample interval for a majority probe, in ms
+};
+
+struct PumpConfig {
+  const char * name;  // PROGMEM
+  int type;
+  int pin;
+  long timing;  // Delay after a probe change for a water pump, on interval for a wort pump, in ms
+  int probe;  // Index of the probe that stops the pump
+  int alarmProbe;  // Index of the probe that raises the alarm, or NO_CHANNEL to alarm on the stopping probe
+  const char * alarmEvent;  // PROGMEM
+  int button;  // Index of the button that makes the pump active
+};
+
+ProbeConfig ReadProbeConfig(const ProbeConfig * row);
+PumpConfig ReadPumpConfig(const PumpConfig * row);
+IProbe * BuildProbe(const ProbeConfig & config, IProbe ** input);
+IPump * BuildPump(const PumpConfig & config, IProbe ** probes, EventQueue * alarmEventQueue);
+
+#endif
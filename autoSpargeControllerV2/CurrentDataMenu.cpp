@@ -3,38 +3,40 @@
   Created by Tom Wallace.
 */
 
-#include "Adafruit_RGBLCDShield.h"
+#include "BufferedLcd.h"
 #include "Arduino.h"
 #include "CurrentDataMenu.h"
-#include "IProbe.h"
+#include "PressureSensor.h"
+#include "VesselSettings.h"
 
-CurrentDataMenu::CurrentDataMenu(IProbe * probe, Adafruit_RGBLCDShield * lcd) {
+CurrentDataMenu::CurrentDataMenu(PressureSensor * probe, BufferedLcd * lcd) {
    _probe = probe;
    _lcd = lcd;
 }
 
 String CurrentDataMenu::GetName() {
-  return "Current Data";
+  return F("Current Data");
 }
 
 void CurrentDataMenu::Interact(int button) {
-  extern float boilStopOne;  // Set in main program for the first gallon stop for the boil
-  extern float boilStopTwo;  // Set in main program for the second gallon stop for the boil
-  extern bool atBoilStopOne; // Set in main program for using the first gallon
   extern int selectedMenu;   // Set in main program for currently selected menu
-  extern bool boilShowGallons;  // Set in main program as an option to show gallons or pressure
+  VesselSettings * settings = _probe->GetSettings();
   
   // Draw
-  if (boilShowGallons) {
+  if (settings->showGallons) {
     _lcd->setCursor(0, 0);
-    _lcd->print("Curr/Targ Gal");
+    // Once the fill rate is known, alternate the header with the ETA to each stop
+    String header = F("Curr/Targ Gal");
+    if (_probe->GetMinutesToGallons(settings->stopTwo) >= 0 && (millis() / ETA_ALTERNATE_MILLIS) % 2 == 1)
+      header = String(F("ETA ")) + FormatEta(settings->stopOne) + F("/") + FormatEta(settings->stopTwo);
+    _lcd->print(FitRow(header));
     _lcd->setCursor(0, 1);
-    String suffix = atBoilStopOne ? "[" + String(boilStopOne,1) + "]/" + String(boilStopTwo,1) : String(boilStopOne,1) + "/[" + String(boilStopTwo,1) + "]";
-    String displayValue = _probe->Display() + "/" + suffix;
-    _lcd->print(displayValue);
+    String suffix = settings->atStopOne ? String(F("[")) + String(settings->stopOne,1) + F("]/") + String(settings->stopTwo,1) : String(settings->stopOne,1) + F("/[") + String(settings->stopTwo,1) + F("]");
+    String displayValue = _probe->Display() + F("/") + suffix;
+    _lcd->print(FitRow(displayValue));
   } else {
     _lcd->setCursor(0, 0);
-    _lcd->print("Current Pressure");
+    _lcd->print(F("Current Pressure"));
     _lcd->setCursor(0, 1);
     _lcd->print(_probe->Display());
   }
@@ -46,4 +48,23 @@ void CurrentDataMenu::Interact(int button) {
         selectedMenu = 0;
         return;
    }
-}
\ No newline at end of file
+}
+
+// Private - Formats the minutes until the kettle reaches the gallons, or -- when the fill rate is unknown
+String CurrentDataMenu::FormatEta(float gallons) {
+  float minutes = _probe->GetMinutesToGallons(gallons);
+  if (minutes < 0)
+    return F("--");
+
+  return String((int)(minutes + 0.5)) + F("m");
+}
+
+// Private - Pads or clips the text to exactly one LCD row, so it never wraps or leaves old characters behind
+String CurrentDataMenu::FitRow(String text) {
+  if (text.length() > LCD_COLUMNS)
+    return text.substring(0, LCD_COLUMNS);
+
+  while (text.length() < LCD_COLUMNS)
+    text += ' ';
+  return text;
+}
@@ -5,19 +5,24 @@
 #ifndef CurrentDataMenu_h
 #define CurrentDataMenu_h
 
-#include "Adafruit_RGBLCDShield.h"
+#include "BufferedLcd.h"
 #include "Arduino.h"
 #include "IMenu.h"
-#include "IProbe.h"
+#include "PressureSensor.h"
+
+#define ETA_ALTERNATE_MILLIS 3000  // Milliseconds the header and the ETA each show for
 
 class CurrentDataMenu : public IMenu {
   public: 
-	CurrentDataMenu(IProbe * probe, Adafruit_RGBLCDShield * lcd);
+	CurrentDataMenu(PressureSensor * probe, BufferedLcd * lcd);
 	virtual String GetName();
     virtual void Interact(int button);
   private:
-    IProbe * _probe;
-	Adafruit_RGBLCDShield * _lcd;
+    PressureSensor * _probe;
+	BufferedLcd * _lcd;
+
+	String FormatEta(float gallons);
+	String FitRow(String text);
 };
 
 #endif
\ No newline at end of file
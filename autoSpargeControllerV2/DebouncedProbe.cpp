@@ -0,0 +1,63 @@
+/*
+  DebouncedProbe.cpp - Library for wrapping a probe so it reports touching once the wrapped probe has stayed touching for a short confirm
+  time, and only clears once it has stayed clear for a longer dwell time.  A stop input stops the pump on any touch that lasts, while
+  splashes neither stop it nor let it restart early.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "DebouncedProbe.h"
+#include "IProbe.h"
+#include "Loggable.h"
+
+DebouncedProbe::DebouncedProbe(const __FlashStringHelper * probeName, IProbe * probe, long confirm, long dwell) {
+  ProbeName = probeName;
+  _probe = probe;
+  _confirm = confirm;  // Milliseconds the wrapped probe must stay touching before this one touches
+  _dwell = dwell;  // Milliseconds the wrapped probe must stay clear before this one clears
+  _isTouching = false;
+  _changeStartMillis = 0;
+  _isChanging = false;
+  _rejectedCount = 0;
+}
+
+bool DebouncedProbe::IsTouching() {
+  return _isTouching;
+}
+
+void DebouncedProbe::Update(long currentMillis) {
+  _probe->Update(currentMillis);
+  bool isTouching = _probe->IsTouching();
+
+  // Wrapped probe went back before the change was confirmed, so the reading was a glitch
+  if (isTouching == _isTouching) {
+    if (_isChanging)
+      _rejectedCount++;
+    _isChanging = false;
+    return;
+  }
+
+  if (!_isChanging) {
+    _isChanging = true;
+    _changeStartMillis = currentMillis;
+  }
+
+  // A touch only has to outlast a splash, so the pump still stops quickly, while clearing waits out the full dwell
+  if (currentMillis - _changeStartMillis < (isTouching ? _confirm : _dwell))
+    return;
+
+  _isChanging = false;
+  _isTouching = isTouching;
+  if (isTouching)
+    Log(currentMillis, ProbeName, F("State has changed to TOUCH LIQUID"));
+  else
+    Log(currentMillis, ProbeName, F("State has changed to CLEAR"));
+}
+
+String DebouncedProbe::Display() {
+  return _probe->Display();
+}
+
+unsigned long DebouncedProbe::GetRejectedCount() {
+  return _rejectedCount;
+}
@@ -0,0 +1,33 @@
+/*
+  DebouncedProbe.h - Library for wrapping a probe so it reports touching once the wrapped probe has stayed touching for a short confirm
+  time, and only clears once it has stayed clear for a longer dwell time.  A stop input stops the pump on any touch that lasts, while
+  splashes neither stop it nor let it restart early.
+  Created by Tom Wallace.
+*/
+#ifndef DebouncedProbe_h
+#define DebouncedProbe_h
+
+#include "Arduino.h"
+#include "IProbe.h"
+#include "Loggable.h"
+
+class DebouncedProbe : public IProbe, public Loggable {
+  private:
+	const __FlashStringHelper * ProbeName;
+	IProbe * _probe;
+	long _confirm;
+	long _dwell;
+	bool _isTouching;
+	long _changeStartMillis;
+	bool _isChanging;
+	unsigned long _rejectedCount;
+
+  public: 
+	DebouncedProbe(const __FlashStringHelper * probeName, IProbe * probe, long confirm, long dwell);
+	bool IsTouching();
+	void Update(long currentMillis);
+	String Display();
+	unsigned long GetRejectedCount();
+};
+
+#endif
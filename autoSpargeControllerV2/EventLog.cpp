@@ -0,0 +1,223 @@
+/*
+  EventLog.cpp - Library for keeping the last critical events, such as pump changes, alarms and resets, in an EEPROM ring
+  so they can be read back after the controller reboots mid-brew.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "EventLog.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "LoopWatchdog.h"
+#include "PressureSensor.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+EventLog::EventLog(int address, int numSlots, IPump ** pumps, int numPumps, PressureSensor * pressureSensor, LoopWatchdog * loopWatchdog) {
+  FLUSH_INTERVAL = 30000;  // Milliseconds an event may wait for others to share its write
+  FLUSH_BATCH = 4;  // Events that are worth writing without waiting
+
+  _address = address;  // First EEPROM byte of the ring
+  _numSlots = numSlots;
+  _pumps = pumps;
+  _numPumps = min(numPumps, MAX_LOGGED_PUMPS);
+  _pressureSensor = pressureSensor;  // NULL in builds without the pressure sensor
+  _loopWatchdog = loopWatchdog;
+
+  _headSlot = -1;
+  _numStored = 0;
+  _sequence = 0;
+  _numPending = 0;
+  _firstPendingMillis = 0;
+  _isUrgent = false;
+  _writeOffset = -1;
+  _droppedCount = 0;
+  _isWatching = false;
+  _wasConnected = false;
+  _stallCount = 0;
+}
+
+// Finds the newest stored event, then records why the board last reset
+void EventLog::Begin(long currentMillis) {
+  LogEvent event;
+  uint16_t newestSequence = 0;
+
+  // A fixed number of slots to check, so boot takes the same time however full the log is
+  for (int slot = 0; slot < _numSlots; slot++) {
+    if (!ReadSlot(slot, &event))
+      continue;
+    if (_headSlot == -1 || (int16_t)(event.sequence - newestSequence) > 0) {
+      newestSequence = event.sequence;
+      _headSlot = slot;
+    }
+    _numStored++;
+  }
+  _sequence = newestSequence;
+  Log(currentMillis, F("Event Log"), String(_numStored) + F(" events from before this boot"));
+
+  uint8_t resetFlags = _loopWatchdog->GetResetFlags();
+  Add(currentMillis, EVENT_RESET, resetFlags, true);
+  if (resetFlags & _BV(WDRF))
+    Add(currentMillis, EVENT_WATCHDOG_RESET, _loopWatchdog->GetResetStage(), true);
+}
+
+// Queues an event for the next batch, or the next loop when urgent
+void EventLog::Add(long currentMillis, uint8_t code, uint8_t detail, bool isUrgent) {
+  if (_numPending == MAX_PENDING_EVENTS) {
+    _droppedCount++;
+    return;
+  }
+
+  if (_numPending == 0)
+    _firstPendingMillis = currentMillis;
+  _isUrgent = _isUrgent || isUrgent;
+
+  LogEvent * event = &_pending[_numPending++];
+  event->sequence = ++_sequence;
+  event->code = code;
+  event->detail = detail;
+  event->millis = currentMillis;
+  event->crc = GetCrc(event);
+}
+
+void EventLog::Update(long currentMillis) {
+  WatchForEvents(currentMillis);
+
+  if (_writeOffset < 0) {
+    if (_numPending == 0)
+      return;
+    if (!_isUrgent && _numPending < FLUSH_BATCH && currentMillis - _firstPendingMillis < (unsigned long)FLUSH_INTERVAL)
+      return;
+    _writeOffset = 0;
+  }
+
+  // Write one byte per loop, since each EEPROM write holds up the loop for over 3 ms
+  int slot = (_headSlot + 1) % _numSlots;
+  EEPROM.update(GetSlotAddress(slot) + _writeOffset, ((uint8_t *)&_pending[0])[_writeOffset]);
+  _writeOffset++;
+  if (_writeOffset < (int)sizeof(LogEvent))
+    return;
+
+  // A write cut short by a reboot fails its CRC, and the log simply ends one event earlier
+  _headSlot = slot;
+  _numStored = min(_numStored + 1, _numSlots);
+  _numPending--;
+  memmove(_pending, _pending + 1, _numPending * sizeof(LogEvent));
+
+  // Keep going until the whole batch is written
+  _writeOffset = _numPending > 0 ? 0 : -1;
+  if (_numPending == 0) {
+    _isUrgent = false;
+    if (_droppedCount > 0) {
+      Log(currentMillis, F("Event Log"), String(F("Dropped ")) + String(_droppedCount) + F(" events waiting to be written"));
+      _droppedCount = 0;
+    }
+  }
+}
+
+int EventLog::GetCount() {
+  return _numStored;
+}
+
+// Reads a stored event, where age 0 is the newest
+bool EventLog::GetEvent(int age, LogEvent * event) {
+  if (age < 0 || age >= _numStored)
+    return false;
+  return ReadSlot((_headSlot - age + _numSlots) % _numSlots, event);
+}
+
+String EventLog::GetEventText(LogEvent * event) {
+  String number = String(event->detail + 1);
+  switch (event->code) {
+    case EVENT_RESET:
+      if (event->detail & _BV(WDRF))
+        return F("Reset: watchdog");
+      if (event->detail & _BV(BORF))
+        return F("Reset: brownout");
+      if (event->detail & _BV(EXTRF))
+        return F("Reset: button");
+      if (event->detail & _BV(PORF))
+        return F("Reset: power on");
+      return F("Reset");
+    case EVENT_WATCHDOG_RESET:
+      return String(F("Hung: ")) + _loopWatchdog->GetStageName(event->detail);
+    case EVENT_LOOP_STALL:
+      return String(F("Stall: ")) + _loopWatchdog->GetStageName(event->detail);
+    case EVENT_PUMP_ON:
+      return String(F("Pump ")) + number + F(" on");
+    case EVENT_PUMP_OFF:
+      return String(F("Pump ")) + number + F(" off");
+    case EVENT_ALARM_ON:
+      return String(F("Alarm ")) + number + F(" on");
+    case EVENT_ALARM_OFF:
+      return String(F("Alarm ")) + number + F(" off");
+    case EVENT_SENSOR_LOST:
+      return F("Sensor lost");
+    case EVENT_SENSOR_FOUND:
+      return F("Sensor found");
+  }
+  return String(F("Event ")) + String(event->code);
+}
+
+// Time since the boot the event happened in, as +H:MM:SS
+String EventLog::GetEventTime(LogEvent * event) {
+  unsigned long seconds = event->millis / 1000;
+  unsigned int minutes = (seconds / 60) % 60;
+  unsigned int secs = seconds % 60;
+  return String(F("+")) + String(seconds / 3600) + (minutes < 10 ? F(":0") : F(":")) + String(minutes) + (secs < 10 ? F(":0") : F(":")) + String(secs);
+}
+
+// Private - Logs changes in pump activity, alarms, the pressure sensor and loop stalls
+void EventLog::WatchForEvents(long currentMillis) {
+  bool isConnected = _pressureSensor != NULL && _pressureSensor->IsConnected();
+  unsigned long stallCount = _loopWatchdog->GetStallCount();
+
+  // Only the switches and alarms are logged - each pumping cycle would wear the EEPROM out within weeks
+  for (int i = 0; i < _numPumps; i++) {
+    bool isActive = _pumps[i]->GetIsActive();
+    bool isAlarming = _pumps[i]->IsAlarming();
+    if (_isWatching && isActive != _wasActive[i])
+      Add(currentMillis, isActive ? EVENT_PUMP_ON : EVENT_PUMP_OFF, i, false);
+    if (_isWatching && isAlarming != _wasAlarming[i])
+      Add(currentMillis, isAlarming ? EVENT_ALARM_ON : EVENT_ALARM_OFF, i, isAlarming);
+    _wasActive[i] = isActive;
+    _wasAlarming[i] = isAlarming;
+  }
+
+  if (_isWatching && isConnected != _wasConnected)
+    Add(currentMillis, isConnected ? EVENT_SENSOR_FOUND : EVENT_SENSOR_LOST, 0, !isConnected);
+  if (_isWatching && stallCount != _stallCount)
+    Add(currentMillis, EVENT_LOOP_STALL, _loopWatchdog->GetLastOverrunStage(), true);
+
+  _wasConnected = isConnected;
+  _stallCount = stallCount;
+  _isWatching = true;
+}
+
+// First EEPROM byte after the ring, for anything stored behind it
+int EventLog::GetEndAddress() {
+  return GetSlotAddress(_numSlots);
+}
+
+// Private
+int EventLog::GetSlotAddress(int slot) {
+  return _address + slot * sizeof(LogEvent);
+}
+
+// Private - Returns false unless the slot holds a good event
+bool EventLog::ReadSlot(int slot, LogEvent * event) {
+  int address = GetSlotAddress(slot);
+  for (unsigned int i = 0; i < sizeof(LogEvent); i++)
+    ((uint8_t *)event)[i] = EEPROM.read(address + i);
+
+  // Erased EEPROM reads as 0xFF, which is never a code
+  return event->code != 0xFF && event->crc == GetCrc(event);
+}
+
+// Private - CRC of everything in the event before the CRC itself
+uint8_t EventLog::GetCrc(LogEvent * event) {
+  uint8_t crc = 0;
+  for (unsigned int i = 0; i < offsetof(LogEvent, crc); i++)
+    crc = _crc8_ccitt_update(crc, ((uint8_t *)event)[i]);
+  return crc;
+}
@@ -0,0 +1,84 @@
+/*
+  EventLog.h - Library for keeping the last critical events, such as pump changes, alarms and resets, in an EEPROM ring
+  so they can be read back after the controller reboots mid-brew.
+  Created by Tom Wallace.
+*/
+#ifndef EventLog_h
+#define EventLog_h
+
+#include "Arduino.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "LoopWatchdog.h"
+#include "PressureSensor.h"
+
+// Event codes
+#define EVENT_RESET 1  // Detail is MCUSR from before the reset
+#define EVENT_WATCHDOG_RESET 2  // Detail is the stage that hung
+#define EVENT_LOOP_STALL 3  // Detail is the stage that stalled
+#define EVENT_PUMP_ON 4  // Detail is the pump index for these four
+#define EVENT_PUMP_OFF 5
+#define EVENT_ALARM_ON 6
+#define EVENT_ALARM_OFF 7
+#define EVENT_SENSOR_LOST 8
+#define EVENT_SENSOR_FOUND 9
+
+#define MAX_PENDING_EVENTS 8
+#define MAX_LOGGED_PUMPS 4
+
+struct LogEvent {
+  uint16_t sequence;  // Counts up with each event, so the newest slot can be found after a reboot
+  uint8_t code;
+  uint8_t detail;
+  unsigned long millis;  // Time since the boot the event happened in
+  uint8_t crc;
+};
+
+class EventLog : public Loggable {
+  private:
+	long FLUSH_INTERVAL;
+	int FLUSH_BATCH;
+	int _address;
+	int _numSlots;
+	IPump ** _pumps;
+	int _numPumps;
+	PressureSensor * _pressureSensor;
+	LoopWatchdog * _loopWatchdog;
+
+	int _headSlot;  // Slot of the newest stored event
+	int _numStored;
+	uint16_t _sequence;
+
+	// Events wait here to be written in a batch
+	LogEvent _pending[MAX_PENDING_EVENTS];
+	int _numPending;
+	unsigned long _firstPendingMillis;
+	bool _isUrgent;
+	int _writeOffset;  // Next byte of _pending[0] to write, or -1 when not writing
+	unsigned long _droppedCount;
+
+	// Last seen states, to spot changes
+	bool _isWatching;
+	bool _wasActive[MAX_LOGGED_PUMPS];
+	bool _wasAlarming[MAX_LOGGED_PUMPS];
+	bool _wasConnected;
+	unsigned long _stallCount;
+
+	int GetSlotAddress(int slot);
+	bool ReadSlot(int slot, LogEvent * event);
+	uint8_t GetCrc(LogEvent * event);
+	void WatchForEvents(long currentMillis);
+
+  public: 
+	EventLog(int address, int numSlots, IPump ** pumps, int numPumps, PressureSensor * pressureSensor, LoopWatchdog * loopWatchdog);
+	void Begin(long currentMillis);
+	void Add(long currentMillis, uint8_t code, uint8_t detail, bool isUrgent);
+	void Update(long currentMillis);
+	int GetCount();
+	bool GetEvent(int age, LogEvent * event);
+	String GetEventText(LogEvent * event);
+	String GetEventTime(LogEvent * event);
+	int GetEndAddress();
+};
+
+#endif
@@ -0,0 +1,50 @@
+/*
+  EventLogMenu.cpp - Menu item that pages through the events kept in EEPROM, newest first
+  Created by Tom Wallace.
+*/
+
+#include "BufferedLcd.h"
+#include "Arduino.h"
+#include "EventLog.h"
+#include "EventLogMenu.h"
+
+EventLogMenu::EventLogMenu(EventLog * eventLog, BufferedLcd * lcd) {
+   _eventLog = eventLog;
+   _lcd = lcd;
+   _eventIndex = 0;
+}
+
+String EventLogMenu::GetName() {
+  return F("Event Log");
+}
+
+void EventLogMenu::Interact(int button) {
+  extern int selectedMenu;   // Set in main program for currently selected menu
+  
+  // Draw
+  LogEvent event;
+  _lcd->setCursor(0, 0);
+  if (_eventLog->GetEvent(_eventIndex, &event)) {
+    _lcd->print(_eventLog->GetEventText(&event));
+    _lcd->setCursor(0, 1);
+    _lcd->print(_eventLog->GetEventTime(&event) + F(" #") + String(_eventIndex + 1));
+  } else {
+    _lcd->print(F("No events"));
+  }
+
+  // Interact
+  switch (button) {
+    case 2:  // Newer event
+        _lcd->clear();
+        _eventIndex = constrain(_eventIndex - 1, 0, max(_eventLog->GetCount() - 1, 0));
+        return;
+    case 3:  // Older event
+        _lcd->clear();
+        _eventIndex = constrain(_eventIndex + 1, 0, max(_eventLog->GetCount() - 1, 0));
+        return;
+    case 4:  // This case will execute if the "back" button is pressed
+        _lcd->clear();
+        selectedMenu = 0;
+        return;
+   }
+}
@@ -0,0 +1,24 @@
+/*
+  EventLogMenu.h - Menu item that pages through the events kept in EEPROM, newest first
+  Created by Tom Wallace.
+*/
+#ifndef EventLogMenu_h
+#define EventLogMenu_h
+
+#include "BufferedLcd.h"
+#include "Arduino.h"
+#include "EventLog.h"
+#include "IMenu.h"
+
+class EventLogMenu : public IMenu {
+  public: 
+	EventLogMenu(EventLog * eventLog, BufferedLcd * lcd);
+	virtual String GetName();
+    virtual void Interact(int button);
+  private:
+	EventLog * _eventLog;
+	BufferedLcd * _lcd;
+	int _eventIndex;
+};
+
+#endif
@@ -6,7 +6,7 @@
 #include "Arduino.h"
 #include "EventQueue.h"
 
-EventQueue::EventQueue(String queueName)
+EventQueue::EventQueue(const __FlashStringHelper * queueName)
 {
 	_queue = "";
     _queueName = queueName;
@@ -26,4 +26,8 @@ void EventQueue::RemoveEvent(String event) {
 
 bool EventQueue::IsPopulated() {
     return (_queue.length() > 0);
+}
+
+bool EventQueue::HasEvent(String event) {
+    return (_queue.indexOf(event) != -1);
 }
\ No newline at end of file
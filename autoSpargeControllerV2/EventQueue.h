@@ -10,13 +10,14 @@
 class EventQueue {
   private: 
 	String _queue;
-	String _queueName;
+	const __FlashStringHelper * _queueName;
   
   public: 
-	EventQueue(String queueName);
+	EventQueue(const __FlashStringHelper * queueName);
 	void AddEvent(String event);
 	void RemoveEvent(String event);
 	bool IsPopulated();
+	bool HasEvent(String event);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+  FastLcd.cpp - Library for driving the RGB LCD shield's HD44780 through its MCP23017 with whole characters per I2C transaction.
+  The MCP23017 is put in byte mode so repeated writes land on GPIOB, and each nibble goes out as two writes, enable high then low.
+  Call Begin() after the Adafruit_RGBLCDShield has initialized the LCD - the Adafruit drawing calls can not be used after that.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "FastLcd.h"
+
+// MCP23017 registers with IOCON.BANK = 0
+#define MCP_IOCON 0x0A
+#define MCP_GPIOA 0x12
+#define MCP_GPIOB 0x13
+#define MCP_IOCON_SEQOP 0x20
+
+// Shield wiring on GPIOB - D7 to D4 are on bits 1 to 4, in reverse order
+#define LCD_BLUE_BIT 0x01
+#define LCD_ENABLE_BIT 0x20
+#define LCD_RS_BIT 0x80
+
+// Wire buffer is 32 bytes - one goes to the register address and each character takes four
+#define LCD_CHARS_PER_TRANSACTION 7
+
+FastLcd::FastLcd(uint8_t address) {
+  _address = address;
+  _portB = 0;  // Blue backlight is active low, so on
+  _bytesSent = 0;
+}
+
+// Switches the MCP23017 to byte mode and the bus to 400 kHz
+void FastLcd::Begin() {
+  Wire.setClock(400000);
+  WriteRegister(MCP_IOCON, MCP_IOCON_SEQOP);
+}
+
+void FastLcd::SetCursor(uint8_t column, uint8_t row) {
+  uint8_t command = 0x80 | (column + (row == 0 ? 0x00 : 0x40));
+  Send(&command, 1, false);
+}
+
+// Writes characters at the cursor, several to a transaction
+void FastLcd::Write(const uint8_t * values, uint8_t count) {
+  Send(values, count, true);
+}
+
+// Colors are the shield's red, green and blue bits, which drive active low outputs
+void FastLcd::SetBacklight(uint8_t color) {
+  uint8_t portA = ((~color & 0x01) << 6) | (((~color >> 1) & 0x01) << 7);
+  _portB = (~color >> 2) & LCD_BLUE_BIT;
+  WriteRegister(MCP_GPIOA, portA);
+  WriteRegister(MCP_GPIOB, _portB);
+}
+
+// Returns the pressed buttons as the BUTTON_ bits of Adafruit_RGBLCDShield, which are GPIOA bits 0 to 4 pulled low when pressed
+uint8_t FastLcd::ReadButtons() {
+  Wire.beginTransmission(_address);
+  Wire.write(MCP_GPIOA);
+  Wire.endTransmission();
+  Wire.requestFrom(_address, (uint8_t)1);
+  return ~Wire.read() & 0x1F;
+}
+
+unsigned long FastLcd::GetBytesSent() {
+  return _bytesSent;
+}
+
+// Private - Writes one MCP23017 register
+void FastLcd::WriteRegister(uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(_address);
+  Wire.write(reg);
+  Wire.write(value);
+  Wire.endTransmission();
+  _bytesSent += 2;
+}
+
+// Private - Sends bytes to the LCD as commands or data, strobing enable for each nibble in the same transaction
+void FastLcd::Send(const uint8_t * values, uint8_t count, bool isData) {
+  uint8_t base = _portB | (isData ? LCD_RS_BIT : 0);
+
+  for (uint8_t start = 0; start < count; start += LCD_CHARS_PER_TRANSACTION) {
+    uint8_t end = min(count, start + LCD_CHARS_PER_TRANSACTION);
+    Wire.beginTransmission(_address);
+    Wire.write(MCP_GPIOB);
+    for (uint8_t i = start; i < end; i++) {
+      uint8_t high = base | MapNibble(values[i] >> 4);
+      uint8_t low = base | MapNibble(values[i] & 0x0F);
+      Wire.write(high | LCD_ENABLE_BIT);
+      Wire.write(high);
+      Wire.write(low | LCD_ENABLE_BIT);
+      Wire.write(low);
+    }
+    Wire.endTransmission();
+    _bytesSent += 1 + ((end - start) * 4);
+  }
+}
+
+// Private - Moves nibble bits 0 to 3 (D4 to D7) onto GPIOB bits 4 to 1
+uint8_t FastLcd::MapNibble(uint8_t nibble) {
+  return ((nibble & 0x01) << 4) | ((nibble & 0x02) << 2) | (nibble & 0x04) | ((nibble & 0x08) >> 2);
+}
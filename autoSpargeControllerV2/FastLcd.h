@@ -0,0 +1,33 @@
+/*
+  FastLcd.h - Library for driving the RGB LCD shield's HD44780 through its MCP23017 with whole characters per I2C transaction.
+  The MCP23017 is put in byte mode so repeated writes land on GPIOB, and each nibble goes out as two writes, enable high then low.
+  Call Begin() after the Adafruit_RGBLCDShield has initialized the LCD - the Adafruit drawing calls can not be used after that.
+  Created by Tom Wallace.
+*/
+#ifndef FastLcd_h
+#define FastLcd_h
+
+#include "Arduino.h"
+#include <Wire.h>
+
+class FastLcd {
+  private:
+	uint8_t _address;
+	uint8_t _portB;  // GPIOB bits that stay put between nibbles - the blue backlight
+	unsigned long _bytesSent;
+
+	void WriteRegister(uint8_t reg, uint8_t value);
+	void Send(const uint8_t * values, uint8_t count, bool isData);
+	uint8_t MapNibble(uint8_t nibble);
+
+  public: 
+	FastLcd(uint8_t address);
+	void Begin();
+	void SetCursor(uint8_t column, uint8_t row);
+	void Write(const uint8_t * values, uint8_t count);
+	void SetBacklight(uint8_t color);
+	uint8_t ReadButtons();
+	unsigned long GetBytesSent();
+};
+
+#endif
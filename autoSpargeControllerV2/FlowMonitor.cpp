@@ -0,0 +1,95 @@
+/*
+  FlowMonitor.cpp - Library for detecting a dry-running wort pump or stuck grain bed, where the pump runs but the boil kettle volume does not rise.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "EventQueue.h"
+#include "FlowMonitor.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+
+FlowMonitor::FlowMonitor(IPump * wortPump, PressureSensor * boilPressureSensor, EventQueue * alarmEventQueue, long onTimeWindow, float minGallons, bool pauseOnStall) {
+  _wortPump = wortPump;
+  _boilPressureSensor = boilPressureSensor;
+  _alarmEventQueue = alarmEventQueue;
+
+  _onTimeWindow = onTimeWindow;  // Milliseconds of pump on-time to watch for flow
+  _minGallons = minGallons;  // Gallons the kettle must rise over the window
+  _pauseOnStall = pauseOnStall;  // Pause the pump when a stall is detected
+
+  // Wort takes TRANSIT_TIME to run from the pump to the kettle, then up to a sample interval to be read and a window to fill the
+  // average - both are the sensor's AVERAGE_WINDOW once sampling is sparse - so 6 + 2 + 2 = 10 sec with the sketch defaults
+  FLOW_LAG = TRANSIT_TIME + (2 * boilPressureSensor->GetAverageWindow());
+  _isStalled = false;
+  _isWindowOpen = false;
+  _startGallons = 0;
+  _windowMillis = 0;
+  _onMillis = 0;
+  _previousMillis = 0;
+  _lastPumpingMillis = 0;
+}
+
+bool FlowMonitor::IsStalled() {
+  return _isStalled;
+}
+
+void FlowMonitor::Update(long currentMillis) {
+  unsigned long elapsed = currentMillis - _previousMillis;
+  _previousMillis = currentMillis;
+
+  // Turning the wort pump off acknowledges a stall
+  if (!_wortPump->GetIsActive()) {
+    if (_isStalled)
+      Log(currentMillis, F("Flow Monitor"), F("Stall acknowledged"));
+    _isStalled = false;
+    _wortPump->SetIsPaused(false, PAUSE_DRY_RUN);
+    _alarmEventQueue->RemoveEvent(F("DryRun"));
+    ResetWindow();
+    return;
+  }
+
+  if (_isStalled)
+    return;
+
+  if (!_boilPressureSensor->IsConnected()) {
+    ResetWindow();
+    return;
+  }
+
+  if (!_isWindowOpen) {
+    _isWindowOpen = true;
+    _startGallons = _boilPressureSensor->GetGallons();
+    _windowMillis = currentMillis;
+    _onMillis = 0;
+  }
+
+  if (_wortPump->IsPumping()) {
+    _onMillis += elapsed;
+    _lastPumpingMillis = currentMillis;
+  }
+
+  // Judge the window once the flow from its on-time has had time to show up in the kettle
+  if (_onMillis < (unsigned long)_onTimeWindow)
+    return;
+  bool flowHasArrived = (currentMillis - _lastPumpingMillis >= (unsigned long)FLOW_LAG) || (_onMillis >= (unsigned long)(_onTimeWindow + FLOW_LAG));
+  if (!flowHasArrived)
+    return;
+
+  float gained = _boilPressureSensor->GetGallons() - _startGallons;
+  if (gained < _minGallons) {
+    _isStalled = true;
+    _wortPump->SetIsPaused(_pauseOnStall, PAUSE_DRY_RUN);
+    _alarmEventQueue->AddEvent(F("DryRun"));
+    // The time since the window opened is the detection latency, so the constants can be checked against a real stall on the bench
+    Log(currentMillis, F("Flow Monitor"), String(F("Stall detected - kettle rose ")) + String(gained, 2) + F(" gal over ") + String(_onMillis / 1000) + F(" sec of pumping, ") + String((currentMillis - _windowMillis) / 1000) + F(" sec after the window opened"));
+  }
+  ResetWindow();
+}
+
+// Private - Starts watching a fresh window of pump on-time
+void FlowMonitor::ResetWindow() {
+  _isWindowOpen = false;
+  _onMillis = 0;
+}
@@ -0,0 +1,41 @@
+/*
+  FlowMonitor.h - Library for detecting a dry-running wort pump or stuck grain bed, where the pump runs but the boil kettle volume does not rise.
+  Created by Tom Wallace.
+*/
+#ifndef FlowMonitor_h
+#define FlowMonitor_h
+
+#include "Arduino.h"
+#include "EventQueue.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+
+#define TRANSIT_TIME 6000L  // Milliseconds allowed for wort to run through the hose
+
+class FlowMonitor : public Loggable {
+  private:
+	long FLOW_LAG;
+	IPump * _wortPump;
+	PressureSensor * _boilPressureSensor;
+	EventQueue * _alarmEventQueue;
+	long _onTimeWindow;
+	float _minGallons;
+	bool _pauseOnStall;
+	bool _isStalled;
+	bool _isWindowOpen;
+	float _startGallons;
+	unsigned long _windowMillis;
+	unsigned long _onMillis;
+	unsigned long _previousMillis;
+	unsigned long _lastPumpingMillis;
+
+	void ResetWindow();
+
+  public: 
+	FlowMonitor(IPump * wortPump, PressureSensor * boilPressureSensor, EventQueue * alarmEventQueue, long onTimeWindow, float minGallons, bool pauseOnStall);
+	bool IsStalled();
+	void Update(long currentMillis);
+};
+
+#endif
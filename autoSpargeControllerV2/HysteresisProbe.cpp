@@ -0,0 +1,60 @@
+/*
+  HysteresisProbe.cpp - Library for wrapping an analog-backed probe so it only clears once its value falls a band below the threshold.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "HysteresisProbe.h"
+#include "IAnalogProbe.h"
+#include "Loggable.h"
+
+HysteresisProbe::HysteresisProbe(const __FlashStringHelper * probeName, IAnalogProbe * probe, float band) {
+  ProbeName = probeName;
+  _probe = probe;
+  _band = band;  // How far below the threshold the value must fall to clear
+  _isTouching = false;
+  _wasProbeTouching = false;
+  _rejectedCount = 0;
+}
+
+bool HysteresisProbe::IsTouching() {
+  return _isTouching;
+}
+
+void HysteresisProbe::Update(long currentMillis) {
+  _probe->Update(currentMillis);
+
+  bool isProbeTouching = _probe->IsTouching();
+  bool isTouching = _isTouching;
+  if (isProbeTouching) {
+    isTouching = true;
+  } else if (_probe->GetValue() < _probe->GetThreshold() - _band) {
+    isTouching = false;
+  } else if (_isTouching && _wasProbeTouching) {
+    // Wrapped probe cleared inside the band, so hold the state
+    _rejectedCount++;
+  }
+  _wasProbeTouching = isProbeTouching;
+
+  if (isTouching != _isTouching) {
+    _isTouching = isTouching;
+    String state = _isTouching ? F("TOUCH LIQUID") : F("CLEAR");
+    Log(currentMillis, ProbeName, String(F("State has changed to ")) + state); 
+  }
+}
+
+String HysteresisProbe::Display() {
+  return _probe->Display();
+}
+
+float HysteresisProbe::GetValue() {
+  return _probe->GetValue();
+}
+
+float HysteresisProbe::GetThreshold() {
+  return _probe->GetThreshold();
+}
+
+unsigned long HysteresisProbe::GetRejectedCount() {
+  return _rejectedCount;
+}
@@ -0,0 +1,31 @@
+/*
+  HysteresisProbe.h - Library for wrapping an analog-backed probe so it only clears once its value falls a band below the threshold.
+  Created by Tom Wallace.
+*/
+#ifndef HysteresisProbe_h
+#define HysteresisProbe_h
+
+#include "Arduino.h"
+#include "IAnalogProbe.h"
+#include "Loggable.h"
+
+class HysteresisProbe : public IAnalogProbe, public Loggable {
+  private:
+	const __FlashStringHelper * ProbeName;
+	IAnalogProbe * _probe;
+	float _band;
+	bool _isTouching;
+	bool _wasProbeTouching;
+	unsigned long _rejectedCount;
+
+  public: 
+	HysteresisProbe(const __FlashStringHelper * probeName, IAnalogProbe * probe, float band);
+	bool IsTouching();
+	void Update(long currentMillis);
+	String Display();
+	float GetValue();
+	float GetThreshold();
+	unsigned long GetRejectedCount();
+};
+
+#endif
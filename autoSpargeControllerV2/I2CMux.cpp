@@ -0,0 +1,29 @@
+/*
+  I2CMux.cpp - Library for a TCA9548A style I2C multiplexer, which lets devices with the same fixed address sit on their own channels.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "I2CMux.h"
+
+I2CMux::I2CMux(uint8_t address) {
+  _address = address;
+  _selectedChannel = -1;  // Unknown until the first select
+}
+
+// Connects the channel to the bus, skipping the write when it is already selected - returns false if the mux did not answer
+bool I2CMux::Select(int channel) {
+  if (channel == _selectedChannel)
+    return true;
+
+  Wire.beginTransmission(_address);
+  Wire.write((uint8_t)(1 << channel));
+  if (Wire.endTransmission() != 0) {
+    _selectedChannel = -1;
+    return false;
+  }
+
+  _selectedChannel = channel;
+  return true;
+}
@@ -0,0 +1,21 @@
+/*
+  I2CMux.h - Library for a TCA9548A style I2C multiplexer, which lets devices with the same fixed address sit on their own channels.
+  Created by Tom Wallace.
+*/
+#ifndef I2CMux_h
+#define I2CMux_h
+
+#include "Arduino.h"
+#include <Wire.h>
+
+class I2CMux {
+  private:
+	uint8_t _address;
+	int _selectedChannel;
+
+  public: 
+	I2CMux(uint8_t address);
+	bool Select(int channel);
+};
+
+#endif
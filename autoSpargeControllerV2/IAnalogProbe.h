@@ -0,0 +1,18 @@
+/*
+  IAnalogProbe.h - Header library file for interface for probe inputs backed by an analog value compared to a threshold
+  Created by Tom Wallace.
+*/
+#ifndef IAnalogProbe_h
+#define IAnalogProbe_h
+
+#include "Arduino.h"
+#include "IProbe.h"
+
+class IAnalogProbe : public IProbe {
+  public: 
+    virtual ~IAnalogProbe() {};
+    virtual float GetValue() = 0;
+    virtual float GetThreshold() = 0;
+};
+
+#endif
@@ -0,0 +1,29 @@
+/*
+  IPump.h - Header library file for interface for pump outputs
+  Created by Tom Wallace.
+*/
+#ifndef IPump_h
+#define IPump_h
+
+#include "Arduino.h"
+#include "IProbe.h"
+
+// Each source of a pause holds its own bit, so one clearing its pause never lifts another's
+#define PAUSE_DRY_RUN 0x01  // Flow monitor stall
+#define PAUSE_HOST 0x02  // Serial protocol command
+#define PAUSE_STALL 0x04  // Loop watchdog, set from an interrupt
+
+class IPump {
+  public: 
+    virtual ~IPump() {};
+    virtual void SetIsActive(bool isActive) = 0;
+    virtual bool GetIsActive() = 0;
+    virtual void SetIsPaused(bool isPaused, uint8_t source) = 0;
+    virtual void ForcePause(uint8_t source) = 0;
+    virtual bool IsPumping() = 0;
+    virtual bool IsAlarming() = 0;
+    virtual void SetProbe(IProbe * probe) = 0;
+    virtual void Update(long currentMillis) = 0;
+};
+
+#endif
@@ -7,8 +7,48 @@
 #include "Loggable.h"
 #include "EventQueue.h"
 
-Loggable::Loggable() {};
-  
+bool Loggable::_isAllLogging = true;
+
 void Loggable::Log(long currentMillis, String callingObjName, String msg) {
-	Serial.println(String(currentMillis) + " - " + callingObjName + ": " + msg);
+	if (!StartLine(currentMillis))
+		return;
+
+	Serial.print(callingObjName);
+	Serial.print(F(": "));
+	Serial.println(msg);
+}
+
+// For a name kept in flash with F(), so the literal never takes a copy in RAM
+void Loggable::Log(long currentMillis, const __FlashStringHelper * callingObjName, String msg) {
+	if (!StartLine(currentMillis))
+		return;
+
+	Serial.print(callingObjName);
+	Serial.print(F(": "));
+	Serial.println(msg);
+}
+
+// Private - Prints the time that starts a log line, or returns false when this object is quiet
+bool Loggable::StartLine(long currentMillis) {
+	if (!_isLogging || !_isAllLogging)
+		return false;
+
+	Serial.print(currentMillis);
+	Serial.print(F(" - "));
+	return true;
+}
+
+// Lets a wrapped object go quiet when whatever wraps it logs instead
+void Loggable::SetIsLogging(bool isLogging) {
+	_isLogging = isLogging;
+}
+
+// Quiets every object at once, such as when the serial port is carrying something else
+void Loggable::SetAllLogging(bool isAllLogging) {
+	_isAllLogging = isAllLogging;
+}
+
+// For anything that prints to the serial port itself, so it goes quiet along with the log lines
+bool Loggable::IsAllLogging() {
+	return _isAllLogging;
 }
\ No newline at end of file
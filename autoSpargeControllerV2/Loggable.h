@@ -7,10 +7,25 @@
 
 #include "Arduino.h"
 
+// Names are kept in flash - F() where they are used in a function, a PROGMEM array passed through FPSTR() where they are not
+#ifndef FPSTR
+#define FPSTR(pstr) (reinterpret_cast<const __FlashStringHelper *>(pstr))
+#endif
+
 class Loggable {
+  private:
+	bool _isLogging;
+	static bool _isAllLogging;
+
+	bool StartLine(long currentMillis);
+
   public: 
-	Loggable();
+	Loggable() : _isLogging(true) {}  // Inline, so the vtable of an interface listed before Loggable can be dropped
 	void Log(long currentMillis, String callingObjName, String msg);
+	void Log(long currentMillis, const __FlashStringHelper * callingObjName, String msg);
+	void SetIsLogging(bool isLogging);
+	static void SetAllLogging(bool isAllLogging);
+	static bool IsAllLogging();
 };
 
 #endif
\ No newline at end of file
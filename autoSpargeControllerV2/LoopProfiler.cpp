@@ -0,0 +1,112 @@
+/*
+  LoopProfiler.cpp - Library for profiling the loop on the board, reporting the CPU cycles each stage takes and the deepest
+  the stack has reached, so firmware changes can be judged against the ATmega328 rather than a desktop.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "Loggable.h"
+#include "LoopProfiler.h"
+#include "LoopWatchdog.h"
+
+// Set by the linker and avr-libc - the end of static data, and the top of the heap or 0 before anything has been allocated
+extern uint8_t _end;
+extern char * __brkval;
+
+LoopProfiler::LoopProfiler(const char (* stageNames)[STAGE_NAME_SIZE], int numStages, long reportInterval) {
+  _stageNames = stageNames;  // In PROGMEM, shared with the loop watchdog
+  _numStages = min(numStages, MAX_PROFILED_STAGES);
+  _reportInterval = reportInterval;  // Milliseconds between reports
+  _previousMillis = 0;
+
+  _stage = -1;
+  _stageMicros = 0;
+  _loopMicros = 0;
+  for (int i = 0; i < MAX_PROFILED_STAGES; i++) {
+    _totalMicros[i] = 0;
+    _maxMicros[i] = 0;
+  }
+  _loopTotalMicros = 0;
+  _loopMaxMicros = 0;
+  _loops = 0;
+}
+
+// Call once the mode starts - paints the free RAM between the heap and the stack, so the deepest the loop takes the stack
+// can be found from what is left.  Only a profiling build calls this, and nothing runs before main to do it for the others.
+void LoopProfiler::Begin() {
+  uint8_t * p = __brkval == 0 ? &_end : (uint8_t *)__brkval;
+  uint8_t * stackPointer = (uint8_t *)SP;
+  while (p < stackPointer) {
+    *p = STACK_CANARY;
+    p++;
+  }
+}
+
+// Marks the start of a stage of the loop, closing out the one before it
+void LoopProfiler::Stage(int stage) {
+  unsigned long now = micros();
+  EndStage(now);
+  _stage = stage;
+  _stageMicros = now;
+}
+
+// Call once at the end of every loop
+void LoopProfiler::Update(long currentMillis) {
+  unsigned long now = micros();
+  EndStage(now);
+  _stage = -1;
+
+  if (_loops > 0) {
+    unsigned long loopMicros = now - _loopMicros;
+    _loopTotalMicros += loopMicros;
+    _loopMaxMicros = max(_loopMaxMicros, loopMicros);
+  }
+  _loops++;
+  _loopMicros = now;
+
+  if (currentMillis - _previousMillis < (unsigned long)_reportInterval || _loops < 2)
+    return;
+  _previousMillis = currentMillis;
+
+  // micros() counts in steps of 64 cycles, so averages over many loops are finer than any single reading
+  unsigned long loops = _loops - 1;
+  Log(currentMillis, F("Loop Profiler"), String(F("Loop avg ")) + String(ToCycles(_loopTotalMicros / loops)) + F(" cycles, max ") + String(ToCycles(_loopMaxMicros)) + F(" cycles over ") + String(loops) + F(" loops"));
+  for (int i = 0; i < _numStages; i++) {
+    Log(currentMillis, F("Loop Profiler"), String((const __FlashStringHelper *)_stageNames[i]) + F(" avg ") + String(ToCycles(_totalMicros[i] / loops)) + F(" cycles, max ") + String(ToCycles(_maxMicros[i])) + F(" cycles"));
+    _totalMicros[i] = 0;
+    _maxMicros[i] = 0;
+  }
+  uint8_t * heapEnd = __brkval == 0 ? &_end : (uint8_t *)__brkval;
+  int unusedStack = GetUnusedStack();
+  int peakStack = ((uint8_t *)RAMEND - heapEnd + 1) - unusedStack;
+  Log(currentMillis, F("Loop Profiler"), String(F("Stack peak ")) + String(peakStack) + F(" bytes, ") + String(unusedStack) + F(" bytes never used"));
+
+  _loopTotalMicros = 0;
+  _loopMaxMicros = 0;
+  _loops = 1;
+}
+
+// Bytes above the heap that still hold the paint, which the stack has never reached
+int LoopProfiler::GetUnusedStack() {
+  uint8_t * p = __brkval == 0 ? &_end : (uint8_t *)__brkval;
+  int unused = 0;
+  while (p <= (uint8_t *)RAMEND && *p == STACK_CANARY) {
+    unused++;
+    p++;
+  }
+  return unused;
+}
+
+// Private
+void LoopProfiler::EndStage(unsigned long now) {
+  if (_stage < 0 || _stage >= _numStages)
+    return;
+  unsigned long stageMicros = now - _stageMicros;
+  _totalMicros[_stage] += stageMicros;
+  _maxMicros[_stage] = max(_maxMicros[_stage], stageMicros);
+}
+
+// Private
+unsigned long LoopProfiler::ToCycles(unsigned long micros) {
+  return micros * (F_CPU / 1000000UL);
+}
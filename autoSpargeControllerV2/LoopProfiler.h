@@ -0,0 +1,43 @@
+/*
+  LoopProfiler.h - Library for profiling the loop on the board, reporting the CPU cycles each stage takes and the deepest
+  the stack has reached, so firmware changes can be judged against the ATmega328 rather than a desktop.
+  Created by Tom Wallace.
+*/
+#ifndef LoopProfiler_h
+#define LoopProfiler_h
+
+#include "Arduino.h"
+#include "Loggable.h"
+#include "LoopWatchdog.h"
+
+#define MAX_PROFILED_STAGES 8
+#define STACK_CANARY 0xC5
+
+class LoopProfiler : public Loggable {
+  private:
+	const char (* _stageNames)[STAGE_NAME_SIZE];
+	int _numStages;
+	long _reportInterval;
+	unsigned long _previousMillis;
+
+	int _stage;
+	unsigned long _stageMicros;
+	unsigned long _loopMicros;
+	unsigned long _totalMicros[MAX_PROFILED_STAGES];
+	unsigned long _maxMicros[MAX_PROFILED_STAGES];
+	unsigned long _loopTotalMicros;
+	unsigned long _loopMaxMicros;
+	unsigned long _loops;
+
+	void EndStage(unsigned long now);
+	static unsigned long ToCycles(unsigned long micros);
+
+  public: 
+	LoopProfiler(const char (* stageNames)[STAGE_NAME_SIZE], int numStages, long reportInterval);
+	void Begin();
+	void Stage(int stage);
+	void Update(long currentMillis);
+	static int GetUnusedStack();
+};
+
+#endif
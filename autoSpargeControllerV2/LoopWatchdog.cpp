@@ -0,0 +1,242 @@
+/*
+  LoopWatchdog.cpp - Library for catching a stalled loop, such as a hung I2C bus, and forcing the pumps off before a kettle overflows.
+  A software deadline is checked every millisecond from the Timer0 compare B interrupt, and the AVR hardware watchdog resets
+  the board if even that stops running.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "EventQueue.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "LoopWatchdog.h"
+#include <Wire.h>
+#include <avr/wdt.h>
+
+volatile unsigned long LoopWatchdog::_loopStartMillis = 0;
+volatile bool LoopWatchdog::_isTripped = false;
+volatile uint8_t LoopWatchdog::_trippedStage = NO_STAGE;
+long LoopWatchdog::_loopBudget = 0;
+int LoopWatchdog::_alarmPin = -1;
+IPump ** LoopWatchdog::_pumps = NULL;
+int LoopWatchdog::_numPumps = 0;
+bool LoopWatchdog::_isRunning = false;
+
+// Kept through a watchdog reset, so the stage that hung can be logged after the reboot
+uint8_t watchdogResetFlags __attribute__((section(".noinit")));
+uint8_t watchdogStage __attribute__((section(".noinit")));
+
+// Runs before the static constructors - after a watchdog reset the watchdog stays on at 16 ms and would reset again mid boot.
+// The host build has no .init3, so a high priority constructor stands in for it
+#ifdef __AVR__
+void saveResetFlags(void) __attribute__((naked, used, section(".init3")));
+#else
+void saveResetFlags(void) __attribute__((constructor(102)));
+#endif
+void saveResetFlags(void) {
+  watchdogResetFlags = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+LoopWatchdog::LoopWatchdog(long loopBudget, int alarmPin, EventQueue * alarmEventQueue, const char (* stageNames)[STAGE_NAME_SIZE], int numStages, long busClock) {
+
+  _loopBudget = loopBudget;  // Milliseconds a loop may take before the pumps are forced off
+  _alarmPin = alarmPin;
+  _alarmEventQueue = alarmEventQueue;
+  _stageNames = stageNames;  // In PROGMEM
+  _numStages = numStages;
+  _busClock = busClock;  // I2C clock to restore after recovering the bus
+
+  _stageMicros = 0;
+  _slowestStage = NO_STAGE;
+  _slowestMicros = 0;
+  _overruns = 0;
+  _stalls = 0;
+  _stallMillis = 0;
+  _isAlarming = false;
+  _lastOverrunStage = NO_STAGE;
+
+  // Static constructors run after the .init3 hook, so these still hold what it saved
+  _resetFlags = watchdogResetFlags;
+  _resetStage = watchdogStage;
+}
+
+// Pumps force paused on a stall, so each one knows its output went off
+void LoopWatchdog::SetPumps(IPump ** pumps, int numPumps) {
+  _pumps = pumps;
+  _numPumps = numPumps;
+}
+
+unsigned long LoopWatchdog::GetOverrunCount() {
+  return _overruns;
+}
+
+// Loops the interrupt caught and forced the pumps off for
+unsigned long LoopWatchdog::GetStallCount() {
+  return _stalls;
+}
+
+// Stage blamed for the last stall or slow loop
+int LoopWatchdog::GetLastOverrunStage() {
+  return _lastOverrunStage;
+}
+
+// MCUSR from before the last reset, such as _BV(WDRF) for a watchdog reset
+uint8_t LoopWatchdog::GetResetFlags() {
+  return _resetFlags;
+}
+
+// Stage that hung, when the last reset was from the watchdog
+uint8_t LoopWatchdog::GetResetStage() {
+  return _resetStage;
+}
+
+// Call at the end of setup, once the slow start up screens are done
+void LoopWatchdog::Begin(long currentMillis) {
+  if (_resetFlags & _BV(WDRF)) {
+    Log(currentMillis, F("Loop Watchdog"), String(F("Reset by the hardware watchdog during ")) + GetStageName(_resetStage));
+    RaiseAlarm(currentMillis);
+  }
+  watchdogStage = NO_STAGE;
+
+  // Interrupt after 1 s to force the pins safe, then reset on the next 1 s if the loop is still stuck
+  noInterrupts();
+  wdt_reset();
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | _BV(WDE) | _BV(WDP2) | _BV(WDP1);
+  interrupts();
+
+  // Share Timer0 with millis() and the beepers, checking the deadline every millisecond
+  _loopStartMillis = millis();
+  _isRunning = true;
+  OCR0B = 0x40;
+  TIMSK0 |= _BV(OCIE0B);
+}
+
+// Marks the start of a stage of the loop, so a stall can be blamed on it
+void LoopWatchdog::Stage(int stage) {
+  unsigned long now = micros();
+  if (watchdogStage != NO_STAGE && now - _stageMicros > _slowestMicros) {
+    _slowestMicros = now - _stageMicros;
+    _slowestStage = watchdogStage;
+  }
+  _stageMicros = now;
+  watchdogStage = stage;
+}
+
+// Call once at the end of every loop
+void LoopWatchdog::Update(long currentMillis) {
+  Stage(NO_STAGE);
+  wdt_reset();
+
+  // Re-arm the interrupt, which the hardware clears each time it fires
+  WDTCSR |= _BV(WDIE);
+
+  unsigned long now = millis();
+  if (_isTripped) {
+    _overruns++;
+    _stalls++;
+    _lastOverrunStage = _trippedStage;
+    Log(currentMillis, F("Loop Watchdog"), String(F("Loop stalled past ")) + String(_loopBudget) + F(" ms during ") + GetStageName(_trippedStage) + F(", pumps were forced off"));
+    RaiseAlarm(currentMillis);
+    _isTripped = false;
+
+    // The loop is running again, so the pumps can go back to following their probes
+    for (int i = 0; i < _numPumps; i++)
+      _pumps[i]->SetIsPaused(false, PAUSE_STALL);
+  } else if (now - _loopStartMillis > (unsigned long)_loopBudget) {
+    // Slow but finished before the interrupt caught it, so just say where the time went
+    _overruns++;
+    _lastOverrunStage = _slowestStage;
+    Log(currentMillis, F("Loop Watchdog"), String(F("Loop took ")) + String(now - _loopStartMillis) + F(" ms, slowest was ") + GetStageName(_slowestStage) + F(" at ") + String(_slowestMicros) + F(" us"));
+  }
+
+  // A bus timeout means a device held the bus, so clock it free before the next loop uses it
+  if (Wire.getWireTimeoutFlag()) {
+    Wire.clearWireTimeoutFlag();
+    RecoverBus(currentMillis);
+  }
+
+  if (_isAlarming && currentMillis - _stallMillis >= (unsigned long)STALL_ALARM_HOLD) {
+    _isAlarming = false;
+    _alarmEventQueue->RemoveEvent(F("LoopStall"));
+  }
+
+  _slowestStage = NO_STAGE;
+  _slowestMicros = 0;
+
+  // The interrupt reads this, so it must not see half a write
+  noInterrupts();
+  _loopStartMillis = millis();
+  interrupts();
+}
+
+// Called from the Timer0 compare B interrupt
+void LoopWatchdog::Tick() {
+  if (!_isRunning || _isTripped)
+    return;
+
+  if (millis() - _loopStartMillis > (unsigned long)_loopBudget)
+    Trip();
+}
+
+// Force pauses the pumps and turns the alarm on - the next loop to finish lifts the pause
+void LoopWatchdog::Trip() {
+  for (int i = 0; i < _numPumps; i++)
+    _pumps[i]->ForcePause(PAUSE_STALL);
+  if (_alarmPin >= 0)
+    digitalWrite(_alarmPin, HIGH);
+
+  _trippedStage = watchdogStage;
+  _isTripped = true;
+}
+
+String LoopWatchdog::GetStageName(int stage) {
+  if (stage < 0 || stage >= _numStages)
+    return F("no stage");
+  return String((const __FlashStringHelper *)_stageNames[stage]);
+}
+
+// Private
+void LoopWatchdog::RaiseAlarm(long currentMillis) {
+  _isAlarming = true;
+  _stallMillis = currentMillis;
+  _alarmEventQueue->AddEvent(F("LoopStall"));
+}
+
+// Private - Clocks SCL until a device holding SDA low lets go, then sends a stop and restarts Wire
+void LoopWatchdog::RecoverBus(long currentMillis) {
+  Wire.end();
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+
+  int pulses = 0;
+  while (digitalRead(SDA) == LOW && pulses < 9) {
+    pinMode(SCL, OUTPUT);
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    pinMode(SCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+    pulses++;
+  }
+
+  // Stop condition - SDA rises while SCL is high
+  pinMode(SDA, OUTPUT);
+  digitalWrite(SDA, LOW);
+  delayMicroseconds(5);
+  pinMode(SDA, INPUT_PULLUP);
+  delayMicroseconds(5);
+
+  Wire.begin();
+  Wire.setClock(_busClock);
+  Log(currentMillis, F("Loop Watchdog"), String(F("Recovered I2C bus after ")) + String(pulses) + F(" clock pulses"));
+}
+
+ISR(TIMER0_COMPB_vect) {
+  LoopWatchdog::Tick();
+}
+
+ISR(WDT_vect) {
+  LoopWatchdog::Trip();
+}
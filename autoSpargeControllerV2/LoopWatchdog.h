@@ -0,0 +1,65 @@
+/*
+  LoopWatchdog.h - Library for catching a stalled loop, such as a hung I2C bus, and forcing the pumps off before a kettle overflows.
+  A software deadline is checked every millisecond from the Timer0 compare B interrupt, and the AVR hardware watchdog resets
+  the board if even that stops running.
+  Created by Tom Wallace.
+*/
+#ifndef LoopWatchdog_h
+#define LoopWatchdog_h
+
+#include "Arduino.h"
+#include "EventQueue.h"
+#include "IPump.h"
+#include "Loggable.h"
+
+#define NO_STAGE 0xFF
+#define STAGE_NAME_SIZE 9  // Longest stage name and its terminator, so the names fit one PROGMEM table
+#define STALL_ALARM_HOLD 10000L  // Milliseconds to keep sounding after a stall so the brewer hears it
+
+class LoopWatchdog : public Loggable {
+  private:
+	EventQueue * _alarmEventQueue;
+	const char (* _stageNames)[STAGE_NAME_SIZE];
+	int _numStages;
+	long _busClock;
+	unsigned long _stageMicros;
+	int _slowestStage;
+	unsigned long _slowestMicros;
+	unsigned long _overruns;
+	unsigned long _stalls;
+	unsigned long _stallMillis;
+	bool _isAlarming;
+	int _lastOverrunStage;
+	uint8_t _resetFlags;
+	uint8_t _resetStage;
+
+	// Shared with the interrupts
+	static volatile unsigned long _loopStartMillis;
+	static volatile bool _isTripped;
+	static volatile uint8_t _trippedStage;
+	static long _loopBudget;
+	static int _alarmPin;
+	static IPump ** _pumps;
+	static int _numPumps;
+	static bool _isRunning;
+
+	void RaiseAlarm(long currentMillis);
+	void RecoverBus(long currentMillis);
+
+  public: 
+	LoopWatchdog(long loopBudget, int alarmPin, EventQueue * alarmEventQueue, const char (* stageNames)[STAGE_NAME_SIZE], int numStages, long busClock);
+	void SetPumps(IPump ** pumps, int numPumps);
+	void Begin(long currentMillis);
+	void Stage(int stage);
+	void Update(long currentMillis);
+	unsigned long GetOverrunCount();
+	unsigned long GetStallCount();
+	int GetLastOverrunStage();
+	uint8_t GetResetFlags();
+	uint8_t GetResetStage();
+	String GetStageName(int stage);
+	static void Tick();
+	static void Trip();
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+  MajorityProbe.cpp - Library for wrapping a probe so it reports touching once the wrapped probe has stayed touching for a short confirm
+  time, and only clears once N of the last M samples are clear.  A stop input stops the pump on any touch that lasts, while splashes
+  are ignored and chatter is ridden out on the way back.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "IProbe.h"
+#include "Loggable.h"
+#include "MajorityProbe.h"
+
+MajorityProbe::MajorityProbe(const __FlashStringHelper * probeName, IProbe * probe, long confirm, int votesNeeded, int numSamples, long sampleInterval) {
+  ProbeName = probeName;
+  _probe = probe;
+  _confirm = confirm;  // Milliseconds the wrapped probe must stay touching before this one touches
+  _numSamples = constrain(numSamples, 1, 16);  // Samples kept, up to the bits in _samples
+  _votesNeeded = constrain(votesNeeded, 1, _numSamples);  // Clear samples needed to clear
+  _sampleInterval = sampleInterval;  // Milliseconds between samples
+  _samples = 0;
+  _isTouching = false;
+  _isDisagreeing = false;
+  _isConfirming = false;
+  _touchStartMillis = 0;
+  _previousMillis = 0;
+  _rejectedCount = 0;
+}
+
+bool MajorityProbe::IsTouching() {
+  return _isTouching;
+}
+
+void MajorityProbe::Update(long currentMillis) {
+  _probe->Update(currentMillis);
+
+  // A touch counts once it has outlasted a splash, and fills the window so clearing needs a full vote
+  if (!_isTouching) {
+    if (!_probe->IsTouching()) {
+      if (_isConfirming)
+        _rejectedCount++;
+      _isConfirming = false;
+      return;
+    }
+    if (!_isConfirming) {
+      _isConfirming = true;
+      _touchStartMillis = currentMillis;
+    }
+    if (currentMillis - _touchStartMillis < _confirm)
+      return;
+
+    _isConfirming = false;
+    _isTouching = true;
+    _isDisagreeing = false;
+    _samples = 0xFFFF;
+    _previousMillis = currentMillis;
+    Log(currentMillis, ProbeName, F("State has changed to TOUCH LIQUID"));
+    return;
+  }
+
+  if (currentMillis - _previousMillis < (unsigned long)_sampleInterval)
+    return;
+  _previousMillis = currentMillis;
+
+  bool sample = _probe->IsTouching();
+  _samples = (_samples << 1) | (sample ? 1 : 0);
+
+  if (_isTouching && (_numSamples - CountTouching()) >= _votesNeeded) {
+    _isTouching = false;
+    _isDisagreeing = false;
+    Log(currentMillis, ProbeName, F("State has changed to CLEAR"));
+    return;
+  }
+
+  // A run of clear samples that ended without outvoting the touch was a glitch
+  if (sample != _isTouching) {
+    _isDisagreeing = true;
+  } else if (_isDisagreeing) {
+    _isDisagreeing = false;
+    _rejectedCount++;
+  }
+}
+
+String MajorityProbe::Display() {
+  return _probe->Display();
+}
+
+unsigned long MajorityProbe::GetRejectedCount() {
+  return _rejectedCount;
+}
+
+// Private - Counts the touching samples in the window
+int MajorityProbe::CountTouching() {
+  int count = 0;
+  for (int i = 0; i < _numSamples; i++) {
+    if (_samples & (1U << i))
+      count++;
+  }
+  return count;
+}
@@ -0,0 +1,40 @@
+/*
+  MajorityProbe.h - Library for wrapping a probe so it reports touching once the wrapped probe has stayed touching for a short confirm
+  time, and only clears once N of the last M samples are clear.  A stop input stops the pump on any touch that lasts, while splashes
+  are ignored and chatter is ridden out on the way back.
+  Created by Tom Wallace.
+*/
+#ifndef MajorityProbe_h
+#define MajorityProbe_h
+
+#include "Arduino.h"
+#include "IProbe.h"
+#include "Loggable.h"
+
+class MajorityProbe : public IProbe, public Loggable {
+  private:
+	const __FlashStringHelper * ProbeName;
+	IProbe * _probe;
+	long _confirm;
+	int _votesNeeded;
+	int _numSamples;
+	long _sampleInterval;
+	unsigned int _samples;  // One bit per sample, set when touching
+	bool _isTouching;
+	bool _isDisagreeing;
+	bool _isConfirming;
+	long _touchStartMillis;
+	unsigned long _previousMillis;
+	unsigned long _rejectedCount;
+
+	int CountTouching();
+
+  public: 
+	MajorityProbe(const __FlashStringHelper * probeName, IProbe * probe, long confirm, int votesNeeded, int numSamples, long sampleInterval);
+	bool IsTouching();
+	void Update(long currentMillis);
+	String Display();
+	unsigned long GetRejectedCount();
+};
+
+#endif
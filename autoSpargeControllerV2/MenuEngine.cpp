@@ -0,0 +1,184 @@
+/*
+  MenuEngine.cpp - Library for running the menus from a table kept in flash.  Each row is either a setting bound to a variable,
+  edited with up and down within its limits, or a page with its own IMenu for anything more than a value.  The main menu list,
+  paging and cursor are handled for every row alike, and the LCD is only redrawn when something changes.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "BufferedLcd.h"
+#include "IMenu.h"
+#include "MenuEngine.h"
+#include "SpargeSequencer.h"
+#include <avr/pgmspace.h>
+
+MenuEngine::MenuEngine(const MenuEntry * entries, int numEntries, BufferedLcd * lcd) {
+  _entries = entries;
+  _numEntries = numEntries;
+  _lcd = lcd;
+  _cursor = 0;  // Row the cursor is on
+  _top = 0;  // Row shown on the first line
+  _lastSelected = -1;
+  _isDrawn = false;
+  _drawnValue = 0;
+}
+
+void MenuEngine::Interact(int button) {
+  extern int selectedMenu;   // Set in main program for currently selected menu, 0 for the main menu list
+
+  // Pages go back by setting selectedMenu themselves, so watch for it changing
+  if (selectedMenu != _lastSelected) {
+    _lastSelected = selectedMenu;
+    _isDrawn = false;
+  }
+
+  if (selectedMenu == 0) {
+    MainMenu(button);
+    return;
+  }
+
+  MenuEntry entry;
+  ReadEntry(selectedMenu - 1, &entry);
+  if (entry.kind == MENU_PAGE)
+    ((IMenu *)entry.value)->Interact(button);
+  else
+    EditSetting(&entry, button);
+}
+
+// Draws everything again on the next call, even if nothing changed
+void MenuEngine::Redraw() {
+  _isDrawn = false;
+}
+
+// Private - The list of rows, two at a time with the cursor and arrows for more above or below
+void MenuEngine::MainMenu(int button) {
+  extern int selectedMenu;
+
+  switch (button) {
+    case 1:  // Open the row under the cursor
+      _lcd->clear();
+      selectedMenu = _cursor + 1;
+      return;
+    case 2:  // Up
+      if (_cursor > 0) {
+        _cursor--;
+        _top = min(_top, _cursor);
+        _isDrawn = false;
+      }
+      break;
+    case 3:  // Down
+      if (_cursor < _numEntries - 1) {
+        _cursor++;
+        _top = max(_top, _cursor - (LCD_ROWS - 1));
+        _isDrawn = false;
+      }
+      break;
+  }
+
+  if (_isDrawn)
+    return;
+  _isDrawn = true;
+
+  _lcd->clear();
+  MenuEntry entry;
+  for (int row = 0; row < LCD_ROWS && _top + row < _numEntries; row++) {
+    ReadEntry(_top + row, &entry);
+    _lcd->setCursor(0, row);
+    _lcd->write(_top + row == _cursor ? (uint8_t)MENU_CURSOR_CHAR : (uint8_t)' ');
+    _lcd->print(entry.name);
+  }
+  if (_top > 0) {
+    _lcd->setCursor(LCD_COLUMNS - 1, 0);
+    _lcd->write((uint8_t)MENU_UP_CHAR);
+  }
+  if (_top + LCD_ROWS < _numEntries) {
+    _lcd->setCursor(LCD_COLUMNS - 1, LCD_ROWS - 1);
+    _lcd->write((uint8_t)MENU_DOWN_CHAR);
+  }
+}
+
+// Private - Up and down step the bound variable within its limits, left goes back
+void MenuEngine::EditSetting(MenuEntry * entry, int button) {
+  extern int selectedMenu;
+  float value = GetValue(entry);
+
+  switch (button) {
+    case 2:  // Up
+      if (entry->kind == MENU_BOOL)
+        value = 1;
+      else if (value + entry->step > entry->maximum)
+        value = entry->wraps ? entry->minimum : entry->maximum;
+      else
+        value += entry->step;
+      SetValue(entry, value);
+      break;
+    case 3:  // Down
+      if (entry->kind == MENU_BOOL)
+        value = 0;
+      else if (value - entry->step < entry->minimum)
+        value = entry->wraps ? entry->maximum : entry->minimum;
+      else
+        value -= entry->step;
+      SetValue(entry, value);
+      break;
+    case 4:  // Back to the main menu list
+      _lcd->clear();
+      selectedMenu = 0;
+      return;
+  }
+
+  // The value can also change from elsewhere, such as the serial protocol
+  if (_isDrawn && value == _drawnValue)
+    return;
+  _isDrawn = true;
+  _drawnValue = value;
+
+  _lcd->clear();
+  _lcd->setCursor(0, 0);
+  _lcd->print(entry->title);
+  _lcd->setCursor(0, 1);
+  _lcd->print(Format(entry, value));
+}
+
+// Private - Copies a row out of flash
+void MenuEngine::ReadEntry(int index, MenuEntry * entry) {
+  memcpy_P(entry, &_entries[index], sizeof(MenuEntry));
+}
+
+// Private
+float MenuEngine::GetValue(MenuEntry * entry) {
+  if (entry->kind == MENU_FLOAT)
+    return *(float *)entry->value;
+  if (entry->kind == MENU_INT)
+    return *(int *)entry->value;
+  return *(bool *)entry->value ? 1 : 0;
+}
+
+// Private
+void MenuEngine::SetValue(MenuEntry * entry, float value) {
+  if (entry->kind == MENU_FLOAT)
+    *(float *)entry->value = value;
+  else if (entry->kind == MENU_INT)
+    *(int *)entry->value = (int)value;
+  else
+    *(bool *)entry->value = value != 0;
+}
+
+// Private
+String MenuEngine::Format(MenuEntry * entry, float value) {
+  switch (entry->format) {
+    case FORMAT_STOP:
+      return value != 0 ? F("Boil Stop 1") : F("Boil Stop 2");
+    case FORMAT_UNITS:
+      return value != 0 ? F("Gallons") : F("Pressure");
+    case FORMAT_ADVANCE:
+      if ((int)value == SEQUENCE_HOLD)
+        return F("Hold Time");
+      if ((int)value == SEQUENCE_MASH)
+        return F("Mash Level");
+      return F("Off");
+  }
+  if (entry->kind == MENU_FLOAT)
+    return String(value, 2);
+  return String((int)value);
+}
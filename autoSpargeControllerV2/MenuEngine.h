@@ -0,0 +1,67 @@
+/*
+  MenuEngine.h - Library for running the menus from a table kept in flash.  Each row is either a setting bound to a variable,
+  edited with up and down within its limits, or a page with its own IMenu for anything more than a value.  The main menu list,
+  paging and cursor are handled for every row alike, and the LCD is only redrawn when something changes.
+  Created by Tom Wallace.
+*/
+#ifndef MenuEngine_h
+#define MenuEngine_h
+
+#include "Arduino.h"
+#include "BufferedLcd.h"
+#include "IMenu.h"
+
+// Row kinds
+#define MENU_PAGE 0  // value is the IMenu that draws and handles the page
+#define MENU_FLOAT 1  // value is a float
+#define MENU_INT 2  // value is an int
+#define MENU_BOOL 3  // value is a bool, up sets it and down clears it
+
+// Value formats
+#define FORMAT_PLAIN 0
+#define FORMAT_STOP 1  // bool shown as Boil Stop 1 or Boil Stop 2
+#define FORMAT_UNITS 2  // bool shown as Gallons or Pressure
+#define FORMAT_ADVANCE 3  // int shown as the sequencer mode
+
+// Custom characters the engine draws with, created in setup
+#define MENU_CURSOR_CHAR 0
+#define MENU_UP_CHAR 1
+#define MENU_DOWN_CHAR 2
+
+struct MenuEntry {
+  char name[15];  // Shown in the main menu list
+  char title[17];  // Shown on the first line while editing
+  uint8_t kind;
+  uint8_t format;
+  void * value;
+  float minimum;
+  float maximum;
+  float step;
+  bool wraps;  // Stepping past one limit goes round to the other
+};
+
+class MenuEngine {
+  private:
+	const MenuEntry * _entries;  // In flash
+	int _numEntries;
+	BufferedLcd * _lcd;
+	int _cursor;
+	int _top;
+	int _lastSelected;
+	bool _isDrawn;
+	float _drawnValue;
+
+	void MainMenu(int button);
+	void EditSetting(MenuEntry * entry, int button);
+	void ReadEntry(int index, MenuEntry * entry);
+	float GetValue(MenuEntry * entry);
+	void SetValue(MenuEntry * entry, float value);
+	String Format(MenuEntry * entry, float value);
+
+  public: 
+	MenuEngine(const MenuEntry * entries, int numEntries, BufferedLcd * lcd);
+	void Interact(int button);
+	void Redraw();
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+  MprlsReader.cpp - Library for reading MPRLS pressure sensors without blocking, one per I2C mux channel or a single one wired directly.
+  Requested channels all start converting together and are read back on a later pass once the conversion time has passed.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "I2CMux.h"
+#include "MprlsReader.h"
+
+#define MPRLS_ADDRESS 0x18
+#define MPRLS_STATUS_BUSY 0x20
+
+// Channel states
+#define CHANNEL_IDLE 0
+#define CHANNEL_REQUESTED 1
+#define CHANNEL_CONVERTING 2
+#define CHANNEL_READY 3
+
+MprlsReader::MprlsReader(I2CMux * mux, int numChannels) {
+  _mux = mux;  // NULL when a single sensor is wired directly to the bus
+  _numChannels = constrain(numChannels, 1, MAX_PRESSURE_CHANNELS);
+
+  for (int i = 0; i < MAX_PRESSURE_CHANNELS; i++) {
+    _states[i] = CHANNEL_IDLE;
+    _statuses[i] = 0;
+    _pressures[i] = 0;
+    _outputs[i] = 0;
+    _sampleCounts[i] = 0;
+    _startMillis[i] = 0;
+  }
+}
+
+// Asks for a new reading on the channel, which IsReady reports once it is in
+void MprlsReader::Request(int channel) {
+  if (_states[channel] == CHANNEL_IDLE)
+    _states[channel] = CHANNEL_REQUESTED;
+}
+
+bool MprlsReader::IsReady(int channel) {
+  return _states[channel] == CHANNEL_READY;
+}
+
+// Returns the MPRLS status byte for the reading, 64 when powered and the reading is good, 0 when the sensor did not answer
+uint8_t MprlsReader::GetStatus(int channel) {
+  return _statuses[channel];
+}
+
+// Returns the reading in hPa and frees the channel for the next request
+float MprlsReader::GetPressure(int channel) {
+  _states[channel] = CHANNEL_IDLE;
+  return _pressures[channel];
+}
+
+// Returns the raw 24 bit output of the last reading the sensor answered, for tracing
+uint32_t MprlsReader::GetOutput(int channel) {
+  return _outputs[channel];
+}
+
+// Counts up with each finished reading, good or failed, so a watcher can tell a new one has come in without consuming it
+uint8_t MprlsReader::GetSampleCount(int channel) {
+  return _sampleCounts[channel];
+}
+
+// Starts and collects conversions without waiting on any of them - returns true if the bus was used
+bool MprlsReader::Update(long currentMillis) {
+  bool isBusUsed = false;
+
+  for (int i = 0; i < _numChannels; i++) {
+    if (_states[i] == CHANNEL_REQUESTED) {
+      StartConversion(i, currentMillis);
+      isBusUsed = true;
+    } else if (_states[i] == CHANNEL_CONVERTING && (currentMillis - _startMillis[i] >= (unsigned long)CONVERSION_TIME)) {
+      ReadConversion(i);
+      isBusUsed = true;
+    }
+  }
+  return isBusUsed;
+}
+
+// Private - Selects the channel on the mux, if there is one
+bool MprlsReader::Select(int channel) {
+  return _mux == NULL || _mux->Select(channel);
+}
+
+// Private - Sends the output measurement command
+void MprlsReader::StartConversion(int channel, long currentMillis) {
+  bool isSent = false;
+  if (Select(channel)) {
+    Wire.beginTransmission(MPRLS_ADDRESS);
+    Wire.write((uint8_t)0xAA);
+    Wire.write((uint8_t)0x00);
+    Wire.write((uint8_t)0x00);
+    isSent = Wire.endTransmission() == 0;
+  }
+
+  if (!isSent) {
+    _statuses[channel] = 0;
+    _sampleCounts[channel]++;
+    _states[channel] = CHANNEL_READY;
+    return;
+  }
+
+  _startMillis[channel] = currentMillis;
+  _states[channel] = CHANNEL_CONVERTING;
+}
+
+// Private - Reads the status and 24 bit output, leaving the channel converting if the sensor is still busy
+void MprlsReader::ReadConversion(int channel) {
+  if (!Select(channel) || Wire.requestFrom((uint8_t)MPRLS_ADDRESS, (uint8_t)4) != 4) {
+    _statuses[channel] = 0;
+    _sampleCounts[channel]++;
+    _states[channel] = CHANNEL_READY;
+    return;
+  }
+
+  uint8_t status = Wire.read();
+  uint32_t output = (uint32_t)Wire.read() << 16;
+  output |= (uint32_t)Wire.read() << 8;
+  output |= Wire.read();
+  if (status & MPRLS_STATUS_BUSY)
+    return;
+
+  // Transfer function A - 10% to 90% of counts spans 0 to 25 psi, reported in hPa
+  float psi = ((float)output - 0x19999AUL) * 25.0 / (0xE66666UL - 0x19999AUL);
+  _statuses[channel] = status;
+  _pressures[channel] = psi * 68.947572932;
+  _outputs[channel] = output;
+  _sampleCounts[channel]++;
+  _states[channel] = CHANNEL_READY;
+}
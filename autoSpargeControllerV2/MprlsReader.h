@@ -0,0 +1,43 @@
+/*
+  MprlsReader.h - Library for reading MPRLS pressure sensors without blocking, one per I2C mux channel or a single one wired directly.
+  Requested channels all start converting together and are read back on a later pass once the conversion time has passed.
+  Created by Tom Wallace.
+*/
+#ifndef MprlsReader_h
+#define MprlsReader_h
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "I2CMux.h"
+
+#define MAX_PRESSURE_CHANNELS 2  // The boil kettle and one more vessel - each takes 15 bytes of RAM
+#define MPRLS_STATUS_GOOD 0x40  // Powered, with no errors
+#define CONVERSION_TIME 6L  // Milliseconds the MPRLS takes to convert, with a little to spare
+
+class MprlsReader {
+  private:
+	I2CMux * _mux;
+	int _numChannels;
+	uint8_t _states[MAX_PRESSURE_CHANNELS];
+	uint8_t _statuses[MAX_PRESSURE_CHANNELS];
+	float _pressures[MAX_PRESSURE_CHANNELS];
+	uint32_t _outputs[MAX_PRESSURE_CHANNELS];
+	uint8_t _sampleCounts[MAX_PRESSURE_CHANNELS];
+	unsigned long _startMillis[MAX_PRESSURE_CHANNELS];
+
+	bool Select(int channel);
+	void StartConversion(int channel, long currentMillis);
+	void ReadConversion(int channel);
+
+  public: 
+	MprlsReader(I2CMux * mux, int numChannels);
+	void Request(int channel);
+	bool IsReady(int channel);
+	uint8_t GetStatus(int channel);
+	float GetPressure(int channel);
+	uint32_t GetOutput(int channel);
+	uint8_t GetSampleCount(int channel);
+	bool Update(long currentMillis);
+};
+
+#endif
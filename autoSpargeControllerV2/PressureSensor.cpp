@@ -5,68 +5,169 @@
 
 #include "Arduino.h"
 #include "PressureSensor.h"
-PressureSensor::PressureSensor(Adafruit_MPRLS * mpr) {
-  _mpr = mpr;
+PressureSensor::PressureSensor(const __FlashStringHelper * sensorName, MprlsReader * reader, int channel, VesselSettings * settings, float formulaSlope, float formulaIntercept) {
+  _sensorName = sensorName;
+  _reader = reader;
+  _channel = channel;  // Mux channel the sensor sits on, 0 when wired directly
+  _isRequested = false;
+  _settings = settings;
+  _formulaSlope = formulaSlope;  // Gallons per hPa
+  _formulaIntercept = formulaIntercept;  // Gallons at zero pressure, which the slope correction pivots around
   _numReadings = 20;
   _sensorZero = 0;
   _readingPointer = 0;
   _readings = new float[_numReadings];
   _initSensorZeroCount = 0;
+
+  AVERAGE_WINDOW = 2000;  // Milliseconds of readings to average once sampling is sparse
+  _sampleInterval = 0;
+  _lastSampleMillis = 0;
+  _activeReadings = _numReadings;
+
+  _referenceProbe = NULL;
+  _referenceWasTouching = false;
+  _isReferencePending = false;
+  _isReferenceSettled = false;
+  _referenceEdgeGallons = 0;
+  _referenceEdgeReading = 0;
+  _referenceEdgeMillis = 0;
+  _hasReferenceReading = false;
+  _referenceReading = 0;
+  _slopeCorrection = 1;
+  _offsetCorrection = 0;
+  _isDrifting = false;
+
+  _fillRate = 0;
+  _averageFillRate = 0;
+  _rateGallons = 0;
+  _rateMillis = 0;
+
+  _wasAtTarget = false;
+  _isSettling = false;
+  _cutoffTarget = 0;
+  _lastOvershoot = 0;
+  _cutoffGallons = 0;
+  _cutoffRate = 0;
+  _cutoffMillis = 0;
 }
 
 bool PressureSensor::IsTouching() {
-  extern float boilStopOne;  // Set in main program for the first gallon stop for the boil
-  extern float boilStopTwo;  // Set in main program for the second gallon stop for the boil
-  extern bool atBoilStopOne; // Set in main program for using the first gallon stop
-
   // Make sure if we are UNCONNECTED to say IsTouching = true to prevent pump from firing without the probe
   if (_sensorZero == 0)
     return true;
 
-  if (atBoilStopOne) {
-    return GetGallons() >= boilStopOne;
-  }
-  
-  return GetGallons() >= boilStopTwo;
+  // The reference probe is a hard backstop whenever it sits at or above the target, or always until the brewer has measured its level
+  if (_referenceProbe != NULL && _referenceProbe->IsTouching() && (GetReferenceGallons() == 0 || GetTarget() <= GetReferenceGallons()))
+    return true;
+
+  // The measured volume is always a hard stop - the prediction can only cut the pump earlier, so the volume still in flight lands on the target
+  return GetGallons() >= GetTarget() || GetPredictedGallons() >= GetTarget();
 }
 
 void PressureSensor::Update(long currentMillis) {
+  // Once initialized, leave the bus alone until the next sample is due, then ask the reader for one
+  if (!_isRequested) {
+    if (_initSensorZeroCount > 20 && (currentMillis - _lastSampleMillis < (unsigned long)_sampleInterval))
+      return;
+    _reader->Request(_channel);
+    _isRequested = true;
+    return;
+  }
+
+  if (!_reader->IsReady(_channel))
+    return;
+  _isRequested = false;
+  _lastSampleMillis = currentMillis;
+  uint8_t status = _reader->GetStatus(_channel);
+  float pressure = _reader->GetPressure(_channel);
+
   // CONNECTED sensor readStatus = 64
-  if (_mpr->readStatus() == 64) {
+  if (status == 64) {
     // Still need to initialize sensor "zero"
     if (_initSensorZeroCount <= 20) {
       _initSensorZeroCount++;
       
-      AddReading(_mpr->readPressure());
+      AddReading(pressure);
 
       // If we are greater than 20 initialization readings, set _sensorZero
       if (_initSensorZeroCount > 20) {
         _sensorZero = AverageReadings();
-        Serial.println("Connected - Setting _sensorZero to - " + String(_sensorZero));
+        Log(currentMillis, _sensorName, String(F("Connected - Setting _sensorZero to - ")) + String(_sensorZero));
       }
     } else {
       // Normal condition - read pressure
-      AddReading(_mpr->readPressure());
+      AddReading(pressure);
+      UpdateFillRate(currentMillis);
+      UpdateCutoffModel(currentMillis);
+      UpdateReference(currentMillis);
+      UpdateSampleRate();
     }
   } else if (_sensorZero != 0) {
-    Serial.println("Unconnected");
+    Log(currentMillis, _sensorName, F("Unconnected"));
     // UNCONNECTED, so reset variables
     _initSensorZeroCount = 0;
     _sensorZero = 0;
+    _fillRate = 0;
+    _averageFillRate = 0;
+    _rateMillis = 0;
+    _wasAtTarget = false;
+    _isSettling = false;
+    _referenceWasTouching = false;
+    _isReferencePending = false;
+    _sampleInterval = 0;
+    _activeReadings = _numReadings;
   }
 }
 
 String PressureSensor::Display() {
-  extern bool boilShowGallons;  // Set in main program as an option to show gallons or pressure
-
   // If _sensorZero == 0 and likely UNCONNECTED, then we are not initialized, so display ---
   if (_sensorZero == 0)
-    return "----";
+    return F("----");
 
-  if (!boilShowGallons)
+  if (!_settings->showGallons)
     return String(AverageReadings() - _sensorZero,2);
 
-  return String(GetGallons(),1);
+  // Flag drift against the reference probe so the brewer knows not to trust the reading blindly
+  return String(GetGallons(),1) + (_isDrifting ? F("!") : F(""));
+}
+
+// Returns the predicted settled gallons that IsTouching compares against the threshold
+float PressureSensor::GetValue() {
+  return GetPredictedGallons();
+}
+
+// Returns the gallon stop currently in use
+float PressureSensor::GetThreshold() {
+  return GetTarget();
+}
+
+bool PressureSensor::IsConnected() {
+  return _sensorZero != 0;
+}
+
+// Returns the stops and display options for the vessel this sensor measures
+VesselSettings * PressureSensor::GetSettings() {
+  return _settings;
+}
+
+// Cross-validates against a digital probe that touches liquid at the referenceGallons setting, such as the boil probe
+void PressureSensor::SetReferenceProbe(IProbe * referenceProbe) {
+  _referenceProbe = referenceProbe;
+}
+
+// Returns minutes until the kettle reaches the gallons at the averaged fill rate, 0 if already there or -1 if unknown
+float PressureSensor::GetMinutesToGallons(float gallons) {
+  if (_sensorZero == 0)
+    return -1;
+
+  float remaining = gallons - GetGallons();
+  if (remaining <= 0)
+    return 0;
+
+  if (_averageFillRate <= 0.01)
+    return -1;
+
+  return remaining / _averageFillRate;
 }
 
 // Private - Adds the new reading to our array of reading numbers, moving the pointer
@@ -77,21 +178,191 @@ void PressureSensor::AddReading(float reading) {
     _readingPointer = 0;
 }
 
-// Private - Returns the average of the array of reading numbers
+// Private - Returns the average of the most recent readings in the active window
 float PressureSensor::AverageReadings() {
   float total = 0;
-  int readIndex1 = 0;
-  for (readIndex1 = 0; readIndex1 < _numReadings; readIndex1++){
+  int readIndex1 = _readingPointer;
+  for (int count = 0; count < _activeReadings; count++){
+      readIndex1 = readIndex1 == 0 ? _numReadings - 1 : readIndex1 - 1;
       total += _readings[readIndex1];
   }
-  return total / _numReadings;
+  return total / _activeReadings;
 }
 
-// Private - Returns pressure in gallons
+// Returns pressure in gallons, corrected against the reference probe
 float PressureSensor::GetGallons() {
+  return (GetUncorrectedGallons() * _slopeCorrection) + _offsetCorrection;
+}
+
+// Private - Returns pressure in gallons from the calibration formula alone
+float PressureSensor::GetUncorrectedGallons() {
   float pressure = AverageReadings() - _sensorZero;
   
-  // Translate the pressure into gallons applying formula
-  // Formula updated on 04/21/23 - reading 0.5 gal low at key points
-  return ((0.4021 * pressure) + 0.4707) + 0.5;
+  // Translate the pressure into gallons applying the formula for this vessel
+  return (_formulaSlope * pressure) + _formulaIntercept;
+}
+
+// Private - Returns the gallons expected once the wort still in the line has drained into the kettle
+float PressureSensor::GetPredictedGallons() {
+  float gallons = GetGallons();
+  if (_fillRate <= 0)
+    return gallons + _settings->deadVolume;
+
+  return gallons + _settings->deadVolume + ((_fillRate / 60) * _settings->lagSeconds);
+}
+
+// Private - Returns the gallon stop currently in use
+float PressureSensor::GetTarget() {
+  return _settings->atStopOne ? _settings->stopOne : _settings->stopTwo;
+}
+
+// Private - Returns the gallons at the reference probe, or 0 until the brewer has measured it
+float PressureSensor::GetReferenceGallons() {
+  return _settings->referenceGallons;
+}
+
+// Private - Samples the averaged gallons on a fixed interval to estimate the rate of rise in gallons per minute
+void PressureSensor::UpdateFillRate(long currentMillis) {
+  float gallons = GetGallons();
+  if (_rateMillis == 0) {
+    _rateGallons = gallons;
+    _rateMillis = currentMillis;
+    return;
+  }
+
+  long elapsed = currentMillis - _rateMillis;
+  if (elapsed < RATE_INTERVAL)
+    return;
+
+  float rate = (gallons - _rateGallons) * 60000 / elapsed;
+  _fillRate += 0.3 * (rate - _fillRate);
+  _averageFillRate += 0.03 * (rate - _averageFillRate);
+  _rateGallons = gallons;
+  _rateMillis = currentMillis;
+}
+
+// Tuning constants and the learned model, for the session report
+long PressureSensor::GetAverageWindow() {
+  return AVERAGE_WINDOW;
+}
+
+void PressureSensor::SetAverageWindow(long averageWindow) {
+  AVERAGE_WINDOW = averageWindow;
+}
+
+float PressureSensor::GetDeadVolume() {
+  return _settings->deadVolume;
+}
+
+float PressureSensor::GetLagSeconds() {
+  return _settings->lagSeconds;
+}
+
+// Gallons the kettle settled above its target after the last cutoff
+float PressureSensor::GetLastOvershoot() {
+  return _lastOvershoot;
+}
+
+// Private - Records each predictive cutoff and, once the kettle settles, logs the overshoot and tunes the in-flight model
+void PressureSensor::UpdateCutoffModel(long currentMillis) {
+  float target = GetTarget();
+  bool isAtTarget = GetPredictedGallons() >= target;
+
+  // Cutoff happened on this reading
+  if (isAtTarget && !_wasAtTarget && !_isSettling && GetGallons() < target) {
+    _isSettling = true;
+    _cutoffTarget = target;
+    _cutoffGallons = GetGallons();
+    _cutoffRate = _fillRate > 0 ? _fillRate / 60 : 0;
+    _cutoffMillis = currentMillis;
+    Log(currentMillis, _sensorName, String(F("Cutoff at ")) + String(_cutoffGallons, 2) + F(" gal for target ") + String(target, 2));
+  }
+  _wasAtTarget = isAtTarget;
+
+  if (!_isSettling)
+    return;
+
+  // Stop changed while settling, so this cutoff no longer says anything about the model
+  if (target != _cutoffTarget) {
+    _isSettling = false;
+    return;
+  }
+
+  if (currentMillis - _cutoffMillis < CUTOFF_SETTLE_DELAY)
+    return;
+
+  _isSettling = false;
+  float settledGallons = GetGallons();
+  float overshoot = settledGallons - _cutoffTarget;
+  _lastOvershoot = overshoot;
+
+  // Normalized LMS step on [1, rate] so the dead volume and lag share the correction
+  float predictedRise = _settings->deadVolume + (_cutoffRate * _settings->lagSeconds);
+  float error = (settledGallons - _cutoffGallons) - predictedRise;
+  float norm = 1 + (_cutoffRate * _cutoffRate);
+  _settings->deadVolume = constrain(_settings->deadVolume + (0.5 * error / norm), 0.0, 2.0);  // Never negative, so the prediction never reads below the measured volume
+  _settings->lagSeconds = constrain(_settings->lagSeconds + (0.5 * error * _cutoffRate / norm), 0.0, 30.0);
+
+  Log(currentMillis, _sensorName, String(F("Overshoot ")) + String(overshoot, 2) + F(" gal - dead volume ") + String(_settings->deadVolume, 2) + F(" gal, lag ") + String(_settings->lagSeconds, 1) + F(" sec"));
+}
+
+// Private - Each time the reference probe trips and stays wet, logs the drift from its measured volume, and recalibrates if the
+// reading was settled when it tripped
+void PressureSensor::UpdateReference(long currentMillis) {
+  if (_referenceProbe == NULL || GetReferenceGallons() == 0)
+    return;
+
+  // Note the reading as the probe trips - it is only settled if the lag of the averaged readings is worth less than half the tolerance
+  bool isTouching = _referenceProbe->IsTouching();
+  if (isTouching && !_referenceWasTouching) {
+    _isReferencePending = true;
+    _isReferenceSettled = (_fillRate / 60) * _settings->lagSeconds < DRIFT_TOLERANCE / 2;
+    _referenceEdgeGallons = GetGallons();
+    _referenceEdgeReading = GetUncorrectedGallons();
+    _referenceEdgeMillis = currentMillis;
+  }
+  _referenceWasTouching = isTouching;
+
+  if (!_isReferencePending)
+    return;
+  if (!isTouching) {
+    _isReferencePending = false;
+    Log(currentMillis, _sensorName, F("Reference probe splash ignored"));
+    return;
+  }
+  if (currentMillis - _referenceEdgeMillis < (unsigned long)REFERENCE_HOLD)
+    return;
+  _isReferencePending = false;
+
+  float referenceGallons = GetReferenceGallons();
+  float drift = _referenceEdgeGallons - referenceGallons;
+  _isDrifting = abs(drift) > DRIFT_TOLERANCE;
+  Log(currentMillis, _sensorName, String(F("Reference probe at ")) + String(_referenceEdgeGallons, 2) + F(" gal, measured ") + String(referenceGallons, 2) + F(" - drift ") + String(drift, 2) + (_isDrifting ? F(" - DRIFT") : F("")));
+  if (!_isReferenceSettled) {
+    Log(currentMillis, _sensorName, F("Reading was still rising, not recalibrating"));
+    return;
+  }
+
+  // Blend the new formula reading into the running one, then pivot the slope around the formula anchor so it lands on the reference
+  _referenceReading = _hasReferenceReading ? (0.5 * _referenceReading) + (0.5 * _referenceEdgeReading) : _referenceEdgeReading;
+  _hasReferenceReading = true;
+  if (_referenceReading - _formulaIntercept < 0.5)
+    return;
+
+  _slopeCorrection = constrain((referenceGallons - _formulaIntercept) / (_referenceReading - _formulaIntercept), 0.8, 1.2);
+  _offsetCorrection = _formulaIntercept * (1 - _slopeCorrection);
+  Log(currentMillis, _sensorName, String(F("Recalibrated slope ")) + String(_slopeCorrection, 3) + F(", offset ") + String(_offsetCorrection, 3));
+}
+
+// Private - Spaces readings by how soon the kettle could reach the active stop, and keeps the averaging window about the same length in time
+void PressureSensor::UpdateSampleRate() {
+  float distance = abs(GetTarget() - GetPredictedGallons());
+
+  // A second between readings for each gallon away, and at least 100 readings before the stop at the current fill rate
+  float interval = distance * 1000;
+  if (_fillRate > 0)
+    interval = min(interval, (distance / _fillRate) * 60000 / 100);
+
+  _sampleInterval = constrain((long)interval, 0L, MAX_SAMPLE_INTERVAL);
+  _activeReadings = _sampleInterval == 0 ? _numReadings : constrain((int)(AVERAGE_WINDOW / _sampleInterval), 4, _numReadings);
 }
@@ -6,28 +6,97 @@
 #define PressureSensor_h
 
 #include "Arduino.h"
-#include "Adafruit_MPRLS.h"
-#include <utility/Adafruit_MCP23017.h>
+#include "IAnalogProbe.h"
 #include "IProbe.h"
+#include "Loggable.h"
+#include "MprlsReader.h"
+#include "VesselSettings.h"
 
-class PressureSensor : public IProbe {
+#define MAX_SAMPLE_INTERVAL 2000L  // Most milliseconds between readings, when far from the stop
+#define DRIFT_TOLERANCE 0.25  // Gallons the reading may be off at the reference probe before flagging drift
+#define REFERENCE_HOLD 5000L  // Milliseconds the reference probe must stay wet, so a splash is not taken for the level
+#define RATE_INTERVAL 2000L  // Milliseconds between fill rate samples
+#define CUTOFF_SETTLE_DELAY 30000L  // Milliseconds after cutoff before the kettle volume is considered settled
+
+class PressureSensor : public IAnalogProbe, Loggable {
   public:
-    PressureSensor(Adafruit_MPRLS * mpr);
+    PressureSensor(const __FlashStringHelper * sensorName, MprlsReader * reader, int channel, VesselSettings * settings, float formulaSlope, float formulaIntercept);
     virtual bool IsTouching();
     virtual void Update(long currentMillis);
     virtual String Display();
+    virtual float GetValue();
+    virtual float GetThreshold();
+    bool IsConnected();
+    VesselSettings * GetSettings();
+    float GetGallons();
+    float GetMinutesToGallons(float gallons);
+    void SetReferenceProbe(IProbe * referenceProbe);
+    long GetAverageWindow();
+    void SetAverageWindow(long averageWindow);  // For tuning runs on the host
+    float GetDeadVolume();
+    float GetLagSeconds();
+    float GetLastOvershoot();
     
   private:
-    Adafruit_MPRLS * _mpr;
+    const __FlashStringHelper * _sensorName;
+    MprlsReader * _reader;
+    int _channel;
+    bool _isRequested;
+    VesselSettings * _settings;
+    float _formulaSlope;
+    float _formulaIntercept;
     int _numReadings;
     float* _readings;
     int _initSensorZeroCount;
     float _sensorZero;
     int _readingPointer;
 
+    // Adaptive sampling - sparse and long window far from the stop, dense and short window near it
+    long AVERAGE_WINDOW;
+    long _sampleInterval;
+    unsigned long _lastSampleMillis;
+    int _activeReadings;
+
+    // Cross-validation against a digital probe at a known volume - gallons = (formula * _slopeCorrection) + _offsetCorrection
+    IProbe * _referenceProbe;
+    bool _referenceWasTouching;
+    bool _isReferencePending;
+    bool _isReferenceSettled;
+    float _referenceEdgeGallons;
+    float _referenceEdgeReading;
+    unsigned long _referenceEdgeMillis;
+    bool _hasReferenceReading;
+    float _referenceReading;
+    float _slopeCorrection;
+    float _offsetCorrection;
+    bool _isDrifting;
+
+    // Rate of rise estimator
+    float _fillRate;  // Smoothed gallons per minute
+    float _averageFillRate;  // Gallons per minute averaged over about a minute of pump pulses
+    float _rateGallons;
+    long _rateMillis;
+
+    // Learned in-flight volume model - predicted rise after cutoff = deadVolume + (rate * lagSeconds), kept in the vessel settings
+    // so a reboot picks up where the last cutoff left it
+    float _lastOvershoot;
+    bool _wasAtTarget;
+    bool _isSettling;
+    float _cutoffTarget;
+    float _cutoffGallons;
+    float _cutoffRate;
+    long _cutoffMillis;
+
     void AddReading(float reading);
     float AverageReadings();
-    float GetGallons();
+    float GetUncorrectedGallons();
+    float GetPredictedGallons();
+    float GetTarget();
+    float GetReferenceGallons();
+    void UpdateFillRate(long currentMillis);
+    void UpdateCutoffModel(long currentMillis);
+    void UpdateReference(long currentMillis);
+    void UpdateSampleRate();
 };
 
 #endif
@@ -7,7 +7,7 @@
 #include "Probe.h"
 #include "Loggable.h"
 
-Probe::Probe(String probeName, int inputPin, int inputType) {
+Probe::Probe(const __FlashStringHelper * probeName, int inputPin, int inputType) {
   InputPin = inputPin;
   ProbeName = probeName;
   pinMode(InputPin, inputType);
@@ -27,8 +27,8 @@ void Probe::Update(long currentMillis) {
     
   // If state changed, then log
   if (CurrentState != OriginalState) {
-    String state = CurrentState == PROBE_TOUCH_LIQUID ? "TOUCH LIQUID" : "CLEAR";
-    Log(currentMillis, ProbeName, "State has changed to " + state); 
+    String state = CurrentState == PROBE_TOUCH_LIQUID ? F("TOUCH LIQUID") : F("CLEAR");
+    Log(currentMillis, ProbeName, String(F("State has changed to ")) + state); 
   }
 }
 
@@ -9,16 +9,16 @@
 #include "IProbe.h"
 #include "Loggable.h"
 
-class Probe : public IProbe, Loggable {
+class Probe : public IProbe, public Loggable {
   private:
 	int PROBE_CLEAR;
 	int PROBE_TOUCH_LIQUID;
-	String ProbeName;
+	const __FlashStringHelper * ProbeName;
 	int CurrentState;
 	int InputPin;   // The pin number that receives probe input
 
   public: 
-	Probe(String probeName, int inputPin, int inputType);
+	Probe(const __FlashStringHelper * probeName, int inputPin, int inputType);
 	bool IsTouching();
 	void Update(long currentMillis);
   String Display();
@@ -0,0 +1,336 @@
+/*
+  SerialProtocol.cpp - Library for a framed binary command and telemetry protocol over the serial port.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "Button.h"
+#include "ChannelConfig.h"
+#include "EventLog.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+#include "SerialProtocol.h"
+#include "VesselSettings.h"
+#include <util/crc16.h>
+
+SerialProtocol::SerialProtocol(VesselSettings * settings, PressureSensor * pressureSensor, IPump ** pumps, int numPumps, Button ** buttons, const PumpConfig * pumpConfig, BrewStats * brewStats, EventLog * eventLog, unsigned int telemetryInterval) {
+  WAIT_START = 0;
+  READ_TYPE = 1;
+  READ_LENGTH = 2;
+  READ_PAYLOAD = 3;
+  READ_CRC_LOW = 4;
+  READ_CRC_HIGH = 5;
+
+  _settings = settings;
+  _pressureSensor = pressureSensor;
+  _pumps = pumps;
+  _numPumps = numPumps;
+  _buttons = buttons;
+  _pumpConfig = pumpConfig;  // Says which button makes each pump active
+  _brewStats = brewStats;  // Either may be NULL in a build without it, and its request is NAKed as unknown
+  _eventLog = eventLog;
+  _telemetryInterval = telemetryInterval;  // Milliseconds between telemetry frames, 0 for none
+  _previousMillis = 0;
+
+  _state = WAIT_START;
+  _type = 0;
+  _length = 0;
+  _received = 0;
+  _crc = 0xFFFF;
+  _frameCrc = 0;
+  _lastByteMillis = 0;
+  _badFrames = 0;
+  _nextStat = -1;
+  _nextEvent = -1;
+  _isTraceRequested = false;
+  _isQuietingLogs = false;
+  _lastFrameMillis = 0;
+}
+
+unsigned long SerialProtocol::GetBadFrameCount() {
+  return _badFrames;
+}
+
+// Set by the host, and watched by the trace recorder
+bool SerialProtocol::IsTraceRequested() {
+  return _isTraceRequested;
+}
+
+void SerialProtocol::Update(long currentMillis) {
+  // Only take what has already arrived, so a slow host never holds up the loop
+  int available = Serial.available();
+
+  // A host that stopped mid frame must not leave the parser eating the start of the next one
+  if (_state != WAIT_START && currentMillis - _lastByteMillis >= FRAME_BYTE_TIMEOUT) {
+    _badFrames++;
+    _state = WAIT_START;
+  }
+  if (available > 0)
+    _lastByteMillis = currentMillis;
+
+  while (available-- > 0) {
+    Parse(Serial.read(), currentMillis);
+  }
+  UpdateLogging(currentMillis);
+
+  // Stats go out one per loop so a request never fills the transmit buffer and blocks
+  if (_nextStat >= 0) {
+    SendStat(_nextStat++);
+    if (_nextStat >= _brewStats->GetStatCount())
+      _nextStat = -1;
+  } else if (_nextEvent >= 0) {
+    SendEvent(_nextEvent++);
+    if (_nextEvent >= _eventLog->GetCount())
+      _nextEvent = -1;
+  }
+
+  if (_telemetryInterval > 0 && currentMillis - _previousMillis >= _telemetryInterval) {
+    _previousMillis = currentMillis;
+    SendTelemetry(currentMillis);
+  }
+}
+
+// Private - Steps the frame parser one byte, handling the command once its CRC checks out
+void SerialProtocol::Parse(uint8_t data, long currentMillis) {
+  if (_state == WAIT_START) {
+    if (data == FRAME_START) {
+      _crc = 0xFFFF;
+      _state = READ_TYPE;
+    }
+  } else if (_state == READ_TYPE) {
+    _type = data;
+    _crc = _crc_ccitt_update(_crc, data);
+    _state = READ_LENGTH;
+  } else if (_state == READ_LENGTH) {
+    _length = data;
+    _received = 0;
+    _crc = _crc_ccitt_update(_crc, data);
+    if (_length > MAX_FRAME_PAYLOAD) {
+      // Too long to be ours - drop it and look for the next start byte
+      _badFrames++;
+      SendNak(_type, NAK_LENGTH);
+      _state = WAIT_START;
+    } else {
+      _state = _length == 0 ? READ_CRC_LOW : READ_PAYLOAD;
+    }
+  } else if (_state == READ_PAYLOAD) {
+    _payload[_received++] = data;
+    _crc = _crc_ccitt_update(_crc, data);
+    if (_received == _length)
+      _state = READ_CRC_LOW;
+  } else if (_state == READ_CRC_LOW) {
+    _frameCrc = data;
+    _state = READ_CRC_HIGH;
+  } else if (_state == READ_CRC_HIGH) {
+    _frameCrc |= (uint16_t)data << 8;
+    _state = WAIT_START;
+    if (_frameCrc != _crc) {
+      _badFrames++;
+      SendNak(_type, NAK_CRC);
+      return;
+    }
+    _lastFrameMillis = currentMillis;
+    HandleCommand(currentMillis);
+  }
+}
+
+// Private - Keeps log text off the port while a host is framing, and brings it back once the host has gone
+void SerialProtocol::UpdateLogging(long currentMillis) {
+  bool isHostFraming = _lastFrameMillis != 0 && currentMillis - _lastFrameMillis < HOST_QUIET_TIMEOUT;
+  if (isHostFraming && !_isQuietingLogs && Loggable::IsAllLogging()) {
+    // Logging that was already off, such as for a waveform dump, is left for whatever turned it off
+    Log(currentMillis, F("Serial Protocol"), F("Host framing, log text off"));
+    Loggable::SetAllLogging(false);
+    _isQuietingLogs = true;
+  } else if (!isHostFraming && _isQuietingLogs) {
+    Loggable::SetAllLogging(true);
+    _isQuietingLogs = false;
+    Log(currentMillis, F("Serial Protocol"), F("Host quiet, log text back on"));
+  }
+}
+
+// Private - Acts on the frame sitting in _payload
+void SerialProtocol::HandleCommand(long currentMillis) {
+  switch (_type) {
+    case CMD_SET_STOP_ONE:
+    case CMD_SET_STOP_TWO: {
+      if (_length != 2) {
+        SendNak(_type, NAK_LENGTH);
+        return;
+      }
+      int16_t hundredths = ReadInt16(0);
+      if (hundredths < 0 || hundredths > MAX_STOP_HUNDREDTHS) {
+        SendNak(_type, NAK_RANGE);
+        return;
+      }
+      float gallons = hundredths / 100.0;
+      if (_type == CMD_SET_STOP_ONE)
+        _settings->stopOne = gallons;
+      else
+        _settings->stopTwo = gallons;
+      Log(currentMillis, F("Serial Protocol"), String(F("Boil stop ")) + String(_type == CMD_SET_STOP_ONE ? 1 : 2) + F(" set to ") + String(gallons, 2));
+      break;
+    }
+    case CMD_TOGGLE_STOP:
+      _settings->atStopOne = !_settings->atStopOne;
+      break;
+    case CMD_SET_PUMP_PAUSED:
+      if (_length != 2) {
+        SendNak(_type, NAK_LENGTH);
+        return;
+      }
+      if (_payload[0] >= _numPumps) {
+        SendNak(_type, NAK_RANGE);
+        return;
+      }
+      // Only pauses or resumes for the host - the pump button still decides if a pump may run at all,
+      // and a dry run pause stays until the pump is turned off
+      _pumps[_payload[0]]->SetIsPaused(_payload[1] != 0, PAUSE_HOST);
+      break;
+    case CMD_SET_PUMP_ACTIVE:
+      if (_length != 2) {
+        SendNak(_type, NAK_LENGTH);
+        return;
+      }
+      if (_payload[0] >= _numPumps) {
+        SendNak(_type, NAK_RANGE);
+        return;
+      }
+      // Through the pump's button, which the loop reads the pump's active state from, so its light follows
+      _buttons[ReadPumpConfig(&_pumpConfig[_payload[0]]).button]->SetMatchingFunctionOn(_payload[1] != 0);
+      break;
+    case CMD_REQUEST_STATS:
+      if (_brewStats == NULL) {
+        SendNak(_type, NAK_UNKNOWN);  // Left out of this build
+        return;
+      }
+      _nextStat = 0;
+      break;
+    case CMD_SET_TELEMETRY:
+      if (_length != 2) {
+        SendNak(_type, NAK_LENGTH);
+        return;
+      }
+      _telemetryInterval = (uint16_t)ReadInt16(0);
+      break;
+    case CMD_SET_UNITS:
+      if (_length != 1) {
+        SendNak(_type, NAK_LENGTH);
+        return;
+      }
+      _settings->showGallons = _payload[0] != 0;
+      break;
+    case CMD_SET_TRACE:
+      if (_length != 1) {
+        SendNak(_type, NAK_LENGTH);
+        return;
+      }
+      _isTraceRequested = _payload[0] != 0;
+      break;
+    case CMD_READ_EVENT_LOG:
+      if (_eventLog == NULL) {
+        SendNak(_type, NAK_UNKNOWN);
+        return;
+      }
+      _nextEvent = _eventLog->GetCount() > 0 ? 0 : -1;
+      break;
+    default:
+      SendNak(_type, NAK_UNKNOWN);
+      return;
+  }
+  SendAck(_type);
+}
+
+// Private - Little endian 16 bit value from the payload
+int16_t SerialProtocol::ReadInt16(int offset) {
+  return (int16_t)(_payload[offset] | ((uint16_t)_payload[offset + 1] << 8));
+}
+
+// Frames and sends a payload, for anything else with something to tell the host
+void SerialProtocol::SendFrame(uint8_t type, const uint8_t * payload, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  crc = _crc_ccitt_update(crc, type);
+  crc = _crc_ccitt_update(crc, length);
+  for (uint8_t i = 0; i < length; i++)
+    crc = _crc_ccitt_update(crc, payload[i]);
+
+  Serial.write((uint8_t)FRAME_START);
+  Serial.write(type);
+  Serial.write(length);
+  Serial.write(payload, length);
+  Serial.write((uint8_t)(crc & 0xFF));
+  Serial.write((uint8_t)(crc >> 8));
+}
+
+void SerialProtocol::SendAck(uint8_t command) {
+  SendFrame(FRAME_ACK, &command, 1);
+}
+
+void SerialProtocol::SendNak(uint8_t command, uint8_t reason) {
+  uint8_t payload[2] = {command, reason};
+  SendFrame(FRAME_NAK, payload, 2);
+}
+
+// Private - Fixed 10 byte frame: uint32 millis, int16 measured gallons, int16 active stop,
+// uint8 pump bits (active then pumping, two bits per pump), uint8 flags (see below)
+void SerialProtocol::SendTelemetry(long currentMillis) {
+  uint8_t payload[10];
+  int16_t gallons = (int16_t)(_pressureSensor->GetGallons() * 100);
+  int16_t stop = (int16_t)(_pressureSensor->GetThreshold() * 100);
+
+  payload[0] = currentMillis & 0xFF;
+  payload[1] = (currentMillis >> 8) & 0xFF;
+  payload[2] = (currentMillis >> 16) & 0xFF;
+  payload[3] = (currentMillis >> 24) & 0xFF;
+  payload[4] = gallons & 0xFF;
+  payload[5] = (gallons >> 8) & 0xFF;
+  payload[6] = stop & 0xFF;
+  payload[7] = (stop >> 8) & 0xFF;
+
+  uint8_t pumpBits = 0;
+  bool isAlarming = false;
+  for (int i = 0; i < _numPumps && i < 4; i++) {
+    if (_pumps[i]->GetIsActive())
+      pumpBits |= 1 << (i * 2);
+    if (_pumps[i]->IsPumping())
+      pumpBits |= 1 << (i * 2 + 1);
+    isAlarming = isAlarming || _pumps[i]->IsAlarming();
+  }
+  payload[8] = pumpBits;
+
+  // Bit 0 at stop 1, bit 1 showing gallons, bit 2 sensor connected, bit 3 any pump alarming
+  payload[9] = (_settings->atStopOne ? 0x01 : 0) | (_settings->showGallons ? 0x02 : 0) | (_pressureSensor->IsConnected() ? 0x04 : 0) | (isAlarming ? 0x08 : 0);
+
+  SendFrame(FRAME_TELEMETRY, payload, sizeof(payload));
+}
+
+// Private - Sends one stat as "name=value" text, cut to fit the payload buffer
+void SerialProtocol::SendStat(int index) {
+  uint8_t payload[MAX_FRAME_PAYLOAD];
+  String text = _brewStats->GetStatName(index) + F("=") + _brewStats->GetStatValue(index);
+  uint8_t length = min((unsigned int)text.length(), (unsigned int)(MAX_FRAME_PAYLOAD - 1));
+  payload[0] = index;
+  memcpy(payload + 1, text.c_str(), length);
+  SendFrame(FRAME_STAT, payload, length + 1);
+}
+
+// Private - Sends one event read back from EEPROM
+void SerialProtocol::SendEvent(int age) {
+  LogEvent event;
+  if (!_eventLog->GetEvent(age, &event))
+    return;
+
+  uint8_t payload[9];
+  payload[0] = age;
+  payload[1] = event.sequence & 0xFF;
+  payload[2] = event.sequence >> 8;
+  payload[3] = event.code;
+  payload[4] = event.detail;
+  payload[5] = event.millis & 0xFF;
+  payload[6] = (event.millis >> 8) & 0xFF;
+  payload[7] = (event.millis >> 16) & 0xFF;
+  payload[8] = (event.millis >> 24) & 0xFF;
+  SendFrame(FRAME_EVENT, payload, sizeof(payload));
+}
@@ -0,0 +1,111 @@
+/*
+  SerialProtocol.h - Library for a framed binary command and telemetry protocol over the serial port.
+  Created by Tom Wallace.
+
+  Every frame is: 0x7E, type, length, payload (length bytes), CRC-CCITT low byte, CRC-CCITT high byte.
+  The CRC starts at 0xFFFF and covers type, length and payload.  Multi-byte values are little endian,
+  and volumes are sent as hundredths of a gallon.  A frame that goes quiet for FRAME_BYTE_TIMEOUT
+  is dropped and the parser goes back to hunting for 0x7E.  Log text shares the port until the host sends a frame that passes
+  its CRC, then stays off until the host has been quiet for HOST_QUIET_TIMEOUT, so hosts should still drop anything that does
+  not frame and pass the CRC.
+*/
+#ifndef SerialProtocol_h
+#define SerialProtocol_h
+
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "Button.h"
+#include "ChannelConfig.h"
+#include "EventLog.h"
+#include "IPump.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+#include "VesselSettings.h"
+
+#define FRAME_START 0x7E
+#define MAX_FRAME_PAYLOAD 32
+#define FRAME_BYTE_TIMEOUT 50  // ms of silence inside a frame before it is dropped
+#define HOST_QUIET_TIMEOUT 30000  // ms without a good frame before log text comes back
+#define MAX_STOP_HUNDREDTHS 9950  // Same 0 to 99.5 gallon range as the boil stop menus
+
+// Commands from the host
+#define CMD_SET_STOP_ONE 0x01  // int16 hundredths of a gallon
+#define CMD_SET_STOP_TWO 0x02  // int16 hundredths of a gallon
+#define CMD_TOGGLE_STOP 0x03  // No payload
+#define CMD_SET_PUMP_PAUSED 0x04  // uint8 pump index, uint8 1 to pause, 0 to start
+#define CMD_REQUEST_STATS 0x05  // No payload
+#define CMD_SET_TELEMETRY 0x06  // uint16 ms between telemetry frames, 0 to stop
+#define CMD_SET_UNITS 0x07  // uint8 1 for gallons, 0 for the raw value
+#define CMD_READ_EVENT_LOG 0x08  // No payload
+#define CMD_SET_TRACE 0x09  // uint8 1 to start recording a trace, 0 to stop
+#define CMD_SET_PUMP_ACTIVE 0x0A  // uint8 pump index, uint8 1 to turn on, 0 to turn off
+
+// Frames to the host
+#define FRAME_ACK 0x80  // uint8 command
+#define FRAME_NAK 0x81  // uint8 command, uint8 reason
+#define FRAME_TELEMETRY 0x82  // See SendTelemetry
+#define FRAME_STAT 0x83  // uint8 index, then "name=value" text
+#define FRAME_EVENT 0x84  // uint8 age (0 is newest), uint16 sequence, uint8 code, uint8 detail, uint32 ms since its boot
+#define FRAME_TRACE 0x85  // Trace records, see TraceRecorder.h
+
+// NAK reasons
+#define NAK_CRC 0x01
+#define NAK_UNKNOWN 0x02
+#define NAK_LENGTH 0x03
+#define NAK_RANGE 0x04
+
+class SerialProtocol : public Loggable {
+  private:
+	int WAIT_START;
+	int READ_TYPE;
+	int READ_LENGTH;
+	int READ_PAYLOAD;
+	int READ_CRC_LOW;
+	int READ_CRC_HIGH;
+
+	VesselSettings * _settings;
+	PressureSensor * _pressureSensor;
+	IPump ** _pumps;
+	int _numPumps;
+	Button ** _buttons;
+	const PumpConfig * _pumpConfig;
+	BrewStats * _brewStats;
+	EventLog * _eventLog;
+	unsigned int _telemetryInterval;
+	unsigned long _previousMillis;
+
+	// Parser state - commands are handled straight out of _payload
+	int _state;
+	uint8_t _type;
+	uint8_t _length;
+	uint8_t _payload[MAX_FRAME_PAYLOAD];
+	uint8_t _received;
+	uint16_t _crc;
+	uint16_t _frameCrc;
+	unsigned long _lastByteMillis;
+	unsigned long _badFrames;
+	int _nextStat;  // Next stat to send, or -1 when none were requested
+	int _nextEvent;  // Age of the next logged event to send, or -1 when none were requested
+	bool _isTraceRequested;
+	bool _isQuietingLogs;  // Log text was turned off for the host
+	unsigned long _lastFrameMillis;
+
+	void Parse(uint8_t data, long currentMillis);
+	void HandleCommand(long currentMillis);
+	void UpdateLogging(long currentMillis);
+	void SendAck(uint8_t command);
+	void SendNak(uint8_t command, uint8_t reason);
+	void SendTelemetry(long currentMillis);
+	void SendStat(int index);
+	void SendEvent(int age);
+	int16_t ReadInt16(int offset);
+
+  public: 
+	SerialProtocol(VesselSettings * settings, PressureSensor * pressureSensor, IPump ** pumps, int numPumps, Button ** buttons, const PumpConfig * pumpConfig, BrewStats * brewStats, EventLog * eventLog, unsigned int telemetryInterval);
+	void Update(long currentMillis);
+	unsigned long GetBadFrameCount();
+	bool IsTraceRequested();
+	void SendFrame(uint8_t type, const uint8_t * payload, uint8_t length);
+};
+
+#endif
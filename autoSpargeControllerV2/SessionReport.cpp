@@ -0,0 +1,74 @@
+/*
+  SessionReport.cpp - Library for printing one CSV row per brew session, pairing the tuning constants with how the session went,
+  so production constants can be picked from the data of many brew days.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "ChannelConfig.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+#include "SessionReport.h"
+
+SessionReport::SessionReport(BrewStats * brewStats, PressureSensor * pressureSensor, const PumpConfig * pumpConfig, int numPumps) {
+  _brewStats = brewStats;
+  _pressureSensor = pressureSensor;
+  _pumpConfig = pumpConfig;  // Each pump's timing is a tuning constant
+  _numPumps = numPumps;
+  _sessionCount = 0;
+}
+
+// Prints the CSV header - every row line starts with SESSION, so they can be filtered out of a serial capture
+void SessionReport::Begin() {
+  _sessionCount = _brewStats->GetSessionCount();  // The last session may have been loaded from EEPROM, and was reported before the reboot
+
+  Serial.print(F("SESSION"));
+  for (int i = 0; i < _numPumps; i++) {
+    Serial.print(',');
+    Serial.print(FPSTR(ReadPumpConfig(&_pumpConfig[i]).name));
+    Serial.print(F(" timing ms"));
+  }
+  Serial.print(F(",Average Window ms,Stop One,Stop Two,Dead Volume,Lag sec,Overshoot gal"));
+  for (int i = 0; i < _brewStats->GetStatCount(); i++) {
+    Serial.print(',');
+    Serial.print(_brewStats->GetStatName(i));
+  }
+  Serial.println();
+}
+
+// Prints a row once each session ends
+void SessionReport::Update(long currentMillis) {
+  unsigned long sessionCount = _brewStats->GetSessionCount();
+  if (sessionCount == _sessionCount)
+    return;
+  _sessionCount = sessionCount;
+
+  // A host framing on the port would take the row for a broken frame
+  if (!Loggable::IsAllLogging())
+    return;
+
+  VesselSettings * settings = _pressureSensor->GetSettings();
+  Serial.print(F("SESSION"));
+  for (int i = 0; i < _numPumps; i++) {
+    Serial.print(',');
+    Serial.print(ReadPumpConfig(&_pumpConfig[i]).timing);
+  }
+  Serial.print(',');
+  Serial.print(_pressureSensor->GetAverageWindow());
+  Serial.print(',');
+  Serial.print(settings->stopOne, 2);
+  Serial.print(',');
+  Serial.print(settings->stopTwo, 2);
+  Serial.print(',');
+  Serial.print(_pressureSensor->GetDeadVolume(), 2);
+  Serial.print(',');
+  Serial.print(_pressureSensor->GetLagSeconds(), 1);
+  Serial.print(',');
+  Serial.print(_pressureSensor->GetLastOvershoot(), 2);
+  for (int i = 0; i < _brewStats->GetStatCount(); i++) {
+    Serial.print(',');
+    Serial.print(_brewStats->GetStatNumber(i), 2);
+  }
+  Serial.println();
+}
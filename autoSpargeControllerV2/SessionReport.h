@@ -0,0 +1,29 @@
+/*
+  SessionReport.h - Library for printing one CSV row per brew session, pairing the tuning constants with how the session went,
+  so production constants can be picked from the data of many brew days.  There is no host simulation to sweep, so the rows
+  come from real sessions, one per brew, and only cover the constants that were actually run.
+  Created by Tom Wallace.
+*/
+#ifndef SessionReport_h
+#define SessionReport_h
+
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "ChannelConfig.h"
+#include "PressureSensor.h"
+
+class SessionReport {
+  private:
+	BrewStats * _brewStats;
+	PressureSensor * _pressureSensor;
+	const PumpConfig * _pumpConfig;
+	int _numPumps;
+	unsigned long _sessionCount;
+
+  public: 
+	SessionReport(BrewStats * brewStats, PressureSensor * pressureSensor, const PumpConfig * pumpConfig, int numPumps);
+	void Begin();
+	void Update(long currentMillis);
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+  SettingsStore.cpp - Library for keeping a block of settings or counters in EEPROM across reboots, written lazily and spread over a
+  ring of slots.  Each slot holds a version, a sequence number, the data and a CRC.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "Loggable.h"
+#include "SettingsStore.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+SettingsStore::SettingsStore(const __FlashStringHelper * storeName, void * data, int size, uint8_t version, int address, int numSlots) {
+
+  _storeName = storeName;
+  _data = (uint8_t *)data;
+  _size = size;
+  _version = version;  // Slots written with another version are ignored
+  _address = address;  // First EEPROM byte of the ring
+  _numSlots = numSlots;  // Each write moves to the next slot, spreading the wear
+  _savedCrc = GetDataCrc();
+  _lastCrc = _savedCrc;
+  _changedMillis = 0;
+  _slot = numSlots - 1;  // So the first write goes to slot 0
+  _sequence = 0;
+  _pending = new uint8_t[size + SETTINGS_OVERHEAD];
+  _writeOffset = -1;
+  _isAutoSave = true;
+}
+
+// Data that changes all the time, such as counters, turns this off and is only written by Save
+void SettingsStore::SetAutoSave(bool isAutoSave) {
+  _isAutoSave = isAutoSave;
+}
+
+// First EEPROM byte after the ring, for anything stored behind it
+int SettingsStore::GetEndAddress() {
+  return GetSlotAddress(_numSlots);
+}
+
+// Reads the newest good slot over the defaults, returning false if there is none
+bool SettingsStore::Load(long currentMillis) {
+  uint8_t sequence;
+  uint8_t newestSequence = 0;
+  int newestSlot = -1;
+
+  // A fixed number of slots to check, so boot takes the same time whatever is stored
+  for (int slot = 0; slot < _numSlots; slot++) {
+    if (!ReadSlot(slot, &sequence))
+      continue;
+    if (newestSlot == -1 || (uint8_t)(sequence - newestSequence) < 128) {
+      newestSequence = sequence;
+      newestSlot = slot;
+    }
+  }
+
+  if (newestSlot == -1) {
+    Log(currentMillis, _storeName, F("Nothing saved, using defaults"));
+    return false;
+  }
+
+  int address = GetSlotAddress(newestSlot) + 2;
+  for (int i = 0; i < _size; i++)
+    _data[i] = EEPROM.read(address + i);
+  _savedCrc = GetDataCrc();
+  _lastCrc = _savedCrc;
+  _slot = newestSlot;
+  _sequence = newestSequence;
+  Log(currentMillis, _storeName, String(F("Loaded from slot ")) + String(newestSlot));
+  return true;
+}
+
+void SettingsStore::Update(long currentMillis) {
+  // Write one byte per loop, since each EEPROM write holds up the loop for over 3 ms
+  if (_writeOffset >= 0) {
+    EEPROM.update(GetSlotAddress(_slot) + _writeOffset, _pending[_writeOffset]);
+    _writeOffset++;
+    if (_writeOffset == _size + SETTINGS_OVERHEAD) {
+      _writeOffset = -1;
+      Log(currentMillis, _storeName, String(F("Saved to slot ")) + String(_slot));
+    }
+    return;
+  }
+
+  if (!_isAutoSave)
+    return;
+
+  // Restart the settle time on every change, so holding a menu key down only writes once it is let go
+  uint16_t crc = GetDataCrc();
+  if (crc != _lastCrc) {
+    _lastCrc = crc;
+    _changedMillis = currentMillis;
+  }
+
+  if (_lastCrc == _savedCrc || currentMillis - _changedMillis < (unsigned long)SAVE_SETTLE_DELAY)
+    return;
+
+  StartWrite(currentMillis);
+}
+
+// Writes the data now, without waiting for it to settle, such as counters that change every loop
+void SettingsStore::Save(long currentMillis) {
+  if (_writeOffset < 0)
+    StartWrite(currentMillis);
+}
+
+// Private - Snapshots the data into the next slot's record, which Update then writes a byte at a time
+void SettingsStore::StartWrite(long currentMillis) {
+  // A write cut short by a reboot fails its CRC, and the slot before it is loaded instead
+  _slot = (_slot + 1) % _numSlots;
+  _pending[0] = _version;
+  _pending[1] = ++_sequence;
+  memcpy(&_pending[2], _data, _size);
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < _size + 2; i++)
+    crc = _crc16_update(crc, _pending[i]);
+  _pending[_size + 2] = crc & 0xFF;
+  _pending[_size + 3] = crc >> 8;
+  _savedCrc = GetDataCrc();
+  _lastCrc = _savedCrc;
+  _writeOffset = 0;
+}
+
+// Private
+int SettingsStore::GetSlotAddress(int slot) {
+  return _address + slot * (_size + SETTINGS_OVERHEAD);
+}
+
+// Private - Returns false unless the slot holds a good record of this version, reading the CRC straight from EEPROM
+bool SettingsStore::ReadSlot(int slot, uint8_t * sequence) {
+  int address = GetSlotAddress(slot);
+  if (EEPROM.read(address) != _version)
+    return false;
+
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < _size + 2; i++)
+    crc = _crc16_update(crc, EEPROM.read(address + i));
+  uint16_t storedCrc = EEPROM.read(address + _size + 2) | (EEPROM.read(address + _size + 3) << 8);
+  *sequence = EEPROM.read(address + 1);
+  return crc == storedCrc;
+}
+
+// Private - Stands in for a copy of the data when watching for changes, at a fraction of the RAM
+uint16_t SettingsStore::GetDataCrc() {
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < _size; i++)
+    crc = _crc16_update(crc, _data[i]);
+  return crc;
+}
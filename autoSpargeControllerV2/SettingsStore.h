@@ -0,0 +1,50 @@
+/*
+  SettingsStore.h - Library for keeping a block of settings or counters in EEPROM across reboots, written lazily and spread over a
+  ring of slots.  Each slot holds a version, a sequence number, the data and a CRC.
+  Created by Tom Wallace.
+*/
+#ifndef SettingsStore_h
+#define SettingsStore_h
+
+#include "Arduino.h"
+#include "Loggable.h"
+
+// Bump when VesselSettings changes, so old records fall back to the defaults
+#define SETTINGS_VERSION 4
+
+// Bytes in a slot around the data - version, sequence and CRC
+#define SETTINGS_OVERHEAD 4
+#define SAVE_SETTLE_DELAY 5000L  // Milliseconds the data must stay unchanged before it is written
+
+class SettingsStore : public Loggable {
+  private:
+	const __FlashStringHelper * _storeName;
+	uint8_t * _data;
+	int _size;
+	uint8_t _version;
+	int _address;
+	int _numSlots;
+	uint16_t _savedCrc;  // CRC of the data in the newest slot
+	uint16_t _lastCrc;  // CRC of the data as of its last change
+	unsigned long _changedMillis;
+	int _slot;
+	uint8_t _sequence;
+	uint8_t * _pending;  // Copy of the whole slot being written, so the data can keep changing meanwhile
+	int _writeOffset;  // Next byte of _pending to write, or -1 when not writing
+	bool _isAutoSave;
+
+	int GetSlotAddress(int slot);
+	bool ReadSlot(int slot, uint8_t * sequence);
+	uint16_t GetDataCrc();
+	void StartWrite(long currentMillis);
+
+  public: 
+	SettingsStore(const __FlashStringHelper * storeName, void * data, int size, uint8_t version, int address, int numSlots);
+	bool Load(long currentMillis);
+	void Update(long currentMillis);
+	void Save(long currentMillis);
+	void SetAutoSave(bool isAutoSave);
+	int GetEndAddress();
+};
+
+#endif
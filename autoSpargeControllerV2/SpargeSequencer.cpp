@@ -0,0 +1,47 @@
+/*
+  SpargeSequencer.cpp - Optionally advances the boil kettle from stop 1 to stop 2 once a hold time or mash condition is met.  The mode
+  and hold time are vessel settings, so they are stored with the stops.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "IProbe.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+#include "SpargeSequencer.h"
+
+SpargeSequencer::SpargeSequencer(PressureSensor * boilPressureSensor, IProbe * mashProbe) {
+  _boilPressureSensor = boilPressureSensor;
+  _mashProbe = mashProbe;
+  _reachedStopOneMillis = 0;  // When the kettle reached stop 1, 0 if it has not
+}
+
+void SpargeSequencer::Update(long currentMillis) {
+  VesselSettings * settings = _boilPressureSensor->GetSettings();
+  if (settings->sequencerMode == SEQUENCE_OFF || !settings->atStopOne) {
+    _reachedStopOneMillis = 0;
+    return;
+  }
+
+  // An unconnected sensor also reports touching, so only a real reading can start the hold
+  if (_reachedStopOneMillis == 0) {
+    if (_boilPressureSensor->IsConnected() && _boilPressureSensor->IsTouching()) {
+      _reachedStopOneMillis = currentMillis;
+      Log(currentMillis, F("Sparge Sequencer"), F("Reached boil stop 1"));
+    }
+    return;
+  }
+
+  if (settings->sequencerMode == SEQUENCE_HOLD && (currentMillis - _reachedStopOneMillis >= settings->holdMinutes * 60000L)) {
+    Advance(currentMillis);
+  } else if (settings->sequencerMode == SEQUENCE_MASH && _mashProbe->IsTouching()) {
+    Advance(currentMillis);
+  }
+}
+
+// Private - Moves the active stop to boil stop 2 so the wort pump resumes
+void SpargeSequencer::Advance(long currentMillis) {
+  _boilPressureSensor->GetSettings()->atStopOne = false;
+  _reachedStopOneMillis = 0;
+  Log(currentMillis, F("Sparge Sequencer"), F("Advanced to boil stop 2"));
+}
@@ -0,0 +1,32 @@
+/*
+  SpargeSequencer.h - Optionally advances the boil kettle from stop 1 to stop 2 once a hold time or mash condition is met.  The mode
+  and hold time are vessel settings, so they are stored with the stops.
+  Created by Tom Wallace.
+*/
+#ifndef SpargeSequencer_h
+#define SpargeSequencer_h
+
+#include "Arduino.h"
+#include "IProbe.h"
+#include "Loggable.h"
+#include "PressureSensor.h"
+
+// Sequencer modes
+#define SEQUENCE_OFF 0
+#define SEQUENCE_HOLD 1
+#define SEQUENCE_MASH 2
+
+class SpargeSequencer : public Loggable {
+  private:
+	PressureSensor * _boilPressureSensor;
+	IProbe * _mashProbe;
+	long _reachedStopOneMillis;
+
+	void Advance(long currentMillis);
+
+  public: 
+	SpargeSequencer(PressureSensor * boilPressureSensor, IProbe * mashProbe);
+	void Update(long currentMillis);
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+  StatisticsMenu.cpp - Menu item that pages through the brew session statistics
+  Created by Tom Wallace.
+*/
+
+#include "BufferedLcd.h"
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "StatisticsMenu.h"
+
+StatisticsMenu::StatisticsMenu(BrewStats * brewStats, BufferedLcd * lcd) {
+   _brewStats = brewStats;
+   _lcd = lcd;
+   _statIndex = 0;
+}
+
+String StatisticsMenu::GetName() {
+  return F("Statistics");
+}
+
+void StatisticsMenu::Interact(int button) {
+  extern int selectedMenu;   // Set in main program for currently selected menu
+  
+  // Draw
+  _lcd->setCursor(0, 0);
+  _lcd->print(_brewStats->GetStatName(_statIndex));
+  _lcd->setCursor(0, 1);
+  _lcd->print(_brewStats->GetStatValue(_statIndex));
+
+  // Interact
+  switch (button) {
+    case 2:  // Previous statistic
+        _lcd->clear();
+        _statIndex = constrain(_statIndex - 1, 0, _brewStats->GetStatCount() - 1);
+        return;
+    case 3:  // Next statistic
+        _lcd->clear();
+        _statIndex = constrain(_statIndex + 1, 0, _brewStats->GetStatCount() - 1);
+        return;
+    case 4:  // This case will execute if the "back" button is pressed
+        _lcd->clear();
+        selectedMenu = 0;
+        return;
+   }
+}
@@ -0,0 +1,24 @@
+/*
+  StatisticsMenu.h - Menu item that pages through the brew session statistics
+  Created by Tom Wallace.
+*/
+#ifndef StatisticsMenu_h
+#define StatisticsMenu_h
+
+#include "BufferedLcd.h"
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "IMenu.h"
+
+class StatisticsMenu : public IMenu {
+  public: 
+	StatisticsMenu(BrewStats * brewStats, BufferedLcd * lcd);
+	virtual String GetName();
+    virtual void Interact(int button);
+  private:
+	BrewStats * _brewStats;
+	BufferedLcd * _lcd;
+	int _statIndex;
+};
+
+#endif
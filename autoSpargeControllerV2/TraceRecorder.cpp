@@ -0,0 +1,197 @@
+/*
+  TraceRecorder.cpp - Library for recording the raw inputs of a brew, such as probe edges, button and keypad presses and MPRLS
+  samples, as a compact trace sent to the host in FRAME_TRACE frames, so a brew day can be replayed later.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "Button.h"
+#include "IProbe.h"
+#include "Loggable.h"
+#include "MprlsReader.h"
+#include "SerialProtocol.h"
+#include "TraceRecorder.h"
+
+TraceRecorder::TraceRecorder(SerialProtocol * serialProtocol, IProbe ** probeInputs, int numProbes, Button ** buttons, int numButtons, MprlsReader * pressureReader, int numPressureChannels) {
+  FLUSH_INTERVAL = 1000;  // Milliseconds a record may wait for others to share its frame
+
+  _serialProtocol = serialProtocol;
+  _probeInputs = probeInputs;  // The raw inputs inside the filters, ahead of any filtering
+  _numProbes = min(numProbes, MAX_TRACE_INPUTS);
+  _buttons = buttons;
+  _numButtons = min(numButtons, MAX_TRACE_INPUTS);
+  _pressureReader = pressureReader;
+  _numPressureChannels = min(numPressureChannels, MAX_PRESSURE_CHANNELS);
+
+  _isRecording = false;
+  _lastMillis = 0;
+  _firstBufferedMillis = 0;
+  _probeLevels = 0;
+  _buttonsDown = 0;
+  _keypadButton = 0;
+  _recordedKeypadButton = 0;
+  _lostChannels = 0;
+  _recordCount = 0;
+  _length = 0;
+}
+
+// The keypad button the menu acted on this loop, 0 for none
+void TraceRecorder::SetKeypadButton(int button) {
+  _keypadButton = button;
+}
+
+void TraceRecorder::Update(long currentMillis) {
+  // The host starts and stops recording through the serial protocol
+  bool isRequested = _serialProtocol->IsTraceRequested();
+  if (isRequested && !_isRecording) {
+    Start(currentMillis);
+  } else if (!isRequested && _isRecording) {
+    Flush();
+    _isRecording = false;
+    Log(currentMillis, F("Trace Recorder"), String(F("Stopped after ")) + String(_recordCount) + F(" records"));
+  }
+
+  if (!_isRecording)
+    return;
+
+  uint8_t probeLevels = ReadProbeLevels();
+  uint8_t changed = probeLevels ^ _probeLevels;
+  for (int i = 0; i < _numProbes; i++) {
+    if (changed & (1 << i))
+      AddRecord(currentMillis, ((probeLevels & (1 << i)) ? TRACE_PROBE_HIGH : TRACE_PROBE_LOW) | i, false, 0);
+  }
+  _probeLevels = probeLevels;
+
+  uint8_t buttonsDown = ReadButtonsDown();
+  changed = buttonsDown ^ _buttonsDown;
+  for (int i = 0; i < _numButtons; i++) {
+    if (changed & (1 << i))
+      AddRecord(currentMillis, ((buttonsDown & (1 << i)) ? TRACE_BUTTON_DOWN : TRACE_BUTTON_UP) | i, false, 0);
+  }
+  _buttonsDown = buttonsDown;
+
+  if (_keypadButton != _recordedKeypadButton) {
+    AddRecord(currentMillis, TRACE_KEYPAD | _keypadButton, false, 0);
+    _recordedKeypadButton = _keypadButton;
+  }
+
+  // Samples are spotted by their count, so the pressure sensor still consumes them as usual
+  for (int i = 0; i < _numPressureChannels; i++) {
+    uint8_t sampleCount = _pressureReader->GetSampleCount(i);
+    if (sampleCount == _sampleCounts[i])
+      continue;
+    _sampleCounts[i] = sampleCount;
+
+    // The pressure sensor resets on the first failed reading and ignores the rest until a good one, so only the first is kept
+    if (_pressureReader->GetStatus(i) != MPRLS_STATUS_GOOD) {
+      if (!(_lostChannels & (1 << i)))
+        AddRecord(currentMillis, TRACE_SENSOR_LOST | i, false, 0);
+      _lostChannels |= 1 << i;
+      continue;
+    }
+    _lostChannels &= ~(1 << i);
+    uint32_t output = _pressureReader->GetOutput(i);
+    AddRecord(currentMillis, TRACE_PRESSURE | i, true, (long)output - (long)_outputs[i]);
+    _outputs[i] = output;
+  }
+
+  if (_length > 0 && currentMillis - _firstBufferedMillis >= (unsigned long)FLUSH_INTERVAL)
+    Flush();
+}
+
+// Private - Sends the start record with the state every later record changes from
+void TraceRecorder::Start(long currentMillis) {
+  _isRecording = true;
+  _recordCount = 0;
+  _length = 0;
+  _lastMillis = currentMillis;
+  _firstBufferedMillis = currentMillis;
+  _probeLevels = ReadProbeLevels();
+  _buttonsDown = ReadButtonsDown();
+  _recordedKeypadButton = _keypadButton;
+  _lostChannels = 0;
+  for (int i = 0; i < _numPressureChannels; i++) {
+    _sampleCounts[i] = _pressureReader->GetSampleCount(i);
+    _outputs[i] = 0;
+  }
+
+  _buffer[_length++] = TRACE_START;
+  _buffer[_length++] = currentMillis & 0xFF;
+  _buffer[_length++] = (currentMillis >> 8) & 0xFF;
+  _buffer[_length++] = (currentMillis >> 16) & 0xFF;
+  _buffer[_length++] = (currentMillis >> 24) & 0xFF;
+  _buffer[_length++] = _probeLevels;
+  _buffer[_length++] = _buttonsDown;
+  _buffer[_length++] = ReadButtonsOn();  // Pumps turned on before the trace started, which no later record shows
+  _buffer[_length++] = _recordedKeypadButton;
+  Log(currentMillis, F("Trace Recorder"), F("Started"));
+}
+
+// Private - Appends a record, sending the buffered frame first if the record would not fit
+void TraceRecorder::AddRecord(long currentMillis, uint8_t kind, bool hasValue, long value) {
+  uint8_t record[11];
+  uint8_t length = 0;
+  record[length++] = kind;
+  length += WriteVarint(record + length, currentMillis - _lastMillis);
+  if (hasValue)
+    length += WriteVarint(record + length, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));  // Zigzag, so small changes either way stay small
+
+  if (_length + length > MAX_FRAME_PAYLOAD)
+    Flush();
+  if (_length == 0)
+    _firstBufferedMillis = currentMillis;
+
+  memcpy(_buffer + _length, record, length);
+  _length += length;
+  _lastMillis = currentMillis;
+  _recordCount++;
+}
+
+// Private
+void TraceRecorder::Flush() {
+  if (_length == 0)
+    return;
+  _serialProtocol->SendFrame(FRAME_TRACE, _buffer, _length);
+  _length = 0;
+}
+
+// Private - One bit per probe, set when its raw input read high this loop
+uint8_t TraceRecorder::ReadProbeLevels() {
+  uint8_t levels = 0;
+  for (int i = 0; i < _numProbes; i++) {
+    if (_probeInputs[i]->IsTouching())
+      levels |= 1 << i;
+  }
+  return levels;
+}
+
+// Private - One bit per button, set when its last Update saw it held down
+uint8_t TraceRecorder::ReadButtonsDown() {
+  uint8_t down = 0;
+  for (int i = 0; i < _numButtons; i++) {
+    if (_buttons[i]->WasDepressed())
+      down |= 1 << i;
+  }
+  return down;
+}
+
+// Private - One bit per button, set when the function it toggles is on
+uint8_t TraceRecorder::ReadButtonsOn() {
+  uint8_t on = 0;
+  for (int i = 0; i < _numButtons; i++) {
+    if (_buttons[i]->GetMatchingFunctionOn())
+      on |= 1 << i;
+  }
+  return on;
+}
+
+// Private - Unsigned LEB128, seven bits per byte with the high bit set on all but the last
+uint8_t TraceRecorder::WriteVarint(uint8_t * buffer, unsigned long value) {
+  uint8_t length = 0;
+  while (value >= 0x80) {
+    buffer[length++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  buffer[length++] = value;
+  return length;
+}
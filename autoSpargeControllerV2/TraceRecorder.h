@@ -0,0 +1,77 @@
+/*
+  TraceRecorder.h - Library for recording the raw inputs of a brew, such as probe edges, button and keypad presses and MPRLS
+  samples, as a compact trace sent to the host in FRAME_TRACE frames, so a brew day can be replayed later.
+
+  Each record starts with a kind byte, with the kind in the high nibble and the probe, button, keypad button or pressure
+  channel in the low nibble.  The start record is followed by uint32 millis, uint8 probe levels, uint8 buttons down and uint8
+  buttons on (the pumps they turned on), one bit per channel, then uint8 keypad button.  Every other record is followed by the
+  ms since the previous record as an unsigned LEB128 varint.  Pressure records add the change in raw 24 bit counts since that channel's last good sample as a
+  zigzag varint, starting from 0.  A sensor lost record marks the first failed reading after a good one.
+
+  Probe levels and buttons are the values their objects read this loop, not fresh reads, so a replay sees what the filters
+  and the pump logic saw.
+  Created by Tom Wallace.
+*/
+#ifndef TraceRecorder_h
+#define TraceRecorder_h
+
+#include "Arduino.h"
+#include "Button.h"
+#include "IProbe.h"
+#include "Loggable.h"
+#include "MprlsReader.h"
+#include "SerialProtocol.h"
+
+// Record kinds
+#define TRACE_START 0x00
+#define TRACE_PROBE_HIGH 0x10
+#define TRACE_PROBE_LOW 0x20
+#define TRACE_BUTTON_DOWN 0x30
+#define TRACE_BUTTON_UP 0x40
+#define TRACE_PRESSURE 0x50
+#define TRACE_KEYPAD 0x60
+#define TRACE_SENSOR_LOST 0x70
+
+#define MAX_TRACE_INPUTS 8
+
+class TraceRecorder : public Loggable {
+  private:
+	long FLUSH_INTERVAL;
+	SerialProtocol * _serialProtocol;
+	IProbe ** _probeInputs;
+	int _numProbes;
+	Button ** _buttons;
+	int _numButtons;
+	MprlsReader * _pressureReader;
+	int _numPressureChannels;
+
+	bool _isRecording;
+	unsigned long _lastMillis;
+	unsigned long _firstBufferedMillis;
+	uint8_t _probeLevels;
+	uint8_t _buttonsDown;
+	uint8_t _keypadButton;
+	uint8_t _recordedKeypadButton;
+	uint8_t _lostChannels;
+	uint8_t _sampleCounts[MAX_PRESSURE_CHANNELS];
+	uint32_t _outputs[MAX_PRESSURE_CHANNELS];
+	unsigned long _recordCount;
+
+	uint8_t _buffer[MAX_FRAME_PAYLOAD];
+	uint8_t _length;
+
+	void Start(long currentMillis);
+	void AddRecord(long currentMillis, uint8_t kind, bool hasValue, long value);
+	void Flush();
+	uint8_t ReadProbeLevels();
+	uint8_t ReadButtonsDown();
+	uint8_t ReadButtonsOn();
+	static uint8_t WriteVarint(uint8_t * buffer, unsigned long value);
+
+  public: 
+	TraceRecorder(SerialProtocol * serialProtocol, IProbe ** probeInputs, int numProbes, Button ** buttons, int numButtons, MprlsReader * pressureReader, int numPressureChannels);
+	void SetKeypadButton(int button);
+	void Update(long currentMillis);
+};
+
+#endif
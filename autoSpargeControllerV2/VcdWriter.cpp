@@ -0,0 +1,106 @@
+/*
+  VcdWriter.cpp - Library for streaming pins and internal signals as a VCD waveform over the serial port, so a whole sparge
+  can be captured to a file and viewed in GTKWave.
+  Created by Tom Wallace.
+*/
+
+#include "Arduino.h"
+#include "VcdWriter.h"
+
+VcdWriter::VcdWriter() {
+  _numSignals = 0;
+  _hasDumped = false;
+}
+
+// Samples the pin each loop, so it reads back what was last written to an output
+void VcdWriter::AddPin(const __FlashStringHelper * name, int pin) {
+  Add(name, VCD_WIRE, pin, NULL);
+}
+
+void VcdWriter::AddSignal(const __FlashStringHelper * name, uint8_t kind, VcdSignal signal) {
+  Add(name, kind, -1, signal);
+}
+
+// Prints the header - call once every signal has been added
+void VcdWriter::Begin() {
+  Serial.println(F("$timescale 1ms $end"));
+  Serial.println(F("$scope module autoSparge $end"));
+  for (int i = 0; i < _numSignals; i++) {
+    Serial.print(F("$var "));
+    if (_kinds[i] == VCD_REAL)
+      Serial.print(F("real 64 "));
+    else if (_kinds[i] == VCD_INTEGER)
+      Serial.print(F("integer 8 "));
+    else
+      Serial.print(F("wire 1 "));
+    Serial.print((char)('!' + i));
+    Serial.print(' ');
+    Serial.print(_names[i]);
+    Serial.println(F(" $end"));
+  }
+  Serial.println(F("$upscope $end"));
+  Serial.println(F("$enddefinitions $end"));
+}
+
+// Prints a time stamp and the signals that changed, or everything on the first call
+void VcdWriter::Update(long currentMillis) {
+  bool hasTime = false;
+  for (int i = 0; i < _numSignals; i++) {
+    float value = Read(i);
+    if (_hasDumped && value == _values[i])
+      continue;
+
+    if (!hasTime) {
+      Serial.print('#');
+      Serial.println(currentMillis);
+      if (!_hasDumped)
+        Serial.println(F("$dumpvars"));
+      hasTime = true;
+    }
+    PrintValue(i, value);
+    _values[i] = value;
+  }
+
+  if (!_hasDumped) {
+    Serial.println(F("$end"));
+    _hasDumped = true;
+  }
+}
+
+// Private
+void VcdWriter::Add(const __FlashStringHelper * name, uint8_t kind, int pin, VcdSignal signal) {
+  if (_numSignals == MAX_VCD_SIGNALS)
+    return;
+  _names[_numSignals] = name;  // VCD names cannot hold spaces
+  _kinds[_numSignals] = kind;
+  _pins[_numSignals] = pin;
+  _signals[_numSignals] = signal;
+  _values[_numSignals] = 0;
+  _numSignals++;
+}
+
+// Private
+float VcdWriter::Read(int index) {
+  if (_pins[index] >= 0)
+    return digitalRead(_pins[index]) == HIGH ? 1 : 0;
+  return _signals[index]();
+}
+
+// Private - The id of each signal is a single printable character
+void VcdWriter::PrintValue(int index, float value) {
+  char id = '!' + index;
+  if (_kinds[index] == VCD_REAL) {
+    Serial.print('r');
+    Serial.print(value, 3);
+    Serial.print(' ');
+  } else if (_kinds[index] == VCD_INTEGER) {
+    int integer = (int)value;
+    Serial.print('b');
+    for (int bit = VCD_INTEGER_WIDTH - 1; bit >= 0; bit--)
+      Serial.print((integer >> bit) & 1 ? '1' : '0');
+    Serial.print(' ');
+  } else {
+    Serial.print(value != 0 ? '1' : '0');
+  }
+  Serial.println(id);
+}
@@ -0,0 +1,44 @@
+/*
+  VcdWriter.h - Library for streaming pins and internal signals as a VCD waveform over the serial port, so a whole sparge
+  can be captured to a file and viewed in GTKWave.  It samples once per loop on a real run - host/VcdDump gives the same
+  signals from the simulated board, stamped to the µs, and is where to look first.
+  Created by Tom Wallace.
+*/
+#ifndef VcdWriter_h
+#define VcdWriter_h
+
+#include "Arduino.h"
+
+// Signal kinds
+#define VCD_WIRE 0
+#define VCD_INTEGER 1
+#define VCD_REAL 2
+
+#define MAX_VCD_SIGNALS 16
+#define VCD_INTEGER_WIDTH 8
+
+typedef float (*VcdSignal)();
+
+class VcdWriter {
+  private:
+	const __FlashStringHelper * _names[MAX_VCD_SIGNALS];
+	uint8_t _kinds[MAX_VCD_SIGNALS];
+	int8_t _pins[MAX_VCD_SIGNALS];  // -1 when the signal comes from a function
+	VcdSignal _signals[MAX_VCD_SIGNALS];
+	float _values[MAX_VCD_SIGNALS];
+	int _numSignals;
+	bool _hasDumped;
+
+	void Add(const __FlashStringHelper * name, uint8_t kind, int pin, VcdSignal signal);
+	float Read(int index);
+	void PrintValue(int index, float value);
+
+  public: 
+	VcdWriter();
+	void AddPin(const __FlashStringHelper * name, int pin);
+	void AddSignal(const __FlashStringHelper * name, uint8_t kind, VcdSignal signal);
+	void Begin();
+	void Update(long currentMillis);
+};
+
+#endif
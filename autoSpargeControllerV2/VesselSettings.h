@@ -0,0 +1,22 @@
+/*
+  VesselSettings.h - The brewer's settings for one vessel measured by a pressure sensor, such as its gallon stops and display units.
+  Created by Tom Wallace.
+*/
+#ifndef VesselSettings_h
+#define VesselSettings_h
+
+#include "Arduino.h"
+
+struct VesselSettings {
+  float stopOne;  // First gallon stop, such as the pause in the boil kettle to turn off sparge
+  float stopTwo;  // Second gallon stop, such as the complete boil kettle level
+  bool atStopOne;  // Indicates if we are at the first stop
+  bool showGallons;  // Display in gallons, or pressure when false
+  float referenceGallons;  // Gallons measured by the brewer when the vessel's reference probe first touches, 0 until measured
+  float deadVolume;  // Learned gallons still in the line when the pump stops
+  float lagSeconds;  // Learned lag of the averaged readings behind the vessel
+  int sequencerMode;  // How the sequencer advances from stop 1 to stop 2 - SEQUENCE_OFF, SEQUENCE_HOLD or SEQUENCE_MASH
+  int holdMinutes;  // Minutes to hold at stop 1 when advancing on hold time
+};
+
+#endif
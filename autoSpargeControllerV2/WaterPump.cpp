@@ -8,17 +8,21 @@
 #include "Loggable.h"
 #include "IProbe.h"
 #include "WaterPump.h"
+#include <util/atomic.h>
 
-WaterPump::WaterPump(int outputPin, long delay, EventQueue * alarmEventQueue, IProbe * mashProbe, IProbe * mashProbeHigh) {
+WaterPump::WaterPump(const __FlashStringHelper * pumpName, int outputPin, long delay, EventQueue * alarmEventQueue, const __FlashStringHelper * alarmEvent, IProbe * mashProbe, IProbe * mashProbeHigh) {
+    PumpName = pumpName; // Name of the pump for logging
     OutputPin = outputPin; // The pin number that control pump output
     pinMode(OutputPin, OUTPUT);
 
     _alarmEventQueue = alarmEventQueue;
+    _alarmEvent = alarmEvent; // Event queued while the high probe is touching
     _mashProbe = mashProbe;
     _mashProbeHigh = mashProbeHigh;
     
     Delay = delay; // Milliseconds of delay after change of state from probe
     IsActive = true; // Toggle to let overrides stop pump
+    PausedBy = 0; // PAUSE_ bits for whatever is holding the pump off without changing IsActive
 
     CurrentState = PUMP_OFF;  // Pump starts off
     CurrentAlarmState = LOW;
@@ -36,34 +40,75 @@ bool WaterPump::GetIsActive() {
     return IsActive;
 }
 
+void WaterPump::SetIsPaused(bool isPaused, uint8_t source) {
+    // ForcePause can land from an interrupt, so its bit must not be lost in the middle of this
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (isPaused)
+        PausedBy |= source;
+      else
+        PausedBy &= ~source;
+    }
+}
+
+// Pauses and turns the output off now, for a caller that cannot wait for the next Update such as the loop watchdog interrupt
+void WaterPump::ForcePause(uint8_t source) {
+    PausedBy |= source;
+    CurrentState = PUMP_OFF;
+    digitalWrite(OutputPin, CurrentState);
+}
+
+bool WaterPump::IsPumping() {
+    return CurrentState == PUMP_ON;
+}
+
+bool WaterPump::IsAlarming() {
+    return _mashProbeHigh->IsTouching() && IsActive;
+}
+
 void WaterPump::Update(long currentMillis) {
-    int OriginalState = CurrentState;
-    
-    // If probe is contacting liquid, pump is always off
-    if (_mashProbe->IsTouching() || ! IsActive) {
-      previousMillis = currentMillis;
-      
-      CurrentState = PUMP_OFF;
-      digitalWrite(OutputPin, CurrentState);
-    } else {
-      if (currentMillis - previousMillis >= Delay) { 
+    int OriginalState;
+    bool isHeldOff = _mashProbe->IsTouching() || ! IsActive;
+
+    // A ForcePause landing between reading PausedBy and writing the pin would be undone by a stale ON, so the loop watchdog
+    // interrupt waits until the pin is written
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      OriginalState = CurrentState;
+
+      // If probe is contacting liquid, pump is always off
+      if (isHeldOff || PausedBy != 0) {
         previousMillis = currentMillis;
-  
-        CurrentState = PUMP_ON;
+      
+        CurrentState = PUMP_OFF;
         digitalWrite(OutputPin, CurrentState);
+      } else {
+        if (currentMillis - previousMillis >= Delay) { 
+          previousMillis = currentMillis;
+  
+          CurrentState = PUMP_ON;
+          digitalWrite(OutputPin, CurrentState);
+        }
       }
     }
 
     // Sound alarm if high level probe contacting liquid
     if (_mashProbeHigh->IsTouching() && IsActive) {
-      _alarmEventQueue->AddEvent("MashProbeHigh");
+      _alarmEventQueue->AddEvent(_alarmEvent);
     } else {
-      _alarmEventQueue->RemoveEvent("MashProbeHigh");
+      _alarmEventQueue->RemoveEvent(_alarmEvent);
     }
 
     // If state changed, then log
     if (CurrentState != OriginalState) {
-      String state = CurrentState == PUMP_ON ? "ON" : "OFF";
-      Log(currentMillis, "Water Pump", "State has changed to " + state); 
+      String state = CurrentState == PUMP_ON ? F("ON") : F("OFF");
+      Log(currentMillis, PumpName, String(F("State has changed to ")) + state); 
     }
 }
+
+void WaterPump::SetProbe(IProbe * mashProbe) {
+  _mashProbe = mashProbe;
+}
+
+// For tuning runs on the host - the build takes it from PUMP_CONFIG
+void WaterPump::SetDelay(long delay) {
+  Delay = delay;
+}
@@ -9,25 +9,35 @@
 #include "EventQueue.h"
 #include "Loggable.h"
 #include "IProbe.h"
+#include "IPump.h"
 
-class WaterPump : public Loggable {
+class WaterPump : public IPump, public Loggable {
   private:
 	int PUMP_ON;
 	int PUMP_OFF;
+	const __FlashStringHelper * PumpName;
 	EventQueue * _alarmEventQueue;
+	const __FlashStringHelper * _alarmEvent;
 	IProbe * _mashProbe;
 	IProbe * _mashProbeHigh;
 	int OutputPin;
 	bool IsActive;
+	volatile uint8_t PausedBy;
 	long Delay;
-	int CurrentState;
+	volatile int CurrentState;  // ForcePause writes it from an interrupt
 	int CurrentAlarmState;
 	unsigned long previousMillis;
   
   public: 
-	WaterPump(int outputPin, long delay, EventQueue * alarmEventQueue, IProbe * mashProbe, IProbe * mashProbeHigh);
+	WaterPump(const __FlashStringHelper * pumpName, int outputPin, long delay, EventQueue * alarmEventQueue, const __FlashStringHelper * alarmEvent, IProbe * mashProbe, IProbe * mashProbeHigh);
 	void SetIsActive(bool isActive);
 	bool GetIsActive();
+	void SetIsPaused(bool isPaused, uint8_t source);
+	void ForcePause(uint8_t source);
+	bool IsPumping();
+	bool IsAlarming();
+	void SetProbe(IProbe * mashProbe);
+	void SetDelay(long delay);
 	void Update(long currentMillis);
 };
 
@@ -8,18 +8,21 @@
 #include "Loggable.h"
 #include "IProbe.h"
 #include "WortPump.h"
+#include <util/atomic.h>
 
-WortPump::WortPump(int outputPin, long onInterval, EventQueue * alarmEventQueue, IProbe * boilProbe) {
+WortPump::WortPump(const __FlashStringHelper * pumpName, int outputPin, long onInterval, EventQueue * alarmEventQueue, const __FlashStringHelper * alarmEvent, IProbe * boilProbe) {
+    PumpName = pumpName; // Name of the pump for logging
 	OutputPin = outputPin; // The pin number that control pump output
     pinMode(OutputPin, OUTPUT);
 
     _alarmEventQueue = alarmEventQueue;
+    _alarmEvent = alarmEvent; // Event queued while the boil probe is touching
     _boilProbe = boilProbe;
     
     OnInterval = onInterval; // Milliseconds in a minute the pump is on
     OffInterval = 60000 - onInterval; // Milliseconds in a minute the pump is off
     IsActive = true; // Toggle to let overrides stop pump
-    IsAlarmForToggle = true; // Used to alternate the alarm when probe is touching
+    PausedBy = 0; // PAUSE_ bits for whatever is holding the pump off without changing IsActive
 
     CurrentState = PUMP_OFF;  // Pump starts off
     previousMillis = 0;
@@ -36,48 +39,70 @@ bool WortPump::GetIsActive() {
     return IsActive;
 }
 
+void WortPump::SetIsPaused(bool isPaused, uint8_t source) {
+    // ForcePause can land from an interrupt, so its bit must not be lost in the middle of this
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (isPaused)
+        PausedBy |= source;
+      else
+        PausedBy &= ~source;
+    }
+}
+
+// Pauses and turns the output off now, for a caller that cannot wait for the next Update such as the loop watchdog interrupt
+void WortPump::ForcePause(uint8_t source) {
+    PausedBy |= source;
+    CurrentState = PUMP_OFF;
+    digitalWrite(OutputPin, CurrentState);
+}
+
+bool WortPump::IsPumping() {
+    return CurrentState == PUMP_ON;
+}
+
+bool WortPump::IsAlarming() {
+    return _boilProbe->IsTouching() && IsActive;
+}
+
 void WortPump::Update(long currentMillis) {
-    int OriginalState = CurrentState;
-    
-    // If probe is contacting liquid, pump is always off
-    if (_boilProbe->IsTouching() || ! IsActive) {
-      CurrentState = PUMP_OFF;
-      digitalWrite(OutputPin, CurrentState);
-    } else {
-      if ((CurrentState == PUMP_OFF) && (currentMillis - previousMillis >= OffInterval)) { 
-        previousMillis = currentMillis;
-  
-        CurrentState = PUMP_ON;
-        digitalWrite(OutputPin, CurrentState);
-      } else if ((CurrentState == PUMP_ON) && (currentMillis - previousMillis >= OnInterval)) { 
-        previousMillis = currentMillis;
-  
+    int OriginalState;
+    bool isHeldOff = _boilProbe->IsTouching() || ! IsActive;
+
+    // A ForcePause landing between reading PausedBy and writing the pin would be undone by a stale ON, so the loop watchdog
+    // interrupt waits until the pin is written
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      OriginalState = CurrentState;
+
+      // If probe is contacting liquid, pump is always off
+      if (isHeldOff || PausedBy != 0) {
         CurrentState = PUMP_OFF;
         digitalWrite(OutputPin, CurrentState);
+      } else {
+        if ((CurrentState == PUMP_OFF) && (currentMillis - previousMillis >= OffInterval)) { 
+          previousMillis = currentMillis;
+  
+          CurrentState = PUMP_ON;
+          digitalWrite(OutputPin, CurrentState);
+        } else if ((CurrentState == PUMP_ON) && (currentMillis - previousMillis >= OnInterval)) { 
+          previousMillis = currentMillis;
+  
+          CurrentState = PUMP_OFF;
+          digitalWrite(OutputPin, CurrentState);
+        }
       }
     }
 
-    // Handle pulsing alarm every 0.5 seconds if probe is touching
+    // Sound alarm if probe is touching - the alarm Beeper plays the pulse pattern for this event
     if (_boilProbe->IsTouching() && IsActive) {
-      // TODO: Consider changing to pulsing it works - inaccurate - need to bounce milli times
-      bool canToggle = (currentMillis % 500) == 0;
-      if (canToggle) {
-        IsAlarmForToggle = IsAlarmForToggle ? false : true;
-        Log(currentMillis, "AlarmState", "State has changed to " + IsAlarmForToggle); 
-      }
-      if (IsAlarmForToggle) {
-        _alarmEventQueue->AddEvent("BoilProbe");
-      } else {
-        _alarmEventQueue->RemoveEvent("BoilProbe");
-      }
+      _alarmEventQueue->AddEvent(_alarmEvent);
     } else {
-      _alarmEventQueue->RemoveEvent("BoilProbe");
+      _alarmEventQueue->RemoveEvent(_alarmEvent);
     }
     
     // If state changed, then log
     if (CurrentState != OriginalState) {
-      String state = CurrentState == PUMP_ON ? "ON" : "OFF";
-      Log(currentMillis, "Wort Pump", "State has changed to " + state); 
+      String state = CurrentState == PUMP_ON ? F("ON") : F("OFF");
+      Log(currentMillis, PumpName, String(F("State has changed to ")) + state); 
     }
 }
 
@@ -85,3 +110,9 @@ void WortPump::Update(long currentMillis) {
 void WortPump::SetProbe(IProbe * boilProbe) {
   _boilProbe = boilProbe;
 }
+
+// For tuning runs on the host - the build takes it from PUMP_CONFIG
+void WortPump::SetOnInterval(long onInterval) {
+  OnInterval = onInterval;
+  OffInterval = 60000 - onInterval;
+}
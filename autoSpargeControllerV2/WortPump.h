@@ -9,28 +9,36 @@
 #include "EventQueue.h"
 #include "Loggable.h"
 #include "IProbe.h"
+#include "IPump.h"
 
-class WortPump : public Loggable {
+class WortPump : public IPump, public Loggable {
   private:
 	int PUMP_ON;
 	int PUMP_OFF;
+	const __FlashStringHelper * PumpName;
 	EventQueue * _alarmEventQueue;
+	const __FlashStringHelper * _alarmEvent;
 	IProbe * _boilProbe;
 	int OutputPin;
 	long OnInterval;
 	long OffInterval;
 	bool IsActive;
-	bool IsAlarmForToggle;
-	int CurrentState;
+	volatile uint8_t PausedBy;
+	volatile int CurrentState;  // ForcePause writes it from an interrupt
 	unsigned long previousMillis;
   
   // Constructor
   public: 
-	WortPump(int outputPin, long onInterval, EventQueue * alarmEventQueue, IProbe * boilProbe);
+	WortPump(const __FlashStringHelper * pumpName, int outputPin, long onInterval, EventQueue * alarmEventQueue, const __FlashStringHelper * alarmEvent, IProbe * boilProbe);
 	void SetIsActive(bool isActive);
 	bool GetIsActive();
+	void SetIsPaused(bool isPaused, uint8_t source);
+	void ForcePause(uint8_t source);
+	bool IsPumping();
+	bool IsAlarming();
 	void Update(long currentMillis);
   void SetProbe(IProbe * boilProbe);
+	void SetOnInterval(long onInterval);
 };
 
 #endif
@@ -3,19 +3,36 @@
 #include <utility/Adafruit_MCP23017.h>
 
 #include "Beeper.h"
+#include "Benchmark.h"
+#include "BrewStats.h"
+#include "BufferedLcd.h"
+#include "BusScheduler.h"
 #include "Button.h"
+#include "ChannelConfig.h"
+#include "EventLog.h"
 #include "EventQueue.h"
+#include "FastLcd.h"
+#include "FlowMonitor.h"
+#include "HysteresisProbe.h"
+#include "I2CMux.h"
+#include "IPump.h"
+#include "LoopProfiler.h"
+#include "LoopWatchdog.h"
+#include "MprlsReader.h"
 #include "PressureSensor.h"
-#include "Probe.h"
-#include "WaterPump.h"
-#include "WortPump.h"
+#include "SerialProtocol.h"
+#include "SessionReport.h"
+#include "SettingsStore.h"
+#include "SpargeSequencer.h"
+#include "TraceRecorder.h"
+#include "VcdWriter.h"
+#include "VesselSettings.h"
 
 #include "IMenu.h"
 #include "CurrentDataMenu.h"
-#include "SetBoilDisplayUnitsMenu.h"
-#include "SetBoilStopOneMenu.h"
-#include "SetBoilStopTwoMenu.h"
-#include "ToggleBoilStopMenu.h"
+#include "EventLogMenu.h"
+#include "MenuEngine.h"
+#include "StatisticsMenu.h"
 
 /* AUTOSPARGE CONTROLLER
  * version 2.0
@@ -33,10 +50,7 @@
  * it finishes booting.  All lights will flash three times if in test mode.  To exit test mode,
  * reboot the trinket. Updated.
  */
-// readStatus
 // Define Pins
-#define RESET_PIN -1  // set to any GPIO pin # to hard-reset on begin()
-#define EOC_PIN -1  // set to any GPIO pin to read end-of-conversion by pin
 #define TRINKET_BOARD_LED_PIN 13
 #define ALARM_PIN 8 //8
 #define BUZZER_PIN 9 //11
@@ -64,161 +78,670 @@
 #define V1_MODE 1
 #define V2_MODE 2 
 
-// Create objects
-Adafruit_MPRLS mpr = Adafruit_MPRLS(RESET_PIN, EOC_PIN);
-Adafruit_RGBLCDShield lcd = Adafruit_RGBLCDShield();
-
-EventQueue AlarmEventQueue("AlarmEventQueue");
-EventQueue BuzzerEventQueue("BuzzerEventQueue");
-
-Beeper Alarm("Alarm", ALARM_PIN, &AlarmEventQueue);
-Beeper Buzzer("Buzzer", BUZZER_PIN, &BuzzerEventQueue);
-
-Button LeftButton("Left Button", LEFT_BUTTON_PIN, INPUT_PULLUP, LEFT_BUTTON_LIGHT_PIN, &BuzzerEventQueue);
-Button RightButton("Right Button", RIGHT_BUTTON_PIN, INPUT_PULLUP, RIGHT_BUTTON_LIGHT_PIN, &BuzzerEventQueue);
-
-Probe MashProbe("Mash Probe", MASH_PROBE_PIN, INPUT);
-Probe MashProbeHigh("Mash Probe High", MASH_PROBE_HIGH_PIN, INPUT);
-Probe BoilProbe("Boil Probe", BOIL_PROBE_PIN, INPUT);
-
-PressureSensor BoilPressureSensor(&mpr);
+// Firmware variant - set a mode or hardware option to 0 and its code and objects are left out of the image completely
+#define WITH_V1_MODE 1  // Probes alone decide when the pumps stop
+#define WITH_TEST_MODE 1  // Lights and beeps for checking the wiring
+#define WITH_V2_MODE 1  // Menus, the pressure sensor stops and the serial protocol
+#define HAS_LCD 1  // RGB LCD shield - without it the Left Button held at boot picks TEST mode
+#define HAS_PRESSURE_SENSOR 1  // MPRLS on the boil kettle - only V2 mode reads it
+
+#define NUM_MODES (WITH_V1_MODE + WITH_TEST_MODE + WITH_V2_MODE)
+#if NUM_MODES == 0
+#error "Build at least one mode"
+#endif
+#if WITH_V2_MODE && !(HAS_LCD && HAS_PRESSURE_SENSOR)
+#error "V2 mode needs the LCD shield and the pressure sensor"
+#endif
+#if HAS_PRESSURE_SENSOR && !WITH_V2_MODE
+#error "Only V2 mode reads the pressure sensor, so set HAS_PRESSURE_SENSOR to 0"
+#endif
+
+// Mode used when the brewer does not pick one, or the only mode built
+#if WITH_V1_MODE
+#define DEFAULT_MODE V1_MODE
+#elif WITH_V2_MODE
+#define DEFAULT_MODE V2_MODE
+#else
+#define DEFAULT_MODE TEST_MODE
+#endif
+
+// Uncomment to keep the session stats across reboots and show them on the Statistics menu page.  This and the two extras
+// below are left out by default as the board has little RAM to spare - host/ram_budget.py says how much a build leaves
+//#define BREW_STATS
+
+// Uncomment to keep the last 32 events in EEPROM and show them on the Event Log menu page
+//#define EVENT_LOG
+
+// Uncomment for the binary serial protocol in V2 mode, with the trace recorder that sends over it - it sends the stats and the
+// event log too when they are built
+//#define SERIAL_PROTOCOL
+
+// Uncomment to time the hot-path classes at boot, printing BENCH lines as CSV to compare between builds
+//#define RUN_BENCHMARKS
+
+// Uncomment to log the CPU cycles each loop stage takes, and the peak stack depth, every 10 seconds - host/LoopCost gives
+// the same per stage from the simulated board without a rebuild
+//#define PROFILE_LOOP
+
+// Uncomment to print a CSV row of the tuning constants and how the sparge went at the end of each brew session - host/TuningSweep
+// gives the same table across a grid of constants on the simulated board.  Needs BREW_STATS
+//#define SESSION_REPORT
+
+// Uncomment to stream the pins and internal signals as a VCD waveform instead of log lines - capture the serial port from the $timescale line to a .vcd file.
+// host/VcdDump writes the same from the simulated board without a rebuild
+//#define DUMP_VCD
+
+#if defined(SESSION_REPORT) && !defined(BREW_STATS)
+#error "The session report prints the session stats, so define BREW_STATS"
+#endif
+
+// Serial port speed - fast enough that telemetry frames and log lines do not back up the loop
+#define SERIAL_BAUD 57600
+
+// Loop stages, so the watchdog can say where a stall happened
+#define STAGE_BUTTONS 0
+#define STAGE_PROBES 1
+#define STAGE_PRESSURE 2
+#define STAGE_PUMPS 3
+#define STAGE_MENU 4
+#define STAGE_ALARMS 5
+#define STAGE_SERIAL 6
+#define STAGE_LCD 7
+
+// Define I2C addresses
+#define PRESSURE_MUX_ADDRESS 0x70
+#define LCD_ADDRESS 0x20
+#define I2C_CLOCK 400000
+#define I2C_TIMEOUT_MICROS 25000
+
+// Names for the objects below, kept in flash - outside a function F() cannot be used, and a plain string literal is copied
+// to RAM at boot
+const char MPRLS_NAME[] PROGMEM = "MPRLS";
+const char LCD_NAME[] PROGMEM = "LCD";
+const char ALARM_QUEUE_NAME[] PROGMEM = "AlarmEventQueue";
+const char BUZZER_QUEUE_NAME[] PROGMEM = "BuzzerEventQueue";
+const char ALARM_NAME[] PROGMEM = "Alarm";
+const char BUZZER_NAME[] PROGMEM = "Buzzer";
+const char LEFT_BUTTON_NAME[] PROGMEM = "Left Button";
+const char RIGHT_BUTTON_NAME[] PROGMEM = "Right Button";
+const char MASH_PROBE_NAME[] PROGMEM = "Mash Probe";
+const char MASH_PROBE_HIGH_NAME[] PROGMEM = "Mash Probe High";
+const char BOIL_PROBE_NAME[] PROGMEM = "Boil Probe";
+const char WATER_PUMP_NAME[] PROGMEM = "Water Pump";
+const char WORT_PUMP_NAME[] PROGMEM = "Wort Pump";
+const char MASH_PROBE_HIGH_EVENT[] PROGMEM = "MashProbeHigh";
+const char BOIL_PROBE_EVENT[] PROGMEM = "BoilProbe";
+const char PRESSURE_SENSOR_NAME[] PROGMEM = "Boil Pressure Sensor";
+const char SETTINGS_STORE_NAME[] PROGMEM = "Settings Store";
+const char BOIL_STOP_NAME[] PROGMEM = "Boil Stop";
+const char STATS_STORE_NAME[] PROGMEM = "Stats Store";
 
-WaterPump WaterPump(WATER_PUMP_PIN, 10000, &AlarmEventQueue, &MashProbe, &MashProbeHigh);
-WortPump WortPump(WORT_PUMP_PIN, 2000, &AlarmEventQueue, &BoilProbe);
+// Create objects
+#if HAS_PRESSURE_SENSOR
+I2CMux PressureMux(PRESSURE_MUX_ADDRESS);
+MprlsReader PressureReader(NULL, 1);  // Pass &PressureMux and the number of channels once more than one vessel has a sensor
+#endif
+#if HAS_LCD
+Adafruit_RGBLCDShield lcdShield = Adafruit_RGBLCDShield();  // Only used to initialize the LCD and for the welcome message
+FastLcd fastLcd(LCD_ADDRESS);
+BufferedLcd lcd(&fastLcd);  // Everything draws here, and only changes are flushed to fastLcd
+
+// Share the I2C bus - pressure readings always go first, the LCD gets what is left of 10 ms per loop
+BusScheduler BusScheduler(10000, 300000);
+#if HAS_PRESSURE_SENSOR
+int pressureBusDevice = BusScheduler.AddDevice(FPSTR(MPRLS_NAME));
+#endif
+int lcdBusDevice = BusScheduler.AddDevice(FPSTR(LCD_NAME));
+#endif
+
+EventQueue AlarmEventQueue(FPSTR(ALARM_QUEUE_NAME));
+EventQueue BuzzerEventQueue(FPSTR(BUZZER_QUEUE_NAME));
+
+Beeper Alarm(FPSTR(ALARM_NAME), ALARM_PIN, &AlarmEventQueue);
+Beeper Buzzer(FPSTR(BUZZER_NAME), BUZZER_PIN, &BuzzerEventQueue);
+
+// Force the pumps off when a loop runs past 200 ms
+const char stageNames[][STAGE_NAME_SIZE] PROGMEM = {"buttons", "probes", "pressure", "pumps", "menu", "alarms", "serial", "LCD"};
+LoopWatchdog LoopWatchdog(200, ALARM_PIN, &AlarmEventQueue, stageNames, 8, I2C_CLOCK);
+#ifdef PROFILE_LOOP
+LoopProfiler LoopProfiler(stageNames, 8, 10000);
+#endif
+
+Button LeftButton(FPSTR(LEFT_BUTTON_NAME), LEFT_BUTTON_PIN, INPUT_PULLUP, LEFT_BUTTON_LIGHT_PIN, &BuzzerEventQueue);
+Button RightButton(FPSTR(RIGHT_BUTTON_NAME), RIGHT_BUTTON_PIN, INPUT_PULLUP, RIGHT_BUTTON_LIGHT_PIN, &BuzzerEventQueue);
+
+Button * buttons[] = {&LeftButton, &RightButton};
+
+// Channel tables - add rows here for a HERMS or two-kettle setup, then use the indexes below to wire them up
+// Filter splashes and chatter - a touch must hold for 100 ms, longer than a splash but only a spoonful of flow, before it stops a pump,
+// and the filtered probes update and log for the raw inputs they wrap
+const ProbeConfig PROBE_CONFIG[] PROGMEM = {
+  {MASH_PROBE_NAME, MASH_PROBE_PIN, PROBE_DEBOUNCE, 100, 500},
+  {MASH_PROBE_HIGH_NAME, MASH_PROBE_HIGH_PIN, PROBE_DEBOUNCE, 100, 500},
+  {BOIL_PROBE_NAME, BOIL_PROBE_PIN, PROBE_MAJORITY, 100, 100},
+};
+const PumpConfig PUMP_CONFIG[] PROGMEM = {
+  {WATER_PUMP_NAME, PUMP_WATER, WATER_PUMP_PIN, 10000, 0, 1, MASH_PROBE_HIGH_EVENT, 0},
+  {WORT_PUMP_NAME, PUMP_WORT, WORT_PUMP_PIN, 2000, 2, NO_CHANNEL, BOIL_PROBE_EVENT, 1},
+};
+#define NUM_PROBES (sizeof(PROBE_CONFIG) / sizeof(PROBE_CONFIG[0]))
+#define NUM_PUMPS (sizeof(PUMP_CONFIG) / sizeof(PUMP_CONFIG[0]))
+
+// Indexes into probes and pumps, matching the rows above
+#define MASH_PROBE 0
+#define MASH_PROBE_HIGH 1
+#define BOIL_PROBE 2
+#define WATER_PUMP 0
+#define WORT_PUMP 1
+
+IProbe * probes[NUM_PROBES];
+IProbe * probeInputs[NUM_PROBES];  // The raw input inside each filtered probe, read by the trace recorder
+IPump * pumps[NUM_PUMPS];
+
+// Build every channel from the tables - must come before anything below that is handed a probe or pump
+bool BuildChannels() {
+  for (unsigned int i = 0; i < NUM_PROBES; i++)
+    probes[i] = BuildProbe(ReadProbeConfig(&PROBE_CONFIG[i]), &probeInputs[i]);
+  for (unsigned int i = 0; i < NUM_PUMPS; i++)
+    pumps[i] = BuildPump(ReadPumpConfig(&PUMP_CONFIG[i]), probes, &AlarmEventQueue);
+  return true;
+}
+bool channelsBuilt = BuildChannels();
+
+#if WITH_V2_MODE
+// Boil kettle - formula updated on 04/21/23 - reading 0.5 gal low at key points
+VesselSettings BoilKettle = {4, 7.5, true, true, 0, 0.2, 3, SEQUENCE_OFF, 10};  // Provide defaults for stop 1 to pause sparge, stop 2 for the complete boil, starting at stop 1 in gallons, boil probe not yet measured, starting guesses for the in-flight model, and advancing from stop 1 to stop 2 by hand or after a 10 minute hold
+PressureSensor BoilPressureSensor(FPSTR(PRESSURE_SENSOR_NAME), &PressureReader, 0, &BoilKettle, 0.4021, 0.4707 + 0.5);
+SettingsStore BoilKettleStore(FPSTR(SETTINGS_STORE_NAME), &BoilKettle, sizeof(BoilKettle), SETTINGS_VERSION, 0, 16);  // Ring of 16 slots at the start of EEPROM
+HysteresisProbe BoilStop(FPSTR(BOIL_STOP_NAME), &BoilPressureSensor, 0.1);
+
+SpargeSequencer SpargeSequencer(&BoilPressureSensor, probes[MASH_PROBE]);
+// Judge every 6 sec of wort pump on-time - three of its 2 sec pulses, so one short or slow pulse cannot trip it alone - and stall
+// below a 0.05 gal rise.  With a pulse a minute that is 2-3 minutes plus the flow lag to catch a dry pump; the stall log line shows
+// the rise and latency seen, to tune these against the real brewery.
+FlowMonitor FlowMonitor(pumps[WORT_PUMP], &BoilPressureSensor, &AlarmEventQueue, 6000, 0.05, true);
+#define BOIL_PRESSURE_SENSOR &BoilPressureSensor
+#define EVENT_LOG_ADDRESS BoilKettleStore.GetEndAddress()  // Just past the settings ring
+#else
+#define BOIL_PRESSURE_SENSOR NULL
+#define EVENT_LOG_ADDRESS 0  // At the start of EEPROM with no settings to keep
+#endif
+
+// EEPROM is laid out the same whichever extras are built, so turning one on does not move what the others saved
+#define EVENT_LOG_SLOTS 32
+#define STATS_ADDRESS (EVENT_LOG_ADDRESS + EVENT_LOG_SLOTS * sizeof(LogEvent))  // Just past the event log
+
+#ifdef EVENT_LOG
+EventLog EventLog(EVENT_LOG_ADDRESS, EVENT_LOG_SLOTS, pumps, NUM_PUMPS, BOIL_PRESSURE_SENSOR, &LoopWatchdog);  // Last 32 events
+#define EVENT_LOG_OBJECT &EventLog
+#else
+#define EVENT_LOG_OBJECT NULL
+#endif
+#ifdef BREW_STATS
+BrewStats BrewStats(pumps[WATER_PUMP], pumps[WORT_PUMP], BOIL_PRESSURE_SENSOR);
+SettingsStore BrewStatsStore(FPSTR(STATS_STORE_NAME), BrewStats.GetCounters(), sizeof(BrewCounters), STATS_VERSION, STATS_ADDRESS, 4);  // Last session's stats
+#define BREW_STATS_OBJECT &BrewStats
+#else
+#define BREW_STATS_OBJECT NULL
+#endif
+
+#if WITH_V2_MODE && defined(SESSION_REPORT) && !defined(DUMP_VCD)
+SessionReport SessionReport(&BrewStats, &BoilPressureSensor, PUMP_CONFIG, NUM_PUMPS);
+#endif
+#if WITH_V2_MODE && defined(SERIAL_PROTOCOL)
+#ifdef DUMP_VCD
+SerialProtocol SerialProtocol(&BoilKettle, &BoilPressureSensor, pumps, NUM_PUMPS, buttons, PUMP_CONFIG, BREW_STATS_OBJECT, EVENT_LOG_OBJECT, 0);  // No telemetry in the waveform
+#else
+SerialProtocol SerialProtocol(&BoilKettle, &BoilPressureSensor, pumps, NUM_PUMPS, buttons, PUMP_CONFIG, BREW_STATS_OBJECT, EVENT_LOG_OBJECT, 1000);
+#endif
+TraceRecorder TraceRecorder(&SerialProtocol, probeInputs, NUM_PROBES, buttons, sizeof(buttons) / sizeof(buttons[0]), &PressureReader, 1);  // Records once the host asks for a trace
+#endif
 
 // Global variables
+#if NUM_MODES > 1
+int mode = DEFAULT_MODE;  // Default to existing behavior
+#else
+constexpr int mode = DEFAULT_MODE;  // Checks against the mode fold away when only one is built
+#endif
+#if NUM_MODES > 1 && HAS_LCD
 bool initializeComplete = false;
-int mode = V1_MODE;  // Default to existing behavior
 int startTime = 0;  
 int endInitTime = 0;
-float boilStopOne = 4;  // Provides default for pause boil to turn off sparge
-float boilStopTwo = 7.5;  // Provide default for complete boil stop level
-bool atBoilStopOne = true;  // Indicates if we are at the first stop in the boil
-bool boilShowGallons = true;  // Provide default for display in gallons
+#endif
 
+#if WITH_V2_MODE
 // Menu control variables
 CurrentDataMenu CurrentDataMenu(&BoilPressureSensor, &lcd);
-ToggleBoilStopMenu ToggleBoilStopMenu(&lcd);
-SetBoilStopOneMenu SetBoilStopOneMenu(&lcd);
-SetBoilStopTwoMenu SetBoilStopTwoMenu(&lcd);
-SetBoilDisplayUnitsMenu SetBoilDisplayUnitsMenu(&lcd);
-IMenu * menuItems[] = {&CurrentDataMenu, &ToggleBoilStopMenu, &SetBoilStopOneMenu, &SetBoilStopTwoMenu, &SetBoilDisplayUnitsMenu};
-
-int menuPage = 0;
-int sizeOfMenuItems = 5;
-int maxMenuPages = 3;
-int cursorPosition = 0;
+#ifdef BREW_STATS
+StatisticsMenu StatisticsMenu(&BrewStats, &lcd);
+#endif
+#ifdef EVENT_LOG
+EventLogMenu EventLogMenu(&EventLog, &lcd);
+#endif
+
+// Main menu listing, in flash - a setting is a row bound to its variable, and only pages need a class
+const MenuEntry MENU[] PROGMEM = {
+  // name,           title,               kind,        format,          value,                         min,           max,            step, wraps
+  {"Current Data",   "",                  MENU_PAGE,   FORMAT_PLAIN,    (IMenu *)&CurrentDataMenu,     0,             0,              0,    false},
+  {"Toggle Stop",    "Toggle Boil Stop",  MENU_BOOL,   FORMAT_STOP,     &BoilKettle.atStopOne,         0,             1,              1,    false},
+  {"Boil Stop 1",    "Set Boil Stop 1",   MENU_FLOAT,  FORMAT_PLAIN,    &BoilKettle.stopOne,           0,             99.5,           0.5,  false},
+  {"Boil Stop 2",    "Set Boil Stop 2",   MENU_FLOAT,  FORMAT_PLAIN,    &BoilKettle.stopTwo,           0,             99.5,           0.5,  false},
+  {"Display Units",  "Display Units",     MENU_BOOL,   FORMAT_UNITS,    &BoilKettle.showGallons,       0,             1,              1,    false},
+  {"Probe Gallons",  "Boil Probe Gal",    MENU_FLOAT,  FORMAT_PLAIN,    &BoilKettle.referenceGallons,  0,             99.5,           0.1,  false},
+  {"Auto Advance",   "Auto Advance",      MENU_INT,    FORMAT_ADVANCE,  &BoilKettle.sequencerMode,     SEQUENCE_OFF,  SEQUENCE_MASH,  1,    true},
+  {"Advance Hold",   "Set Hold Minutes",  MENU_INT,    FORMAT_PLAIN,    &BoilKettle.holdMinutes,       0,             240,            1,    false},
+#ifdef BREW_STATS
+  {"Statistics",     "",                  MENU_PAGE,   FORMAT_PLAIN,    (IMenu *)&StatisticsMenu,      0,             0,              0,    false},
+#endif
+#ifdef EVENT_LOG
+  {"Event Log",      "",                  MENU_PAGE,   FORMAT_PLAIN,    (IMenu *)&EventLogMenu,        0,             0,              0,    false},
+#endif
+};
+#define NUM_MENU_ENTRIES (sizeof(MENU) / sizeof(MENU[0]))
+MenuEngine MenuEngine(MENU, NUM_MENU_ENTRIES, &lcd);
+
 int selectedMenu = 0;
-byte upArrow[8] = {0x04,0x0E,0x1F,0x04,0x04,0x04,0x04,0x00};
-byte downArrow[8] = {0x04,0x04,0x04,0x04,0x1F,0x0E,0x04,0x00};
-byte menuCursor[8] = {0x10,0x08,0x04,0x02,0x04,0x08,0x10,0x00};
+const byte upArrow[8] PROGMEM = {0x04,0x0E,0x1F,0x04,0x04,0x04,0x04,0x00};
+const byte downArrow[8] PROGMEM = {0x04,0x04,0x04,0x04,0x1F,0x0E,0x04,0x00};
+const byte menuCursor[8] PROGMEM = {0x10,0x08,0x04,0x02,0x04,0x08,0x10,0x00};
+#endif
+
+#ifdef RUN_BENCHMARKS
+// Benchmarks - each runs a single call, which Benchmark::Run repeats and times
+const char BENCHMARK_QUEUE_NAME[] PROGMEM = "BenchmarkQueue";
+EventQueue BenchmarkQueue(FPSTR(BENCHMARK_QUEUE_NAME));
+
+void BenchmarkQueueAddRemove() {
+  BenchmarkQueue.AddEvent(F("Bench"));
+  BenchmarkQueue.RemoveEvent(F("Bench"));
+}
+void BenchmarkQueueIsPopulated() { BenchmarkQueue.IsPopulated(); }
+void BenchmarkQueueHasEvent() { BenchmarkQueue.HasEvent(F("Bench")); }
+#if WITH_V2_MODE
+void BenchmarkGetGallons() { BoilPressureSensor.GetGallons(); }
+void BenchmarkDisplay() { BoilPressureSensor.Display(); }
+void BenchmarkMenu() {
+  MenuEngine.Redraw();
+  MenuEngine.Interact(0);
+}
+#endif
+void BenchmarkLog() { LeftButton.Log(millis(), F("Benchmark"), F("Formatting a log line")); }
+void BenchmarkProbes() { UpdateProbes(millis()); }
+void BenchmarkButtons() {
+  for (unsigned int i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++)
+    buttons[i]->Update(millis());
+}
+
+void RunBenchmarks() {
+  Benchmark::Begin();
+
+  // Queue costs grow with the events already in it
+  int queued = 0;
+  for (int events = 0; events <= 8; events = events == 0 ? 1 : events * 2) {
+    while (queued < events)
+      BenchmarkQueue.AddEvent(String(F("Event")) + String(queued++));
+    String count = String(F(" n=")) + String(events);
+    Benchmark::Run(String(F("EventQueue AddRemove")) + count, BenchmarkQueueAddRemove, 100);
+    Benchmark::Run(String(F("EventQueue IsPopulated")) + count, BenchmarkQueueIsPopulated, 100);
+    Benchmark::Run(String(F("EventQueue HasEvent")) + count, BenchmarkQueueHasEvent, 100);
+  }
+
+  Benchmark::Run(F("Loggable Log"), BenchmarkLog, 20);
+  Benchmark::Run(F("Probe Update"), BenchmarkProbes, 100);
+  Benchmark::Run(F("Button Update"), BenchmarkButtons, 100);
+
+#if WITH_V2_MODE
+  Benchmark::Run(F("PressureSensor GetGallons"), BenchmarkGetGallons, 100);
+  Benchmark::Run(F("PressureSensor Display"), BenchmarkDisplay, 100);
+
+  // Renders only - button 0 takes no action
+  for (unsigned int i = 0; i <= NUM_MENU_ENTRIES; i++) {
+    selectedMenu = i;
+    Benchmark::Run(String(F("Menu ")) + String(i), BenchmarkMenu, 50);
+    lcd.clear();
+  }
+  selectedMenu = 0;
+#endif
+}
+#endif
+
+#ifdef DUMP_VCD
+// Internal signals for the waveform
+VcdWriter VcdWriter;
+
+float VcdAlarmQueue() { return AlarmEventQueue.IsPopulated(); }
+float VcdWaterPumping() { return pumps[WATER_PUMP]->IsPumping(); }
+float VcdWortPumping() { return pumps[WORT_PUMP]->IsPumping(); }
+#if WITH_V2_MODE
+float VcdBoilGallons() { return BoilPressureSensor.GetGallons(); }
+float VcdSelectedMenu() { return selectedMenu; }
+#endif
+
+void BeginVcd() {
+  VcdWriter.AddPin(F("water_pump"), WATER_PUMP_PIN);
+  VcdWriter.AddPin(F("wort_pump"), WORT_PUMP_PIN);
+  VcdWriter.AddPin(F("left_light"), LEFT_BUTTON_LIGHT_PIN);
+  VcdWriter.AddPin(F("right_light"), RIGHT_BUTTON_LIGHT_PIN);
+  VcdWriter.AddPin(F("alarm"), ALARM_PIN);
+  VcdWriter.AddPin(F("buzzer"), BUZZER_PIN);
+  VcdWriter.AddPin(F("mash_probe"), MASH_PROBE_PIN);
+  VcdWriter.AddPin(F("mash_probe_high"), MASH_PROBE_HIGH_PIN);
+  VcdWriter.AddPin(F("boil_probe"), BOIL_PROBE_PIN);
+  VcdWriter.AddPin(F("left_button_n"), LEFT_BUTTON_PIN);
+  VcdWriter.AddPin(F("right_button_n"), RIGHT_BUTTON_PIN);
+  VcdWriter.AddSignal(F("alarm_queue_populated"), VCD_WIRE, VcdAlarmQueue);
+  VcdWriter.AddSignal(F("water_pumping"), VCD_WIRE, VcdWaterPumping);
+  VcdWriter.AddSignal(F("wort_pumping"), VCD_WIRE, VcdWortPumping);
+#if WITH_V2_MODE
+  VcdWriter.AddSignal(F("boil_gallons"), VCD_REAL, VcdBoilGallons);
+  VcdWriter.AddSignal(F("selected_menu"), VCD_INTEGER, VcdSelectedMenu);
+#endif
+  VcdWriter.Begin();
+}
+#endif
 
 // Setup code only runs once
 void setup() {
   pinMode(TRINKET_BOARD_LED_PIN, OUTPUT);
-  // Set up serial port for output at 9600 bps
-  Serial.begin(9600);
-
-  mpr.begin();
-  lcd.begin(16, 2);
-  lcd.setBacklight(BLUE);
+  // Set up serial port for log output and the binary protocol
+  Serial.begin(SERIAL_BAUD);
+#ifdef DUMP_VCD
+  Loggable::SetAllLogging(false);  // Log lines would corrupt the waveform
+#endif
+
+#if WITH_V2_MODE
+  // Replace the boil kettle defaults with the brewer's last settings
+  BoilKettleStore.Load(millis());
+#endif
+
+#ifdef BREW_STATS
+  // Bring back the last session's stats, saved at its start, its end and every few minutes during it, and carry on with a session
+  // a reboot cut short
+  BrewStatsStore.SetAutoSave(false);
+  BrewStatsStore.Load(millis());
+  BrewStats.SetStore(&BrewStatsStore);
+  BrewStats.Resume(millis());
+#endif
+
+#ifdef EVENT_LOG
+  // Read back what happened before this boot, and record why it reset
+  EventLog.Begin(millis());
+#endif
+
+  Wire.begin();
+  Wire.setWireTimeout(I2C_TIMEOUT_MICROS, true);  // A device holding the bus makes Wire give up rather than block forever
+#if HAS_LCD
+  lcdShield.begin(16, 2);
+  lcdShield.setBacklight(BLUE);
   
   displayLugWrenchWelcomeMessage();
   
+#if NUM_MODES > 1
   startTime = millis();
   endInitTime = 9000 + startTime;
+#endif
   
+#if WITH_V2_MODE
   // Menu items
-  lcd.createChar(0, menuCursor); // Create the custom arrow characters in void setup for global use
-  lcd.createChar(1, upArrow);
-  lcd.createChar(2, downArrow);  
+  createChar(0, menuCursor); // Create the custom arrow characters in void setup for global use
+  createChar(1, upArrow);
+  createChar(2, downArrow);
+#endif
+
+  // Take over the LCD from the Adafruit library and log how much faster a full screen is
+  unsigned long libraryMicros = micros();
+  for (int row = 0; row < 2; row++) {
+    lcdShield.setCursor(0, row);
+    lcdShield.print(F("                "));
+  }
+  libraryMicros = micros() - libraryMicros;
+
+  fastLcd.Begin();
+  uint8_t blankRow[16];
+  memset(blankRow, ' ', sizeof(blankRow));
+  unsigned long fastMicros = micros();
+  for (int row = 0; row < 2; row++) {
+    fastLcd.SetCursor(0, row);
+    fastLcd.Write(blankRow, sizeof(blankRow));
+  }
+  fastMicros = micros() - fastMicros;
+  Serial.println(String(F("LCD full screen update - library ")) + String(libraryMicros) + F(" us, fast ") + String(fastMicros) + F(" us"));
+#endif
+
+  // Alarm patterns, so each alarm source can be told apart by ear
+  Alarm.SetEventPattern(F("BoilProbe"), BEEPER_PULSE, 1);
+  Alarm.SetEventPattern(F("MashProbeHigh"), BEEPER_DOUBLE_CHIRP, 2);
+  Alarm.SetEventPattern(F("DryRun"), BEEPER_DRY_RUN, 3);
+  Alarm.SetEventPattern(F("LoopStall"), BEEPER_STALL, 4);
+
+  // The buzzer also plays pitch-coded melodies for the alarms
+  Buzzer.EnableTone();
+  Buzzer.AddEventQueue(&AlarmEventQueue);
+  Buzzer.SetEventPattern(F("BoilProbe"), BEEPER_KETTLE_FULL, 1);
+  Buzzer.SetEventPattern(F("MashProbeHigh"), BEEPER_MASH_HIGH, 2);
+  Buzzer.SetEventPattern(F("DryRun"), BEEPER_DRY_RUN, 3);
+  Buzzer.SetEventPattern(F("LoopStall"), BEEPER_STALL, 4);
+  Beeper::Begin();
+
+  LoopWatchdog.SetPumps(pumps, NUM_PUMPS);
+
+#ifdef RUN_BENCHMARKS
+  RunBenchmarks();
+#endif
+
+#ifdef DUMP_VCD
+  BeginVcd();
+#elif WITH_V2_MODE && defined(SESSION_REPORT)
+  SessionReport.Begin();
+#endif
+
+#if NUM_MODES > 1 && !HAS_LCD
+  // No LCD buttons to pick with, so holding the Left Button through boot picks TEST mode
+  mode = WITH_TEST_MODE && LeftButton.IsCurrentlyDepressed() ? TEST_MODE : DEFAULT_MODE;
+#endif
+#if NUM_MODES == 1 || !HAS_LCD
+  StartMode(millis());
+#endif
 }
 
 // Main code that runs as a state machine
 void loop() {
   // Get current clock
   unsigned long currentMillis = millis();
+#if HAS_LCD
+  BusScheduler.Begin();
+#endif
   
+#if NUM_MODES > 1 && HAS_LCD
   if (!initializeComplete) {
     Initialize(currentMillis);
-    
-    // Provide V2 override for pressure sensor probe in WortPump - this overload is what allows the pressure sensor to be used
-    if (mode == V2_MODE) {
-      WortPump.SetProbe(&BoilPressureSensor);
-    }
+    FlushLcd();
+    if (initializeComplete)
+      StartMode(currentMillis);
     return;
   }
+#endif
 
+#if WITH_V1_MODE
   // Use legacy Version 1.0
   if (mode == V1_MODE) {
+#if HAS_LCD
     lcd.setBacklight(VIOLET);
     lcd.setCursor(0, 0);
-    lcd.print("Using V1.0");
-
-    LeftButton.Update(currentMillis);
-    RightButton.Update(currentMillis);
-  
-    // Set pump active based on their buttons
-    WaterPump.SetIsActive(LeftButton.GetMatchingFunctionOn());
-    WortPump.SetIsActive(RightButton.GetMatchingFunctionOn());
-  
-    MashProbe.Update(currentMillis);
-    MashProbeHigh.Update(currentMillis);
-    
-    BoilProbe.Update(currentMillis);
-  
-    WaterPump.Update(currentMillis);
-    WortPump.Update(currentMillis);
-
+    lcd.print(F("Using V1.0"));
+#endif
+
+    MarkStage(STAGE_BUTTONS);
+    UpdateButtons(currentMillis);
+    MarkStage(STAGE_PROBES);
+    UpdateProbes(currentMillis);
+    MarkStage(STAGE_PUMPS);
+    UpdatePumps(currentMillis);
+    UpdateRecords(currentMillis);
+
+    MarkStage(STAGE_ALARMS);
     Alarm.Update(currentMillis);
     Buzzer.Update(currentMillis);
+  }
+#endif
 
+#if WITH_V2_MODE
   // Use new Version 2.0 code
-  } else if (mode == V2_MODE) {
+  if (mode == V2_MODE) {
     lcd.setBacklight(GREEN);
 
-    menu();
-
-    LeftButton.Update(currentMillis);
-    RightButton.Update(currentMillis);
-  
-    // Set pump active based on their buttons
-    WaterPump.SetIsActive(LeftButton.GetMatchingFunctionOn());
-    WortPump.SetIsActive(RightButton.GetMatchingFunctionOn());
-  
-    MashProbe.Update(currentMillis);
-    MashProbeHigh.Update(currentMillis);
+    // The pressure sensor gets the I2C bus first, before the keypad and the LCD
+    MarkStage(STAGE_PRESSURE);
+    unsigned long busMicros = micros();
+    if (PressureReader.Update(currentMillis))
+      BusScheduler.Record(pressureBusDevice, busMicros);
+    BoilStop.Update(currentMillis);  // Also updates BoilPressureSensor
 
-    BoilPressureSensor.Update(currentMillis);
-  
-    WaterPump.Update(currentMillis);
-    WortPump.Update(currentMillis);
+    MarkStage(STAGE_MENU);
+    menu();
 
+    MarkStage(STAGE_BUTTONS);
+    UpdateButtons(currentMillis);
+    MarkStage(STAGE_PROBES);
+    UpdateProbes(currentMillis);
+
+    MarkStage(STAGE_PUMPS);
+    SpargeSequencer.Update(currentMillis);
+    UpdatePumps(currentMillis);
+    FlowMonitor.Update(currentMillis);
+    UpdateRecords(currentMillis);
+
+    MarkStage(STAGE_SERIAL);
+#if defined(SESSION_REPORT) && !defined(DUMP_VCD)
+    SessionReport.Update(currentMillis);
+#endif
+#ifdef SERIAL_PROTOCOL
+    SerialProtocol.Update(currentMillis);
+    TraceRecorder.Update(currentMillis);
+#endif
+    BoilKettleStore.Update(currentMillis);
+
+    MarkStage(STAGE_ALARMS);
     Alarm.Update(currentMillis);
     Buzzer.Update(currentMillis);
+  }
+#endif
 
+#if WITH_TEST_MODE
   // Work in TEST mode
-  } else if (mode == TEST_MODE) {
+  if (mode == TEST_MODE) {
     TestInteractions();
   }
+#endif
+
+  MarkStage(STAGE_LCD);
+#if HAS_LCD
+  FlushLcd();
+  BusScheduler.Update(currentMillis);
+#endif
+  if (mode != TEST_MODE) {
+    LoopWatchdog.Update(currentMillis);
+#ifdef PROFILE_LOOP
+    LoopProfiler.Update(currentMillis);
+#endif
+  }
+
+#ifdef DUMP_VCD
+  VcdWriter.Update(currentMillis);
+#endif
+}
+
+// Runs once the mode is picked, or at boot when there is nothing to pick
+void StartMode(long currentMillis) {
+#if WITH_V2_MODE
+  // Provide V2 override for pressure sensor probe in WortPump - this overload is what allows the pressure sensor to be used
+  if (mode == V2_MODE) {
+    pumps[WORT_PUMP]->SetProbe(&BoilStop);
+    BoilPressureSensor.SetReferenceProbe(probes[BOIL_PROBE]);  // At the Probe Gallons setting
+  }
+#endif
+
+  // Test mode blinks with long delays, so only watch the loop when brewing
+  if (mode != TEST_MODE) {
+    LoopWatchdog.Begin(currentMillis);
+#ifdef PROFILE_LOOP
+    LoopProfiler.Begin();
+#endif
+  }
+}
+
+// Marks the loop stage for the watchdog, and for the profiler when it is built in
+void MarkStage(int stage) {
+  LoopWatchdog.Stage(stage);
+#ifdef PROFILE_LOOP
+  LoopProfiler.Stage(stage);
+#endif
+}
+
+// Updates the buttons and sets each pump active based on its button
+void UpdateButtons(long currentMillis) {
+  for (unsigned int i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++)
+    buttons[i]->Update(currentMillis);
+
+  for (unsigned int i = 0; i < NUM_PUMPS; i++)
+    pumps[i]->SetIsActive(buttons[ReadPumpConfig(&PUMP_CONFIG[i]).button]->GetMatchingFunctionOn());
+}
+
+// Updates every filtered probe, which also updates the raw input it wraps
+void UpdateProbes(long currentMillis) {
+  for (unsigned int i = 0; i < NUM_PROBES; i++)
+    probes[i]->Update(currentMillis);
+}
+
+void UpdatePumps(long currentMillis) {
+  for (unsigned int i = 0; i < NUM_PUMPS; i++)
+    pumps[i]->Update(currentMillis);
 }
 
+// The stats and the event log, whichever are built, from what the pumps just did
+void UpdateRecords(long currentMillis) {
+#ifdef BREW_STATS
+  BrewStats.Update(currentMillis);
+  BrewStatsStore.Update(currentMillis);
+#endif
+#ifdef EVENT_LOG
+  EventLog.Update(currentMillis);
+#endif
+}
+
+#if HAS_LCD
+// Sends the changed LCD characters in whatever bus time is left this loop
+void FlushLcd() {
+  unsigned long busMicros = micros();
+  lcd.Flush(BusScheduler.GetRemainingMicros());
+  BusScheduler.Record(lcdBusDevice, busMicros);
+}
+#endif
+
+#if NUM_MODES > 1 && HAS_LCD
 // Initialize with button options to determine running mode
 void Initialize(long currentMillis) {
   lcd.setBacklight(GREEN);
+#if WITH_V2_MODE
   lcd.setCursor(0,0);
-  lcd.print("Select for 2.0");
+  lcd.print(F("Select for 2.0"));
+#endif
+#if WITH_TEST_MODE
   lcd.setCursor(0,1);
-  lcd.print("Left for TEST");
+  lcd.print(F("Left for TEST"));
+#endif
 
-  // Check if "Select" button is pressed
   int button = evaluateButton();
+#if WITH_V2_MODE
+  // Check if "Select" button is pressed
   if (button == 5) {
     initializeComplete = true;
     mode = V2_MODE;
     lcd.clear();
     return;
   }
+#endif
+#if WITH_TEST_MODE
   // Check to see if the "Left" button is pressed
   if (button == 4) {
     initializeComplete = true;
@@ -226,11 +749,12 @@ void Initialize(long currentMillis) {
     lcd.clear();
     return;
   }
+#endif
 
-  // Our countdown is over - default to Auto Sparge 1.0
+  // Our countdown is over - default to Auto Sparge 1.0, or V2 when 1.0 is not built
   if (currentMillis > endInitTime) {
     initializeComplete = true;
-    mode = V1_MODE;
+    mode = DEFAULT_MODE;
     lcd.clear();
     return;
   }
@@ -239,12 +763,16 @@ void Initialize(long currentMillis) {
   lcd.setCursor(15,1);
   lcd.print(currTimeDisplay);
 }
+#endif
 
+#if WITH_TEST_MODE
 // Version 1.0 TEST Mode
 void TestInteractions() {
+#if HAS_LCD
   lcd.setBacklight(RED);
   lcd.setCursor(0, 0);
-  lcd.print("TEST Mode v1.0");
+  lcd.print(F("TEST Mode v1.0"));
+#endif
     
   if (LeftButton.IsCurrentlyDepressed()) {
       digitalWrite(LEFT_BUTTON_LIGHT_PIN, HIGH);
@@ -297,11 +825,13 @@ void TestInteractions() {
       }
     }
 }
+#endif
 
+#if HAS_LCD
 // Display LugWrench Welcome Message on start up
 void displayLugWrenchWelcomeMessage() {
   // Lug Wrench welcome message  
-  String welcome = "Lug Wrench Brewing Company Auto Sparge V2.0";
+  String welcome = F("Lug Wrench Brewing Company Auto Sparge V2.0");
   for (int i = 0; i < (welcome.length() + 16); i++) {
     int start = 0;
     if (i > 16) {
@@ -314,132 +844,41 @@ void displayLugWrenchWelcomeMessage() {
       cursorLocation = 0;
     }
     
-    lcd.setCursor(cursorLocation, 0);
-    lcd.print(subWelcome);
+    lcdShield.setCursor(cursorLocation, 0);
+    lcdShield.print(subWelcome);
     delay(150);
-    lcd.clear();
+    lcdShield.clear();
   }
   
-  lcd.clear();
+  lcdShield.clear();
   delay(1000);
 }
+#endif
+
+#if WITH_V2_MODE
+// The custom characters are kept in flash, and the library reads them from RAM
+void createChar(uint8_t location, const byte * charmap) {
+  byte character[8];
+  memcpy_P(character, charmap, sizeof(character));
+  lcdShield.createChar(location, character);
+}
 
 // Base function for interacting with the menus
 void menu() {
   int button = evaluateButton();
-
-  if (selectedMenu == 0)
-     mainMenu(button);
-  else
-     menuItems[selectedMenu - 1]->Interact(button);
-}
-
-// Interaction with the main menu listing
-void mainMenu(int button) {
-  // Draw
-  lcd.setCursor(1, 0);
-  lcd.print(menuItems[menuPage]->GetName());
-  //lcd.print(menuItems[menuPage]);
-  lcd.setCursor(1, 1);
-  lcd.print(menuItems[menuPage + 1]->GetName());
-  //lcd.print(menuItems[menuPage + 1]);
-  if (menuPage == 0) {
-    lcd.setCursor(15, 1);
-    lcd.write(byte(2));
-  } else if (menuPage > 0 and menuPage < maxMenuPages) {
-    lcd.setCursor(15, 1);
-    lcd.write(byte(2));
-    lcd.setCursor(15, 0);
-    lcd.write(byte(1));
-  } else if (menuPage == maxMenuPages) {
-    lcd.setCursor(15, 0);
-    lcd.write(byte(1));
-  }
-
-  drawCursor();
-
-  // Interact
-  switch (button) {
-    case 0: // When button returns as 0 there is no action taken
-      return;
-    case 1:  // This case will execute if the "forward" button is pressed
-      lcd.clear();
-      selectedMenu = cursorPosition + 1; // The case that is selected here is dependent on which menu page you are on and where the cursor is.
-      return;
-
-      break;
-    case 2:
-      lcd.clear();
-      if (menuPage == 0) {
-        cursorPosition = cursorPosition - 1;
-        cursorPosition = constrain(cursorPosition, 0, sizeOfMenuItems - 1);
-      }
- 
-      if (menuPage % 2 == 0 and cursorPosition % 2 == 0) {
-        menuPage = menuPage - 1;
-        menuPage = constrain(menuPage, 0, maxMenuPages);
-      }
-
-      if (menuPage % 2 != 0 and cursorPosition % 2 != 0) {
-        menuPage = menuPage - 1;
-        menuPage = constrain(menuPage, 0, maxMenuPages);
-      }
-
-      cursorPosition = cursorPosition - 1;
-      cursorPosition = constrain(cursorPosition, 0, sizeOfMenuItems - 1);
-      break;
-    case 3:
-      lcd.clear();
-      if (menuPage % 2 == 0 and cursorPosition % 2 != 0) {
-        menuPage = menuPage + 1;
-        menuPage = constrain(menuPage, 0, maxMenuPages);
-      }
-
-      if (menuPage % 2 != 0 and cursorPosition % 2 == 0) {
-        menuPage = menuPage + 1;
-        menuPage = constrain(menuPage, 0, maxMenuPages);
-      }
-
-      cursorPosition = cursorPosition + 1;
-      cursorPosition = constrain(cursorPosition, 0, sizeOfMenuItems - 1);
-      break;
-  }
-}
-
-// When called, this function will erase the current cursor and redraw it based on the cursorPosition and menuPage variables.
-void drawCursor() {
-  for (int x = 0; x < 2; x++) {  // Erases current cursor
-    lcd.setCursor(0, x);
-    lcd.print(" ");
-  }
-
-  // The menu is set up to be progressive (menuPage 0 = Item 1 & Item 2, menuPage 1 = Item 2 & Item 3, menuPage 2 = Item 3 & Item 4), so
-  // in order to determine where the cursor should be you need to see if you are at an odd or even menu page and an odd or even cursor position.
-  if (menuPage % 2 == 0) {
-    if (cursorPosition % 2 == 0) {  // If the menu page is even and the cursor position is even that means the cursor should be on line 1
-      lcd.setCursor(0, 0);
-      lcd.write(byte(0));
-    }
-    if (cursorPosition % 2 != 0) {  // If the menu page is even and the cursor position is odd that means the cursor should be on line 2
-      lcd.setCursor(0, 1);
-      lcd.write(byte(0));
-    }
-  }
-  if (menuPage % 2 != 0) {
-    if (cursorPosition % 2 == 0) {  // If the menu page is odd and the cursor position is even that means the cursor should be on line 2
-      lcd.setCursor(0, 1);
-      lcd.write(byte(0));
-    }
-    if (cursorPosition % 2 != 0) {  // If the menu page is odd and the cursor position is odd that means the cursor should be on line 1
-      lcd.setCursor(0, 0);
-      lcd.write(byte(0));
-    }
-  }
+#ifdef SERIAL_PROTOCOL
+  TraceRecorder.SetKeypadButton(button);
+#endif
+  MenuEngine.Interact(button);
 }
+#endif
 
+#if HAS_LCD
 // This function monitors for button presses to know which button was pressed.
 int evaluateButton() {
-  uint8_t buttons = lcd.readButtons();
+  unsigned long busMicros = micros();
+  uint8_t buttons = fastLcd.ReadButtons();
+  BusScheduler.Record(lcdBusDevice, busMicros);
   int result = 0;
   if (buttons & BUTTON_RIGHT) {
     result = 1; // right
@@ -454,3 +893,4 @@ int evaluateButton() {
   }
   return result;
 }
+#endif
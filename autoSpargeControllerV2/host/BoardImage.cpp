@@ -0,0 +1,14 @@
+/*
+  BoardImage.cpp - Stands in for the Arduino core's main(), so that the sketch linked with --gc-sections keeps what the board's
+  image would and no more - the harnesses' SketchAccess.inc is left off it.  Only linked, for ram_budget.py to read the map of,
+  never run.
+  Created by Tom Wallace.
+*/
+
+#include "Sim.h"
+
+int main() {
+  Sim::Boot();
+  while (Sim::RunLoop());
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+  DryRunTest.cpp - Runs the V2 sketch with the wort pump pulsing into a kettle that does not fill, and one that does, to pin
+  down how long FlowMonitor takes to catch a dry pump and that it leaves a flowing one alone.
+
+  With the sketch's settings the pump runs 2 sec a minute, FlowMonitor judges 6 sec of on-time - the third pulse - and then
+  waits out its 10 sec flow lag, so a dry pump is caught 2 min 12 sec after its first pulse starts.
+  Created by Tom Wallace.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "Harness.h"
+
+#define EXPECTED_LATENCY 132000  // Three pulses a minute apart, then the flow lag
+#define LATENCY_TOLERANCE 1000
+#define BEEP_TOLERANCE 2  // ms - the pattern steps on the 1 ms Timer0 interrupt
+#define HOSE_DELAY 3000  // ms for wort to reach the kettle
+#define FILL_HPA_PER_MILLI 0.00025  // About 0.2 gal a pulse
+#define MAX_BEEPS 8
+
+static uint64_t firstPumpMicros;
+static uint64_t detectedMicros;
+static uint64_t soundMicros;  // Alarm pin last went high
+static uint64_t silentMicros;  // Alarm pin last went low
+static uint64_t beepMicros[MAX_BEEPS];  // How long each alarm beep after the detection lasted
+static uint64_t gapMicros[MAX_BEEPS];
+static int numBeeps;
+static int numPulses;
+static bool wasWortOn;
+
+// Kettle filling at a steady rate for as long as the pump has been on, one hose delay later
+static bool isFilling;
+static bool pumpHistory[HOSE_DELAY];
+static float fillHpa;
+
+static void Watch(void * context, unsigned long currentMillis) {
+  bool isWortOn = Sim::GetLevel(Harness::GetPin(SKETCH_WORT_PUMP)) == HIGH;
+  if (isWortOn && !wasWortOn) {
+    numPulses++;
+    if (firstPumpMicros == 0)
+      firstPumpMicros = Sim::Micros();
+  }
+  wasWortOn = isWortOn;
+
+  if (detectedMicros == 0 && Sketch::GetAlarmQueue()->HasEvent(F("DryRun")))
+    detectedMicros = Sim::Micros();
+
+  if (isFilling) {
+    int slot = currentMillis % HOSE_DELAY;
+    if (pumpHistory[slot])
+      fillHpa += FILL_HPA_PER_MILLI;
+    pumpHistory[slot] = isWortOn;
+    Harness::SetPressure(fillHpa);
+  }
+}
+
+static void WatchAlarm(void * context, uint8_t pin, uint8_t level) {
+  if (pin != Harness::GetPin(SKETCH_ALARM) || detectedMicros == 0 || numBeeps == MAX_BEEPS)
+    return;
+  if (level == HIGH) {
+    soundMicros = Sim::Micros();
+    if (silentMicros != 0)
+      gapMicros[numBeeps] = Sim::Micros() - silentMicros;
+  } else if (soundMicros != 0) {
+    beepMicros[numBeeps++] = Sim::Micros() - soundMicros;
+    silentMicros = Sim::Micros();
+  }
+}
+
+static void CheckMillis(uint64_t micros, long expected, const char * what) {
+  long millis = (micros + 500) / 1000;
+  Harness::Check(millis >= expected - BEEP_TOLERANCE && millis <= expected + BEEP_TOLERANCE, "%s lasted %ld ms, expected %ld", what,
+                 millis, expected);
+}
+
+// Boots V2 with only the wort pump active
+static void Start() {
+  Harness::Boot(SKETCH_V2_MODE);
+  Sim::SetTickHook(Watch, NULL);
+  Sim::SetPinHook(WatchAlarm, NULL);
+  Harness::PressButton(SKETCH_RIGHT_BUTTON, 100);
+}
+
+static void CaughtDryPump() {
+  Start();
+  Sim::RunFor(4 * 60000);
+
+  Harness::Check(firstPumpMicros != 0, "wort pump never ran");
+  Harness::Check(detectedMicros != 0, "dry pump not caught");
+  if (firstPumpMicros == 0 || detectedMicros == 0)
+    return;
+  long latency = (detectedMicros - firstPumpMicros) / 1000;
+  printf("  caught %ld ms after the first pulse started, %d pulses\n", latency, numPulses);
+  Harness::Check(latency >= EXPECTED_LATENCY - LATENCY_TOLERANCE && latency <= EXPECTED_LATENCY + LATENCY_TOLERANCE,
+                 "caught after %ld ms, expected %d", latency, EXPECTED_LATENCY);
+  Harness::Check(numPulses == 3, "pump pulsed %d times, expected 3 then paused", numPulses);
+  Harness::Check(Sim::GetLevel(Harness::GetPin(SKETCH_WORT_PUMP)) == LOW, "wort pump not paused");
+
+  // Three 150 ms beeps 100 ms apart, unlike any other alarm
+  Harness::Check(numBeeps >= 4, "alarm beeped %d times", numBeeps);
+  for (int i = 0; i < 3 && i < numBeeps; i++)
+    CheckMillis(beepMicros[i], 150, "beep");
+  for (int i = 1; i < 3 && i < numBeeps; i++)
+    CheckMillis(gapMicros[i], 100, "gap between beeps");
+  if (numBeeps >= 4)
+    CheckMillis(gapMicros[3], 1350, "pause before the pattern repeats");
+
+  // Turning the pump off acknowledges the stall
+  Harness::PressButton(SKETCH_RIGHT_BUTTON, 100);
+  Sim::RunFor(100);
+  Harness::Check(!Sketch::GetAlarmQueue()->HasEvent(F("DryRun")), "stall not acknowledged by the pump button");
+}
+
+static void LeftFlowingPump() {
+  isFilling = true;
+  Start();
+  Sim::RunFor(8 * 60000);
+
+  printf("  %d pulses, kettle rose %.2f hPa\n", numPulses, fillHpa);
+  Harness::Check(numPulses >= 7, "pump pulsed %d times, expected 7 or more", numPulses);
+  Harness::Check(detectedMicros == 0, "flowing pump flagged as dry");
+}
+
+int main(int argc, char ** argv) {
+  Harness::SetVerbose(argc > 1 && strcmp(argv[1], "--verbose") == 0);
+  Harness::RunCase("dry pump caught on time", CaughtDryPump);
+  Harness::RunCase("flowing pump left alone", LeftFlowingPump);
+  return Harness::Finish("DryRunTest");
+}
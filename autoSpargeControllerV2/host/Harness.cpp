@@ -0,0 +1,120 @@
+/*
+  Harness.cpp - Helpers shared by the host tests and tools.
+  Created by Tom Wallace.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <Adafruit_RGBLCDShield.h>
+#include "Harness.h"
+
+SimLcdShield Harness::_lcdShield;
+SimI2cMux Harness::_mux;
+SimMprls Harness::_mprls;
+bool Harness::_isVerbose = false;
+int Harness::_failures = 0;
+int Harness::_cases = 0;
+int Harness::_failedCases = 0;
+
+static void PrintSerial(void * context, uint8_t value) {
+  fputc(value, stderr);
+}
+
+void Harness::SetVerbose(bool isVerbose) {
+  _isVerbose = isVerbose;
+  Sim::SetSerialSink(isVerbose ? PrintSerial : NULL, NULL);
+}
+
+bool Harness::IsVerbose() {
+  return _isVerbose;
+}
+
+// Attaches the devices, holds the probes dry and boots - Select held on the keypad picks V2, and V1 comes up once the mode
+// prompt times out
+void Harness::Boot(int mode) {
+  Sim::AttachI2c(Sketch::GetAddress(SKETCH_LCD_ADDRESS), &_lcdShield);
+  Sim::AttachI2c(Sketch::GetAddress(SKETCH_MUX_ADDRESS), &_mux);
+  Sim::AttachI2c(MPRLS_ADDRESS, &_mprls);
+  Sim::SetInput(GetPin(SKETCH_MASH_PROBE), LOW);
+  Sim::SetInput(GetPin(SKETCH_MASH_PROBE_HIGH), LOW);
+  Sim::SetInput(GetPin(SKETCH_BOIL_PROBE), LOW);
+
+  _lcdShield.SetKeys(mode == SKETCH_V2_MODE ? BUTTON_SELECT : mode == SKETCH_TEST_MODE ? BUTTON_LEFT : 0);
+  Sim::Boot();
+  while (!Sketch::IsModeStarted() && !Sim::IsReset())
+    Sim::RunLoop();
+  _lcdShield.SetKeys(0);
+  if (Sim::IsReset() || Sketch::GetMode() != mode) {
+    fprintf(stderr, "Harness: booted mode %d, not %d\n", Sketch::GetMode(), mode);
+    exit(2);
+  }
+}
+
+void Harness::PressButton(int wiredTo, unsigned long millis) {
+  Sim::SetInput(GetPin(wiredTo), LOW);
+  Sim::RunFor(millis);
+  Sim::ReleaseInput(GetPin(wiredTo));
+  Sim::RunFor(1);
+}
+
+void Harness::PressKeys(uint8_t keys, unsigned long millis) {
+  _lcdShield.SetKeys(keys);
+  Sim::RunFor(millis);
+  _lcdShield.SetKeys(0);
+  Sim::RunFor(1);
+}
+
+void Harness::SetPressure(float hpa) {
+  _mprls.SetCounts(SimMprls::HpaToCounts(SIM_ATMOSPHERE_HPA + hpa));
+}
+
+uint8_t Harness::GetPin(int wiredTo) {
+  return Sketch::GetPin(wiredTo);
+}
+
+SimLcdShield * Harness::GetLcdShield() {
+  return &_lcdShield;
+}
+
+SimMprls * Harness::GetMprls() {
+  return &_mprls;
+}
+
+// Forks, so the case gets the sketch's globals as they were before it booted
+void Harness::RunCase(const char * name, HarnessCase test) {
+  fflush(stdout);
+  fflush(stderr);
+  _cases++;
+  pid_t pid = fork();
+  if (pid == 0) {
+    test();
+    fflush(stdout);
+    _exit(_failures == 0 ? 0 : 1);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  bool isPassed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (!isPassed)
+    _failedCases++;
+  printf("%s %s\n", isPassed ? "PASS" : "FAIL", name);
+}
+
+void Harness::Check(bool isPassed, const char * format, ...) {
+  if (isPassed)
+    return;
+  _failures++;
+  printf("  %.3f s: ", Sim::Micros() / 1e6);
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  printf("\n");
+}
+
+int Harness::Finish(const char * testName) {
+  printf("%s: %d of %d cases passed\n", testName, _cases - _failedCases, _cases);
+  return _failedCases == 0 ? 0 : 1;
+}
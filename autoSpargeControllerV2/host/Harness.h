@@ -0,0 +1,45 @@
+/*
+  Harness.h - Helpers shared by the host tests and tools - wiring the simulated devices to the sketch, booting it into a mode,
+  pressing its buttons, and running each test case in a forked process so it starts from a clean sketch.
+  Created by Tom Wallace.
+*/
+#ifndef Harness_h
+#define Harness_h
+
+#include <stdint.h>
+#include "Devices.h"
+#include "Sim.h"
+#include "Sketch.h"
+
+#define MPRLS_ADDRESS 0x18
+
+typedef void (* HarnessCase)();
+
+class Harness {
+  private:
+	static SimLcdShield _lcdShield;
+	static SimI2cMux _mux;
+	static SimMprls _mprls;
+	static bool _isVerbose;
+	static int _failures;
+	static int _cases;
+	static int _failedCases;
+
+  public:
+	static void SetVerbose(bool isVerbose);  // Copies the sketch's serial output to stderr
+	static bool IsVerbose();
+	static void Boot(int mode);  // Exits if the sketch does not come up in the mode
+	static void PressButton(int wiredTo, unsigned long millis);  // A pump button, held then let go
+	static void PressKeys(uint8_t keys, unsigned long millis);  // Keypad BUTTON_ bits, held then let go
+	static void SetPressure(float hpa);  // Over the atmosphere, as the kettle fills
+	static uint8_t GetPin(int wiredTo);
+	static SimLcdShield * GetLcdShield();
+	static SimMprls * GetMprls();
+
+	// Tests - a case runs in its own process, and main returns Finish()
+	static void RunCase(const char * name, HarnessCase test);
+	static void Check(bool isPassed, const char * format, ...) __attribute__((format(printf, 2, 3)));
+	static int Finish(const char * testName);
+};
+
+#endif
@@ -0,0 +1,276 @@
+/*
+  HostBenchmark.cpp - Times the sketch's hot-path classes on the host build, and writes a CSV line per benchmark with the host
+  ns per call, the µs per call the simulated board charges for it, and the heap allocations and frees per call, so runs from
+  different commits can be compared.
+
+    HostBenchmark [--out results.csv] [--baseline earlier.csv] [--millis N] [--quiet]
+
+  Each benchmark calls into the booted V2 sketch's own objects, in batches short enough on the simulated clock that the loop
+  runs between them and neither watchdog trips.  ns per call is the fastest batch, as the least disturbed by the rest of the
+  machine, and the other columns come from the simulated board so barely vary from run to run.  With --baseline, calls that
+  the simulated board charges more than SIM_SLACK longer for, or that allocate more than before, fail the run, and calls more
+  than HOST_SLACK slower on the host are listed.  --quiet leaves out the results, for make test.
+  Created by Tom Wallace.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Harness.h"
+
+#define BATCH_SIM_MICROS 50000  // Simulated time a batch may take, well inside the loop budget
+#define MAX_BATCH 10000
+#define DEFAULT_MILLIS 20  // Host time spent timing each benchmark
+#define SIM_SLACK 0.05  // Simulated µs per call may grow this much before it counts as a regression
+#define HOST_SLACK 0.5  // Host ns per call may grow this much before it is listed as slower
+#define MAX_EVENTS 8
+
+struct BenchmarkResult {
+	std::string name;
+	unsigned long calls;
+	double nsPerCall;
+	double simMicrosPerCall;
+	double allocsPerCall;
+	double freesPerCall;
+};
+
+typedef void (* BenchmarkCall)();
+
+static std::vector<BenchmarkResult> results;
+static long timingMillis = DEFAULT_MILLIS;
+static bool isQuiet = false;
+static BenchmarkCall benchmarkCall;
+static unsigned long batchSize;
+static unsigned long batchCalls;
+
+static uint64_t HostNanos() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Cut short once the simulated clock has run a batch's worth, as a call can block on the UART once its buffer fills
+static void RunBatch(void * context) {
+  uint64_t simStart = Sim::Micros();
+  batchCalls = 0;
+  while (batchCalls < batchSize) {
+    benchmarkCall();
+    batchCalls++;
+    if (Sim::Micros() - simStart >= BATCH_SIM_MICROS)
+      break;
+  }
+}
+
+static void Measure(std::string name, BenchmarkCall call) {
+  benchmarkCall = call;
+
+  // One call first, to size the batches on the simulated clock
+  batchSize = 1;
+  uint64_t simStart = Sim::Micros();
+  Sim::Call(RunBatch, NULL);
+  uint64_t simMicros = Sim::Micros() - simStart;
+  batchSize = simMicros == 0 ? MAX_BATCH : BATCH_SIM_MICROS / simMicros;
+  batchSize = batchSize < 1 ? 1 : batchSize > MAX_BATCH ? MAX_BATCH : batchSize;
+  Sim::RunLoop();
+
+  BenchmarkResult result;
+  result.name = name;
+  result.calls = 0;
+  result.nsPerCall = INFINITY;
+  uint64_t simTotal = 0;
+  uint64_t hostTotal = 0;
+  unsigned long allocs = 0;
+  unsigned long frees = 0;
+  while (hostTotal < (uint64_t)timingMillis * 1000000ULL) {
+    SimHeapStats heap = Sim::GetHeap();
+    simStart = Sim::Micros();
+    uint64_t hostStart = HostNanos();
+    Sim::Call(RunBatch, NULL);
+    uint64_t hostNanos = HostNanos() - hostStart;
+    simTotal += Sim::Micros() - simStart;
+    allocs += Sim::GetHeap().allocs - heap.allocs;
+    frees += Sim::GetHeap().frees - heap.frees;
+    hostTotal += hostNanos;
+    result.calls += batchCalls;
+    if ((double)hostNanos / batchCalls < result.nsPerCall)
+      result.nsPerCall = (double)hostNanos / batchCalls;
+    Sim::RunLoop();
+  }
+  result.simMicrosPerCall = (double)simTotal / result.calls;
+  result.allocsPerCall = (double)allocs / result.calls;
+  result.freesPerCall = (double)frees / result.calls;
+  results.push_back(result);
+  if (!isQuiet)
+      printf("%-32s %10.1f ns %10.1f sim us %6.2f allocs %6.2f frees\n", name.c_str(), result.nsPerCall, result.simMicrosPerCall,
+           result.allocsPerCall, result.freesPerCall);
+}
+
+// The benchmarks
+static EventQueue * benchmarkQueue;
+static int menuIndex;
+
+static void QueueAddRemove() {
+  benchmarkQueue->AddEvent(F("Bench"));
+  benchmarkQueue->RemoveEvent(F("Bench"));
+}
+static void QueueIsPopulated() { benchmarkQueue->IsPopulated(); }
+static void QueueHasEvent() { benchmarkQueue->HasEvent(F("Bench")); }
+static void PressureUpdate() { Sketch::GetBoilPressureSensor()->Update(millis()); }
+static void PressureGetGallons() { Sketch::GetBoilPressureSensor()->GetGallons(); }
+static void PressureDisplay() { Sketch::GetBoilPressureSensor()->Display(); }
+static void LogLine() { Sketch::GetBrewStats()->Log(millis(), F("Benchmark"), F("Formatting a log line")); }
+
+static void ProbeUpdate() {
+  for (int i = SKETCH_MASH_PROBE_INDEX; i <= SKETCH_BOIL_PROBE_INDEX; i++)
+    Sketch::GetProbe(i)->Update(millis());
+}
+
+static void ButtonUpdate() {
+  Sketch::GetButton(0)->Update(millis());
+  Sketch::GetButton(1)->Update(millis());
+}
+
+// Renders only - button 0 takes no action
+static void MenuRender() {
+  Sketch::SetSelectedMenu(menuIndex);
+  Sketch::GetMenuEngine()->Redraw();
+  Sketch::GetMenuEngine()->Interact(0);
+}
+
+static void AddEvent(void * context) {
+  benchmarkQueue->AddEvent(String(F("Event")) + String(*(int *)context));
+}
+
+static void RunBenchmarks() {
+  // Queue costs grow with the events already in it
+  EventQueue queue(F("BenchmarkQueue"));
+  benchmarkQueue = &queue;
+  int queued = 0;
+  for (int events = 0; events <= MAX_EVENTS; events = events == 0 ? 1 : events * 2) {
+    for (; queued < events; queued++)
+      Sim::Call(AddEvent, &queued);
+    char count[16];
+    snprintf(count, sizeof(count), " n=%d", events);
+    Measure(std::string("EventQueue AddRemove") + count, QueueAddRemove);
+    Measure(std::string("EventQueue IsPopulated") + count, QueueIsPopulated);
+    Measure(std::string("EventQueue HasEvent") + count, QueueHasEvent);
+  }
+
+  Measure("PressureSensor Update", PressureUpdate);
+  Measure("PressureSensor GetGallons", PressureGetGallons);
+  Measure("PressureSensor Display", PressureDisplay);
+  Measure("Loggable Log", LogLine);
+  Measure("Probe Update", ProbeUpdate);
+  Measure("Button Update", ButtonUpdate);
+
+  for (menuIndex = 0; menuIndex <= Sketch::GetNumMenuEntries(); menuIndex++) {
+    char name[16];
+    snprintf(name, sizeof(name), "Menu %d", menuIndex);
+    Measure(name, MenuRender);
+  }
+  Sketch::SetSelectedMenu(0);
+}
+
+// Results
+static bool WriteResults(const char * path) {
+  FILE * out = fopen(path, "w");
+  if (out == NULL)
+    return false;
+  fprintf(out, "name,calls,ns_per_call,sim_us_per_call,allocs_per_call,frees_per_call\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult & result = results[i];
+    fprintf(out, "%s,%lu,%.1f,%.2f,%.3f,%.3f\n", result.name.c_str(), result.calls, result.nsPerCall, result.simMicrosPerCall,
+            result.allocsPerCall, result.freesPerCall);
+  }
+  return fclose(out) == 0;
+}
+
+static bool ReadResults(const char * path, std::map<std::string, BenchmarkResult> * baseline) {
+  FILE * in = fopen(path, "r");
+  if (in == NULL)
+    return false;
+  char line[256];
+  fgets(line, sizeof(line), in);  // Header
+  while (fgets(line, sizeof(line), in) != NULL) {
+    char * comma = strchr(line, ',');
+    if (comma == NULL)
+      continue;
+    BenchmarkResult result;
+    result.name.assign(line, comma - line);
+    if (sscanf(comma + 1, "%lu,%lf,%lf,%lf,%lf", &result.calls, &result.nsPerCall, &result.simMicrosPerCall, &result.allocsPerCall,
+               &result.freesPerCall) == 5)
+      (*baseline)[result.name] = result;
+  }
+  fclose(in);
+  return true;
+}
+
+// Returns the number of benchmarks that regressed - only on the simulated board's figures, as host timings on a shared machine
+// move too much to fail a run on, so those are only listed
+static int Compare(const std::map<std::string, BenchmarkResult> & baseline) {
+  int regressions = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    std::map<std::string, BenchmarkResult>::const_iterator before = baseline.find(results[i].name);
+    if (before == baseline.end())
+      continue;
+    const BenchmarkResult & after = results[i];
+    bool isCharged = after.simMicrosPerCall > before->second.simMicrosPerCall * (1 + SIM_SLACK) + 0.01;
+    bool isAllocating = after.allocsPerCall > before->second.allocsPerCall + 0.001;
+    bool isSlower = after.nsPerCall > before->second.nsPerCall * (1 + HOST_SLACK);
+    if (!isSlower && !isAllocating && !isCharged)
+      continue;
+    if (isCharged || isAllocating)
+      regressions++;
+    printf("%s %s: %.1f -> %.1f ns, %.2f -> %.2f sim us, %.3f -> %.3f allocs\n", isCharged || isAllocating ? "REGRESSED" : "SLOWER",
+           after.name.c_str(), before->second.nsPerCall, after.nsPerCall, before->second.simMicrosPerCall, after.simMicrosPerCall,
+           before->second.allocsPerCall, after.allocsPerCall);
+  }
+  return regressions;
+}
+
+int main(int argc, char ** argv) {
+  const char * outPath = NULL;
+  const char * baselinePath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+      outPath = argv[++i];
+    else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+      baselinePath = argv[++i];
+    else if (strcmp(argv[i], "--millis") == 0 && i + 1 < argc)
+      timingMillis = atol(argv[++i]);
+    else if (strcmp(argv[i], "--quiet") == 0)
+      isQuiet = true;
+    else {
+      fprintf(stderr, "usage: HostBenchmark [--out results.csv] [--baseline earlier.csv] [--millis N] [--quiet]\n");
+      return 2;
+    }
+  }
+
+  // Read first, as the baseline may be the file about to be written
+  std::map<std::string, BenchmarkResult> baseline;
+  if (baselinePath != NULL && !ReadResults(baselinePath, &baseline)) {
+    fprintf(stderr, "HostBenchmark: cannot read %s\n", baselinePath);
+    return 2;
+  }
+
+  Harness::Boot(SKETCH_V2_MODE);
+  RunBenchmarks();
+  if (Sim::IsReset()) {
+    fprintf(stderr, "HostBenchmark: watchdog reset the board\n");
+    return 1;
+  }
+  if (outPath != NULL && !WriteResults(outPath)) {
+    fprintf(stderr, "HostBenchmark: cannot write %s\n", outPath);
+    return 1;
+  }
+  if (baselinePath == NULL)
+    return 0;
+  int regressions = Compare(baseline);
+  printf("HostBenchmark: %d of %lu benchmarks regressed against %s\n", regressions, (unsigned long)results.size(), baselinePath);
+  return regressions == 0 ? 0 : 1;
+}
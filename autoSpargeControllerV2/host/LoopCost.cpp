@@ -0,0 +1,222 @@
+/*
+  LoopCost.cpp - Runs the sketch on the simulated board through a script of pin, keypad and sensor stimuli, and reports what
+  each loop and each loop stage cost in simulated µs and in cycles at the Trinket Pro's 16 MHz, with the deepest the sketch
+  took the stack and the most it held on the heap.
+
+    LoopCost [--csv results.csv] [--budget] script.stim...
+
+  The scripts are those StimulusScript reads, as in stimuli/.
+
+  The costs come from the simulator's model of the board - each core call is charged about what it takes on the ATmega328,
+  I2C and the UART at their bit rates - so they move with the code the sketch runs, and are meant for comparing builds, not as
+  a cycle-exact count.  A stage's cost is the time between the micros() reads LoopWatchdog::Stage makes as the sketch marks it,
+  and what is left of the loop, the simulator's own charge for running it among them, is listed as unmarked.
+  The stack is that of the host build, run on a painted stack of its own, so it too is for comparing builds - the AVR's own
+  figure comes from a PROFILE_LOOP build on the board.  The heap's blocks are the host's sizes too - each object is smaller on
+  the AVR, its strings the same - and are what the Makefile's RAM_RESERVE is worked out from.
+  --budget fails a script whose slowest loop is over the sketch's budget.
+  Created by Tom Wallace.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+#include <LoopWatchdog.h>
+#include "Harness.h"
+#include "StimulusScript.h"
+
+#define F_CPU_MHZ 16
+#define MAX_STAGES 16
+#define SCRIPT_STACK_SIZE (1024 * 1024)
+#define STACK_PAINT 0xC5
+
+struct Cost {
+	unsigned long count;
+	uint64_t totalMicros;
+	uint64_t maxMicros;
+};
+
+// Per stage, gathered from the micros hook
+static int stage = NO_STAGE;
+static uint64_t stageStart;
+static uint64_t lastRead;
+static uint64_t loopStageMicros[MAX_STAGES];
+static Cost stageCosts[MAX_STAGES];
+static Cost loopCost;
+static Cost unmarkedCost;  // What the loop spends outside its stages
+
+static StimulusScript script;
+static bool isScriptFailed;
+static ucontext_t mainContext;
+static ucontext_t scriptContext;
+
+// The stage changes just after the micros() read Stage makes, so the read before a change is where one stage ends and the next begins
+static void CheckStage() {
+  int marked = Sketch::GetStage();
+  if (marked != stage) {
+    if (stage != NO_STAGE && stage < MAX_STAGES)
+      loopStageMicros[stage] += lastRead - stageStart;
+    stage = marked;
+    stageStart = lastRead;
+  }
+}
+
+static void WatchMicros(void * context, uint64_t micros) {
+  CheckStage();
+  lastRead = micros;
+}
+
+static void AddCost(Cost * cost, uint64_t micros) {
+  cost->count++;
+  cost->totalMicros += micros;
+  if (micros > cost->maxMicros)
+    cost->maxMicros = micros;
+}
+
+static void RunLoops(void * context, unsigned long untilMillis) {
+  while (Sim::Micros() / 1000 < untilMillis && !Sim::IsReset()) {
+    memset(loopStageMicros, 0, sizeof(loopStageMicros));
+    uint64_t start = Sim::Micros();
+    Sim::RunLoop();
+    CheckStage();  // The loop's last stage ends with it
+    uint64_t loopMicros = Sim::Micros() - start;
+    AddCost(&loopCost, loopMicros);
+    for (int i = 0; i < Sketch::GetNumStages() && i < MAX_STAGES; i++) {
+      if (loopStageMicros[i] > 0)
+        AddCost(&stageCosts[i], loopStageMicros[i]);
+      loopMicros -= loopStageMicros[i] < loopMicros ? loopStageMicros[i] : loopMicros;
+    }
+    AddCost(&unmarkedCost, loopMicros);
+  }
+}
+
+// Runs on the painted stack
+static void RunScript() {
+  Harness::Boot(script.GetBootMode());
+  Sim::SetMicrosHook(WatchMicros, NULL);
+  isScriptFailed = !script.Run(RunLoops, NULL);
+  Sim::SetMicrosHook(NULL, NULL);
+}
+
+static void PrintCost(const char * name, const Cost & cost) {
+  if (cost.count == 0)
+    return;
+  double averageMicros = (double)cost.totalMicros / cost.count;
+  printf("  %-10s %9lu %12.0f %12llu %10.1f %10llu\n", name, cost.count, averageMicros * F_CPU_MHZ,
+         (unsigned long long)cost.maxMicros * F_CPU_MHZ, averageMicros, (unsigned long long)cost.maxMicros);
+}
+
+static void WriteCost(FILE * csv, const char * path, const char * name, const Cost & cost) {
+  if (csv == NULL || cost.count == 0)
+    return;
+  fprintf(csv, "%s,%s,%lu,%.1f,%llu,%llu\n", path, name, cost.count, (double)cost.totalMicros / cost.count,
+          (unsigned long long)cost.maxMicros, (unsigned long long)cost.maxMicros * F_CPU_MHZ);
+}
+
+// Runs in a forked child, so each script starts from a freshly booted sketch
+static int RunScriptFile(const char * path, FILE * csv, bool isBudgetChecked) {
+  // The heap counts everything allocated before boot, as the sketch's globals are built then, so the script is taken off
+  SimHeapStats unread = Sim::GetHeap();
+  if (!script.Read(path))
+    return 1;
+  long scriptBytes = Sim::GetHeap().liveBytes - unread.liveBytes;
+  long scriptBlocks = Sim::GetHeap().liveBlocks - unread.liveBlocks;
+  Sim::ResetHeapPeak();
+
+  uint8_t * stack = (uint8_t *)malloc(SCRIPT_STACK_SIZE);
+  memset(stack, STACK_PAINT, SCRIPT_STACK_SIZE);
+  getcontext(&scriptContext);
+  scriptContext.uc_stack.ss_sp = stack;
+  scriptContext.uc_stack.ss_size = SCRIPT_STACK_SIZE;
+  scriptContext.uc_link = &mainContext;
+  makecontext(&scriptContext, RunScript, 0);
+  swapcontext(&mainContext, &scriptContext);
+
+  // The stack grows down, so the paint left at the bottom is what it never reached
+  size_t unused = 0;
+  while (unused < SCRIPT_STACK_SIZE && stack[unused] == STACK_PAINT)
+    unused++;
+  free(stack);
+
+  printf("%s: %lu loops over %.3f simulated s\n", path, loopCost.count, Sim::Micros() / 1e6);
+  printf("  %-10s %9s %12s %12s %10s %10s\n", "", "loops", "avg cycles", "max cycles", "avg us", "max us");
+  PrintCost("loop", loopCost);
+  WriteCost(csv, path, "loop", loopCost);
+  for (int i = 0; i < Sketch::GetNumStages() && i < MAX_STAGES; i++) {
+    PrintCost(Sketch::GetStageName(i), stageCosts[i]);
+    WriteCost(csv, path, Sketch::GetStageName(i), stageCosts[i]);
+  }
+  PrintCost("unmarked", unmarkedCost);
+  WriteCost(csv, path, "unmarked", unmarkedCost);
+  printf("  host stack peak %lu bytes\n", (unsigned long)(SCRIPT_STACK_SIZE - unused));
+  SimHeapStats heap = Sim::GetHeap();
+  printf("  heap peak %ld bytes in %ld blocks\n", heap.peakBytes - scriptBytes, heap.peakBlocks - scriptBlocks);
+  if (csv != NULL)
+    fprintf(csv, "%s,host stack,1,%lu,%lu,0\n", path, (unsigned long)(SCRIPT_STACK_SIZE - unused), (unsigned long)(SCRIPT_STACK_SIZE - unused));
+
+  if (Sim::IsReset()) {
+    fprintf(stderr, "FAIL %s: watchdog reset the board\n", path);
+    return 1;
+  }
+  if (isBudgetChecked && loopCost.maxMicros > (uint64_t)Sketch::GetLoopBudget() * 1000) {
+    fprintf(stderr, "FAIL %s: slowest loop %.1f ms, budget is %ld ms\n", path, loopCost.maxMicros / 1000.0, Sketch::GetLoopBudget());
+    return 1;
+  }
+  return isScriptFailed ? 1 : 0;
+}
+
+int main(int argc, char ** argv) {
+  const char * csvPath = NULL;
+  bool isBudgetChecked = false;
+  std::vector<const char *> paths;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+      csvPath = argv[++i];
+    else if (strcmp(argv[i], "--budget") == 0)
+      isBudgetChecked = true;
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: LoopCost [--csv results.csv] [--budget] script.stim...\n");
+      return 2;
+    } else
+      paths.push_back(argv[i]);
+  }
+  if (paths.empty()) {
+    fprintf(stderr, "usage: LoopCost [--csv results.csv] [--budget] script.stim...\n");
+    return 2;
+  }
+
+  FILE * csv = NULL;
+  if (csvPath != NULL) {
+    if ((csv = fopen(csvPath, "w")) == NULL) {
+      fprintf(stderr, "LoopCost: cannot write %s\n", csvPath);
+      return 2;
+    }
+    fprintf(csv, "script,what,loops,avg_us,max_us,max_cycles\n");
+  }
+
+  int failures = 0;
+  for (size_t i = 0; i < paths.size(); i++) {
+    fflush(stdout);
+    if (csv != NULL)
+      fflush(csv);
+    pid_t pid = fork();
+    if (pid == 0) {
+      int result = RunScriptFile(paths[i], csv, isBudgetChecked);
+      fflush(stdout);
+      if (csv != NULL)
+        fflush(csv);
+      _exit(result);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failures++;
+  }
+  if (csv != NULL)
+    fclose(csv);
+  return failures == 0 ? 0 : 1;
+}
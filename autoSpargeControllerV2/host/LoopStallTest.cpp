@@ -0,0 +1,143 @@
+/*
+  LoopStallTest.cpp - Hangs the I2C bus under the V2 sketch to check that LoopWatchdog forces the pumps off within the loop
+  budget and sounds its own alarm, and lands the watchdog interrupt on a pump's ON write, then stalls the loop, to check that the
+  pump's Update cannot turn the pump back on behind the interrupt.
+  Created by Tom Wallace.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "Harness.h"
+
+#define WATER_PUMP_DELAY 10000  // From the sketch's pump table
+#define STALL_TOLERANCE 5  // ms - the deadline is checked on the 1 ms Timer0 interrupt, from the start of the loop
+#define BEEP_TOLERANCE 2
+#define MAX_BEEPS 12
+#define STALL_MICROS 800000ULL  // Past the loop budget, short of the hardware watchdog
+
+static uint64_t hangMicros;  // When the bus was hung
+static uint64_t offMicros;  // When the water pump went off after it
+static uint64_t stallMicros;  // When the loop came back and raised the alarm
+static uint64_t soundMicros;
+static uint64_t silentMicros;
+static uint64_t beepMicros[MAX_BEEPS];
+static uint64_t gapMicros[MAX_BEEPS];
+static int numBeeps;
+
+static bool isStallOnWrite;  // Stall the loop once the water pump's ON write lands
+static bool isStallPending;
+static bool hasWriteLanded;
+static unsigned long stalledOnMillis;  // Water pump on while the loop was stalled
+
+static bool IsWaterOn() {
+  return Sim::GetLevel(Harness::GetPin(SKETCH_WATER_PUMP)) == HIGH;
+}
+
+static void Watch(void * context, unsigned long currentMillis) {
+  if (hangMicros != 0 && offMicros == 0 && !IsWaterOn())
+    offMicros = Sim::Micros();
+  if (stallMicros == 0 && Sketch::GetLoopWatchdog()->GetStallCount() > 0)
+    stallMicros = Sim::Micros();
+  if (hasWriteLanded && stallMicros == 0 && IsWaterOn())
+    stalledOnMillis++;
+
+  // The loop cannot stall inside the pump's atomic block, so the stall waits for the first millisecond after it
+  if (isStallPending && (SREG & _BV(SREG_I)) && !Sim::IsInInterrupt()) {
+    isStallPending = false;
+    Sim::Advance(STALL_MICROS);
+  }
+}
+
+static void WatchPins(void * context, uint8_t pin, uint8_t level) {
+  if (pin == Harness::GetPin(SKETCH_WATER_PUMP) && level == HIGH && isStallOnWrite) {
+    isStallOnWrite = false;
+    hasWriteLanded = true;
+    if (SREG & _BV(SREG_I))
+      Sim::Advance(STALL_MICROS);
+    else
+      isStallPending = true;
+  }
+
+  if (pin != Harness::GetPin(SKETCH_ALARM) || stallMicros == 0 || numBeeps == MAX_BEEPS)
+    return;
+  if (level == HIGH) {
+    soundMicros = Sim::Micros();
+    if (silentMicros != 0)
+      gapMicros[numBeeps] = Sim::Micros() - silentMicros;
+  } else if (soundMicros != 0) {
+    beepMicros[numBeeps++] = Sim::Micros() - soundMicros;
+    silentMicros = Sim::Micros();
+  }
+}
+
+static void CheckMillis(uint64_t micros, long expected, const char * what, int index) {
+  long millis = (micros + 500) / 1000;
+  Harness::Check(millis >= expected - BEEP_TOLERANCE && millis <= expected + BEEP_TOLERANCE, "%s %d lasted %ld ms, expected %ld",
+                 what, index, millis, expected);
+}
+
+// Boots V2 with the water pump turned on and running
+static void Start() {
+  Harness::Boot(SKETCH_V2_MODE);
+  Sim::SetTickHook(Watch, NULL);
+  Sim::SetPinHook(WatchPins, NULL);
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 100);
+}
+
+static void ForcedOffOnBusHang() {
+  Start();
+  Sim::RunFor(WATER_PUMP_DELAY + 500);
+  Harness::Check(IsWaterOn(), "water pump not on before the hang");
+
+  hangMicros = Sim::Micros();
+  Sim::HangBus(600);
+  Sim::RunFor(3000);
+
+  long budget = Sketch::GetLoopBudget();
+  long latency = offMicros == 0 ? -1 : (offMicros - hangMicros) / 1000;
+  printf("  water pump off %ld ms into the hang\n", latency);
+  Harness::Check(offMicros != 0 && latency <= budget + STALL_TOLERANCE, "water pump off after %ld ms, budget is %ld", latency, budget);
+  Harness::Check(Sketch::GetLoopWatchdog()->GetStallCount() == 1, "%lu stalls, expected 1", Sketch::GetLoopWatchdog()->GetStallCount());
+  Harness::Check(!Sim::IsReset(), "hardware watchdog reset the board");
+  Harness::Check(Sketch::GetAlarmQueue()->HasEvent(F("LoopStall")), "stall alarm not raised");
+
+  // Five quick even beeps, then a pause - nothing like the three spaced beeps of a dry run
+  Harness::Check(numBeeps >= 7, "alarm beeped %d times", numBeeps);
+  for (int i = 0; i < 5 && i < numBeeps; i++)
+    CheckMillis(beepMicros[i], 60, "beep", i);
+  for (int i = 1; i < 5 && i < numBeeps; i++)
+    CheckMillis(gapMicros[i], 60, "gap", i);
+  if (numBeeps > 5)
+    CheckMillis(gapMicros[5], 700, "pause", 5);
+
+  // Once the loop runs again the pump goes back to following its probe
+  Sim::RunFor(WATER_PUMP_DELAY + 500);
+  Harness::Check(IsWaterOn(), "water pump not back on after the stall");
+}
+
+static void StallOnPumpWrite() {
+  Start();
+  Sim::RunFor(1000);
+
+  // Off, then on again with the watchdog interrupt armed for the ON write after the pump's delay, and the loop stalling just
+  // after it
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 100);
+  Sim::RunFor(1000);
+  Harness::Check(!IsWaterOn(), "water pump not turned off");
+  Sim::InterruptOnWrite(Harness::GetPin(SKETCH_WATER_PUMP), HIGH, SIM_WDT);
+  isStallOnWrite = true;
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 100);
+  Sim::RunFor(WATER_PUMP_DELAY + 2000);
+
+  Harness::Check(hasWriteLanded, "water pump never turned on");
+  Harness::Check(stallMicros != 0, "stall not caught");
+  Harness::Check(stalledOnMillis == 0, "water pump on for %lu ms of the stall", stalledOnMillis);
+  Harness::Check(!Sim::IsReset(), "hardware watchdog reset the board");
+}
+
+int main(int argc, char ** argv) {
+  Harness::SetVerbose(argc > 1 && strcmp(argv[1], "--verbose") == 0);
+  Harness::RunCase("pumps forced off when the bus hangs", ForcedOffOnBusHang);
+  Harness::RunCase("stall on a pump's ON write leaves it off", StallOnPumpWrite);
+  return Harness::Finish("LoopStallTest");
+}
@@ -0,0 +1,503 @@
+/*
+  SafetyFuzzer.cpp - Fuzzes the sketch on the simulated board and checks the pump safety rules after every loop and every
+  simulated millisecond.  An input is a mode byte and then a string of operations - probe levels and splashes, button presses,
+  keypad presses, MPRLS readings, status bytes, disconnects and slow conversions, raw and framed serial bytes, and a stuck or
+  hung I2C bus - each decoded from the bytes that follow it, so any byte string is a valid input.
+
+  Rules:
+    - The wort pump is never on at the end of a loop while the probe stopping it - the boil probe in V1, the pressure boil stop
+      in V2 - is touching
+    - The water pump is off once the mash probe pin has been high for PROBE_BUDGET, even while the loop is stuck
+    - The wort pump is off once the boil probe pin has been high for PROBE_BUDGET, in V1 or while the boil probe backs up
+      the pressure stop in V2
+    - A pump is only on while it is active
+    - The heap does not grow past what it held once the mode was running, plus HEAP_SLACK for queued alarms and log lines
+    - The watchdog does not reset the board unless the input hung the bus for a second or more
+
+  A standalone run boots each mode once and forks a copy of the booted board for every input, so an input costs its own
+  simulated time and not the boot.  Inputs are random, from --seed, and one that breaks a rule is saved under --crashes for
+  replaying by passing its file, with --verbose to see the sketch's log.
+
+  Built with -DSAFETY_FUZZER_LIBFUZZER and -fsanitize=fuzzer it is a libFuzzer target instead.  Each input still runs in a
+  forked child, so the sketch's globals start clean, which keeps the coverage the child gathers from reaching libFuzzer - use
+  it for its corpus handling and minimizing rather than coverage guidance.
+
+  Created by Tom Wallace.
+*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+#include "Harness.h"
+
+#define PROBE_BUDGET 500  // ms a probe pin may be high before its pump must be off
+#define HEAP_SLACK 256  // Bytes the heap may hold past its level once the mode is running
+#define WARMUP_MILLIS 3000  // Run after the mode starts, before the heap level is taken
+#define HANG_RESET_MILLIS 1000  // A bus hang this long may end in a watchdog reset
+#define MAX_INPUT 4096
+
+// Operations - the byte after the mode byte, modulo NUM_OPS
+#define OP_WAIT 0  // uint8 - run for (n + 1) * 32 ms
+#define OP_PROBE 1  // uint8 - probe n % 3 to level n / 4 % 2
+#define OP_SPLASH 2  // uint8 - probe n % 3 high for n / 4 + 1 ms, then low
+#define OP_BUTTON 3  // uint8 - button n % 2 held for n / 2 * 8 + 20 ms
+#define OP_KEYPAD 4  // uint8 - keypad buttons n % 32 held for n / 32 * 50 + 60 ms
+#define OP_PRESSURE 5  // uint16 - reading at n / 1000 hPa over the atmosphere
+#define OP_STATUS 6  // uint8 - MPRLS status byte, 0x40 for a good reading
+#define OP_CONNECT 7  // uint8 - MPRLS answers on the bus if n is odd
+#define OP_BUSY 8  // uint8 - next conversion busy for n * 100 us longer
+#define OP_SERIAL 9  // uint8, then n % 16 bytes - sent as they are
+#define OP_FRAME 10  // uint8, uint8, then payload - a valid frame of type n % 10, length n % 5
+#define OP_STUCK 11  // uint8 - SDA held low for n * 4 ms
+#define OP_HANG 12  // uint8 - the next transaction hangs for n * 10 ms
+#define NUM_OPS 13
+
+static const uint8_t PROBE_ROLES[] = {SKETCH_MASH_PROBE, SKETCH_MASH_PROBE_HIGH, SKETCH_BOIL_PROBE};
+static const uint8_t BUTTON_ROLES[] = {SKETCH_LEFT_BUTTON, SKETCH_RIGHT_BUTTON};
+
+// Totals across the forked runs
+struct FuzzTotals {
+	unsigned long inputs;
+	unsigned long failures;
+	unsigned long long loops;
+	unsigned long long simMillis;
+};
+
+static int mode;
+static long heapLimit;
+static unsigned long hangMillis;  // Longest bus hang the input asked for
+static uint64_t backstopSinceMicros;  // When the boil probe last started backing up the pressure stop
+static char failure[256];
+
+// Input being run
+static const uint8_t * input;
+static size_t inputSize;
+static size_t inputPosition;
+
+static void Fail(const char * format, ...) __attribute__((format(printf, 1, 2)));
+static void Fail(const char * format, ...) {
+  if (failure[0] != 0)
+    return;
+  int length = snprintf(failure, sizeof(failure), "%.3f s: ", Sim::Micros() / 1e6);
+  va_list args;
+  va_start(args, format);
+  vsnprintf(failure + length, sizeof(failure) - length, format, args);
+  va_end(args);
+}
+
+static uint8_t Pin(int wiredTo) {
+  return Sketch::GetPin(wiredTo);
+}
+
+// Milliseconds a pin has read high, or 0 while it is low
+static unsigned long HighMillis(uint8_t pin) {
+  if (Sim::GetLevel(pin) != HIGH)
+    return 0;
+  return (Sim::Micros() - Sim::GetChangeMicros(pin)) / 1000;
+}
+
+// V2 only stops on the boil probe when its Probe Gallons is unset or at or above the stop in use
+static bool IsBackstop() {
+  if (mode != SKETCH_V2_MODE)
+    return true;
+  float referenceGallons = Sketch::GetBoilKettle()->referenceGallons;
+  return referenceGallons == 0 || Sketch::GetBoilPressureSensor()->GetThreshold() <= referenceGallons;
+}
+
+// Rules that must hold every millisecond, including while the loop is stuck
+static void CheckTick(void * context, unsigned long currentMillis) {
+  if (Sim::IsReset())
+    return;
+
+  unsigned long mashMillis = HighMillis(Pin(SKETCH_MASH_PROBE));
+  if (mashMillis >= PROBE_BUDGET && Sim::GetLevel(Pin(SKETCH_WATER_PUMP)) == HIGH)
+    Fail("water pump on %lu ms after the mash probe touched", mashMillis);
+
+  if (!IsBackstop())
+    backstopSinceMicros = Sim::Micros();
+  unsigned long boilMillis = HighMillis(Pin(SKETCH_BOIL_PROBE));
+  unsigned long backstopMillis = (Sim::Micros() - backstopSinceMicros) / 1000;
+  if (boilMillis >= PROBE_BUDGET && backstopMillis >= PROBE_BUDGET && Sim::GetLevel(Pin(SKETCH_WORT_PUMP)) == HIGH)
+    Fail("wort pump on %lu ms after the boil probe touched", boilMillis);
+}
+
+// Rules that must hold once a loop has run its course
+static void CheckLoop() {
+  if (Sim::IsReset()) {
+    if (hangMillis < HANG_RESET_MILLIS)
+      Fail("watchdog reset with the bus hung for at most %lu ms", hangMillis);
+    return;
+  }
+
+  IProbe * stop = mode == SKETCH_V2_MODE ? (IProbe *)Sketch::GetBoilStop() : Sketch::GetProbe(SKETCH_BOIL_PROBE_INDEX);
+  if (stop->IsTouching() && Sim::GetLevel(Pin(SKETCH_WORT_PUMP)) == HIGH)
+    Fail("wort pump on with the boil stop touching");
+
+  if (Sim::GetLevel(Pin(SKETCH_WATER_PUMP)) == HIGH && !Sketch::GetPump(SKETCH_WATER_PUMP_INDEX)->GetIsActive())
+    Fail("water pump on while not active");
+  if (Sim::GetLevel(Pin(SKETCH_WORT_PUMP)) == HIGH && !Sketch::GetPump(SKETCH_WORT_PUMP_INDEX)->GetIsActive())
+    Fail("wort pump on while not active");
+
+  long heap = Sim::GetHeap().liveBytes;
+  if (heapLimit != 0 && heap > heapLimit)
+    Fail("heap grew to %ld bytes, past %ld", heap, heapLimit);
+}
+
+// Runs whole loops until the time is up or a rule breaks, returning false to stop the input
+static bool Run(unsigned long millis) {
+  uint64_t end = Sim::Micros() + (uint64_t)millis * 1000;
+  while (Sim::Micros() < end) {
+    Sim::RunLoop();
+    CheckLoop();
+    if (failure[0] != 0 || Sim::IsReset())
+      return false;
+  }
+  return true;
+}
+
+static uint8_t Next() {
+  return inputPosition < inputSize ? input[inputPosition++] : 0;
+}
+
+static void Log(const char * format, ...) __attribute__((format(printf, 1, 2)));
+static void Log(const char * format, ...) {
+  if (!Harness::IsVerbose())
+    return;
+  fprintf(stderr, "[fuzz %.3f] ", Sim::Micros() / 1e6);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+static void SendFrame(uint8_t type, const uint8_t * payload, uint8_t length) {
+  uint8_t frame[MAX_FRAME_PAYLOAD + 5];
+  uint16_t crc = 0xFFFF;
+  frame[0] = FRAME_START;
+  frame[1] = type;
+  frame[2] = length;
+  memcpy(frame + 3, payload, length);
+  for (int i = 1; i < length + 3; i++)
+    crc = _crc_ccitt_update(crc, frame[i]);
+  frame[length + 3] = crc & 0xFF;
+  frame[length + 4] = crc >> 8;
+  Sim::SendSerial(frame, length + 5);
+}
+
+// Steps one operation, returning false to stop the input
+static bool Step() {
+  uint8_t op = Next() % NUM_OPS;
+  uint8_t n = Next();
+  switch (op) {
+    case OP_WAIT:
+      Log("wait %d ms", (n + 1) * 32);
+      return Run((n + 1) * 32);
+    case OP_PROBE:
+      Log("probe %d %s", n % 3, n / 4 % 2 ? "high" : "low");
+      Sim::SetInput(Pin(PROBE_ROLES[n % 3]), n / 4 % 2);
+      return Run(1);
+    case OP_SPLASH:
+      Log("splash probe %d for %d ms", n % 3, n / 4 + 1);
+      Sim::SetInput(Pin(PROBE_ROLES[n % 3]), HIGH);
+      if (!Run(n / 4 + 1))
+        return false;
+      Sim::SetInput(Pin(PROBE_ROLES[n % 3]), LOW);
+      return Run(1);
+    case OP_BUTTON:
+      Log("button %d for %d ms", n % 2, n / 2 * 8 + 20);
+      Sim::SetInput(Pin(BUTTON_ROLES[n % 2]), LOW);
+      if (!Run(n / 2 * 8 + 20))
+        return false;
+      Sim::ReleaseInput(Pin(BUTTON_ROLES[n % 2]));
+      return Run(1);
+    case OP_KEYPAD:
+      Log("keypad 0x%02x for %d ms", n % 32, n / 32 * 50 + 60);
+      Harness::GetLcdShield()->SetKeys(n % 32);
+      if (!Run(n / 32 * 50 + 60))
+        return false;
+      Harness::GetLcdShield()->SetKeys(0);
+      return Run(1);
+    case OP_PRESSURE: {
+      float hpa = ((n << 8) | Next()) / 1000.0;
+      Log("pressure %.3f hPa", hpa);
+      Harness::SetPressure(hpa);
+      return Run(1);
+    }
+    case OP_STATUS:
+      Log("MPRLS status 0x%02x", n);
+      Harness::GetMprls()->SetStatus(n);
+      return Run(1);
+    case OP_CONNECT:
+      Log("MPRLS %s", n % 2 ? "connected" : "disconnected");
+      Harness::GetMprls()->SetConnected(n % 2);
+      return Run(1);
+    case OP_BUSY:
+      Log("MPRLS busy %d us longer", n * 100);
+      Harness::GetMprls()->SetBusy(n * 100);
+      return Run(1);
+    case OP_SERIAL: {
+      uint8_t data[16];
+      uint8_t length = n % 16;
+      for (int i = 0; i < length; i++)
+        data[i] = Next();
+      Log("serial %d bytes", length);
+      Sim::SendSerial(data, length);
+      return Run(1);
+    }
+    case OP_FRAME: {
+      uint8_t payload[4];
+      uint8_t length = n % 5;
+      for (int i = 0; i < length; i++)
+        payload[i] = Next();
+      Log("frame type %d length %d", n % 10, length);
+      SendFrame(n % 10, payload, length);
+      return Run(1);
+    }
+    case OP_STUCK:
+      Log("bus stuck for %d ms", n * 4);
+      Sim::SetBusStuck(true);
+      if (!Run(n * 4))
+        return false;
+      Sim::SetBusStuck(false);
+      return Run(1);
+    case OP_HANG:
+      Log("bus hang for %d ms", n * 10);
+      if ((unsigned long)n * 10 > hangMillis)
+        hangMillis = n * 10;
+      Sim::HangBus(n * 10);
+      return Run(1);
+  }
+  return true;
+}
+
+// Runs one input on the booted board, returning true if every rule held
+static bool RunInput(const uint8_t * data, size_t size) {
+  input = data;
+  inputSize = size;
+  inputPosition = 1;
+  failure[0] = 0;
+  while (inputPosition < inputSize)
+    if (!Step())
+      break;
+  if (failure[0] == 0 && !Sim::IsReset())
+    Run(PROBE_BUDGET);  // Let anything the last operation started come due
+  return failure[0] == 0;
+}
+
+// Boots the sketch in a mode and runs it until the heap has settled
+static void Boot(int bootMode) {
+  mode = bootMode;
+  Harness::Boot(mode);
+
+  // Both pumps start active, as when brewing - inputs press the buttons to stop them
+  Sim::SetTickHook(CheckTick, NULL);
+  for (unsigned int i = 0; i < sizeof(BUTTON_ROLES); i++) {
+    Sim::SetInput(Pin(BUTTON_ROLES[i]), LOW);
+    Run(100);
+    Sim::ReleaseInput(Pin(BUTTON_ROLES[i]));
+    Run(100);
+  }
+  Run(WARMUP_MILLIS);
+  heapLimit = Sim::GetHeap().liveBytes + HEAP_SLACK;
+  if (failure[0] != 0) {
+    fprintf(stderr, "SafetyFuzzer: mode %d broke a rule before any input - %s\n", mode, failure);
+    exit(2);
+  }
+  if (!Sketch::GetPump(SKETCH_WATER_PUMP_INDEX)->GetIsActive() || !Sketch::GetPump(SKETCH_WORT_PUMP_INDEX)->GetIsActive()) {
+    fprintf(stderr, "SafetyFuzzer: mode %d did not make the pumps active\n", mode);
+    exit(2);
+  }
+}
+
+static int GetInputMode(const uint8_t * data, size_t size) {
+  return size > 0 && data[0] % 2 ? SKETCH_V2_MODE : SKETCH_V1_MODE;
+}
+
+#ifdef SAFETY_FUZZER_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    Boot(GetInputMode(data, size));
+    if (!RunInput(data, size)) {
+      fprintf(stderr, "SafetyFuzzer: %s\n", failure);
+      _exit(1);
+    }
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    abort();
+  return 0;
+}
+
+#else
+
+static uint64_t seed;
+
+// xorshift64* - the same inputs for the same seed on any host
+static uint64_t Random() {
+  seed ^= seed >> 12;
+  seed ^= seed << 25;
+  seed ^= seed >> 27;
+  return seed * 0x2545F4914F6CDD1DULL;
+}
+
+// Mostly short runs of operations, weighted towards the probes and waits where the rules live
+static size_t MakeInput(uint8_t * data, int inputMode) {
+  size_t size = 1 + 2 * (4 + Random() % 96);
+  data[0] = inputMode == SKETCH_V2_MODE ? 1 : 0;
+  for (size_t i = 1; i < size; i++)
+    data[i] = Random();
+  for (size_t i = 1; i + 1 < size; i += 2)
+    if (Random() % 3 == 0)
+      data[i] = Random() % 3 == 0 ? OP_WAIT : (Random() % 2 ? OP_PROBE : OP_SPLASH);
+  return size;
+}
+
+static void SaveCrash(const char * directory, const uint8_t * data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  char path[512];
+  mkdir(directory, 0755);
+  snprintf(path, sizeof(path), "%s/crash-%016llx", directory, (unsigned long long)hash);
+  FILE * file = fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "SafetyFuzzer: cannot write %s - %s\n", path, strerror(errno));
+    return;
+  }
+  fwrite(data, 1, size, file);
+  fclose(file);
+  fprintf(stderr, "SafetyFuzzer: saved %s\n", path);
+}
+
+static double WallSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Boots one mode, then forks the booted board for each input until the time is up
+static void FuzzMode(int fuzzMode, double endSeconds, const char * crashes, FuzzTotals * totals) {
+  Boot(fuzzMode);
+  uint64_t bootMicros = Sim::Micros();
+  unsigned long bootLoops = Sim::GetLoopCount();
+  uint8_t data[MAX_INPUT];
+
+  while (WallSeconds() < endSeconds) {
+    size_t size = MakeInput(data, fuzzMode);
+    pid_t pid = fork();
+    if (pid == 0) {
+      bool isPassed = RunInput(data, size);
+      __atomic_add_fetch(&totals->loops, Sim::GetLoopCount() - bootLoops, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&totals->simMillis, (Sim::Micros() - bootMicros) / 1000, __ATOMIC_RELAXED);
+      if (!isPassed) {
+        fprintf(stderr, "SafetyFuzzer: mode %d - %s\n", fuzzMode, failure);
+        SaveCrash(crashes, data, size);
+      }
+      _exit(isPassed ? 0 : 1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    __atomic_add_fetch(&totals->inputs, 1, __ATOMIC_RELAXED);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      __atomic_add_fetch(&totals->failures, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// Replays a saved input from a fresh boot
+static bool Replay(const char * path) {
+  uint8_t data[MAX_INPUT];
+  FILE * file = fopen(path, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "SafetyFuzzer: cannot read %s - %s\n", path, strerror(errno));
+    return false;
+  }
+  size_t size = fread(data, 1, sizeof(data), file);
+  fclose(file);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    Boot(GetInputMode(data, size));
+    bool isPassed = RunInput(data, size);
+    printf("%s: %s\n", path, isPassed ? "passed" : failure);
+    fflush(stdout);
+    _exit(isPassed ? 0 : 1);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char ** argv) {
+  double seconds = 10;
+  const char * crashes = "crashes";
+  seed = 1;
+  int numFiles = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = strtoull(argv[++i], NULL, 0);
+    else if (strcmp(argv[i], "--crashes") == 0 && i + 1 < argc)
+      crashes = argv[++i];
+    else if (strcmp(argv[i], "--verbose") == 0)
+      Harness::SetVerbose(true);
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: SafetyFuzzer [--seconds N] [--seed N] [--crashes DIR] [--verbose] [INPUT...]\n");
+      return 2;
+    } else
+      argv[numFiles++] = argv[i];
+  }
+  seed = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+  // Saved inputs replay instead of fuzzing
+  if (numFiles > 0) {
+    int failures = 0;
+    for (int i = 0; i < numFiles; i++)
+      failures += !Replay(argv[i]);
+    return failures == 0 ? 0 : 1;
+  }
+
+  FuzzTotals * totals = (FuzzTotals *)mmap(NULL, sizeof(FuzzTotals), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  memset(totals, 0, sizeof(FuzzTotals));
+  double start = WallSeconds();
+  static const int MODES[] = {SKETCH_V1_MODE, SKETCH_V2_MODE};
+  for (unsigned int i = 0; i < sizeof(MODES) / sizeof(MODES[0]); i++) {
+    if (!Sketch::HasMode(MODES[i]))
+      continue;
+    double end = start + seconds * (i + 1) / 2;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      seed += i;
+      FuzzMode(MODES[i], end, crashes, totals);
+      _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "SafetyFuzzer: mode %d did not boot\n", MODES[i]);
+      return 2;
+    }
+  }
+
+  double elapsed = WallSeconds() - start;
+  printf("SafetyFuzzer: %lu inputs, %lu failed - %llu loops and %llu simulated ms in %.1f s, %.0f loops/s, %.0f simulated ms/s\n",
+         totals->inputs, totals->failures, totals->loops, totals->simMillis, elapsed, totals->loops / elapsed,
+         totals->simMillis / elapsed);
+  return totals->failures == 0 ? 0 : 1;
+}
+
+#endif
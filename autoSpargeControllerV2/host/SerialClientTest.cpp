@@ -0,0 +1,193 @@
+/*
+  SerialClientTest.cpp - Drives the V2 sketch through SpargeClient over a Linux pty, the way a PC drives the controller over
+  its USB serial port.  The sketch runs in a child process on the pty's master side, held to the wall clock so the host's
+  timeouts and the sketch's mean the same thing, and the client opens the pty itself.
+  Created by Tom Wallace.
+*/
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "Harness.h"
+#include "SpargeClient.h"
+
+#define SKETCH_RUN_MILLIS 60000  // Longer than any case, and the child is killed once its case is done
+#define WATER_PUMP_DELAY 10000  // From the sketch's pump table
+#define LOG_DRAIN_MILLIS 500  // For a log line the sketch sent just after an ACK
+
+static SpargeClient client;
+static pid_t sketchPid;
+
+// Boots the sketch on the pty's master side, so its boot log text is on the port before the host frames, and turns the water pump
+// on before holding it to the wall clock
+static void StartSketch() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || !client.Open(ptsname(master))) {
+    perror("SerialClientTest: pty");
+    exit(2);
+  }
+
+  fflush(stdout);
+  sketchPid = fork();
+  if (sketchPid == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    client.Close();
+    Sim::SetSerialFd(master);
+    Harness::Boot(SKETCH_V2_MODE);
+    Harness::PressButton(SKETCH_LEFT_BUTTON, 100);
+    Sim::RunFor(WATER_PUMP_DELAY + 500);
+    Sim::SetRealtime(true);
+    Sim::RunFor(SKETCH_RUN_MILLIS);
+    _exit(0);
+  }
+  close(master);
+}
+
+static void StopSketch() {
+  kill(sketchPid, SIGKILL);
+  waitpid(sketchPid, NULL, 0);
+  client.Close();
+}
+
+static long NowMillis() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000;
+}
+
+// Reads frames for the whole time, counting the telemetry and keeping the last of it, so frames kept from before a command's
+// ACK are never the last
+static int ReadTelemetry(int millis, SpargeTelemetry * last) {
+  int count = 0;
+  long deadline = NowMillis() + millis;
+  SpargeFrame frame;
+  while (client.ReadFrame(FRAME_TELEMETRY, &frame, deadline - NowMillis()) && SpargeClient::DecodeTelemetry(frame, last))
+    count++;
+  return count;
+}
+
+// Waits up to a few telemetry frames for a pump to show the state
+static bool WaitForActive(int pump, bool isActive) {
+  SpargeTelemetry telemetry;
+  SpargeFrame frame;
+  for (int i = 0; i < 3; i++) {
+    if (client.ReadFrame(FRAME_TELEMETRY, &frame, 1500) && SpargeClient::DecodeTelemetry(frame, &telemetry) &&
+        telemetry.IsActive(pump) == isActive)
+      return true;
+  }
+  return false;
+}
+
+static void DroppedLogText() {
+  StartSketch();
+  SpargeTelemetry telemetry;
+  int count = ReadTelemetry(1500, &telemetry);
+  Harness::Check(count >= 1, "%d telemetry frames before the host framed", count);
+  Harness::Check(client.GetDroppedBytes() > 0, "no log text dropped before the host framed");
+  printf("  %lu bytes of log text dropped, %lu false starts\n", client.GetDroppedBytes(), client.GetBadFrames());
+  Harness::Check(telemetry.IsPumping(SKETCH_WATER_PUMP_INDEX), "water pump not on");
+
+  // Once the host frames, nothing but frames comes back - not even the water pump logging that it turned off
+  Harness::Check(client.SetUnits(false), "units not ACKed");
+  ReadTelemetry(LOG_DRAIN_MILLIS, &telemetry);
+  client.ResetCounts();
+  Harness::Check(client.SetPumpActive(SKETCH_WATER_PUMP_INDEX, false), "turning the water pump off not ACKed");
+  count = ReadTelemetry(2500, &telemetry);
+  Harness::Check(count >= 2, "%d telemetry frames after the host framed", count);
+  Harness::Check(!telemetry.IsPumping(SKETCH_WATER_PUMP_INDEX), "water pump still on");
+  Harness::Check(client.GetDroppedBytes() == 0, "%lu bytes of log text after the host framed", client.GetDroppedBytes());
+  Harness::Check(!telemetry.isShowingGallons, "units still shown in gallons");
+  StopSketch();
+}
+
+static void TurnedPumpsOnAndOff() {
+  StartSketch();
+  Harness::Check(WaitForActive(SKETCH_WATER_PUMP_INDEX, true), "water pump not active from its button");
+  Harness::Check(WaitForActive(SKETCH_WORT_PUMP_INDEX, false), "wort pump active before the host turned it on");
+
+  Harness::Check(client.SetPumpActive(SKETCH_WORT_PUMP_INDEX, true), "turning the wort pump on not ACKed");
+  Harness::Check(WaitForActive(SKETCH_WORT_PUMP_INDEX, true), "wort pump not turned on");
+  Harness::Check(client.SetPumpActive(SKETCH_WATER_PUMP_INDEX, false), "turning the water pump off not ACKed");
+  Harness::Check(WaitForActive(SKETCH_WATER_PUMP_INDEX, false), "water pump not turned off");
+  Harness::Check(client.SetPumpActive(SKETCH_WORT_PUMP_INDEX, false), "turning the wort pump off not ACKed");
+  Harness::Check(WaitForActive(SKETCH_WORT_PUMP_INDEX, false), "wort pump not turned off");
+
+  Harness::Check(!client.SetPumpActive(2, true) && client.GetLastNak() == NAK_RANGE, "a third pump not NAKed for its range");
+  uint8_t shortPayload = 1;
+  Harness::Check(!client.Command(CMD_SET_PUMP_ACTIVE, &shortPayload, 1) && client.GetLastNak() == NAK_LENGTH,
+                 "a short pump command not NAKed for its length");
+  StopSketch();
+}
+
+static void AnsweredCommands() {
+  StartSketch();
+  uint8_t payload = 1;
+  uint8_t frame[MAX_FRAME_SIZE];
+  int size = SpargeClient::EncodeFrame(CMD_SET_UNITS, &payload, 1, frame);
+  frame[size - 1] ^= 0xFF;
+  client.WriteRaw(frame, size);
+  SpargeFrame reply;
+  Harness::Check(client.ReadFrame(FRAME_NAK, &reply, SPARGE_CLIENT_TIMEOUT) && reply.payload[1] == NAK_CRC, "bad CRC not NAKed");
+  Harness::Check(!client.Command(0x30, NULL, 0) && client.GetLastNak() == NAK_UNKNOWN, "unknown command not NAKed");
+
+  Harness::Check(client.SetStop(1, 5.5), "stop one not ACKed");
+  SpargeTelemetry telemetry;
+  ReadTelemetry(1500, &telemetry);
+  Harness::Check(telemetry.isAtStopOne && telemetry.stop > 5.49 && telemetry.stop < 5.51, "stop reads %.2f gal, expected 5.50",
+                 telemetry.stop);
+  Harness::Check(!client.SetStop(2, 120) && client.GetLastNak() == NAK_RANGE, "stop past 99.5 gal not NAKed");
+
+  Harness::Check(client.RequestStats(), "stats request not ACKed");
+  int stats = 0;
+  while (client.ReadFrame(FRAME_STAT, &reply, 1000))
+    stats++;
+  int expected = Sketch::GetBrewStats()->GetStatCount();
+  Harness::Check(stats == expected, "%d stats sent, expected %d", stats, expected);
+  StopSketch();
+}
+
+// In this process on the simulated UART, as it waits out the quiet timeout much faster than the wall clock
+static std::string serialText;
+
+static void CaptureSerial(void * context, uint8_t value) {
+  serialText += (char)value;
+}
+
+static bool WasLogged(const char * text) {
+  return serialText.find(text) != std::string::npos;
+}
+
+static void LoggingBackWhenQuiet() {
+  Harness::Boot(SKETCH_V2_MODE);
+  Sim::SetSerialSink(CaptureSerial, NULL);
+  uint8_t payload = 1;
+  uint8_t frame[MAX_FRAME_SIZE];
+  Sim::SendSerial(frame, SpargeClient::EncodeFrame(CMD_SET_UNITS, &payload, 1, frame));
+  Sim::RunFor(1000);
+
+  serialText.clear();
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 100);
+  Sim::RunFor(HOST_QUIET_TIMEOUT - 2000);
+  Harness::Check(!WasLogged("Left Button"), "log text while the host was framing");
+
+  Sim::RunFor(2000);
+  Harness::Check(WasLogged("log text back on"), "log text not back once the host went quiet");
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 100);
+  Harness::Check(WasLogged("Left Button"), "button not logged once the host went quiet");
+}
+
+int main(int argc, char ** argv) {
+  Harness::SetVerbose(argc > 1 && strcmp(argv[1], "--verbose") == 0);
+  Harness::RunCase("log text dropped, then stopped once the host frames", DroppedLogText);
+  Harness::RunCase("pumps turned on and off from the host", TurnedPumpsOnAndOff);
+  Harness::RunCase("commands answered over the pty", AnsweredCommands);
+  Harness::RunCase("log text back once the host goes quiet", LoggingBackWhenQuiet);
+  return Harness::Finish("SerialClientTest");
+}
@@ -0,0 +1,94 @@
+/*
+  Sketch.h - What the host harnesses can reach inside the sketch, defined by SketchAccess.inc at the end of the sketch's own
+  translation unit so it sees the sketch's pins, modes and globals as they are built.  Objects a variant leaves out come back
+  NULL, and their pins as NO_PIN.  Class types are spelled out with class or struct, as the sketch names several globals after their class.
+  Created by Tom Wallace.
+*/
+#ifndef Sketch_h
+#define Sketch_h
+
+#include "Arduino.h"
+#include "BrewStats.h"
+#include "Button.h"
+#include "EventLog.h"
+#include "EventQueue.h"
+#include "FlowMonitor.h"
+#include "HysteresisProbe.h"
+#include "IProbe.h"
+#include "IPump.h"
+#include "LoopWatchdog.h"
+#include "MenuEngine.h"
+#include "PressureSensor.h"
+#include "SerialProtocol.h"
+#include "VesselSettings.h"
+
+#define NO_PIN 0xFF
+
+// Pins, by what they are wired to
+#define SKETCH_LED 0
+#define SKETCH_ALARM 1
+#define SKETCH_BUZZER 2
+#define SKETCH_LEFT_BUTTON 3
+#define SKETCH_LEFT_LIGHT 4
+#define SKETCH_RIGHT_BUTTON 5
+#define SKETCH_RIGHT_LIGHT 6
+#define SKETCH_MASH_PROBE 7
+#define SKETCH_MASH_PROBE_HIGH 8
+#define SKETCH_BOIL_PROBE 9
+#define SKETCH_WATER_PUMP 10
+#define SKETCH_WORT_PUMP 11
+
+// I2C addresses
+#define SKETCH_LCD_ADDRESS 0
+#define SKETCH_MUX_ADDRESS 1
+
+// Modes
+#define SKETCH_TEST_MODE 0
+#define SKETCH_V1_MODE 1
+#define SKETCH_V2_MODE 2
+
+// Pump and probe indexes
+#define SKETCH_WATER_PUMP_INDEX 0
+#define SKETCH_WORT_PUMP_INDEX 1
+#define SKETCH_MASH_PROBE_INDEX 0
+#define SKETCH_MASH_PROBE_HIGH_INDEX 1
+#define SKETCH_BOIL_PROBE_INDEX 2
+
+class Sketch {
+  public:
+	static uint8_t GetPin(int wiredTo);
+	static uint8_t GetAddress(int device);
+	static bool HasMode(int mode);
+	static int GetMode();
+	static bool IsModeStarted();
+	static bool HasLcd();
+	static long GetLoopBudget();  // What the sketch gives its LoopWatchdog
+	static int GetNumStages();
+	static const char * GetStageName(int stage);
+	static int GetStage();  // The loop stage last marked, NO_STAGE between loops
+
+	static class IPump * GetPump(int index);
+	static void SetPumpTiming(int index, long timing);  // In place of its PUMP_CONFIG timing, for tuning runs
+	static class IProbe * GetProbe(int index);
+	static class IProbe * GetRawProbe(int index);
+	static class Button * GetButton(int index);  // Left then right
+	static long GetProbeConfirmTime(int index);
+	static class EventQueue * GetAlarmQueue();
+	static class EventQueue * GetBuzzerQueue();
+	static class LoopWatchdog * GetLoopWatchdog();
+	static class EventLog * GetEventLog();
+	static class BrewStats * GetBrewStats();
+
+	// V2 only
+	static struct VesselSettings * GetBoilKettle();
+	static class PressureSensor * GetBoilPressureSensor();
+	static class HysteresisProbe * GetBoilStop();
+	static class FlowMonitor * GetFlowMonitor();
+	static class SerialProtocol * GetSerialProtocol();
+	static class MenuEngine * GetMenuEngine();
+	static int GetNumMenuEntries();
+	static int GetSelectedMenu();
+	static void SetSelectedMenu(int index);  // 0 for the main menu list, else the entry after it
+};
+
+#endif
@@ -0,0 +1,283 @@
+/*
+  SpargeClient.cpp - Host side of the serial protocol in SerialProtocol.h.
+  Created by Tom Wallace.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+#include "SpargeClient.h"
+
+#define MAX_KEPT_FRAMES 256  // Telemetry nobody read while waiting on ACKs goes once this many are kept
+
+static long NowMillis() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000L + now.tv_nsec / 1000000;
+}
+
+static uint16_t FrameCrc(uint8_t type, const uint8_t * payload, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  crc = _crc_ccitt_update(crc, type);
+  crc = _crc_ccitt_update(crc, length);
+  for (uint8_t i = 0; i < length; i++)
+    crc = _crc_ccitt_update(crc, payload[i]);
+  return crc;
+}
+
+SpargeClient::SpargeClient() {
+  _fd = -1;
+  _droppedBytes = 0;
+  _badFrames = 0;
+  _lastNak = 0;
+}
+
+SpargeClient::~SpargeClient() {
+  Close();
+}
+
+bool SpargeClient::Open(const char * path) {
+  int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+    return false;
+
+  // Raw, so nothing is echoed back to the controller or turned into line endings
+  struct termios settings;
+  if (tcgetattr(fd, &settings) == 0) {
+    cfmakeraw(&settings);
+    cfsetispeed(&settings, B57600);
+    cfsetospeed(&settings, B57600);
+    tcsetattr(fd, TCSANOW, &settings);
+  }
+  return OpenFd(fd);
+}
+
+bool SpargeClient::OpenFd(int fd) {
+  Close();
+  _fd = fd;
+  _frames.clear();
+  _received.clear();
+  ResetCounts();
+  return _fd >= 0;
+}
+
+void SpargeClient::Close() {
+  if (_fd >= 0)
+    close(_fd);
+  _fd = -1;
+}
+
+int SpargeClient::EncodeFrame(uint8_t type, const uint8_t * payload, uint8_t length, uint8_t * frame) {
+  uint16_t crc = FrameCrc(type, payload, length);
+  frame[0] = FRAME_START;
+  frame[1] = type;
+  frame[2] = length;
+  memcpy(frame + 3, payload, length);
+  frame[3 + length] = crc & 0xFF;
+  frame[4 + length] = crc >> 8;
+  return length + 5;
+}
+
+bool SpargeClient::WriteRaw(const uint8_t * data, int length) {
+  while (length > 0) {
+    ssize_t written = write(_fd, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool SpargeClient::SendFrame(uint8_t type, const uint8_t * payload, uint8_t length) {
+  if (length > MAX_FRAME_PAYLOAD)
+    return false;
+  uint8_t frame[MAX_FRAME_SIZE];
+  return WriteRaw(frame, EncodeFrame(type, payload, length, frame));
+}
+
+// Private - Takes the first good frame off what has been received, dropping anything in front of it
+bool SpargeClient::TakeFrame(SpargeFrame * frame) {
+  while (!_received.empty()) {
+    if (_received[0] != FRAME_START) {
+      _received.pop_front();
+      _droppedBytes++;
+      continue;
+    }
+    if (_received.size() < 3)
+      return false;
+    uint8_t length = _received[2];
+    if (length <= MAX_FRAME_PAYLOAD && _received.size() < (size_t)length + 5)
+      return false;
+
+    if (length <= MAX_FRAME_PAYLOAD) {
+      frame->type = _received[1];
+      frame->length = length;
+      for (int i = 0; i < length; i++)
+        frame->payload[i] = _received[3 + i];
+      uint16_t crc = _received[3 + length] | ((uint16_t)_received[4 + length] << 8);
+      if (crc == FrameCrc(frame->type, frame->payload, length)) {
+        _received.erase(_received.begin(), _received.begin() + length + 5);
+        return true;
+      }
+    }
+
+    // Not a frame after all - look again from the byte after its start
+    _badFrames++;
+    _received.pop_front();
+    _droppedBytes++;
+  }
+  return false;
+}
+
+// Private - Next good frame straight off the port
+bool SpargeClient::ReadOne(SpargeFrame * frame, int timeoutMillis) {
+  long deadline = NowMillis() + timeoutMillis;
+  while (!TakeFrame(frame)) {
+    long remaining = deadline - NowMillis();
+    if (remaining <= 0 || _fd < 0)
+      return false;
+    struct pollfd waiting = {_fd, POLLIN, 0};
+    if (poll(&waiting, 1, remaining) <= 0)
+      continue;
+
+    uint8_t buffer[256];
+    ssize_t count = read(_fd, buffer, sizeof(buffer));
+    if (count < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (count <= 0)
+      return false;  // The controller or the pty went away
+    _received.insert(_received.end(), buffer, buffer + count);
+  }
+  return true;
+}
+
+void SpargeClient::Receive(const uint8_t * data, int length) {
+  _received.insert(_received.end(), data, data + length);
+}
+
+bool SpargeClient::ReadFrame(SpargeFrame * frame, int timeoutMillis) {
+  if (!_frames.empty()) {
+    *frame = _frames.front();
+    _frames.pop_front();
+    return true;
+  }
+  return ReadOne(frame, timeoutMillis);
+}
+
+bool SpargeClient::ReadFrame(uint8_t type, SpargeFrame * frame, int timeoutMillis) {
+  long deadline = NowMillis() + timeoutMillis;
+  do {
+    if (!ReadFrame(frame, deadline - NowMillis()))
+      return false;
+    if (frame->type == type)
+      return true;
+  } while (deadline - NowMillis() > 0);
+  return false;
+}
+
+bool SpargeClient::Command(uint8_t type, const uint8_t * payload, uint8_t length) {
+  _lastNak = 0;
+  if (!SendFrame(type, payload, length))
+    return false;
+
+  // Whatever else comes in first is kept for ReadFrame
+  long deadline = NowMillis() + SPARGE_CLIENT_TIMEOUT;
+  SpargeFrame frame;
+  while (ReadOne(&frame, deadline - NowMillis())) {
+    if (frame.type == FRAME_ACK && frame.length == 1 && frame.payload[0] == type)
+      return true;
+    if (frame.type == FRAME_NAK && frame.length == 2 && frame.payload[0] == type) {
+      _lastNak = frame.payload[1];
+      return false;
+    }
+    if (_frames.size() == MAX_KEPT_FRAMES)
+      _frames.pop_front();
+    _frames.push_back(frame);
+  }
+  return false;
+}
+
+bool SpargeClient::SetStop(int stop, float gallons) {
+  int16_t hundredths = (int16_t)(gallons * 100 + (gallons < 0 ? -0.5 : 0.5));
+  uint8_t payload[2] = {(uint8_t)(hundredths & 0xFF), (uint8_t)((hundredths >> 8) & 0xFF)};
+  return Command(stop == 1 ? CMD_SET_STOP_ONE : CMD_SET_STOP_TWO, payload, 2);
+}
+
+bool SpargeClient::ToggleStop() {
+  return Command(CMD_TOGGLE_STOP, NULL, 0);
+}
+
+bool SpargeClient::SetPumpActive(int pump, bool isActive) {
+  uint8_t payload[2] = {(uint8_t)pump, isActive ? (uint8_t)1 : (uint8_t)0};
+  return Command(CMD_SET_PUMP_ACTIVE, payload, 2);
+}
+
+bool SpargeClient::SetPumpPaused(int pump, bool isPaused) {
+  uint8_t payload[2] = {(uint8_t)pump, isPaused ? (uint8_t)1 : (uint8_t)0};
+  return Command(CMD_SET_PUMP_PAUSED, payload, 2);
+}
+
+bool SpargeClient::SetTelemetry(unsigned int intervalMillis) {
+  uint8_t payload[2] = {(uint8_t)(intervalMillis & 0xFF), (uint8_t)((intervalMillis >> 8) & 0xFF)};
+  return Command(CMD_SET_TELEMETRY, payload, 2);
+}
+
+bool SpargeClient::SetUnits(bool isShowingGallons) {
+  uint8_t payload = isShowingGallons ? 1 : 0;
+  return Command(CMD_SET_UNITS, &payload, 1);
+}
+
+bool SpargeClient::SetTrace(bool isRecording) {
+  uint8_t payload = isRecording ? 1 : 0;
+  return Command(CMD_SET_TRACE, &payload, 1);
+}
+
+// The stats follow the ACK, one FRAME_STAT a loop
+bool SpargeClient::RequestStats() {
+  return Command(CMD_REQUEST_STATS, NULL, 0);
+}
+
+// The events follow the ACK, one FRAME_EVENT a loop, newest first
+bool SpargeClient::ReadEventLog() {
+  return Command(CMD_READ_EVENT_LOG, NULL, 0);
+}
+
+bool SpargeClient::DecodeTelemetry(const SpargeFrame & frame, SpargeTelemetry * telemetry) {
+  if (frame.type != FRAME_TELEMETRY || frame.length != 10)
+    return false;
+  const uint8_t * payload = frame.payload;
+  telemetry->millis = payload[0] | ((unsigned long)payload[1] << 8) | ((unsigned long)payload[2] << 16) | ((unsigned long)payload[3] << 24);
+  telemetry->gallons = (int16_t)(payload[4] | (payload[5] << 8)) / 100.0;
+  telemetry->stop = (int16_t)(payload[6] | (payload[7] << 8)) / 100.0;
+  telemetry->pumpBits = payload[8];
+  telemetry->isAtStopOne = payload[9] & 0x01;
+  telemetry->isShowingGallons = payload[9] & 0x02;
+  telemetry->isSensorConnected = payload[9] & 0x04;
+  telemetry->isAlarming = payload[9] & 0x08;
+  return true;
+}
+
+uint8_t SpargeClient::GetLastNak() {
+  return _lastNak;
+}
+
+unsigned long SpargeClient::GetDroppedBytes() {
+  return _droppedBytes;
+}
+
+unsigned long SpargeClient::GetBadFrames() {
+  return _badFrames;
+}
+
+void SpargeClient::ResetCounts() {
+  _droppedBytes = 0;
+  _badFrames = 0;
+}
@@ -0,0 +1,85 @@
+/*
+  SpargeClient.h - Host side of the serial protocol in SerialProtocol.h, for a PC talking to the controller over its USB serial
+  port or to the simulated board over a pty.  Frames are found in whatever comes off the port, so log text sent before the
+  controller notices the host is dropped and counted rather than mistaken for a frame.  A start byte inside log text begins a
+  frame that fails its length or CRC check, and the search picks up again from the byte after it, so it cannot swallow a real
+  frame that follows.
+  Created by Tom Wallace.
+*/
+#ifndef SpargeClient_h
+#define SpargeClient_h
+
+#include <stdint.h>
+#include <deque>
+#include "SerialProtocol.h"
+
+#define SPARGE_CLIENT_TIMEOUT 1000  // ms to wait for a command's ACK or NAK
+#define MAX_FRAME_SIZE (MAX_FRAME_PAYLOAD + 5)
+
+struct SpargeFrame {
+	uint8_t type;
+	uint8_t length;
+	uint8_t payload[MAX_FRAME_PAYLOAD];  // The controller frames no more than it accepts
+};
+
+struct SpargeTelemetry {
+	unsigned long millis;
+	float gallons;
+	float stop;
+	uint8_t pumpBits;  // Active then pumping, two bits per pump
+	bool isAtStopOne;
+	bool isShowingGallons;
+	bool isSensorConnected;
+	bool isAlarming;
+
+	bool IsActive(int pump) const { return (pumpBits >> (pump * 2)) & 1; }
+	bool IsPumping(int pump) const { return (pumpBits >> (pump * 2 + 1)) & 1; }
+};
+
+class SpargeClient {
+  private:
+	int _fd;
+	std::deque<SpargeFrame> _frames;  // Read while waiting on an ACK, kept for ReadFrame
+
+	std::deque<uint8_t> _received;  // Not yet framed
+	unsigned long _droppedBytes;
+	unsigned long _badFrames;
+	uint8_t _lastNak;
+
+	bool TakeFrame(SpargeFrame * frame);
+	bool ReadOne(SpargeFrame * frame, int timeoutMillis);
+
+  public:
+	SpargeClient();
+	~SpargeClient();
+	bool Open(const char * path);  // Sets the port raw at the controller's 57600 baud
+	bool OpenFd(int fd);  // An already open port, which the client closes
+	void Close();
+
+	static int EncodeFrame(uint8_t type, const uint8_t * payload, uint8_t length, uint8_t * frame);  // Returns the frame's size
+	bool WriteRaw(const uint8_t * data, int length);
+	bool SendFrame(uint8_t type, const uint8_t * payload, uint8_t length);
+	void Receive(const uint8_t * data, int length);  // Bytes that came some other way than the port, such as a sim's serial sink
+	bool ReadFrame(SpargeFrame * frame, int timeoutMillis);  // Next frame that passes its CRC, false on timeout
+	bool ReadFrame(uint8_t type, SpargeFrame * frame, int timeoutMillis);  // Next frame of the type, others are let go
+
+	// Commands - each returns true on its ACK, and false on a NAK, with the reason in GetLastNak, or a timeout
+	bool Command(uint8_t type, const uint8_t * payload, uint8_t length);
+	bool SetStop(int stop, float gallons);
+	bool ToggleStop();
+	bool SetPumpActive(int pump, bool isActive);
+	bool SetPumpPaused(int pump, bool isPaused);
+	bool SetTelemetry(unsigned int intervalMillis);
+	bool SetUnits(bool isShowingGallons);
+	bool SetTrace(bool isRecording);
+	bool RequestStats();
+	bool ReadEventLog();
+
+	static bool DecodeTelemetry(const SpargeFrame & frame, SpargeTelemetry * telemetry);
+	uint8_t GetLastNak();  // NAK_ reason, 0 when the last command was not NAKed
+	unsigned long GetDroppedBytes();  // Log text and anything else outside a good frame
+	unsigned long GetBadFrames();
+	void ResetCounts();
+};
+
+#endif
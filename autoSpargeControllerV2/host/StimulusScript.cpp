@@ -0,0 +1,130 @@
+/*
+  StimulusScript.cpp - Reads a script of timed stimuli for the simulated board, and applies them to the booted sketch.
+  Created by Tom Wallace.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Adafruit_RGBLCDShield.h>
+#include <MprlsReader.h>
+#include "Harness.h"
+#include "StimulusScript.h"
+
+#define SENSOR_ERROR_STATUS 0x44  // Powered, with saturated math
+
+static int PinFor(const std::string & name) {
+  if (name == "left") return SKETCH_LEFT_BUTTON;
+  if (name == "right") return SKETCH_RIGHT_BUTTON;
+  if (name == "mash") return SKETCH_MASH_PROBE;
+  if (name == "mash-high") return SKETCH_MASH_PROBE_HIGH;
+  if (name == "boil") return SKETCH_BOIL_PROBE;
+  return -1;
+}
+
+static uint8_t KeysFor(const std::string & name) {
+  if (name == "up") return BUTTON_UP;
+  if (name == "down") return BUTTON_DOWN;
+  if (name == "left") return BUTTON_LEFT;
+  if (name == "right") return BUTTON_RIGHT;
+  if (name == "select") return BUTTON_SELECT;
+  return 0;
+}
+
+StimulusScript::StimulusScript() {
+  _runner = NULL;
+  _context = NULL;
+}
+
+bool StimulusScript::Read(const char * path) {
+  _path = path;
+  _stimuli.clear();
+  FILE * in = fopen(path, "r");
+  if (in == NULL) {
+    fprintf(stderr, "%s: cannot read\n", path);
+    return false;
+  }
+  char line[256];
+  for (int number = 1; fgets(line, sizeof(line), in) != NULL; number++) {
+    char * comment = strchr(line, '#');
+    if (comment != NULL)
+      *comment = 0;
+    char action[32] = "";
+    char target[32] = "";
+    char value[32] = "";
+    unsigned long millis;
+    int fields = sscanf(line, "%lu %31s %31s %31s", &millis, action, target, value);
+    if (fields <= 0)
+      continue;
+    if (fields < 2 || (_stimuli.empty() && strcmp(action, "boot") != 0) || (!_stimuli.empty() && millis < _stimuli.back().millis)) {
+      fprintf(stderr, "%s:%d: expected a time, in order, and a stimulus, starting with boot\n", path, number);
+      fclose(in);
+      return false;
+    }
+    Stimulus stimulus = {millis, action, target, value, number};
+    _stimuli.push_back(stimulus);
+  }
+  fclose(in);
+  if (_stimuli.empty()) {
+    fprintf(stderr, "%s: no stimuli\n", path);
+    return false;
+  }
+  return true;
+}
+
+int StimulusScript::GetBootMode() {
+  const std::string & mode = _stimuli[0].target;
+  return mode == "v1" ? SKETCH_V1_MODE : mode == "test" ? SKETCH_TEST_MODE : SKETCH_V2_MODE;
+}
+
+// Times count from the call, which is where the mode has just started
+bool StimulusScript::Run(StimulusRunner runner, void * context) {
+  _runner = runner;
+  _context = context;
+  unsigned long startMillis = Sim::Micros() / 1000;
+  for (size_t i = 1; i < _stimuli.size() && !Sim::IsReset(); i++) {
+    if (!Apply(_stimuli[i], startMillis))
+      return false;
+  }
+  return true;
+}
+
+// Private - Runs up to the stimulus, then applies it - a press or keypress runs on for as long as it is held
+bool StimulusScript::Apply(const Stimulus & stimulus, unsigned long startMillis) {
+  _runner(_context, startMillis + stimulus.millis);
+  if (stimulus.action == "press") {
+    int pin = PinFor(stimulus.target);
+    if (pin != SKETCH_LEFT_BUTTON && pin != SKETCH_RIGHT_BUTTON)
+      return Fail(stimulus, "press left or right");
+    Sim::SetInput(Harness::GetPin(pin), LOW);
+    _runner(_context, Sim::Micros() / 1000 + atol(stimulus.value.c_str()));
+    Sim::ReleaseInput(Harness::GetPin(pin));
+  } else if (stimulus.action == "probe") {
+    int pin = PinFor(stimulus.target);
+    if (pin != SKETCH_MASH_PROBE && pin != SKETCH_MASH_PROBE_HIGH && pin != SKETCH_BOIL_PROBE)
+      return Fail(stimulus, "probe mash, mash-high or boil");
+    Sim::SetInput(Harness::GetPin(pin), stimulus.value == "high" ? HIGH : LOW);
+  } else if (stimulus.action == "keys") {
+    uint8_t keys = KeysFor(stimulus.target);
+    if (keys == 0)
+      return Fail(stimulus, "keys up, down, left, right or select");
+    Harness::GetLcdShield()->SetKeys(keys);
+    _runner(_context, Sim::Micros() / 1000 + atol(stimulus.value.c_str()));
+    Harness::GetLcdShield()->SetKeys(0);
+  } else if (stimulus.action == "pressure") {
+    Harness::SetPressure(atof(stimulus.target.c_str()));
+  } else if (stimulus.action == "sensor") {
+    Harness::GetMprls()->SetStatus(stimulus.target == "error" ? SENSOR_ERROR_STATUS : MPRLS_STATUS_GOOD);
+  } else if (stimulus.action == "hang-bus") {
+    Sim::HangBus(atol(stimulus.target.c_str()));
+  } else if (stimulus.action != "end") {
+    return Fail(stimulus, "unknown stimulus");
+  }
+  return true;
+}
+
+// Private
+bool StimulusScript::Fail(const Stimulus & stimulus, const char * message) {
+  fprintf(stderr, "%s:%d: %s\n", _path.c_str(), stimulus.line, message);
+  return false;
+}
@@ -0,0 +1,51 @@
+/*
+  StimulusScript.h - Reads a script of timed pin, keypad and sensor stimuli for the simulated board, and applies them to the
+  booted sketch, so host tools can drive a brew without each scripting its own.  A line is a time in ms after the sketch's
+  mode has started, a stimulus and its arguments, with # for comments:
+
+    0       boot v2              v1, v2 or test - the first line
+    1000    press left 150       a pump button held for 150 ms - left or right
+    5000    probe mash high      mash, mash-high or boil, high or low
+    6000    keys down 200        keypad - up, down, left, right or select
+    7000    pressure 10.0        hPa over the atmosphere
+    8000    sensor error         good or error
+    9000    hang-bus 600         the next I2C transaction takes this many ms
+    60000   end
+
+  Created by Tom Wallace.
+*/
+#ifndef StimulusScript_h
+#define StimulusScript_h
+
+#include <string>
+#include <vector>
+
+// Runs the sketch up to a time, in whatever steps the tool measures it in
+typedef void (* StimulusRunner)(void * context, unsigned long untilMillis);
+
+struct Stimulus {
+	unsigned long millis;
+	std::string action;
+	std::string target;
+	std::string value;
+	int line;
+};
+
+class StimulusScript {
+  private:
+	std::vector<Stimulus> _stimuli;
+	std::string _path;
+	StimulusRunner _runner;
+	void * _context;
+
+	bool Apply(const Stimulus & stimulus, unsigned long startMillis);
+	bool Fail(const Stimulus & stimulus, const char * message);
+
+  public:
+	StimulusScript();
+	bool Read(const char * path);  // Prints what is wrong with it and returns false
+	int GetBootMode();
+	bool Run(StimulusRunner runner, void * context);  // Once booted into GetBootMode() - false on a bad stimulus
+};
+
+#endif
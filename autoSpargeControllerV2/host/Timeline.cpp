@@ -0,0 +1,89 @@
+/*
+  Timeline.cpp - Prints what the sketch did, timed from an origin.
+  Created by Tom Wallace.
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include "Sketch.h"
+#include "Timeline.h"
+
+static const int PUMP_PINS[TIMELINE_PUMPS] = {SKETCH_WATER_PUMP, SKETCH_WORT_PUMP};
+static const char * const PUMP_NAMES[TIMELINE_PUMPS] = {"Water Pump", "Wort Pump"};
+
+// The events the sketch gives alarm patterns
+static const char * const ALARM_NAMES[TIMELINE_ALARMS] = {"BoilProbe", "MashProbeHigh", "DryRun", "LoopStall"};
+
+Timeline::Timeline(FILE * out, SimLcdShield * lcdShield) {
+  _out = out;
+  _lcdShield = lcdShield;
+  _originMillis = 0;
+  _lines = 0;
+}
+
+void Timeline::Begin(unsigned long originMillis) {
+  _originMillis = originMillis;
+  for (int i = 0; i < TIMELINE_PUMPS; i++) {
+    _pumpLevels[i] = Sim::GetLevel(Sketch::GetPin(PUMP_PINS[i]));
+    Print(originMillis, "%s %s", PUMP_NAMES[i], _pumpLevels[i] == HIGH ? "ON" : "OFF");
+  }
+  for (int i = 0; i < TIMELINE_ALARMS; i++) {
+    _alarms[i] = Sketch::GetAlarmQueue()->HasEvent(ALARM_NAMES[i]);
+    if (_alarms[i])
+      Print(originMillis, "Alarm %s raised", ALARM_NAMES[i]);
+  }
+  for (int row = 0; row < SIM_LCD_ROWS; row++)
+    _lcdShield->GetRow(row, _rows[row]);
+  memcpy(_pendingRows, _rows, sizeof(_rows));
+  _pendingMillis = originMillis;
+  Print(originMillis, "LCD \"%s\" \"%s\"", _rows[0], _rows[1]);
+}
+
+void Timeline::Update(unsigned long currentMillis) {
+  for (int i = 0; i < TIMELINE_PUMPS; i++) {
+    uint8_t level = Sim::GetLevel(Sketch::GetPin(PUMP_PINS[i]));
+    if (level != _pumpLevels[i]) {
+      _pumpLevels[i] = level;
+      Print(currentMillis, "%s %s", PUMP_NAMES[i], level == HIGH ? "ON" : "OFF");
+    }
+  }
+
+  // Events are only added and removed by the loop, so once every 10 ms is enough and keeps the String work down
+  if (currentMillis % 10 == 0) {
+    for (int i = 0; i < TIMELINE_ALARMS; i++) {
+      bool isRaised = Sketch::GetAlarmQueue()->HasEvent(ALARM_NAMES[i]);
+      if (isRaised != _alarms[i]) {
+        _alarms[i] = isRaised;
+        Print(currentMillis, "Alarm %s %s", ALARM_NAMES[i], isRaised ? "raised" : "cleared");
+      }
+    }
+  }
+
+  // Printed once it settles, at the time it first showed
+  char rows[SIM_LCD_ROWS][SIM_LCD_COLUMNS + 1];
+  for (int row = 0; row < SIM_LCD_ROWS; row++)
+    _lcdShield->GetRow(row, rows[row]);
+  if (memcmp(rows, _pendingRows, sizeof(rows)) != 0) {
+    memcpy(_pendingRows, rows, sizeof(rows));
+    _pendingMillis = currentMillis;
+  } else if (currentMillis - _pendingMillis == TIMELINE_LCD_SETTLE && memcmp(_pendingRows, _rows, sizeof(_rows)) != 0) {
+    memcpy(_rows, _pendingRows, sizeof(_rows));
+    Print(_pendingMillis, "LCD \"%s\" \"%s\"", _rows[0], _rows[1]);
+  }
+}
+
+unsigned long Timeline::GetLines() {
+  return _lines;
+}
+
+// Private - One line, with the seconds since the origin in front
+void Timeline::Print(unsigned long currentMillis, const char * format, ...) {
+  long millis = (long)(currentMillis - _originMillis);
+  fprintf(_out, "%5ld.%03ld  ", millis / 1000, millis % 1000);
+  va_list args;
+  va_start(args, format);
+  vfprintf(_out, format, args);
+  va_end(args);
+  fputc('\n', _out);
+  _lines++;
+}
@@ -0,0 +1,39 @@
+/*
+  Timeline.h - Prints what the sketch did, as a line for each pump turning on or off, each alarm raised or cleared and each
+  change to the LCD, timed from an origin.  Called every simulated millisecond, so a replay and the run it was recorded from
+  can be compared line for line.
+  Created by Tom Wallace.
+*/
+#ifndef Timeline_h
+#define Timeline_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include "Devices.h"
+
+#define TIMELINE_PUMPS 2
+#define TIMELINE_ALARMS 4
+#define TIMELINE_LCD_SETTLE 20  // ms the LCD must hold its text to count, as the sketch writes it a character at a time
+
+class Timeline {
+  private:
+	FILE * _out;
+	SimLcdShield * _lcdShield;
+	unsigned long _originMillis;
+	uint8_t _pumpLevels[TIMELINE_PUMPS];
+	bool _alarms[TIMELINE_ALARMS];
+	char _rows[SIM_LCD_ROWS][SIM_LCD_COLUMNS + 1];  // Last printed
+	char _pendingRows[SIM_LCD_ROWS][SIM_LCD_COLUMNS + 1];
+	unsigned long _pendingMillis;
+	unsigned long _lines;
+
+	void Print(unsigned long currentMillis, const char * format, ...) __attribute__((format(printf, 3, 4)));
+
+  public:
+	Timeline(FILE * out, SimLcdShield * lcdShield);
+	void Begin(unsigned long originMillis);  // Prints the state at the origin
+	void Update(unsigned long currentMillis);
+	unsigned long GetLines();
+};
+
+#endif
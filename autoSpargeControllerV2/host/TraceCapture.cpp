@@ -0,0 +1,215 @@
+/*
+  TraceCapture.cpp - Records a trace for TraceReplay, saving the FRAME_TRACE payloads one after another.
+
+    TraceCapture --port /dev/ttyACM0 --out brew.trace [--seconds N]
+    TraceCapture --sim --out brew.trace [--timeline brew.live]
+
+  With --port it asks the controller for a trace and appends what comes back until N seconds have passed, or until Ctrl-C if
+  N is 0.  With --sim it records a scripted brew on the simulated board instead - both pumps on, the boil kettle filling
+  while the wort pump runs, the mash probe touching and clearing, a trip through the menu, a Mash Probe High alarm and a
+  dropped pressure reading - and can print the run's own timeline, to compare with the replay of what it recorded.
+  Created by Tom Wallace.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Adafruit_RGBLCDShield.h>
+#include "Harness.h"
+#include "SpargeClient.h"
+#include "Timeline.h"
+
+#define FILL_GALLONS_PER_MINUTE 30.0  // While the wort pump runs, for two seconds a minute
+#define HPA_PER_GALLON 2.5  // Roughly what the pressure sensor's fit gives
+#define SENSOR_ERROR_STATUS 0x44  // Powered, with saturated math
+#define DRAIN_MILLIS 1500  // For the frame the recorder sends when it stops
+
+static volatile bool isStopping = false;
+
+static void Stop(int signal) {
+  isStopping = true;
+}
+
+static bool Save(FILE * out, const SpargeFrame & frame, unsigned long * bytes) {
+  if (fwrite(frame.payload, 1, frame.length, out) != frame.length)
+    return false;
+  *bytes += frame.length;
+  return true;
+}
+
+static int CapturePort(const char * port, FILE * out, long seconds) {
+  SpargeClient client;
+  if (!client.Open(port)) {
+    fprintf(stderr, "TraceCapture: cannot open %s\n", port);
+    return 1;
+  }
+  if (!client.SetTrace(true)) {
+    fprintf(stderr, "TraceCapture: trace not started, NAK 0x%02X\n", client.GetLastNak());
+    return 1;
+  }
+
+  signal(SIGINT, Stop);
+  time_t end = time(NULL) + seconds;
+  unsigned long bytes = 0;
+  SpargeFrame frame;
+  while (!isStopping && (seconds == 0 || time(NULL) < end)) {
+    if (client.ReadFrame(FRAME_TRACE, &frame, 500) && !Save(out, frame, &bytes))
+      return 1;
+  }
+  client.SetTrace(false);
+  while (client.ReadFrame(FRAME_TRACE, &frame, DRAIN_MILLIS)) {
+    if (!Save(out, frame, &bytes))
+      return 1;
+  }
+  fprintf(stderr, "TraceCapture: %lu bytes\n", bytes);
+  return 0;
+}
+
+// The scripted brew
+static SpargeClient simClient;
+static Timeline * liveTimeline;
+static double kettleGallons;
+
+static void ReceiveSerial(void * context, uint8_t value) {
+  simClient.Receive(&value, 1);
+}
+
+// The wort pump fills the boil kettle
+static void FillKettle(void * context, unsigned long currentMillis) {
+  if (Sim::GetLevel(Harness::GetPin(SKETCH_WORT_PUMP)) == HIGH)
+    kettleGallons += FILL_GALLONS_PER_MINUTE / 60000.0;
+  if (currentMillis % 100 == 0)
+    Harness::SetPressure(kettleGallons * HPA_PER_GALLON);
+  if (liveTimeline != NULL)
+    liveTimeline->Update(currentMillis);
+}
+
+static void SendTrace(bool isRecording) {
+  uint8_t payload = isRecording ? 1 : 0;
+  uint8_t frame[MAX_FRAME_SIZE];
+  Sim::SendSerial(frame, SpargeClient::EncodeFrame(CMD_SET_TRACE, &payload, 1, frame));
+}
+
+static void RunFor(unsigned long millis, FILE * out, unsigned long * bytes) {
+  Sim::RunFor(millis);
+  SpargeFrame frame;
+  while (simClient.ReadFrame(&frame, 0)) {
+    if (frame.type == FRAME_TRACE)
+      Save(out, frame, bytes);
+  }
+}
+
+static void SetProbe(int wiredTo, uint8_t level) {
+  Sim::SetInput(Harness::GetPin(wiredTo), level);
+}
+
+static int CaptureSim(FILE * out, FILE * timelineOut) {
+  unsigned long bytes = 0;
+  Harness::SetPressure(0);
+  Harness::Boot(SKETCH_V2_MODE);
+  Sim::SetSerialSink(ReceiveSerial, NULL);
+  Sim::SetTickHook(FillKettle, NULL);
+  RunFor(2000, out, &bytes);
+
+  // The recorder starts in the loop that takes the command, which is where the replay's timeline starts too
+  SendTrace(true);
+  while (!Sketch::GetSerialProtocol()->IsTraceRequested())
+    Sim::RunFor(1);
+  Timeline timeline(timelineOut != NULL ? timelineOut : stdout, Harness::GetLcdShield());
+  if (timelineOut != NULL) {
+    timeline.Begin(Sim::Micros() / 1000);
+    liveTimeline = &timeline;
+  }
+  RunFor(500, out, &bytes);
+
+  // Water to the mash, then wort to the kettle
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 150);
+  RunFor(3000, out, &bytes);
+  Harness::PressButton(SKETCH_RIGHT_BUTTON, 150);
+  RunFor(20000, out, &bytes);
+
+  // The mash tun fills to its probe, and drains below it again
+  SetProbe(SKETCH_MASH_PROBE, HIGH);
+  RunFor(15000, out, &bytes);
+  SetProbe(SKETCH_MASH_PROBE, LOW);
+  RunFor(10000, out, &bytes);
+
+  // Down the menu and back
+  Harness::PressKeys(BUTTON_DOWN, 200);
+  RunFor(2000, out, &bytes);
+  Harness::PressKeys(BUTTON_UP, 200);
+  RunFor(5000, out, &bytes);
+
+  // Too full, with the high probe touching long enough to confirm
+  SetProbe(SKETCH_MASH_PROBE_HIGH, HIGH);
+  RunFor(3000, out, &bytes);
+  SetProbe(SKETCH_MASH_PROBE_HIGH, LOW);
+  RunFor(10000, out, &bytes);
+
+  // The sensor drops out for a second
+  Harness::GetMprls()->SetStatus(SENSOR_ERROR_STATUS);
+  RunFor(1000, out, &bytes);
+  Harness::GetMprls()->SetStatus(MPRLS_STATUS_GOOD);
+  RunFor(60000, out, &bytes);
+
+  SendTrace(false);
+  RunFor(DRAIN_MILLIS, out, &bytes);
+  liveTimeline = NULL;
+  fprintf(stderr, "TraceCapture: %lu bytes, kettle at %.2f gallons\n", bytes, kettleGallons);
+  if (Sim::IsReset()) {
+    fprintf(stderr, "TraceCapture: watchdog reset the board\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int Usage() {
+  fprintf(stderr, "usage: TraceCapture --port <device> --out <file> [--seconds N]\n"
+                  "       TraceCapture --sim --out <file> [--timeline <file>]\n");
+  return 2;
+}
+
+int main(int argc, char ** argv) {
+  const char * port = NULL;
+  const char * outPath = NULL;
+  const char * timelinePath = NULL;
+  bool isSim = false;
+  long seconds = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+      port = argv[++i];
+    else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+      outPath = argv[++i];
+    else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+      timelinePath = argv[++i];
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = atol(argv[++i]);
+    else if (strcmp(argv[i], "--sim") == 0)
+      isSim = true;
+    else
+      return Usage();
+  }
+  if (outPath == NULL || isSim == (port != NULL))
+    return Usage();
+
+  // A simulated brew starts its file afresh, a real one adds to it, so a brew day can be caught in several pieces
+  FILE * out = fopen(outPath, isSim ? "wb" : "ab");
+  if (out == NULL) {
+    fprintf(stderr, "TraceCapture: cannot write %s\n", outPath);
+    return 1;
+  }
+  FILE * timelineOut = NULL;
+  if (timelinePath != NULL && (timelineOut = fopen(timelinePath, "w")) == NULL) {
+    fprintf(stderr, "TraceCapture: cannot write %s\n", timelinePath);
+    return 1;
+  }
+
+  int result = isSim ? CaptureSim(out, timelineOut) : CapturePort(port, out, seconds);
+  if (fclose(out) != 0)
+    result = 1;
+  if (timelineOut != NULL)
+    fclose(timelineOut);
+  return result;
+}
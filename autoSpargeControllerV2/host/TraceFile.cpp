@@ -0,0 +1,173 @@
+/*
+  TraceFile.cpp - Reads the traces TraceRecorder sends.
+  Created by Tom Wallace.
+*/
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "TraceFile.h"
+
+TraceFile::TraceFile() {
+  _fd = -1;
+  _data = NULL;
+  _size = 0;
+}
+
+TraceFile::~TraceFile() {
+  Close();
+}
+
+bool TraceFile::Open(const char * path) {
+  Close();
+  _fd = open(path, O_RDONLY);
+  if (_fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(_fd, &info) != 0) {
+    Close();
+    return false;
+  }
+
+  // An empty file cannot be mapped, and holds no sessions anyway
+  _size = info.st_size;
+  if (_size == 0)
+    return true;
+  void * data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  madvise(data, _size, MADV_SEQUENTIAL);
+  _data = (const uint8_t *)data;
+  return true;
+}
+
+void TraceFile::Close() {
+  if (_data != NULL)
+    munmap((void *)_data, _size);
+  if (_fd >= 0)
+    close(_fd);
+  _fd = -1;
+  _data = NULL;
+  _size = 0;
+}
+
+const uint8_t * TraceFile::GetData() {
+  return _data;
+}
+
+size_t TraceFile::GetSize() {
+  return _size;
+}
+
+TraceReader::TraceReader(const uint8_t * data, size_t size) {
+  _data = data;
+  _size = size;
+  _offset = 0;
+  _isStarted = false;
+  _millis = 0;
+  memset(_outputs, 0, sizeof(_outputs));
+  _error = NULL;
+}
+
+size_t TraceReader::GetOffset() {
+  return _offset;
+}
+
+const char * TraceReader::GetError() {
+  return _error;
+}
+
+// Undoes the recorder's zigzag, which keeps small changes either way to small varints
+long TraceReader::Unzigzag(unsigned long value) {
+  return (long)(int32_t)((value >> 1) ^ (0 - (value & 1)));
+}
+
+bool TraceReader::Next(TraceRecord * record) {
+  if (_offset >= _size)
+    return false;
+
+  uint8_t kind;
+  ReadByte(&kind);
+  memset(record, 0, sizeof(*record));
+  record->kind = kind & 0xF0;
+  record->channel = kind & 0x0F;
+
+  if (record->kind == TRACE_START) {
+    uint8_t start[8];
+    for (int i = 0; i < 8; i++) {
+      if (!ReadByte(&start[i])) {
+        _error = "start record cut short";
+        return false;
+      }
+    }
+    _millis = start[0] | ((unsigned long)start[1] << 8) | ((unsigned long)start[2] << 16) | ((unsigned long)start[3] << 24);
+    record->probeLevels = start[4];
+    record->buttonsDown = start[5];
+    record->buttonsOn = start[6];
+    record->keypadButton = start[7];
+    record->millis = _millis;
+    memset(_outputs, 0, sizeof(_outputs));
+    _isStarted = true;
+    return true;
+  }
+
+  if (!_isStarted) {
+    _error = "record before the first start record";
+    return false;
+  }
+  if (record->kind > TRACE_SENSOR_LOST) {
+    _error = "unknown record kind";
+    return false;
+  }
+
+  unsigned long delta;
+  if (!ReadVarint(&delta)) {
+    _error = "record time cut short";
+    return false;
+  }
+  _millis += delta;
+  record->millis = _millis;
+
+  if (record->kind == TRACE_PRESSURE || record->kind == TRACE_SENSOR_LOST) {
+    if (record->channel >= MAX_PRESSURE_CHANNELS) {
+      _error = "pressure channel out of range";
+      return false;
+    }
+  }
+  if (record->kind == TRACE_PRESSURE) {
+    unsigned long change;
+    if (!ReadVarint(&change)) {
+      _error = "pressure change cut short";
+      return false;
+    }
+    _outputs[record->channel] += Unzigzag(change);
+    record->value = _outputs[record->channel];
+  }
+  return true;
+}
+
+// Private
+bool TraceReader::ReadByte(uint8_t * value) {
+  if (_offset >= _size)
+    return false;
+  *value = _data[_offset++];
+  return true;
+}
+
+// Private - Unsigned LEB128, seven bits per byte with the high bit set on all but the last
+bool TraceReader::ReadVarint(unsigned long * value) {
+  *value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t part;
+    if (!ReadByte(&part))
+      return false;
+    *value |= (unsigned long)(part & 0x7F) << shift;
+    if (!(part & 0x80))
+      return true;
+  }
+  return false;  // Longer than any 32 bit value
+}
@@ -0,0 +1,64 @@
+/*
+  TraceFile.h - Reads the traces TraceRecorder sends, saved as the FRAME_TRACE payloads one after another.  Records never
+  span frames, so the payloads joined up are one record stream, and a file can hold several sessions, each opening with its
+  start record.  The file is mapped rather than read, so replaying thousands of them costs no copies.
+  Created by Tom Wallace.
+*/
+#ifndef TraceFile_h
+#define TraceFile_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TraceRecorder.h"
+
+struct TraceRecord {
+	uint8_t kind;  // TRACE_ kind, the high nibble
+	uint8_t channel;  // The low nibble
+	unsigned long millis;  // On the recording board's clock
+	long value;  // Raw counts for a pressure record, after undoing the deltas
+
+	// Start records only
+	uint8_t probeLevels;
+	uint8_t buttonsDown;
+	uint8_t buttonsOn;
+	uint8_t keypadButton;
+};
+
+class TraceFile {
+  private:
+	int _fd;
+	const uint8_t * _data;
+	size_t _size;
+
+  public:
+	TraceFile();
+	~TraceFile();
+	bool Open(const char * path);
+	void Close();
+	const uint8_t * GetData();
+	size_t GetSize();
+};
+
+// Steps through a record stream, keeping the running time and pressure each record is a change from
+class TraceReader {
+  private:
+	const uint8_t * _data;
+	size_t _size;
+	size_t _offset;
+	bool _isStarted;
+	unsigned long _millis;
+	long _outputs[MAX_PRESSURE_CHANNELS];
+	const char * _error;
+
+	bool ReadByte(uint8_t * value);
+	bool ReadVarint(unsigned long * value);
+
+  public:
+	TraceReader(const uint8_t * data, size_t size);
+	bool Next(TraceRecord * record);  // False at the end, or on a bad record with GetError set
+	size_t GetOffset();  // Of the next record
+	const char * GetError();  // NULL unless the stream was cut short or malformed
+	static long Unzigzag(unsigned long value);
+};
+
+#endif
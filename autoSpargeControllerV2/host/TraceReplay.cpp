@@ -0,0 +1,325 @@
+/*
+  TraceReplay.cpp - Replays traces recorded by TraceRecorder through the V2 sketch on the simulated board, and prints what it
+  did as a timeline of pump, alarm and LCD changes.  Each session in a trace gets a freshly booted sketch, its probes, buttons,
+  keypad and pressure samples driven at the times they were recorded, relative to the session's start.
+
+    TraceReplay [--jobs N] [--check | --update] trace...
+
+  --check compares each trace's timeline with the .timeline file beside it, so recorded brews work as regression cases, and
+  --update rewrites those files.  Traces are replayed N at a time in forked workers, and printed in the order given.
+  Created by Tom Wallace.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include <Adafruit_RGBLCDShield.h>
+#include "Harness.h"
+#include "Timeline.h"
+#include "TraceFile.h"
+
+#define SETTLE_MILLIS 1000  // After boot and the pumps the trace starts with are turned on, before the first record
+#define TAIL_MILLIS 5000  // Run on after the last record, for the pumps and alarms to follow it
+#define SENSOR_ERROR_STATUS 0x44  // Powered, with saturated math
+
+static const int PROBE_PINS[] = {SKETCH_MASH_PROBE, SKETCH_MASH_PROBE_HIGH, SKETCH_BOIL_PROBE};
+static const int BUTTON_PINS[] = {SKETCH_LEFT_BUTTON, SKETCH_RIGHT_BUTTON};
+
+// Keypad keys by the number evaluateButton gives them
+static const uint8_t KEYPAD_KEYS[] = {0, BUTTON_RIGHT, BUTTON_UP, BUTTON_DOWN, BUTTON_LEFT, BUTTON_SELECT};
+
+#define NUM_PROBE_PINS (int)(sizeof(PROBE_PINS) / sizeof(PROBE_PINS[0]))
+#define NUM_BUTTON_PINS (int)(sizeof(BUTTON_PINS) / sizeof(BUTTON_PINS[0]))
+#define NUM_KEYPAD_KEYS (int)(sizeof(KEYPAD_KEYS) / sizeof(KEYPAD_KEYS[0]))
+
+static Timeline * timeline;
+
+static void WatchTimeline(void * context, unsigned long currentMillis) {
+  timeline->Update(currentMillis);
+}
+
+// Sets an input as the record says the sketch saw it
+static bool Apply(const TraceRecord & record) {
+  switch (record.kind) {
+    case TRACE_PROBE_HIGH:
+    case TRACE_PROBE_LOW:
+      if (record.channel >= NUM_PROBE_PINS)
+        return false;
+      Sim::SetInput(Harness::GetPin(PROBE_PINS[record.channel]), record.kind == TRACE_PROBE_HIGH ? HIGH : LOW);
+      return true;
+    case TRACE_BUTTON_DOWN:
+      if (record.channel >= NUM_BUTTON_PINS)
+        return false;
+      Sim::SetInput(Harness::GetPin(BUTTON_PINS[record.channel]), LOW);
+      return true;
+    case TRACE_BUTTON_UP:
+      if (record.channel >= NUM_BUTTON_PINS)
+        return false;
+      Sim::ReleaseInput(Harness::GetPin(BUTTON_PINS[record.channel]));
+      return true;
+    case TRACE_KEYPAD:
+      if (record.channel >= NUM_KEYPAD_KEYS)
+        return false;
+      Harness::GetLcdShield()->SetKeys(KEYPAD_KEYS[record.channel]);
+      return true;
+    case TRACE_PRESSURE:
+      Harness::GetMprls()->SetStatus(MPRLS_STATUS_GOOD);
+      Harness::GetMprls()->SetCounts(record.value);
+      return true;
+    case TRACE_SENSOR_LOST:
+      Harness::GetMprls()->SetStatus(SENSOR_ERROR_STATUS);
+      return true;
+  }
+  return false;
+}
+
+// Runs in its own process, from the session's start record to the next one or the end of the file
+static int ReplaySession(const uint8_t * data, size_t size, FILE * out) {
+  TraceReader reader(data, size);
+  TraceRecord start;
+  if (!reader.Next(&start) || start.kind != TRACE_START) {
+    fprintf(out, "bad session: %s\n", reader.GetError() != NULL ? reader.GetError() : "no start record");
+    return 1;
+  }
+
+  // The sensor zeroes on its first readings, so it boots on the pressure the session starts with
+  TraceReader first(data, size);
+  TraceRecord record;
+  while (first.Next(&record) && record.kind != TRACE_PRESSURE) {
+  }
+  Harness::GetMprls()->SetCounts(record.kind == TRACE_PRESSURE ? record.value : SimMprls::HpaToCounts(SIM_ATMOSPHERE_HPA));
+
+  Harness::Boot(SKETCH_V2_MODE);
+  for (int i = 0; i < NUM_BUTTON_PINS; i++) {
+    if (start.buttonsOn & (1 << i))
+      Harness::PressButton(BUTTON_PINS[i], 100);
+  }
+  for (int i = 0; i < NUM_PROBE_PINS; i++)
+    Sim::SetInput(Harness::GetPin(PROBE_PINS[i]), (start.probeLevels & (1 << i)) ? HIGH : LOW);
+  for (int i = 0; i < NUM_BUTTON_PINS; i++) {
+    if (start.buttonsDown & (1 << i))
+      Sim::SetInput(Harness::GetPin(BUTTON_PINS[i]), LOW);
+  }
+  if (start.keypadButton < NUM_KEYPAD_KEYS)
+    Harness::GetLcdShield()->SetKeys(KEYPAD_KEYS[start.keypadButton]);
+  Sim::RunFor(SETTLE_MILLIS);
+
+  // On the board's own clock where the session started late enough, so what runs from boot, such as the wort pump's minute
+  // and the pressure sampling, lines up with the recording
+  unsigned long replayStart = Sim::Micros() / 1000;
+  if (start.millis > replayStart) {
+    Sim::RunFor(start.millis - replayStart);
+    replayStart = start.millis;
+  }
+  Timeline sessionTimeline(out, Harness::GetLcdShield());
+  timeline = &sessionTimeline;
+  fprintf(out, "Session at %lu.%03lu s on the board\n", start.millis / 1000, start.millis % 1000);
+  sessionTimeline.Begin(replayStart);
+  Sim::SetTickHook(WatchTimeline, NULL);
+
+  while (reader.Next(&record)) {
+    unsigned long target = replayStart + (record.millis - start.millis);
+    unsigned long now = Sim::Micros() / 1000;
+    if (target > now)
+      Sim::RunFor(target - now);
+    if (!Apply(record))
+      fprintf(out, "record kind 0x%02X channel %d ignored\n", record.kind, record.channel);
+  }
+  Sim::RunFor(TAIL_MILLIS);
+  if (reader.GetError() != NULL) {
+    fprintf(out, "bad record at byte %lu: %s\n", (unsigned long)reader.GetOffset(), reader.GetError());
+    return 1;
+  }
+  if (Sim::IsReset()) {
+    fprintf(out, "watchdog reset the board\n");
+    return 1;
+  }
+  return 0;
+}
+
+// Replays each session of a trace in a forked child, as each needs the sketch's globals as they were before boot
+static int ReplayTrace(const char * path, FILE * out) {
+  TraceFile file;
+  if (!file.Open(path)) {
+    fprintf(out, "cannot open %s\n", path);
+    return 1;
+  }
+
+  // Sessions are found first, so each child gets only its own records
+  std::vector<size_t> starts;
+  TraceReader reader(file.GetData(), file.GetSize());
+  TraceRecord record;
+  size_t offset = 0;
+  while (reader.Next(&record)) {
+    if (record.kind == TRACE_START)
+      starts.push_back(offset);
+    offset = reader.GetOffset();
+  }
+  if (reader.GetError() != NULL) {
+    fprintf(out, "bad record at byte %lu: %s\n", (unsigned long)reader.GetOffset(), reader.GetError());
+    return 1;
+  }
+  if (starts.empty()) {
+    fprintf(out, "no sessions\n");
+    return 1;
+  }
+
+  int failures = 0;
+  for (size_t i = 0; i < starts.size(); i++) {
+    size_t end = i + 1 < starts.size() ? starts[i + 1] : file.GetSize();
+    fflush(out);
+    pid_t pid = fork();
+    if (pid == 0) {
+      int result = ReplaySession(file.GetData() + starts[i], end - starts[i], out);
+      fflush(out);
+      _exit(result);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failures++;
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+static std::string ReadAll(FILE * file) {
+  std::string text;
+  char buffer[4096];
+  size_t count;
+  rewind(file);
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    text.append(buffer, count);
+  return text;
+}
+
+static std::string TimelinePath(const char * tracePath) {
+  std::string path = tracePath;
+  size_t dot = path.rfind('.');
+  if (dot != std::string::npos && path.find('/', dot) == std::string::npos)
+    path.erase(dot);
+  return path + ".timeline";
+}
+
+// Prints where two timelines first part, line by line
+static void PrintDifference(const std::string & expected, const std::string & actual) {
+  size_t expectedAt = 0;
+  size_t actualAt = 0;
+  for (int line = 1; expectedAt < expected.size() || actualAt < actual.size(); line++) {
+    size_t expectedEnd = expected.find('\n', expectedAt);
+    size_t actualEnd = actual.find('\n', actualAt);
+    std::string expectedLine = expected.substr(expectedAt, expectedEnd == std::string::npos ? std::string::npos : expectedEnd - expectedAt);
+    std::string actualLine = actual.substr(actualAt, actualEnd == std::string::npos ? std::string::npos : actualEnd - actualAt);
+    if (expectedLine != actualLine || expectedAt >= expected.size() || actualAt >= actual.size()) {
+      printf("  line %d\n  expected: %s\n  replayed: %s\n", line, expectedAt < expected.size() ? expectedLine.c_str() : "(end)",
+             actualAt < actual.size() ? actualLine.c_str() : "(end)");
+      return;
+    }
+    expectedAt = expectedEnd == std::string::npos ? expected.size() : expectedEnd + 1;
+    actualAt = actualEnd == std::string::npos ? actual.size() : actualEnd + 1;
+  }
+}
+
+// Prints a trace's timeline, or checks or updates its golden file - returns false on a failure
+static bool Finish(const char * path, FILE * replayed, int result, bool isChecking, bool isUpdating) {
+  std::string actual = ReadAll(replayed);
+  std::string goldenPath = TimelinePath(path);
+  if (isUpdating) {
+    FILE * golden = fopen(goldenPath.c_str(), "w");
+    if (golden == NULL) {
+      printf("FAIL %s: cannot write %s\n", path, goldenPath.c_str());
+      return false;
+    }
+    fwrite(actual.data(), 1, actual.size(), golden);
+    fclose(golden);
+    printf("%s %s\n", result == 0 ? "UPDATED" : "UPDATED, FAILED", goldenPath.c_str());
+    return result == 0;
+  }
+
+  if (!isChecking) {
+    printf("== %s\n%s", path, actual.c_str());
+    return result == 0;
+  }
+
+  FILE * golden = fopen(goldenPath.c_str(), "r");
+  if (golden == NULL) {
+    printf("FAIL %s: no %s\n", path, goldenPath.c_str());
+    return false;
+  }
+  std::string expected = ReadAll(golden);
+  fclose(golden);
+  bool isPassed = result == 0 && expected == actual;
+  printf("%s %s\n", isPassed ? "PASS" : "FAIL", path);
+  if (!isPassed)
+    PrintDifference(expected, actual);
+  return isPassed;
+}
+
+int main(int argc, char ** argv) {
+  int jobs = 1;
+  bool isChecking = false;
+  bool isUpdating = false;
+  std::vector<const char *> paths;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+      jobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--check") == 0)
+      isChecking = true;
+    else if (strcmp(argv[i], "--update") == 0)
+      isUpdating = true;
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: TraceReplay [--jobs N] [--check | --update] trace...\n");
+      return 2;
+    } else
+      paths.push_back(argv[i]);
+  }
+  if (paths.empty() || jobs < 1 || (isChecking && isUpdating)) {
+    fprintf(stderr, "usage: TraceReplay [--jobs N] [--check | --update] trace...\n");
+    return 2;
+  }
+
+  // Each worker writes to its own temporary file, so timelines come out whole and in order whatever finishes first
+  std::vector<FILE *> outputs(paths.size());
+  std::vector<pid_t> workers(paths.size(), 0);
+  std::vector<int> results(paths.size(), 1);
+  int failures = 0;
+  size_t next = 0;
+  size_t finished = 0;
+  int running = 0;
+  while (finished < paths.size()) {
+    while (running < jobs && next < paths.size()) {
+      outputs[next] = tmpfile();
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid == 0) {
+        int result = ReplayTrace(paths[next], outputs[next]);
+        fflush(outputs[next]);
+        _exit(result == 0 ? 0 : 1);
+      }
+      workers[next++] = pid;
+      running++;
+    }
+
+    int status;
+    pid_t pid = wait(&status);
+    running--;
+    for (size_t i = finished; i < next; i++) {
+      if (workers[i] == pid) {
+        results[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        workers[i] = 0;
+      }
+    }
+    while (finished < next && workers[finished] == 0) {
+      if (!Finish(paths[finished], outputs[finished], results[finished], isChecking, isUpdating))
+        failures++;
+      fclose(outputs[finished]);
+      finished++;
+    }
+  }
+  if (isChecking)
+    printf("TraceReplay: %lu of %lu traces matched\n", (unsigned long)(paths.size() - failures), (unsigned long)paths.size());
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+/*
+  TuningSweep.cpp - Sparges a simulated brewery under the V2 sketch across a grid of pump, sensor and plant settings, on every
+  core, and writes a CSV row per scenario with how the sparge went, marking the rows on the Pareto front.
+
+    TuningSweep [--jobs N] [--out sweep.csv] [--seed N] [--wort-on ms,...] [--water-delay ms,...] [--window ms,...]
+                [--stop gal,...] [--wort-gpm gpm,...] [--water-gpm gpm,...] [--lag s,...] [--noise hPa,...]
+
+  A scenario boots the sketch, sets the wort pump's on interval, the water pump's delay, the pressure sensor's averaging
+  window and boil stop 1 in place of the build's constants, turns both pumps on and sparges until the boil stop cuts the wort
+  pump off, then lets the line drain.  The plant is a mash tun the water pump tops up and the wort pump draws from, at the
+  given gallons per minute, with its probes at fixed levels, and a boil kettle fed through a line that delivers the wort
+  the lag later, read by the pressure sensor with the given noise on top.  Each row gives the sparge time to cutoff, the
+  kettle's overshoot past the stop once drained, the pump relay cycles and the time any alarm other than the boil stop's own
+  was raised.  The front is the rows no other on the same plant beats on all four - the rest cost something for nothing -
+  and is printed too.  Each list is a comma separated set of values to try, and the grid is every combination of them.
+  Created by Tom Wallace.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <EventQueue.h>
+#include <HysteresisProbe.h>
+#include <PressureSensor.h>
+#include <VesselSettings.h>
+#include "Harness.h"
+
+// The sketch's formula for the boil kettle, so a sensor without noise reads the kettle true
+#define KETTLE_GALLONS_PER_HPA 0.4021
+#define KETTLE_EMPTY_GALLONS (0.4707 + 0.5)
+
+#define MASH_START_GALLONS 1.0  // Liquid over the grain bed, just touching the mash probe
+#define MASH_PROBE_GALLONS 1.0
+#define MASH_PROBE_HIGH_GALLONS 1.5
+#define BOIL_PROBE_GALLONS 12.0  // Above any stop, only a backstop
+#define SETTLE_MILLIS 35000  // After cutoff, for the line to drain and the sensor to settle
+#define MAX_SPARGE_MILLIS 3600000L  // A scenario that has not cut off by then is marked timed out
+#define STEP_MILLIS 100
+
+struct Scenario {
+	double wortOnMillis;
+	double waterDelayMillis;
+	double windowMillis;
+	double stopGallons;
+	double wortGpm;
+	double waterGpm;
+	double lagSeconds;
+	double noiseHpa;
+};
+
+struct Outcome {
+	bool isTimedOut;
+	double spargeSeconds;
+	double overshootGallons;
+	unsigned long relayCycles;
+	double alarmSeconds;
+	double readingGallons;  // What the sensor made of the kettle at the end
+	bool isOnFront;
+};
+
+// The plant, for the scenario the process is running
+static Scenario plant;
+static double mashGallons;
+static double kettleGallons;
+static std::vector<double> line;  // Wort drawn each ms, delivered a lag later
+static size_t lineHead;
+static unsigned long relayCycles;
+static unsigned long alarmMillis;
+static uint32_t noiseState;
+
+static const char * const ALARM_EVENTS[] = {"MashProbeHigh", "DryRun", "LoopStall"};
+
+// Uniform in -1..1, the same for every run of a scenario
+static double Noise() {
+  noiseState = noiseState * 1664525 + 1013904223;
+  return (noiseState >> 8) / (double)(1 << 23) - 1;
+}
+
+static void SetProbe(int wiredTo, bool isTouching) {
+  Sim::SetInput(Harness::GetPin(wiredTo), isTouching ? HIGH : LOW);
+}
+
+static void RunPlant(void * context, unsigned long currentMillis) {
+  if (Sim::GetLevel(Harness::GetPin(SKETCH_WATER_PUMP)) == HIGH)
+    mashGallons += plant.waterGpm / 60000;
+  double drawn = 0;
+  if (Sim::GetLevel(Harness::GetPin(SKETCH_WORT_PUMP)) == HIGH)
+    drawn = std::min(plant.wortGpm / 60000, mashGallons);
+  mashGallons -= drawn;
+  if (line.empty()) {
+    kettleGallons += drawn;
+  } else {
+    kettleGallons += line[lineHead];
+    line[lineHead] = drawn;
+    lineHead = (lineHead + 1) % line.size();
+  }
+
+  SetProbe(SKETCH_MASH_PROBE, mashGallons >= MASH_PROBE_GALLONS);
+  SetProbe(SKETCH_MASH_PROBE_HIGH, mashGallons >= MASH_PROBE_HIGH_GALLONS);
+  SetProbe(SKETCH_BOIL_PROBE, kettleGallons >= BOIL_PROBE_GALLONS);
+  double hpa = (kettleGallons - KETTLE_EMPTY_GALLONS) / KETTLE_GALLONS_PER_HPA;
+  Harness::SetPressure(std::max(hpa, 0.0) + plant.noiseHpa * Noise());
+
+  // Events only change in the loop, so every 10 ms is close enough
+  if (currentMillis % 10 == 0) {
+    for (size_t i = 0; i < sizeof(ALARM_EVENTS) / sizeof(ALARM_EVENTS[0]); i++) {
+      if (Sketch::GetAlarmQueue()->HasEvent(ALARM_EVENTS[i])) {
+        alarmMillis += 10;
+        break;
+      }
+    }
+  }
+}
+
+static void CountRelays(void * context, uint8_t pin, uint8_t level) {
+  if (level == HIGH && (pin == Harness::GetPin(SKETCH_WATER_PUMP) || pin == Harness::GetPin(SKETCH_WORT_PUMP)))
+    relayCycles++;
+}
+
+// Runs in a forked child, as each scenario needs the sketch as it was before boot
+static Outcome RunScenario(const Scenario & scenario, uint32_t seed) {
+  plant = scenario;
+  mashGallons = MASH_START_GALLONS;
+  kettleGallons = KETTLE_EMPTY_GALLONS;
+  line.assign((size_t)(scenario.lagSeconds * 1000), 0);
+  noiseState = seed;
+
+  Harness::SetPressure(0);
+  Harness::Boot(SKETCH_V2_MODE);
+  Sketch::SetPumpTiming(SKETCH_WATER_PUMP_INDEX, (long)scenario.waterDelayMillis);
+  Sketch::SetPumpTiming(SKETCH_WORT_PUMP_INDEX, (long)scenario.wortOnMillis);
+  Sketch::GetBoilPressureSensor()->SetAverageWindow((long)scenario.windowMillis);
+  Sketch::GetBoilKettle()->atStopOne = true;
+  Sketch::GetBoilKettle()->stopOne = scenario.stopGallons;
+  SetProbe(SKETCH_MASH_PROBE, true);
+  Sim::SetTickHook(RunPlant, NULL);
+  Sim::SetPinHook(CountRelays, NULL);
+
+  // The boil stop holds the wort pump off until the sensor has found its zero
+  while ((!Sketch::GetBoilPressureSensor()->IsConnected() || Sketch::GetBoilStop()->IsTouching()) && !Sim::IsReset())
+    Sim::RunFor(STEP_MILLIS);
+  Harness::PressButton(SKETCH_LEFT_BUTTON, 150);
+  Harness::PressButton(SKETCH_RIGHT_BUTTON, 150);
+  uint64_t startMicros = Sim::Micros();
+  relayCycles = 0;
+  alarmMillis = 0;
+
+  Outcome outcome;
+  memset(&outcome, 0, sizeof(outcome));
+  uint64_t cutoffMicros = 0;
+  while (!Sim::IsReset()) {
+    Sim::RunFor(STEP_MILLIS);
+    uint64_t elapsedMillis = (Sim::Micros() - startMicros) / 1000;
+    if (cutoffMicros == 0 && Sketch::GetBoilStop()->IsTouching())
+      cutoffMicros = Sim::Micros();
+    if (cutoffMicros != 0 && Sim::Micros() - cutoffMicros >= SETTLE_MILLIS * 1000ULL)
+      break;
+    if (cutoffMicros == 0 && elapsedMillis >= MAX_SPARGE_MILLIS) {
+      outcome.isTimedOut = true;
+      break;
+    }
+  }
+  outcome.isTimedOut = outcome.isTimedOut || Sim::IsReset();
+  outcome.spargeSeconds = cutoffMicros == 0 ? 0 : (cutoffMicros - startMicros) / 1e6;
+  outcome.overshootGallons = kettleGallons - scenario.stopGallons;
+  outcome.relayCycles = relayCycles;
+  outcome.alarmSeconds = alarmMillis / 1000.0;
+  outcome.readingGallons = Sketch::GetBoilPressureSensor()->GetGallons();
+  return outcome;
+}
+
+// The front
+static bool Dominates(const Outcome & a, const Outcome & b) {
+  double aOver = fabs(a.overshootGallons);
+  double bOver = fabs(b.overshootGallons);
+  bool isNoWorse = a.spargeSeconds <= b.spargeSeconds && aOver <= bOver && a.relayCycles <= b.relayCycles && a.alarmSeconds <= b.alarmSeconds;
+  bool isBetter = a.spargeSeconds < b.spargeSeconds || aOver < bOver || a.relayCycles < b.relayCycles || a.alarmSeconds < b.alarmSeconds;
+  return isNoWorse && isBetter;
+}
+
+// The brewery is not ours to pick, so scenarios only compete with others on the same plant
+static bool IsSamePlant(const Scenario & a, const Scenario & b) {
+  return a.wortGpm == b.wortGpm && a.waterGpm == b.waterGpm && a.lagSeconds == b.lagSeconds && a.noiseHpa == b.noiseHpa;
+}
+
+static void MarkFront(const std::vector<Scenario> & grid, std::vector<Outcome> & outcomes) {
+  for (size_t i = 0; i < outcomes.size(); i++) {
+    outcomes[i].isOnFront = !outcomes[i].isTimedOut;
+    for (size_t j = 0; j < outcomes.size() && outcomes[i].isOnFront; j++) {
+      if (j != i && !outcomes[j].isTimedOut && IsSamePlant(grid[i], grid[j]) && Dominates(outcomes[j], outcomes[i]))
+        outcomes[i].isOnFront = false;
+    }
+  }
+}
+
+static void PrintRow(FILE * out, const Scenario & scenario, const Outcome & outcome) {
+  fprintf(out, "%.0f,%.0f,%.0f,%.2f,%.2f,%.2f,%.2f,%.3f,", scenario.wortOnMillis, scenario.waterDelayMillis, scenario.windowMillis,
+          scenario.stopGallons, scenario.wortGpm, scenario.waterGpm, scenario.lagSeconds, scenario.noiseHpa);
+  if (outcome.isTimedOut)
+    fprintf(out, ",,,,,0,1\n");
+  else
+    fprintf(out, "%.1f,%.3f,%lu,%.1f,%.3f,%d,0\n", outcome.spargeSeconds, outcome.overshootGallons, outcome.relayCycles,
+            outcome.alarmSeconds, outcome.readingGallons, outcome.isOnFront ? 1 : 0);
+}
+
+static const char * HEADER = "wort_on_ms,water_delay_ms,window_ms,stop_gal,wort_gpm,water_gpm,lag_s,noise_hpa,"
+                             "sparge_s,overshoot_gal,relay_cycles,alarm_s,reading_gal,pareto,timed_out\n";
+
+// The grid
+static bool ParseList(const char * text, std::vector<double> * values) {
+  values->clear();
+  char * end;
+  do {
+    values->push_back(strtod(text, &end));
+    if (end == text)
+      return false;
+    text = end + 1;
+  } while (*end == ',');
+  return *end == 0;
+}
+
+// The plant's lists come last and vary slowest, so each plant's scenarios sit together
+static std::vector<Scenario> BuildGrid(std::vector<double> * lists) {
+  std::vector<Scenario> grid;
+  size_t count = 1;
+  for (int i = 0; i < 8; i++)
+    count *= lists[i].size();
+  for (size_t index = 0; index < count; index++) {
+    double values[8];
+    size_t rest = index;
+    for (int i = 0; i < 8; i++) {
+      values[i] = lists[i][rest % lists[i].size()];
+      rest /= lists[i].size();
+    }
+    Scenario scenario = {values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]};
+    grid.push_back(scenario);
+  }
+  return grid;
+}
+
+static int Usage() {
+  fprintf(stderr, "usage: TuningSweep [--jobs N] [--out sweep.csv] [--seed N] [--wort-on ms,...] [--water-delay ms,...]\n"
+                  "                   [--window ms,...] [--stop gal,...] [--wort-gpm gpm,...] [--water-gpm gpm,...] [--lag s,...]\n"
+                  "                   [--noise hPa,...]\n");
+  return 2;
+}
+
+int main(int argc, char ** argv) {
+  static const char * const OPTIONS[8] = {"--wort-on", "--water-delay", "--window", "--stop", "--wort-gpm", "--water-gpm", "--lag", "--noise"};
+  static const char * const DEFAULTS[8] = {"1000,2000,4000", "5000,10000,20000", "1000,2000,4000", "4", "10,20", "4", "1,3", "0.05"};
+  std::vector<double> lists[8];
+  for (int i = 0; i < 8; i++)
+    ParseList(DEFAULTS[i], &lists[i]);
+
+  int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  const char * outPath = NULL;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    int option = 0;
+    while (option < 8 && strcmp(argv[i], OPTIONS[option]) != 0)
+      option++;
+    if (option < 8 && i + 1 < argc) {
+      if (!ParseList(argv[++i], &lists[option]))
+        return Usage();
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+      jobs = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+      outPath = argv[++i];
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = strtoul(argv[++i], NULL, 10);
+    else
+      return Usage();
+  }
+  if (jobs < 1)
+    return Usage();
+
+  // Each scenario writes its outcome to its own temporary file, read back once every one has finished
+  std::vector<Scenario> grid = BuildGrid(lists);
+  std::vector<Outcome> outcomes(grid.size());
+  std::vector<FILE *> outputs(grid.size());
+  int running = 0;
+  size_t next = 0;
+  while (next < grid.size() || running > 0) {
+    while (running < jobs && next < grid.size()) {
+      outputs[next] = tmpfile();
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid == 0) {
+        Outcome outcome = RunScenario(grid[next], seed + next);
+        fwrite(&outcome, sizeof(outcome), 1, outputs[next]);
+        fflush(outputs[next]);
+        _exit(0);
+      }
+      next++;
+      running++;
+    }
+    int status;
+    wait(&status);
+    running--;
+  }
+
+  int timedOut = 0;
+  for (size_t i = 0; i < grid.size(); i++) {
+    rewind(outputs[i]);
+    if (fread(&outcomes[i], sizeof(outcomes[i]), 1, outputs[i]) != 1) {
+      memset(&outcomes[i], 0, sizeof(outcomes[i]));
+      outcomes[i].isTimedOut = true;
+    }
+    fclose(outputs[i]);
+    if (outcomes[i].isTimedOut)
+      timedOut++;
+  }
+  MarkFront(grid, outcomes);
+
+  if (outPath != NULL) {
+    FILE * out = fopen(outPath, "w");
+    if (out == NULL) {
+      fprintf(stderr, "TuningSweep: cannot write %s\n", outPath);
+      return 1;
+    }
+    fputs(HEADER, out);
+    for (size_t i = 0; i < grid.size(); i++)
+      PrintRow(out, grid[i], outcomes[i]);
+    if (fclose(out) != 0) {
+      fprintf(stderr, "TuningSweep: cannot write %s\n", outPath);
+      return 1;
+    }
+  }
+
+  // The front, a plant at a time in grid order, quickest sparge first
+  std::vector<size_t> front;
+  for (size_t i = 0; i < grid.size(); i++) {
+    if (outcomes[i].isOnFront)
+      front.push_back(i);
+  }
+  for (size_t i = 1; i < front.size(); i++) {
+    for (size_t j = i; j > 0 && IsSamePlant(grid[front[j]], grid[front[j - 1]])
+                       && outcomes[front[j]].spargeSeconds < outcomes[front[j - 1]].spargeSeconds; j--)
+      std::swap(front[j], front[j - 1]);
+  }
+  fputs(HEADER, stdout);
+  for (size_t i = 0; i < front.size(); i++)
+    PrintRow(stdout, grid[front[i]], outcomes[front[i]]);
+  fprintf(stderr, "TuningSweep: %lu scenarios, %lu on the Pareto front, %d timed out\n", (unsigned long)grid.size(),
+          (unsigned long)front.size(), timedOut);
+  return 0;
+}
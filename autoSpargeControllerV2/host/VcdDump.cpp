@@ -0,0 +1,226 @@
+/*
+  VcdDump.cpp - Runs the sketch on the simulated board through a stimulus script and writes what it did as a VCD waveform, to
+  view in GTKWave.
+
+    VcdDump [--out brew.vcd] [--stages] script.stim
+
+  The pins are the same as the DUMP_VCD build streams from the board, but each change is stamped with the simulated µs it
+  happened at rather than sampled once a loop, so a pump turning on can be lined up with the probe edge that caused it.  The
+  sketch's own state - the alarm queue, whether each pump thinks it is pumping and, in V2 mode, the boil kettle's gallons and
+  the selected menu - is sampled every simulated millisecond.  --stages adds the loop stage the sketch is in, from the
+  micros() read each stage mark makes, with 255 between loops; it changes several times a loop so makes for a large file.
+  Created by Tom Wallace.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <EventQueue.h>
+#include <IPump.h>
+#include <LoopWatchdog.h>
+#include <PressureSensor.h>
+#include "Harness.h"
+#include "StimulusScript.h"
+
+#define VCD_WIRE 0
+#define VCD_INTEGER 1
+#define VCD_REAL 2
+#define VCD_INTEGER_WIDTH 8
+#define MAX_VCD_SIGNALS 24
+
+struct VcdPin {
+	const char * name;
+	int wiredTo;
+};
+
+static const VcdPin PINS[] = {
+  {"water_pump", SKETCH_WATER_PUMP},
+  {"wort_pump", SKETCH_WORT_PUMP},
+  {"left_light", SKETCH_LEFT_LIGHT},
+  {"right_light", SKETCH_RIGHT_LIGHT},
+  {"alarm", SKETCH_ALARM},
+  {"buzzer", SKETCH_BUZZER},
+  {"mash_probe", SKETCH_MASH_PROBE},
+  {"mash_probe_high", SKETCH_MASH_PROBE_HIGH},
+  {"boil_probe", SKETCH_BOIL_PROBE},
+  {"left_button_n", SKETCH_LEFT_BUTTON},
+  {"right_button_n", SKETCH_RIGHT_BUTTON},
+};
+#define NUM_PINS (int)(sizeof(PINS) / sizeof(PINS[0]))
+
+typedef double (* VcdRead)();
+
+struct VcdSignal {
+	const char * name;
+	uint8_t kind;
+	uint8_t pin;  // For the pins, which the pin hook reports by number
+	VcdRead read;  // For the sketch's state, sampled each millisecond
+	double value;
+};
+
+static FILE * out;
+static VcdSignal signals[MAX_VCD_SIGNALS];
+static int numSignals;
+static int stageSignal = -1;
+static uint64_t printedMicros;
+static StimulusScript script;
+
+static double ReadAlarmQueue() { return Sketch::GetAlarmQueue()->IsPopulated(); }
+static double ReadWaterPumping() { return Sketch::GetPump(SKETCH_WATER_PUMP_INDEX)->IsPumping(); }
+static double ReadWortPumping() { return Sketch::GetPump(SKETCH_WORT_PUMP_INDEX)->IsPumping(); }
+static double ReadBoilGallons() { return Sketch::GetBoilPressureSensor()->GetGallons(); }
+static double ReadSelectedMenu() { return Sketch::GetSelectedMenu(); }
+
+static void Add(const char * name, uint8_t kind, uint8_t pin, VcdRead read) {
+  VcdSignal signal = {name, kind, pin, read, 0};
+  signals[numSignals++] = signal;
+}
+
+// Each signal's id is a single printable character, as the board's writer does
+static void PrintValue(int index) {
+  char id = '!' + index;
+  const VcdSignal & signal = signals[index];
+  if (signal.kind == VCD_REAL) {
+    fprintf(out, "r%.3f %c\n", signal.value, id);
+  } else if (signal.kind == VCD_INTEGER) {
+    fputc('b', out);
+    for (int bit = VCD_INTEGER_WIDTH - 1; bit >= 0; bit--)
+      fputc(((int)signal.value >> bit) & 1 ? '1' : '0', out);
+    fprintf(out, " %c\n", id);
+  } else {
+    fprintf(out, "%c%c\n", signal.value != 0 ? '1' : '0', id);
+  }
+}
+
+static void Change(int index, double value) {
+  if (value == signals[index].value)
+    return;
+  uint64_t now = Sim::Micros();
+  if (now != printedMicros) {
+    fprintf(out, "#%llu\n", (unsigned long long)now);
+    printedMicros = now;
+  }
+  signals[index].value = value;
+  PrintValue(index);
+}
+
+static void WatchPin(void * context, uint8_t pin, uint8_t level) {
+  for (int i = 0; i < numSignals; i++) {
+    if (signals[i].read == NULL && i != stageSignal && signals[i].pin == pin)
+      Change(i, level == HIGH ? 1 : 0);
+  }
+}
+
+static void SampleState(void * context, unsigned long currentMillis) {
+  for (int i = 0; i < numSignals; i++) {
+    if (signals[i].read != NULL)
+      Change(i, signals[i].read());
+  }
+}
+
+// Stage marks the new stage just after its micros() read, so the change shows on the next read, and is stamped with the last -
+// unless something has been printed since, as time in the file only goes forward
+static uint64_t lastRead;
+static void WatchMicros(void * context, uint64_t micros) {
+  if (Sketch::GetStage() != (int)signals[stageSignal].value) {
+    if (lastRead > printedMicros) {
+      fprintf(out, "#%llu\n", (unsigned long long)lastRead);
+      printedMicros = lastRead;
+    }
+    signals[stageSignal].value = Sketch::GetStage();
+    PrintValue(stageSignal);
+  }
+  lastRead = micros;
+}
+
+static void Begin() {
+  fprintf(out, "$timescale 1us $end\n$scope module autoSparge $end\n");
+  for (int i = 0; i < numSignals; i++) {
+    const char * type = signals[i].kind == VCD_REAL ? "real 64" : signals[i].kind == VCD_INTEGER ? "integer 8" : "wire 1";
+    fprintf(out, "$var %s %c %s $end\n", type, '!' + i, signals[i].name);
+  }
+  fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+
+  printedMicros = Sim::Micros();
+  lastRead = printedMicros;
+  fprintf(out, "#%llu\n$dumpvars\n", (unsigned long long)printedMicros);
+  for (int i = 0; i < numSignals; i++) {
+    if (i == stageSignal)
+      signals[i].value = Sketch::GetStage();
+    else if (signals[i].read != NULL)
+      signals[i].value = signals[i].read();
+    else
+      signals[i].value = Sim::GetLevel(signals[i].pin) == HIGH ? 1 : 0;
+    PrintValue(i);
+  }
+  fprintf(out, "$end\n");
+}
+
+static void RunLoops(void * context, unsigned long untilMillis) {
+  while (Sim::Micros() / 1000 < untilMillis && !Sim::IsReset())
+    Sim::RunLoop();
+}
+
+static int Usage() {
+  fprintf(stderr, "usage: VcdDump [--out brew.vcd] [--stages] script.stim\n");
+  return 2;
+}
+
+int main(int argc, char ** argv) {
+  const char * outPath = NULL;
+  const char * scriptPath = NULL;
+  bool hasStages = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+      outPath = argv[++i];
+    else if (strcmp(argv[i], "--stages") == 0)
+      hasStages = true;
+    else if (argv[i][0] == '-' || scriptPath != NULL)
+      return Usage();
+    else
+      scriptPath = argv[i];
+  }
+  if (scriptPath == NULL)
+    return Usage();
+  if (!script.Read(scriptPath))
+    return 1;
+  out = outPath != NULL ? fopen(outPath, "w") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "VcdDump: cannot write %s\n", outPath);
+    return 1;
+  }
+
+  Harness::Boot(script.GetBootMode());
+  for (int i = 0; i < NUM_PINS; i++)
+    Add(PINS[i].name, VCD_WIRE, Harness::GetPin(PINS[i].wiredTo), NULL);
+  Add("alarm_queue_populated", VCD_WIRE, 0, ReadAlarmQueue);
+  Add("water_pumping", VCD_WIRE, 0, ReadWaterPumping);
+  Add("wort_pumping", VCD_WIRE, 0, ReadWortPumping);
+  if (Sketch::GetMode() == SKETCH_V2_MODE) {
+    Add("boil_gallons", VCD_REAL, 0, ReadBoilGallons);
+    Add("selected_menu", VCD_INTEGER, 0, ReadSelectedMenu);
+  }
+  if (hasStages) {
+    stageSignal = numSignals;
+    Add("loop_stage", VCD_INTEGER, 0, NULL);
+  }
+
+  Begin();
+  Sim::SetPinHook(WatchPin, NULL);
+  Sim::SetTickHook(SampleState, NULL);
+  if (hasStages)
+    Sim::SetMicrosHook(WatchMicros, NULL);
+  bool isRun = script.Run(RunLoops, NULL);
+  Sim::SetMicrosHook(NULL, NULL);
+  Sim::SetTickHook(NULL, NULL);
+  Sim::SetPinHook(NULL, NULL);
+
+  if (out != stdout && fclose(out) != 0) {
+    fprintf(stderr, "VcdDump: cannot write %s\n", outPath);
+    return 1;
+  }
+  if (Sim::IsReset()) {
+    fprintf(stderr, "VcdDump: watchdog reset the board\n");
+    return 1;
+  }
+  return isRun ? 0 : 1;
+}
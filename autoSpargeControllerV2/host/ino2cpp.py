@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""
+ino2cpp.py - Turns the sketch into a C++ file for the host build, the way the Arduino builder does - Arduino.h first and a
+prototype for each function after the includes - then appends SketchAccess.inc so the harnesses can reach the sketch's globals.
+Options uncomment a //#define line or change a #define's value, to build variants such as DUMP_VCD without editing the sketch,
+and --bare leaves SketchAccess.inc off, for an image that keeps only what the board's would.
+Created by Tom Wallace.
+
+usage: ino2cpp.py <sketch.ino> <out.cpp> [-D NAME] [-S NAME=VALUE] [--bare]
+"""
+import argparse
+import re
+import sys
+
+parser = argparse.ArgumentParser()
+parser.add_argument('sketch')
+parser.add_argument('out')
+parser.add_argument('-D', dest='defines', action='append', default=[], help='uncomment //#define NAME')
+parser.add_argument('-S', dest='settings', action='append', default=[], help='set #define NAME VALUE')
+parser.add_argument('--bare', action='store_true', help='leave out SketchAccess.inc')
+args = parser.parse_args()
+
+source = open(args.sketch).read()
+for name in args.defines:
+    source, count = re.subn(r'^//#define %s\b' % re.escape(name), '#define %s' % name, source, flags=re.M)
+    if count == 0:
+        sys.exit('ino2cpp: no //#define %s in %s' % (name, args.sketch))
+for setting in args.settings:
+    name, value = setting.split('=', 1)
+    source, count = re.subn(r'^#define %s\b.*?(\s*//.*)?$' % re.escape(name), r'#define %s %s\1' % (name, value), source, flags=re.M)
+    if count == 0:
+        sys.exit('ino2cpp: no #define %s in %s' % (name, args.sketch))
+
+lines = source.split('\n')
+last_include = 0
+for i, line in enumerate(lines):
+    if line.startswith('#include'):
+        last_include = i + 1
+    elif line.strip() != '':
+        break
+
+prototypes = []
+for match in re.finditer(r'^((?:unsigned |static )?[A-Za-z_][\w<>]*\s*\*?\s+\**([A-Za-z_]\w*)\([^;{)]*\))\s*\{', source, re.M):
+    if match.group(2) not in ('if', 'while', 'for', 'switch', 'setup', 'loop'):
+        prototypes.append(match.group(1) + ';')
+
+with open(args.out, 'w') as out:
+    out.write('#include "Arduino.h"\n')
+    out.write('#line 1 "%s"\n' % args.sketch)
+    out.write('\n'.join(lines[:last_include]) + '\n')
+    out.write('\n'.join(prototypes) + '\n')
+    out.write('#line %d "%s"\n' % (last_include + 1, args.sketch))
+    out.write('\n'.join(lines[last_include:]) + '\n')
+    if not args.bare:
+        out.write('#include "SketchAccess.inc"\n')
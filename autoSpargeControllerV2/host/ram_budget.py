@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""
+ram_budget.py - Estimates the RAM the sketch's statics take on the ATmega328, from the host build's objects, and fails when
+they leave less than the stack and heap need out of its 2048 bytes.  The board's own figure is avr-size's, but the host
+build runs where there is no AVR toolchain, and a build that links but has no RAM left does not say so - it resets or
+corrupts its variables at run time - where one over the flash fails to link.
+
+Each variable in .data, .bss or .rodata - on the AVR .rodata is copied to RAM like .data - is laid out again from the
+object's debug info with the AVR's sizes: two byte int and pointers, four byte double, and no padding, as avr-gcc aligns
+nothing.  PROGMEM data, which the stubs put in .progmem.data as avr-gcc does, stays in flash and is left out.  Vtables
+are counted a pointer to the entry, and string literals - those not in F() - byte for byte.  What has no
+debug info is counted at its host size, so the total is if anything high.  The core's own statics - Serial's buffers
+and the millis() counter - are CORE_RAM, and Wire's, with the other libraries', LIBRARY_RAM, as neither is built here.
+Only what the linker kept, by the map of an image linked with --gc-sections, is counted, as on the board.
+Created by Tom Wallace.
+
+usage: ram_budget.py [--budget BYTES] [--list] <image.map> <object>... [--types <object>...]
+"""
+import argparse
+import re
+import subprocess
+import sys
+
+RAM_SIZE = 2048
+CORE_RAM = 200  # Serial - its two 64 byte rings, registers and vtable - the millis() and micros() counters, malloc's state
+LIBRARY_RAM = 265  # Wire's two 32 byte buffers and the twi driver's three, their state and vtable, and what the LCD shield's
+                   # object takes over its stub's
+
+# Typeinfo and the exception personality, which avr-gcc leaves out as it builds with -fno-rtti and -fno-exceptions, and
+# the table the stub CRC runs from, where avr-libc's is a loop
+HOST_ONLY = r'_ZTI|_ZTS|DW\.ref\.__gxx_personality|_ZZ13_crc16_update|_ZGVZ13_crc16_update'
+
+AVR_POINTER = 2
+AVR_BASE_SIZES = {
+    'char': 1, 'signed char': 1, 'unsigned char': 1, 'bool': 1,
+    'short int': 2, 'short unsigned int': 2, 'int': 2, 'unsigned int': 2, 'wchar_t': 2, 'char16_t': 2,
+    'long int': 4, 'long unsigned int': 4, 'char32_t': 4,
+    'long long int': 8, 'long long unsigned int': 8,
+    'float': 4, 'double': 4, 'long double': 4,
+}
+
+parser = argparse.ArgumentParser()
+parser.add_argument('map', help='the linker\'s map of the image the objects were linked into with --gc-sections')
+parser.add_argument('objects', nargs='+')
+parser.add_argument('--budget', type=int, help='fail when the statics, core and libraries leave fewer bytes than this')
+parser.add_argument('--types', nargs='*', default=[], help='objects to read only class definitions from, such as the simulator\'s')
+parser.add_argument('--list', action='store_true', help='list each variable with its host and AVR size')
+args = parser.parse_args()
+
+
+def run(*command):
+    return subprocess.run(command, check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+
+DIE = re.compile(r'^\s*<(\d+)><([0-9a-f]+)>: Abbrev Number: \d+ \((\w+)\)')
+ATTRIBUTE = re.compile(r'^\s*<[0-9a-f]+>\s+(DW_AT_\w+)\s*:\s*(.*)$')
+
+
+def read_dies(path):
+    """Returns each debug info entry by offset, as (tag, attributes, children)"""
+    dies = {}
+    stack = []
+    current = None
+    for line in run('readelf', '--debug-dump=info', path).split('\n'):
+        match = DIE.match(line)
+        if match:
+            depth, offset, tag = int(match.group(1)), int(match.group(2), 16), match.group(3)
+            current = (tag, {}, [])
+            dies[offset] = current
+            del stack[depth:]
+            if stack:
+                stack[-1][2].append(current)
+            stack.append(current)
+            continue
+        match = ATTRIBUTE.match(line)
+        if match and current is not None:
+            value = match.group(2).strip()
+            if value.startswith('(indirect'):
+                value = value.split('): ', 1)[1]
+            current[1][match.group(1)] = value
+    return dies
+
+
+def reference(value):
+    match = re.match(r'<0x([0-9a-f]+)>', value)
+    return int(match.group(1), 16) if match else None
+
+
+def number(value):
+    match = re.match(r'(-?\d+)', value)
+    return int(match.group(1)) if match else None
+
+
+def avr_size(dies, offset, seen=()):
+    """The size a type takes on the AVR, or None where it cannot tell"""
+    if offset is None or offset in seen or offset not in dies:
+        return None
+    tag, attributes, children = dies[offset]
+    seen = seen + (offset,)
+    if tag == 'DW_TAG_base_type':
+        return AVR_BASE_SIZES.get(attributes.get('DW_AT_name'))
+    if tag in ('DW_TAG_pointer_type', 'DW_TAG_reference_type', 'DW_TAG_rvalue_reference_type'):
+        return AVR_POINTER
+    if tag == 'DW_TAG_ptr_to_member_type':
+        pointee = dies.get(reference(attributes.get('DW_AT_type', '')))
+        return AVR_POINTER * 2 if pointee is not None and pointee[0] == 'DW_TAG_subroutine_type' else AVR_POINTER
+    if tag in ('DW_TAG_typedef', 'DW_TAG_const_type', 'DW_TAG_volatile_type'):
+        return avr_size(dies, reference(attributes.get('DW_AT_type', '')), seen)
+    if tag == 'DW_TAG_enumeration_type':
+        if 'DW_AT_type' in attributes and 'DW_AT_enum_class' in attributes:
+            return avr_size(dies, reference(attributes['DW_AT_type']), seen)
+        return AVR_BASE_SIZES['int']
+    if tag == 'DW_TAG_array_type':
+        size = avr_size(dies, reference(attributes.get('DW_AT_type', '')), seen)
+        for child in children:
+            if child[0] != 'DW_TAG_subrange_type' or size is None:
+                continue
+            if 'DW_AT_count' in child[1]:
+                size *= number(child[1]['DW_AT_count'])
+            elif 'DW_AT_upper_bound' in child[1]:
+                size *= number(child[1]['DW_AT_upper_bound']) + 1
+            else:
+                return None
+        return size
+    if tag in ('DW_TAG_structure_type', 'DW_TAG_class_type', 'DW_TAG_union_type'):
+        if 'DW_AT_declaration' in attributes:
+            # Defined in full only where its vtable is, which may be another object
+            definition = classes.get(attributes.get('DW_AT_name'))
+            return avr_size(*definition) if definition is not None and definition[0] is not dies else None
+        sizes = []
+        bits = 0
+        for child in children:
+            if child[0] not in ('DW_TAG_member', 'DW_TAG_inheritance') or 'DW_AT_declaration' in child[1]:
+                continue
+            if 'DW_AT_bit_size' in child[1]:
+                bits += number(child[1]['DW_AT_bit_size'])
+                continue
+            size = avr_size(dies, reference(child[1].get('DW_AT_type', '')), seen)
+            if size is None:
+                return None
+            base = dies[reference(child[1]['DW_AT_type'])]
+            if child[0] == 'DW_TAG_inheritance' and number(base[1].get('DW_AT_byte_size', '0')) == 1 and not base[2]:
+                size = 0  # An empty base takes no room
+            sizes.append(size)
+        sizes.append((bits + 7) // 8)
+        size = max(sizes) if tag == 'DW_TAG_union_type' else sum(sizes)
+        return max(size, 1)
+    return None
+
+
+def class_definitions(dies):
+    """Maps the name of each class the object defines in full to (dies, offset)"""
+    return dict((attributes['DW_AT_name'], (dies, offset)) for offset, (tag, attributes, children) in dies.items()
+                if tag in ('DW_TAG_structure_type', 'DW_TAG_class_type') and 'DW_AT_name' in attributes
+                and 'DW_AT_declaration' not in attributes)
+
+
+def variable_types(dies):
+    """Maps each variable defined in the object, by both its name and linkage name, to its type"""
+    types = {}
+    for tag, attributes, children in dies.values():
+        if tag != 'DW_TAG_variable' or 'DW_OP_addr' not in attributes.get('DW_AT_location', ''):
+            continue
+        names = [attributes.get('DW_AT_name'), attributes.get('DW_AT_linkage_name')]
+        declaration = attributes
+        if 'DW_AT_specification' in attributes:
+            declaration = dies[reference(attributes['DW_AT_specification'])][1]
+            names += [declaration.get('DW_AT_name'), declaration.get('DW_AT_linkage_name')]
+        type = reference(declaration.get('DW_AT_type', attributes.get('DW_AT_type', '')))
+        for name in names:
+            if name is not None:
+                types.setdefault(name, type)
+    return types
+
+
+def sections(path):
+    result = {}
+    for line in run('readelf', '--section-headers', '--wide', path).split('\n'):
+        match = re.match(r'\s*\[\s*(\d+)\]\s+(\S+)\s+\S+\s+[0-9a-f]+\s+[0-9a-f]+\s+([0-9a-f]+)', line)
+        if match:
+            result[int(match.group(1))] = (match.group(2), int(match.group(3), 16))
+    return result
+
+
+def is_ram(section):
+    if section.startswith('.progmem') or section.startswith('.rodata.cst'):
+        return False  # Flash, and the x86's own constants for floating point, which the AVR loads as immediates
+    return re.match(r'\.(data|bss|rodata|noinit)\b', section) is not None
+
+
+def kept_sections(map_path):
+    """Returns the (object, section) pairs the linker kept, with each one's size, from its map"""
+    kept = {}
+    lines = open(map_path).read().split('Linker script and memory map', 1)[-1].split('\n')
+    for i, line in enumerate(lines):
+        match = re.match(r'^ (\.\S+)(?:\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+))?\s*$', line)
+        if match is None:
+            continue
+        size, path = match.group(2), match.group(3)
+        if size is None and i + 1 < len(lines):
+            following = re.match(r'^\s+0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S+)\s*$', lines[i + 1])
+            if following is None:
+                continue
+            size, path = following.groups()
+        if size is not None:
+            kept[(path, match.group(1))] = kept.get((path, match.group(1)), 0) + int(size, 16)
+    return kept
+
+
+def demangle(name):
+    return run('c++filt', name).strip()
+
+
+debug_info = dict((path, read_dies(path)) for path in args.objects + args.types)
+classes = {}
+for dies in debug_info.values():
+    classes.update(class_definitions(dies))
+
+kept = kept_sections(args.map)
+code = sum(size for (path, section), size in kept.items() if path in args.objects and section.startswith('.text'))
+
+rows = []  # (object, name, host bytes, AVR bytes)
+seen = set()
+for path in args.objects:
+    dies = debug_info[path]
+    types = variable_types(dies)
+    headers = sections(path)
+    counted = set()
+    for line in run('readelf', '--syms', '--wide', path).split('\n'):
+        fields = line.split()
+        if len(fields) < 8 or fields[3] != 'OBJECT' or not fields[6].isdigit():
+            continue
+        size, binding, index, name = int(fields[2]), fields[4], int(fields[6]), fields[7]
+        section = headers.get(index, ('', 0))[0]
+        if not is_ram(section) or size == 0 or (path, section) not in kept:
+            continue
+        counted.add(index)
+        if binding != 'LOCAL':
+            if name in seen:
+                continue  # An inline variable, vtable or typeinfo another object already has
+            seen.add(name)
+        if re.match(HOST_ONLY, name):
+            continue
+        bare = re.sub(r'^_ZL\d+', '', name)
+        if name.startswith('_ZTV'):
+            avr = size // 8 * AVR_POINTER
+        else:
+            avr = avr_size(dies, types.get(name, types.get(bare)))
+            if avr is None:
+                avr = size
+        rows.append((path, demangle(name), size, avr))
+    # String literals have no symbols, and are only ever smaller on the AVR than the section they were merged into here
+    for index, (section, size) in headers.items():
+        if section.startswith('.rodata.str') and index not in counted and (path, section) in kept:
+            rows.append((path, 'string literals', size, size))
+
+statics = sum(row[3] for row in rows)
+if args.list:
+    for path, name, host, avr in sorted(rows, key=lambda row: -row[3]):
+        print('%6d %6d  %s  %s' % (host, avr, name, path))
+free = RAM_SIZE - statics - CORE_RAM - LIBRARY_RAM
+print('ram_budget: statics %d bytes, core %d, libraries %d - %d of %d bytes left for the stack and heap, %d bytes of host code' %
+      (statics, CORE_RAM, LIBRARY_RAM, free, RAM_SIZE, code))
+if args.budget is not None and free < args.budget:
+    sys.exit('ram_budget: FAIL - the stack and heap need %d bytes' % args.budget)
@@ -0,0 +1,341 @@
+/*
+  Core.cpp - Host stand-in for the Arduino core functions and the libraries the sketch uses, all passing through to Sim.
+  Created by Tom Wallace.
+*/
+
+#include <math.h>
+#include <new>
+#include "Arduino.h"
+#include <Adafruit_RGBLCDShield.h>
+#include <EEPROM.h>
+#include <Wire.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include "Sim.h"
+
+// Rough Adafruit library costs - each LCD character is several MCP23017 read-modify-writes at the default 100 kHz
+#define SHIELD_CHAR_MICROS 1500
+#define SHIELD_CLEAR_MICROS 3500
+#define SHIELD_BEGIN_MICROS 60000
+#define EEPROM_WRITE_MICROS 3300  // Each write waits out the one before it
+
+HardwareSerial Serial;
+TwoWire Wire;
+EEPROMClass EEPROM;
+
+// Heap bounds for the sketch's free memory checks, which have nothing to measure on a PC
+char * __brkval = NULL;
+char __heap_start;
+
+// Core functions
+void pinMode(uint8_t pin, uint8_t mode) {
+  Sim::PinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  Sim::DigitalWrite(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  return Sim::DigitalRead(pin);
+}
+
+int analogRead(uint8_t pin) {
+  Sim::Charge(112);
+  return Sim::GetLevel(pin) ? 1023 : 0;
+}
+
+unsigned long millis(void) {
+  return Sim::Micros() / 1000;
+}
+
+unsigned long micros(void) {
+  Sim::Charge(1);
+  return Sim::ReadMicros();
+}
+
+void delay(unsigned long ms) {
+  Sim::Advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  Sim::Advance(us);
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration) {
+}
+
+void noTone(uint8_t pin) {
+}
+
+extern "C" void cli(void) {
+  Sim::Cli();
+}
+
+extern "C" void sei(void) {
+  Sim::Sei();
+}
+
+void SimRestoreSreg(uint8_t sreg) {
+  Sim::RestoreSreg(sreg);
+}
+
+void wdt_reset(void) {
+  Sim::ResetWatchdog();
+}
+
+// Counted, like the String buffers
+void * operator new(size_t size) {
+  void * block = Sim::HeapRealloc(NULL, size, Sim::IsInSketch());
+  if (block == NULL)
+    throw std::bad_alloc();
+  return block;
+}
+
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void * block) noexcept {
+  Sim::HeapFree(block);
+}
+
+void operator delete[](void * block) noexcept {
+  Sim::HeapFree(block);
+}
+
+void operator delete(void * block, size_t size) noexcept {
+  Sim::HeapFree(block);
+}
+
+void operator delete[](void * block, size_t size) noexcept {
+  Sim::HeapFree(block);
+}
+
+// Print - number formatting from the AVR core
+size_t Print::write(const uint8_t * buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++))
+      n++;
+    else
+      break;
+  }
+  return n;
+}
+
+size_t Print::print(long n, int base) {
+  if (base == 0)
+    return write((uint8_t)n);
+  if (base == 10 && n < 0) {
+    size_t t = print('-');
+    return printNumber(-(unsigned long)n, 10) + t;
+  }
+  return printNumber(base == 10 ? n : (uint32_t)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  if (base == 0)
+    return write((uint8_t)n);
+  return printNumber(n, base);
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char * str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2)
+    base = 10;
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+  size_t n = 0;
+  if (isnan(number))
+    return print("nan");
+  if (isinf(number))
+    return print("inf");
+  if (number > 4294967040.0 || number < -4294967040.0)
+    return print("ovf");
+
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i)
+    rounding /= 10.0;
+  number += rounding;
+
+  unsigned long intPart = (unsigned long)number;
+  double remainder = number - (double)intPart;
+  n += print(intPart);
+  if (digits > 0)
+    n += print('.');
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    unsigned int toPrint = (unsigned int)remainder;
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
+
+// HardwareSerial
+void HardwareSerial::begin(unsigned long baud) {
+  Sim::SetBaud(baud);
+}
+
+int HardwareSerial::available() {
+  return Sim::SerialAvailable();
+}
+
+int HardwareSerial::peek() {
+  return Sim::SerialPeek();
+}
+
+int HardwareSerial::read() {
+  return Sim::SerialRead();
+}
+
+int HardwareSerial::availableForWrite() {
+  return Sim::SerialAvailableForWrite();
+}
+
+void HardwareSerial::flush() {
+  Sim::SerialFlush();
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  Sim::SerialWrite(c);
+  return 1;
+}
+
+// TwoWire
+void TwoWire::begin() {
+  _rxIndex = _rxLength = 0;
+  _txLength = 0;
+  _isTransmitting = false;
+  Sim::SetI2cClock(100000);
+}
+
+void TwoWire::end() {
+}
+
+void TwoWire::setClock(uint32_t clock) {
+  Sim::SetI2cClock(clock);
+}
+
+void TwoWire::setWireTimeout(uint32_t timeout, bool resetWithTimeout) {
+  Sim::SetI2cTimeout(timeout);
+}
+
+bool TwoWire::getWireTimeoutFlag() {
+  return Sim::GetI2cTimeoutFlag();
+}
+
+void TwoWire::clearWireTimeoutFlag() {
+  Sim::ClearI2cTimeoutFlag();
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  _isTransmitting = true;
+  _txAddress = address;
+  _txLength = 0;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+  int status = Sim::I2cWrite(_txAddress, _txBuffer, _txLength);
+  _txLength = 0;
+  _isTransmitting = false;
+  return status;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop) {
+  if (quantity > BUFFER_LENGTH)
+    quantity = BUFFER_LENGTH;
+  _rxLength = Sim::I2cRead(address, _rxBuffer, quantity);
+  _rxIndex = 0;
+  return _rxLength;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (!_isTransmitting || _txLength >= BUFFER_LENGTH)
+    return 0;
+  _txBuffer[_txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t * data, size_t quantity) {
+  for (size_t i = 0; i < quantity; i++)
+    if (!write(data[i]))
+      return i;
+  return quantity;
+}
+
+int TwoWire::available() {
+  return _rxLength - _rxIndex;
+}
+
+int TwoWire::read() {
+  return _rxIndex < _rxLength ? _rxBuffer[_rxIndex++] : -1;
+}
+
+int TwoWire::peek() {
+  return _rxIndex < _rxLength ? _rxBuffer[_rxIndex] : -1;
+}
+
+// EEPROM
+uint8_t EEPROMClass::read(int address) {
+  return Sim::ReadEeprom(address);
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  Sim::Charge(EEPROM_WRITE_MICROS);
+  Sim::WriteEeprom(address, value);
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if (Sim::ReadEeprom(address) != value)
+    write(address, value);
+}
+
+// Adafruit_RGBLCDShield
+void Adafruit_RGBLCDShield::begin(uint8_t cols, uint8_t rows) {
+  Sim::Charge(SHIELD_BEGIN_MICROS);
+}
+
+void Adafruit_RGBLCDShield::clear() {
+  Sim::Charge(SHIELD_CLEAR_MICROS);
+}
+
+void Adafruit_RGBLCDShield::home() {
+  Sim::Charge(SHIELD_CLEAR_MICROS);
+}
+
+void Adafruit_RGBLCDShield::setCursor(uint8_t col, uint8_t row) {
+  Sim::Charge(SHIELD_CHAR_MICROS);
+}
+
+void Adafruit_RGBLCDShield::setBacklight(uint8_t status) {
+  Sim::Charge(SHIELD_CHAR_MICROS);
+}
+
+void Adafruit_RGBLCDShield::createChar(uint8_t location, uint8_t charmap[]) {
+  Sim::Charge(9 * SHIELD_CHAR_MICROS);
+}
+
+uint8_t Adafruit_RGBLCDShield::readButtons() {
+  Sim::Charge(SHIELD_CHAR_MICROS);
+  return 0;
+}
+
+size_t Adafruit_RGBLCDShield::write(uint8_t value) {
+  Sim::Charge(SHIELD_CHAR_MICROS);
+  return 1;
+}
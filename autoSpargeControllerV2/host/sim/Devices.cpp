@@ -0,0 +1,213 @@
+/*
+  Devices.cpp - Simulated I2C devices on the controller's bus.
+  Created by Tom Wallace.
+*/
+
+#include <string.h>
+#include "Devices.h"
+
+// MCP23017 registers with IOCON.BANK = 0
+#define MCP_IOCON 0x0A
+#define MCP_GPIOA 0x12
+#define MCP_GPIOB 0x13
+#define MCP_IOCON_SEQOP 0x20
+
+// Shield wiring - GPIOB carries the LCD, GPIOA the keypad on bits 0 to 4 and red and green on bits 6 and 7, all active low
+#define LCD_BLUE_BIT 0x01
+#define LCD_ENABLE_BIT 0x20
+#define LCD_RS_BIT 0x80
+
+#define MPRLS_STATUS_GOOD 0x40
+#define MPRLS_STATUS_BUSY 0x20
+#define MPRLS_CONVERSION_MICROS 5000
+
+SimLcdShield::SimLcdShield() {
+  memset(_registers, 0, sizeof(_registers));
+  _registers[MCP_GPIOA] = 0xFF;
+  _registers[MCP_GPIOB] = 0xFF;
+  _pointer = 0;
+  _keys = 0;
+  _isHighNibble = true;
+  _highNibble = 0;
+  _address = 0;
+  memset(_ddram, ' ', sizeof(_ddram));
+  _writes = 0;
+}
+
+// The first byte sets the register pointer, which steps on with each byte unless SEQOP holds it
+bool SimLcdShield::Write(const uint8_t * data, uint8_t length) {
+  if (length == 0)
+    return true;
+  _pointer = data[0] % sizeof(_registers);
+  for (uint8_t i = 1; i < length; i++) {
+    WriteRegister(_pointer, data[i]);
+    if (!(_registers[MCP_IOCON] & MCP_IOCON_SEQOP))
+      _pointer = (_pointer + 1) % sizeof(_registers);
+  }
+  _writes++;
+  return true;
+}
+
+uint8_t SimLcdShield::Read(uint8_t * data, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    uint8_t value = _registers[_pointer];
+    if (_pointer == MCP_GPIOA)
+      value = (value & 0xE0) | (~_keys & 0x1F);
+    data[i] = value;
+    if (!(_registers[MCP_IOCON] & MCP_IOCON_SEQOP))
+      _pointer = (_pointer + 1) % sizeof(_registers);
+  }
+  return length;
+}
+
+void SimLcdShield::SetKeys(uint8_t keys) {
+  _keys = keys & 0x1F;
+}
+
+uint8_t SimLcdShield::GetKeys() {
+  return _keys;
+}
+
+void SimLcdShield::GetRow(int row, char * text) {
+  memcpy(text, &_ddram[row == 0 ? 0x00 : 0x40], SIM_LCD_COLUMNS);
+  text[SIM_LCD_COLUMNS] = 0;
+}
+
+uint8_t SimLcdShield::GetBacklight() {
+  uint8_t red = !(_registers[MCP_GPIOA] & 0x40);
+  uint8_t green = !(_registers[MCP_GPIOA] & 0x80);
+  uint8_t blue = !(_registers[MCP_GPIOB] & LCD_BLUE_BIT);
+  return red | (green << 1) | (blue << 2);
+}
+
+unsigned long SimLcdShield::GetWrites() {
+  return _writes;
+}
+
+// Private - The LCD latches a nibble as enable falls
+void SimLcdShield::WriteRegister(uint8_t reg, uint8_t value) {
+  uint8_t previous = _registers[reg];
+  _registers[reg] = value;
+  if (reg == MCP_GPIOB && (previous & LCD_ENABLE_BIT) && !(value & LCD_ENABLE_BIT))
+    Strobe(previous);
+}
+
+// Private - D4 to D7 sit on GPIOB bits 4 to 1, and the LCD takes the high nibble first in 4 bit mode
+void SimLcdShield::Strobe(uint8_t value) {
+  uint8_t nibble = ((value >> 4) & 0x01) | ((value >> 2) & 0x02) | (value & 0x04) | ((value << 2) & 0x08);
+  if (_isHighNibble) {
+    _highNibble = nibble;
+    _isHighNibble = false;
+    return;
+  }
+  _isHighNibble = true;
+
+  uint8_t byte = (_highNibble << 4) | nibble;
+  if (!(value & LCD_RS_BIT)) {
+    Command(byte);
+    return;
+  }
+  if (_address < sizeof(_ddram))
+    _ddram[_address] = byte;
+  _address++;
+  if (_address == 0x28)
+    _address = 0x40;
+  else if (_address >= 0x68)
+    _address = 0x00;
+}
+
+// Private - Only the commands that move the cursor or clear matter to what is shown
+void SimLcdShield::Command(uint8_t value) {
+  if (value & 0x80)
+    _address = value & 0x7F;
+  else if (value == 0x01) {
+    memset(_ddram, ' ', sizeof(_ddram));
+    _address = 0;
+  } else if ((value & 0xFE) == 0x02)
+    _address = 0;
+}
+
+SimMprls::SimMprls() {
+  _counts = HpaToCounts(SIM_ATMOSPHERE_HPA);
+  _status = MPRLS_STATUS_GOOD;
+  _isConnected = true;
+  _readyMicros = 0;
+  _extraBusyMicros = 0;
+  _conversions = 0;
+}
+
+// Any write starts a conversion - the driver sends the 0xAA 0x00 0x00 measure command
+bool SimMprls::Write(const uint8_t * data, uint8_t length) {
+  if (!_isConnected)
+    return false;
+  if (length > 0 && data[0] == 0xAA) {
+    _readyMicros = Sim::Micros() + MPRLS_CONVERSION_MICROS + _extraBusyMicros;
+    _extraBusyMicros = 0;
+    _conversions++;
+  }
+  return true;
+}
+
+uint8_t SimMprls::Read(uint8_t * data, uint8_t length) {
+  if (!_isConnected)
+    return 0;
+  uint8_t reading[4];
+  reading[0] = Sim::Micros() < _readyMicros ? (_status | MPRLS_STATUS_BUSY) : _status;
+  reading[1] = _counts >> 16;
+  reading[2] = _counts >> 8;
+  reading[3] = _counts;
+  for (uint8_t i = 0; i < length; i++)
+    data[i] = i < sizeof(reading) ? reading[i] : 0;
+  return length;
+}
+
+void SimMprls::SetCounts(uint32_t counts) {
+  _counts = counts & 0xFFFFFF;
+}
+
+void SimMprls::SetStatus(uint8_t status) {
+  _status = status;
+}
+
+void SimMprls::SetConnected(bool isConnected) {
+  _isConnected = isConnected;
+}
+
+void SimMprls::SetBusy(uint32_t micros) {
+  _extraBusyMicros = micros;
+}
+
+unsigned long SimMprls::GetConversions() {
+  return _conversions;
+}
+
+// Transfer function A, 0 to 25 psi across 10% to 90% of the counts
+uint32_t SimMprls::HpaToCounts(float hpa) {
+  float psi = hpa / 68.947572932;
+  float counts = 0x19999A + psi * (0xE66666 - 0x19999A) / 25.0;
+  if (counts < 0)
+    return 0;
+  if (counts > 0xFFFFFF)
+    return 0xFFFFFF;
+  return (uint32_t)(counts + 0.5);
+}
+
+SimI2cMux::SimI2cMux() {
+  _channels = 0;
+}
+
+bool SimI2cMux::Write(const uint8_t * data, uint8_t length) {
+  if (length > 0)
+    _channels = data[length - 1];
+  return true;
+}
+
+uint8_t SimI2cMux::Read(uint8_t * data, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++)
+    data[i] = _channels;
+  return length;
+}
+
+uint8_t SimI2cMux::GetChannels() {
+  return _channels;
+}
@@ -0,0 +1,77 @@
+/*
+  Devices.h - Simulated I2C devices on the controller's bus - the RGB LCD shield's MCP23017 with the HD44780 behind it, the MPRLS
+  pressure sensor and the TCA9548A mux.  Each is modelled as far as the sketch's drivers use it.
+  Created by Tom Wallace.
+*/
+#ifndef Devices_h
+#define Devices_h
+
+#include <stdint.h>
+#include "Sim.h"
+
+#define SIM_LCD_COLUMNS 16
+#define SIM_LCD_ROWS 2
+#define SIM_ATMOSPHERE_HPA 1013.25  // The MPRLS reads absolute pressure, so an empty kettle reads this
+
+// MCP23017 in its reset bank layout, decoding the LCD writes FastLcd makes on GPIOB and reading the keypad on GPIOA
+class SimLcdShield : public SimI2cDevice {
+  private:
+	uint8_t _registers[0x16];
+	uint8_t _pointer;
+	uint8_t _keys;
+	bool _isHighNibble;
+	uint8_t _highNibble;
+	uint8_t _address;  // HD44780 DDRAM address
+	char _ddram[0x68];
+	unsigned long _writes;
+
+	void WriteRegister(uint8_t reg, uint8_t value);
+	void Strobe(uint8_t value);
+	void Command(uint8_t value);
+
+  public:
+	SimLcdShield();
+	virtual bool Write(const uint8_t * data, uint8_t length);
+	virtual uint8_t Read(uint8_t * data, uint8_t length);
+	void SetKeys(uint8_t keys);  // BUTTON_ bits held down
+	uint8_t GetKeys();
+	void GetRow(int row, char * text);  // SIM_LCD_COLUMNS characters and a terminator
+	uint8_t GetBacklight();  // Red, green and blue bits, as the sketch's colors
+	unsigned long GetWrites();
+};
+
+// MPRLS - a conversion takes 5 ms, during which the status reads busy
+class SimMprls : public SimI2cDevice {
+  private:
+	uint32_t _counts;
+	uint8_t _status;
+	bool _isConnected;
+	uint64_t _readyMicros;
+	uint32_t _extraBusyMicros;
+	unsigned long _conversions;
+
+  public:
+	SimMprls();
+	virtual bool Write(const uint8_t * data, uint8_t length);
+	virtual uint8_t Read(uint8_t * data, uint8_t length);
+	void SetCounts(uint32_t counts);
+	void SetStatus(uint8_t status);  // 0x40 for a good reading, or error bits such as 0x04 for saturated math
+	void SetConnected(bool isConnected);
+	void SetBusy(uint32_t micros);  // Holds the next conversion busy this much longer
+	unsigned long GetConversions();
+	static uint32_t HpaToCounts(float hpa);
+};
+
+// TCA9548A - remembers the channel mask written to it
+class SimI2cMux : public SimI2cDevice {
+  private:
+	uint8_t _channels;
+
+  public:
+	SimI2cMux();
+	virtual bool Write(const uint8_t * data, uint8_t length);
+	virtual uint8_t Read(uint8_t * data, uint8_t length);
+	uint8_t GetChannels();
+};
+
+#endif
@@ -0,0 +1,686 @@
+/*
+  Sim.cpp - Simulated Trinket Pro the host harnesses run the sketch on.
+  Costs charged for the core's calls are rough figures for a 16 MHz ATmega328P - a few microseconds for a pin, the bit times
+  of the bus and the UART, 3.3 ms for an EEPROM write - plus a fixed cost per loop for the sketch's own code, which the host
+  does not time.  They are there so millisecond timing and the watchdog behave, not to profile the sketch.
+  Created by Tom Wallace.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "Sim.h"
+
+#define DIGITAL_MICROS 4  // digitalWrite, digitalRead and pinMode
+#define HEAP_MICROS 8  // malloc, realloc and free walking the free list
+#define I2C_OVERHEAD_MICROS 20  // Wire library work around a transaction
+#define STUCK_BUS_PULSES 3  // SCL pulses it takes a device holding SDA to let go
+
+// Interrupt handlers the sketch defines - weak, so a harness without the classes that define them still links
+extern "C" void WDT_vect(void) __attribute__((weak));
+extern "C" void TIMER0_COMPA_vect(void) __attribute__((weak));
+extern "C" void TIMER0_COMPB_vect(void) __attribute__((weak));
+
+// Registers
+volatile uint8_t SREG = _BV(SREG_I);  // The core's init() enables interrupts before setup()
+volatile uint8_t MCUSR = _BV(PORF);
+volatile uint8_t WDTCSR = 0;
+volatile uint8_t TIMSK0 = 0;
+volatile uint8_t OCR0A = 0;
+volatile uint8_t OCR0B = 0;
+volatile uint8_t TCCR1A = 0;
+volatile uint8_t TCCR1B = 0;
+volatile uint16_t OCR1A = 0;
+volatile uint16_t TCNT1 = 0;
+volatile uint8_t GPIOR0 = 0;
+volatile uintptr_t SP = RAMEND;
+
+uint64_t Sim::_now = 0;
+unsigned long Sim::_lastMillis = 0;
+uint64_t Sim::_nextMillisMicros = 1000;
+bool Sim::_isAdvancing = false;
+uint32_t Sim::_loopMicros = 200;
+SimTickHook Sim::_tickHook = NULL;
+SimMicrosHook Sim::_microsHook = NULL;
+void * Sim::_microsContext = NULL;
+void * Sim::_tickContext = NULL;
+bool Sim::_isRealtime = false;
+uint64_t Sim::_wallStartMicros = 0;
+
+bool Sim::_isBooted = false;
+bool Sim::_isReset = false;
+bool Sim::_isInSketch = false;
+unsigned long Sim::_loopCount = 0;
+unsigned long Sim::_longestLoopMicros = 0;
+
+uint8_t Sim::_modes[SIM_NUM_PINS];
+uint8_t Sim::_outputs[SIM_NUM_PINS];
+uint8_t Sim::_driven[SIM_NUM_PINS];
+uint8_t Sim::_levels[SIM_NUM_PINS];
+uint64_t Sim::_changeMicros[SIM_NUM_PINS];
+SimPinHook Sim::_pinHook = NULL;
+void * Sim::_pinContext = NULL;
+
+uint8_t Sim::_pending = 0;
+bool Sim::_isInInterrupt = false;
+int Sim::_armedPin = -1;
+uint8_t Sim::_armedLevel = 0;
+int Sim::_armedVector = 0;
+uint64_t Sim::_watchdogMicros = 0;
+unsigned long Sim::_watchdogInterrupts = 0;
+
+SimSerialSink Sim::_serialSink = NULL;
+void * Sim::_serialContext = NULL;
+int Sim::_serialFd = -1;
+uint32_t Sim::_byteMicros = 1042;  // 9600 baud until begin()
+uint64_t Sim::_txDoneMicros = 0;
+uint8_t Sim::_rx[64];
+uint8_t Sim::_rxHead = 0;
+uint8_t Sim::_rxTail = 0;
+uint8_t Sim::_rxPending[SIM_RX_PENDING_SIZE];
+unsigned int Sim::_rxPendingHead = 0;
+unsigned int Sim::_rxPendingTail = 0;
+uint64_t Sim::_rxNextMicros = 0;
+unsigned long Sim::_rxOverruns = 0;
+
+SimI2cDevice * Sim::_devices[128];
+uint32_t Sim::_i2cClock = 100000;
+uint32_t Sim::_i2cTimeout = 0;
+bool Sim::_i2cTimeoutFlag = false;
+bool Sim::_isBusStuck = false;
+int Sim::_sclPulses = 0;
+uint32_t Sim::_busHangMillis = 0;
+unsigned long Sim::_busRecoveries = 0;
+unsigned long Sim::_busTimeouts = 0;
+
+uint8_t Sim::_eeprom[SIM_EEPROM_SIZE];
+unsigned long Sim::_eepromWrites = 0;
+
+SimHeapStats Sim::_heap;
+
+static uint64_t WallMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Clock
+uint64_t Sim::Micros() {
+  return _now;
+}
+
+uint64_t Sim::ReadMicros() {
+  if (_microsHook != NULL)
+    _microsHook(_microsContext, _now);
+  return _now;
+}
+
+// Private - Runs each millisecond Advance has passed - a call made while one is already running just adds its time, which
+// the outer call then catches up on
+void Sim::CatchUp() {
+  if (_isAdvancing)
+    return;
+
+  // Interrupts and hooks see the time of the millisecond they run on, not the end of a long call such as a hung bus, and
+  // whatever the interrupts charge is added on
+  _isAdvancing = true;
+  uint64_t target = _now;
+  while (target >= _nextMillisMicros) {
+    uint64_t tickMicros = _nextMillisMicros;
+    _now = tickMicros;
+    _lastMillis++;
+    _nextMillisMicros += 1000;
+    Millisecond();
+    target += _now - tickMicros;
+  }
+  _now = target;
+  _isAdvancing = false;
+}
+
+// Time taken by the sketch's own code each loop, on top of what its calls into the core charge
+void Sim::SetLoopMicros(uint32_t micros) {
+  _loopMicros = micros;
+}
+
+// Called every simulated millisecond, after any interrupts that came due - for checks that must hold even while the loop is stuck
+void Sim::SetTickHook(SimTickHook hook, void * context) {
+  _tickHook = hook;
+  _tickContext = context;
+}
+
+void Sim::SetMicrosHook(SimMicrosHook hook, void * context) {
+  _microsHook = hook;
+  _microsContext = context;
+}
+
+// Holds the simulated clock to the wall clock, for talking to a real host program
+void Sim::SetRealtime(bool isRealtime) {
+  _isRealtime = isRealtime;
+  _wallStartMicros = WallMicros() - _now;
+}
+
+// Running the sketch
+bool Sim::Boot() {
+  _isInSketch = true;
+  setup();
+  _isInSketch = false;
+  _isBooted = true;
+  return !_isReset;
+}
+
+bool Sim::RunLoop() {
+  if (_isReset)
+    return false;
+
+  uint64_t start = _now;
+  _isInSketch = true;
+  loop();
+  _isInSketch = false;
+  Advance(_loopMicros);
+  _loopCount++;
+  if (_now - start > _longestLoopMicros)
+    _longestLoopMicros = _now - start;
+  return !_isReset;
+}
+
+bool Sim::RunFor(unsigned long millis) {
+  uint64_t end = _now + (uint64_t)millis * 1000;
+  while (_now < end)
+    if (!RunLoop())
+      return false;
+  return true;
+}
+
+bool Sim::IsReset() {
+  return _isReset;
+}
+
+unsigned long Sim::GetLoopCount() {
+  return _loopCount;
+}
+
+unsigned long Sim::GetLongestLoopMicros() {
+  return _longestLoopMicros;
+}
+
+// Pins
+void Sim::SetInput(uint8_t pin, uint8_t level) {
+  _driven[pin] = level + 1;
+  UpdateLevel(pin);
+}
+
+void Sim::ReleaseInput(uint8_t pin) {
+  _driven[pin] = 0;
+  UpdateLevel(pin);
+}
+
+uint8_t Sim::GetLevel(uint8_t pin) {
+  return _levels[pin];
+}
+
+bool Sim::IsOutput(uint8_t pin) {
+  return _modes[pin] == OUTPUT;
+}
+
+uint64_t Sim::GetChangeMicros(uint8_t pin) {
+  return _changeMicros[pin];
+}
+
+// Called whenever a pin's level changes, from the sketch or the harness
+void Sim::SetPinHook(SimPinHook hook, void * context) {
+  _pinHook = hook;
+  _pinContext = context;
+}
+
+// Interrupts
+void Sim::RaiseInterrupt(int vector) {
+  _pending |= 1 << vector;
+  RunPending();
+}
+
+void Sim::InterruptOnWrite(uint8_t pin, uint8_t level, int vector) {
+  _armedPin = pin;
+  _armedLevel = level;
+  _armedVector = vector;
+}
+
+bool Sim::IsInterruptArmed() {
+  return _armedPin >= 0;
+}
+
+bool Sim::IsInInterrupt() {
+  return _isInInterrupt;
+}
+
+unsigned long Sim::GetWatchdogInterrupts() {
+  return _watchdogInterrupts;
+}
+
+// UART
+void Sim::SetSerialSink(SimSerialSink sink, void * context) {
+  _serialSink = sink;
+  _serialContext = context;
+}
+
+// Sends the sketch's output to a file descriptor and takes its input from it, such as a pseudo terminal
+void Sim::SetSerialFd(int fd) {
+  _serialFd = fd;
+  if (fd >= 0)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// Queues bytes to arrive on the UART at the baud rate - any the sketch does not read in time overrun its buffer
+void Sim::SendSerial(const uint8_t * data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    unsigned int next = (_rxPendingTail + 1) % SIM_RX_PENDING_SIZE;
+    if (next == _rxPendingHead)
+      return;
+    if (_rxPendingHead == _rxPendingTail && _rxNextMicros < _now + _byteMicros)
+      _rxNextMicros = _now + _byteMicros;
+    _rxPending[_rxPendingTail] = data[i];
+    _rxPendingTail = next;
+  }
+}
+
+unsigned long Sim::GetSerialOverruns() {
+  return _rxOverruns;
+}
+
+// I2C bus
+void Sim::AttachI2c(uint8_t address, SimI2cDevice * device) {
+  _devices[address & 0x7F] = device;
+}
+
+// A device holding SDA low - every transaction times out until SCL is clocked to free it
+void Sim::SetBusStuck(bool isStuck) {
+  _isBusStuck = isStuck;
+  _sclPulses = 0;
+}
+
+bool Sim::IsBusStuck() {
+  return _isBusStuck;
+}
+
+// The next transaction locks up for the time given, as Wire could before it had a timeout - for testing the loop watchdog
+void Sim::HangBus(uint32_t millis) {
+  _busHangMillis = millis;
+}
+
+unsigned long Sim::GetBusRecoveries() {
+  return _busRecoveries;
+}
+
+unsigned long Sim::GetBusTimeouts() {
+  return _busTimeouts;
+}
+
+// EEPROM
+uint8_t Sim::ReadEeprom(int address) {
+  return _eeprom[address % SIM_EEPROM_SIZE] ^ 0xFF;
+}
+
+void Sim::WriteEeprom(int address, uint8_t value) {
+  _eeprom[address % SIM_EEPROM_SIZE] = value ^ 0xFF;
+  _eepromWrites++;
+}
+
+unsigned long Sim::GetEepromWrites() {
+  return _eepromWrites;
+}
+
+SimHeapStats Sim::GetHeap() {
+  return _heap;
+}
+
+void Sim::ResetHeapPeak() {
+  _heap.peakBytes = _heap.liveBytes;
+  _heap.peakBlocks = _heap.liveBlocks;
+}
+
+void Sim::PinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= SIM_NUM_PINS || _isReset)
+    return;
+  Charge(DIGITAL_MICROS);
+  _modes[pin] = mode;
+  UpdateLevel(pin);
+}
+
+void Sim::DigitalWrite(uint8_t pin, uint8_t value) {
+  if (pin >= SIM_NUM_PINS || _isReset)
+    return;
+  Charge(DIGITAL_MICROS);
+  value = value ? HIGH : LOW;
+  if (pin == _armedPin && value == _armedLevel && !_isInInterrupt) {
+    _armedPin = -1;
+    RaiseInterrupt(_armedVector);
+  }
+
+  // Clocking SCL by hand is how a held bus is freed
+  if (pin == SCL && value == LOW && _modes[pin] == OUTPUT && _isBusStuck && ++_sclPulses >= STUCK_BUS_PULSES) {
+    _isBusStuck = false;
+    _busRecoveries++;
+  }
+  _outputs[pin] = value;
+  UpdateLevel(pin);
+}
+
+int Sim::DigitalRead(uint8_t pin) {
+  if (pin >= SIM_NUM_PINS)
+    return LOW;
+  Charge(DIGITAL_MICROS);
+  if (pin == SDA && _isBusStuck)
+    return LOW;
+  return _levels[pin];
+}
+
+void Sim::Cli() {
+  SREG &= ~_BV(SREG_I);
+}
+
+void Sim::Sei() {
+  SREG |= _BV(SREG_I);
+  RunPending();
+}
+
+void Sim::RestoreSreg(uint8_t sreg) {
+  SREG = sreg;
+  RunPending();
+}
+
+void Sim::Call(SimCall call, void * context) {
+  bool wasInSketch = _isInSketch;
+  _isInSketch = true;
+  call(context);
+  _isInSketch = wasInSketch;
+}
+
+void Sim::ResetWatchdog() {
+  _watchdogMicros = 0;
+}
+
+// Blocks carry their size and whether the sketch allocated them, so frees come off the right count
+struct HeapHeader {
+  size_t size;
+  size_t isCounted;
+};
+
+void * Sim::HeapRealloc(void * block, size_t size, bool isCounted) {
+  HeapHeader * header = block == NULL ? NULL : (HeapHeader *)block - 1;
+  if (header != NULL && header->isCounted) {
+    _heap.liveBytes -= header->size;
+    _heap.liveBlocks--;
+  }
+  if (header != NULL)
+    isCounted = header->isCounted;
+
+  header = (HeapHeader *)realloc(header, sizeof(HeapHeader) + size);
+  if (header == NULL)
+    return NULL;
+  header->size = size;
+  header->isCounted = isCounted;
+  if (isCounted) {
+    _heap.liveBytes += size;
+    _heap.liveBlocks++;
+    _heap.allocs++;
+    if (_heap.liveBytes > _heap.peakBytes) {
+      _heap.peakBytes = _heap.liveBytes;
+      _heap.peakBlocks = _heap.liveBlocks;
+    }
+  }
+  if (_isInSketch)
+    Charge(HEAP_MICROS);
+  return header + 1;
+}
+
+void Sim::HeapFree(void * block) {
+  if (block == NULL)
+    return;
+  HeapHeader * header = (HeapHeader *)block - 1;
+  if (header->isCounted) {
+    _heap.liveBytes -= header->size;
+    _heap.liveBlocks--;
+    _heap.frees++;
+  }
+  free(header);
+  if (_isInSketch)
+    Charge(HEAP_MICROS);
+}
+
+// Allocations are the sketch's while its static constructors run and while it is called, but not the harness's in between
+bool Sim::IsInSketch() {
+  return _isInSketch || !_isBooted;
+}
+
+int Sim::SerialAvailable() {
+  Charge(1);
+  ReceiveSerial();
+  return (64 + _rxHead - _rxTail) % 64;
+}
+
+int Sim::SerialPeek() {
+  ReceiveSerial();
+  return _rxHead == _rxTail ? -1 : _rx[_rxTail];
+}
+
+int Sim::SerialRead() {
+  Charge(1);
+  ReceiveSerial();
+  if (_rxHead == _rxTail)
+    return -1;
+  uint8_t value = _rx[_rxTail];
+  _rxTail = (_rxTail + 1) % 64;
+  return value;
+}
+
+// Room left in the transmit buffer, with one byte in the shift register beside it
+int Sim::SerialAvailableForWrite() {
+  uint64_t queued = _txDoneMicros > _now ? (_txDoneMicros - _now + _byteMicros - 1) / _byteMicros : 0;
+  return queued >= SERIAL_TX_BUFFER_SIZE ? 0 : SERIAL_TX_BUFFER_SIZE - 1 - (queued > 0 ? queued - 1 : 0);
+}
+
+void Sim::SerialFlush() {
+  if (_txDoneMicros > _now)
+    Advance(_txDoneMicros - _now);
+}
+
+// Waits for room when the buffer is full, as the core does, then hands the byte to the sink when it would have gone out
+void Sim::SerialWrite(uint8_t value) {
+  if (_isReset)
+    return;
+  Charge(2);
+  if (_txDoneMicros < _now)
+    _txDoneMicros = _now;
+  uint64_t limit = (uint64_t)SERIAL_TX_BUFFER_SIZE * _byteMicros;
+  if (_txDoneMicros - _now > limit)
+    Advance(_txDoneMicros - _now - limit);
+  _txDoneMicros += _byteMicros;
+
+  if (_serialSink != NULL)
+    _serialSink(_serialContext, value);
+  if (_serialFd >= 0) {
+    while (write(_serialFd, &value, 1) < 0 && errno == EAGAIN)
+      usleep(100);
+  }
+}
+
+void Sim::SetBaud(unsigned long baud) {
+  _byteMicros = 10000000UL / baud;
+}
+
+// Returns the Wire status - 0 sent, 2 address not acknowledged, 5 timed out
+int Sim::I2cWrite(uint8_t address, const uint8_t * data, uint8_t length) {
+  if (!TransactI2c(length))
+    return 5;
+  SimI2cDevice * device = _devices[address & 0x7F];
+  if (device == NULL || !device->Write(data, length))
+    return 2;
+  return 0;
+}
+
+uint8_t Sim::I2cRead(uint8_t address, uint8_t * data, uint8_t length) {
+  if (!TransactI2c(length))
+    return 0;
+  SimI2cDevice * device = _devices[address & 0x7F];
+  if (device == NULL)
+    return 0;
+  return device->Read(data, length);
+}
+
+void Sim::SetI2cClock(uint32_t clock) {
+  _i2cClock = clock;
+}
+
+void Sim::SetI2cTimeout(uint32_t micros) {
+  _i2cTimeout = micros;
+}
+
+bool Sim::GetI2cTimeoutFlag() {
+  return _i2cTimeoutFlag;
+}
+
+void Sim::ClearI2cTimeoutFlag() {
+  _i2cTimeoutFlag = false;
+}
+
+// Private - Runs the interrupts and checks that fall on each millisecond
+void Sim::Millisecond() {
+  if (_isReset)
+    return;
+
+  // Timer0 wraps once a millisecond, passing both compare values
+  if (TIMSK0 & _BV(OCIE0A))
+    _pending |= 1 << SIM_TIMER0_COMPA;
+  if (TIMSK0 & _BV(OCIE0B))
+    _pending |= 1 << SIM_TIMER0_COMPB;
+
+  // Watchdog - in interrupt and reset mode the first timeout interrupts and clears WDIE, so the next one resets
+  if (WDTCSR & (_BV(WDE) | _BV(WDIE))) {
+    _watchdogMicros += 1000;
+    int prescaler = (WDTCSR & 0x07) | (WDTCSR & _BV(WDP3) ? 0x08 : 0);
+    if (_watchdogMicros >= (16000ULL << prescaler)) {
+      _watchdogMicros = 0;
+      if (WDTCSR & _BV(WDIE)) {
+        if (WDTCSR & _BV(WDE))
+          WDTCSR &= ~_BV(WDIE);
+        _watchdogInterrupts++;
+        _pending |= 1 << SIM_WDT;
+      } else {
+        ResetBoard();
+        return;
+      }
+    }
+  }
+
+  ReceiveSerial();
+  RunPending();
+  if (_tickHook != NULL)
+    _tickHook(_tickContext, _lastMillis);
+
+  if (_isRealtime) {
+    uint64_t wall = WallMicros() - _wallStartMicros;
+    if (_now > wall + 1000)
+      usleep(_now - wall);
+  }
+}
+
+// Private - Runs pending interrupts in priority order, unless they are off or one is already running
+void Sim::RunPending() {
+  if (_isInInterrupt || _isReset || !(SREG & _BV(SREG_I)))
+    return;
+  while (_pending != 0 && !_isReset) {
+    int vector = 0;
+    while (!(_pending & (1 << vector)))
+      vector++;
+    _pending &= ~(1 << vector);
+    RunVector(vector);
+  }
+}
+
+// Private - The hardware clears the I bit for the handler and reti sets it again
+void Sim::RunVector(int vector) {
+  void (* handler)(void) = vector == SIM_WDT ? WDT_vect : (vector == SIM_TIMER0_COMPA ? TIMER0_COMPA_vect : TIMER0_COMPB_vect);
+  if (handler == NULL)
+    return;
+  _isInInterrupt = true;
+  SREG &= ~_BV(SREG_I);
+  handler();
+  SREG |= _BV(SREG_I);
+  _isInInterrupt = false;
+}
+
+// Private - The watchdog reset - every pin goes back to an input, so the pumps drop out, and the sketch stops here
+void Sim::ResetBoard() {
+  _isReset = true;
+  MCUSR |= _BV(WDRF);
+  WDTCSR = 0;
+  TIMSK0 = 0;
+  _pending = 0;
+  for (uint8_t pin = 0; pin < SIM_NUM_PINS; pin++) {
+    _modes[pin] = INPUT;
+    _outputs[pin] = LOW;
+    UpdateLevel(pin);
+  }
+}
+
+// Private - A driven input wins, then an output, then the pull-up, and a floating input reads low
+void Sim::UpdateLevel(uint8_t pin) {
+  uint8_t level;
+  if (_driven[pin])
+    level = _driven[pin] - 1;
+  else if (_modes[pin] == OUTPUT)
+    level = _outputs[pin];
+  else
+    level = _modes[pin] == INPUT_PULLUP ? HIGH : LOW;
+
+  if (level == _levels[pin])
+    return;
+  _levels[pin] = level;
+  _changeMicros[pin] = _now;
+  if (_pinHook != NULL)
+    _pinHook(_pinContext, pin, level);
+}
+
+// Private - Moves bytes that have arrived into the 64 byte receive buffer, dropping what does not fit
+void Sim::ReceiveSerial() {
+  if (_serialFd >= 0) {
+    uint8_t buffer[64];
+    ssize_t count = read(_serialFd, buffer, sizeof(buffer));
+    if (count > 0)
+      SendSerial(buffer, count);
+  }
+
+  while (_rxPendingHead != _rxPendingTail && _rxNextMicros <= _now) {
+    uint8_t next = (_rxHead + 1) % 64;
+    if (next == _rxTail)
+      _rxOverruns++;
+    else {
+      _rx[_rxHead] = _rxPending[_rxPendingHead];
+      _rxHead = next;
+    }
+    _rxPendingHead = (_rxPendingHead + 1) % SIM_RX_PENDING_SIZE;
+    _rxNextMicros += _byteMicros;
+  }
+}
+
+// Private - Takes the bus time for a transaction, returning false if it timed out
+bool Sim::TransactI2c(uint8_t length) {
+  if (_isReset)
+    return false;
+  if (_busHangMillis != 0) {
+    uint32_t hang = _busHangMillis;
+    _busHangMillis = 0;
+    Advance((uint64_t)hang * 1000);
+  }
+  if (_isBusStuck) {
+    Advance(_i2cTimeout != 0 ? _i2cTimeout : 1000000);
+    _i2cTimeoutFlag = true;
+    _busTimeouts++;
+    return false;
+  }
+  Advance(I2C_OVERHEAD_MICROS + (9ULL * (length + 1) + 2) * 1000000 / _i2cClock);
+  return true;
+}
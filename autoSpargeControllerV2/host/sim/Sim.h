@@ -0,0 +1,218 @@
+/*
+  Sim.h - Simulated Trinket Pro the host harnesses run the sketch on.  The clock only moves as the sketch calls into the stub
+  core, each call taking about what it would on the board, and every millisecond it passes fires the Timer0 compare interrupts
+  and steps the watchdog, so the loop watchdog and the beepers run from their real interrupt handlers.  Pins, the UART, the
+  I2C bus and EEPROM are modelled far enough to drive the sketch from outside and watch what it does.
+  All state is static and zero until used, so the sketch's static constructors can touch pins before main() runs.
+  Created by Tom Wallace.
+*/
+#ifndef Sim_h
+#define Sim_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIM_NUM_PINS 20
+#define SIM_EEPROM_SIZE 1024
+#define SIM_RX_PENDING_SIZE 4096
+
+// Interrupt vectors the sketch may define, in priority order
+#define SIM_WDT 0
+#define SIM_TIMER0_COMPA 1
+#define SIM_TIMER0_COMPB 2
+#define SIM_NUM_VECTORS 3
+
+// A device on the I2C bus
+class SimI2cDevice {
+  public:
+	virtual ~SimI2cDevice() {}
+	virtual bool Write(const uint8_t * data, uint8_t length) = 0;  // Returns false to NACK the address
+	virtual uint8_t Read(uint8_t * data, uint8_t length) = 0;  // Returns the bytes sent, 0 to NACK the address
+};
+
+struct SimHeapStats {
+	long liveBytes;  // Held by the sketch now
+	long liveBlocks;
+	long peakBytes;
+	long peakBlocks;  // Held when liveBytes peaked
+	unsigned long allocs;  // Calls to malloc, realloc and new made by the sketch
+	unsigned long frees;
+};
+
+typedef void (* SimTickHook)(void * context, unsigned long currentMillis);
+typedef void (* SimPinHook)(void * context, uint8_t pin, uint8_t level);
+typedef void (* SimSerialSink)(void * context, uint8_t value);
+typedef void (* SimCall)(void * context);
+typedef void (* SimMicrosHook)(void * context, uint64_t micros);
+
+class Sim {
+  public:
+	// Clock
+	static uint64_t Micros();
+	static inline void Advance(uint64_t micros);
+	static void SetLoopMicros(uint32_t micros);
+	static void SetTickHook(SimTickHook hook, void * context);
+	static void SetRealtime(bool isRealtime);
+	static void SetMicrosHook(SimMicrosHook hook, void * context);  // Each time the sketch reads micros(), as it does to time itself
+
+	// Running the sketch - each returns false once the watchdog has reset the board
+	static bool Boot();
+	static bool RunLoop();
+	static bool RunFor(unsigned long millis);
+	static void Call(SimCall call, void * context);  // Into the sketch's objects directly, charged and counted as the sketch
+	static bool IsReset();
+	static unsigned long GetLoopCount();
+	static unsigned long GetLongestLoopMicros();
+
+	// Pins - an input the harness drives wins over the pull-up
+	static void SetInput(uint8_t pin, uint8_t level);
+	static void ReleaseInput(uint8_t pin);
+	static uint8_t GetLevel(uint8_t pin);
+	static bool IsOutput(uint8_t pin);
+	static uint64_t GetChangeMicros(uint8_t pin);
+	static void SetPinHook(SimPinHook hook, void * context);
+
+	// Interrupts - InterruptOnWrite raises the vector just before the sketch next writes the level to the pin, to land an
+	// interrupt at the worst moment for whatever code is writing it
+	static void RaiseInterrupt(int vector);
+	static void InterruptOnWrite(uint8_t pin, uint8_t level, int vector);
+	static bool IsInterruptArmed();
+	static bool IsInInterrupt();
+	static unsigned long GetWatchdogInterrupts();
+
+	// UART
+	static void SetSerialSink(SimSerialSink sink, void * context);
+	static void SetSerialFd(int fd);
+	static void SendSerial(const uint8_t * data, size_t length);
+	static unsigned long GetSerialOverruns();
+
+	// I2C bus
+	static void AttachI2c(uint8_t address, SimI2cDevice * device);
+	static void SetBusStuck(bool isStuck);
+	static bool IsBusStuck();
+	static void HangBus(uint32_t millis);
+	static unsigned long GetBusRecoveries();
+	static unsigned long GetBusTimeouts();
+
+	// EEPROM
+	static uint8_t ReadEeprom(int address);
+	static void WriteEeprom(int address, uint8_t value);
+	static unsigned long GetEepromWrites();
+
+	// Heap used by the sketch, counted while it runs
+	static SimHeapStats GetHeap();
+	static void ResetHeapPeak();  // To what is held now, for a harness that allocates before boot
+
+	// Stub core side
+	static inline void Charge(uint32_t micros);
+	static uint64_t ReadMicros();
+	static void PinMode(uint8_t pin, uint8_t mode);
+	static void DigitalWrite(uint8_t pin, uint8_t value);
+	static int DigitalRead(uint8_t pin);
+	static void Cli();
+	static void Sei();
+	static void RestoreSreg(uint8_t sreg);
+	static void ResetWatchdog();
+	static void * HeapRealloc(void * block, size_t size, bool isCounted);
+	static void HeapFree(void * block);
+	static bool IsInSketch();
+	static int SerialAvailable();
+	static int SerialPeek();
+	static int SerialRead();
+	static int SerialAvailableForWrite();
+	static void SerialFlush();
+	static void SerialWrite(uint8_t value);
+	static void SetBaud(unsigned long baud);
+	static int I2cWrite(uint8_t address, const uint8_t * data, uint8_t length);
+	static uint8_t I2cRead(uint8_t address, uint8_t * data, uint8_t length);
+	static void SetI2cClock(uint32_t clock);
+	static void SetI2cTimeout(uint32_t micros);
+	static bool GetI2cTimeoutFlag();
+	static void ClearI2cTimeoutFlag();
+
+  private:
+	static uint64_t _now;
+	static unsigned long _lastMillis;
+	static uint64_t _nextMillisMicros;
+	static bool _isAdvancing;
+	static uint32_t _loopMicros;
+	static SimTickHook _tickHook;
+	static void * _tickContext;
+	static SimMicrosHook _microsHook;
+	static void * _microsContext;
+	static bool _isRealtime;
+	static uint64_t _wallStartMicros;
+
+	static bool _isBooted;
+	static bool _isReset;
+	static bool _isInSketch;
+	static unsigned long _loopCount;
+	static unsigned long _longestLoopMicros;
+
+	static uint8_t _modes[SIM_NUM_PINS];
+	static uint8_t _outputs[SIM_NUM_PINS];
+	static uint8_t _driven[SIM_NUM_PINS];  // 0 floating, else level + 1
+	static uint8_t _levels[SIM_NUM_PINS];
+	static uint64_t _changeMicros[SIM_NUM_PINS];
+	static SimPinHook _pinHook;
+	static void * _pinContext;
+
+	static uint8_t _pending;
+	static bool _isInInterrupt;
+	static int _armedPin;
+	static uint8_t _armedLevel;
+	static int _armedVector;
+	static uint64_t _watchdogMicros;
+	static unsigned long _watchdogInterrupts;
+
+	static SimSerialSink _serialSink;
+	static void * _serialContext;
+	static int _serialFd;
+	static uint32_t _byteMicros;
+	static uint64_t _txDoneMicros;
+	static uint8_t _rx[64];
+	static uint8_t _rxHead;
+	static uint8_t _rxTail;
+	static uint8_t _rxPending[SIM_RX_PENDING_SIZE];
+	static unsigned int _rxPendingHead;
+	static unsigned int _rxPendingTail;
+	static uint64_t _rxNextMicros;
+	static unsigned long _rxOverruns;
+
+	static SimI2cDevice * _devices[128];
+	static uint32_t _i2cClock;
+	static uint32_t _i2cTimeout;
+	static bool _i2cTimeoutFlag;
+	static bool _isBusStuck;
+	static int _sclPulses;
+	static uint32_t _busHangMillis;
+	static unsigned long _busRecoveries;
+	static unsigned long _busTimeouts;
+
+	static uint8_t _eeprom[SIM_EEPROM_SIZE];  // Stored inverted, so zeroed memory reads as erased cells
+	static unsigned long _eepromWrites;
+
+	static SimHeapStats _heap;
+
+	static void CatchUp();
+	static void Millisecond();
+	static void RunPending();
+	static void RunVector(int vector);
+	static void ResetBoard();
+	static void UpdateLevel(uint8_t pin);
+	static void ReceiveSerial();
+	static bool TransactI2c(uint8_t length);
+};
+
+// Inline, as the core charges time for nearly every call the sketch makes into it
+inline void Sim::Advance(uint64_t micros) {
+  _now += micros;
+  if (_now >= _nextMillisMicros)
+    CatchUp();
+}
+
+inline void Sim::Charge(uint32_t micros) {
+  Advance(micros);
+}
+
+#endif
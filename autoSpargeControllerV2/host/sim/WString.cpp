@@ -0,0 +1,532 @@
+/*
+  WString.cpp - Host stand-in for the Arduino String class, following the AVR core's buffer handling so heap counts track the
+  board's.  Number formatting matches the core - itoa style for integers and dtostrf with a width of the decimals plus two for
+  floats, which pads single digit values with a leading space.
+  Created by Tom Wallace.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include "Arduino.h"
+#include "Sim.h"
+
+// Private
+void String::init() {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+}
+
+void String::invalidate() {
+  if (buffer)
+    Sim::HeapFree(buffer);
+  buffer = NULL;
+  capacity = len = 0;
+}
+
+bool String::changeBuffer(unsigned int maxStrLen) {
+  char * newbuffer = (char *)Sim::HeapRealloc(buffer, maxStrLen + 1, Sim::IsInSketch());
+  if (newbuffer) {
+    buffer = newbuffer;
+    capacity = maxStrLen;
+    return true;
+  }
+  return false;
+}
+
+String & String::copy(const char * cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return *this;
+  }
+  len = length;
+  memcpy(buffer, cstr, length);
+  buffer[len] = 0;
+  return *this;
+}
+
+void String::move(String & rhs) {
+  if (buffer)
+    Sim::HeapFree(buffer);
+  buffer = rhs.buffer;
+  capacity = rhs.capacity;
+  len = rhs.len;
+  rhs.buffer = NULL;
+  rhs.capacity = 0;
+  rhs.len = 0;
+}
+
+// Constructors
+String::String(const char * cstr) {
+  init();
+  if (cstr)
+    copy(cstr, strlen(cstr));
+}
+
+String::String(const String & value) {
+  init();
+  *this = value;
+}
+
+String::String(const __FlashStringHelper * pstr) {
+  init();
+  *this = pstr;
+}
+
+String::String(String && rval) {
+  init();
+  move(rval);
+}
+
+String::String(StringSumHelper && rval) {
+  init();
+  move(rval);
+}
+
+String::String(char c) {
+  init();
+  char buf[2] = {c, 0};
+  *this = buf;
+}
+
+static void FormatInteger(char * buf, size_t size, unsigned long value, bool isNegative, unsigned char base) {
+  char digits[34];
+  int n = 0;
+  do {
+    int digit = value % base;
+    digits[n++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value != 0 && n < 33);
+  size_t i = 0;
+  if (isNegative)
+    buf[i++] = '-';
+  while (n > 0 && i + 1 < size)
+    buf[i++] = digits[--n];
+  buf[i] = 0;
+}
+
+String::String(unsigned char value, unsigned char base) {
+  init();
+  char buf[34];
+  FormatInteger(buf, sizeof(buf), value, false, base);
+  *this = buf;
+}
+
+String::String(int value, unsigned char base) {
+  init();
+  char buf[34];
+  // The core's itoa formats the 16 bit two's complement for other bases
+  if (base == 10)
+    FormatInteger(buf, sizeof(buf), value < 0 ? -(long)value : value, value < 0, base);
+  else
+    FormatInteger(buf, sizeof(buf), (uint16_t)value, false, base);
+  *this = buf;
+}
+
+String::String(unsigned int value, unsigned char base) {
+  init();
+  char buf[34];
+  FormatInteger(buf, sizeof(buf), value, false, base);
+  *this = buf;
+}
+
+String::String(long value, unsigned char base) {
+  init();
+  char buf[34];
+  if (base == 10)
+    FormatInteger(buf, sizeof(buf), value < 0 ? -(unsigned long)value : value, value < 0, base);
+  else
+    FormatInteger(buf, sizeof(buf), (uint32_t)value, false, base);
+  *this = buf;
+}
+
+String::String(unsigned long value, unsigned char base) {
+  init();
+  char buf[34];
+  FormatInteger(buf, sizeof(buf), value, false, base);
+  *this = buf;
+}
+
+String::String(float value, unsigned char decimalPlaces) {
+  init();
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%*.*f", decimalPlaces + 2, decimalPlaces, (double)value);
+  *this = buf;
+}
+
+String::String(double value, unsigned char decimalPlaces) {
+  init();
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%*.*f", decimalPlaces + 2, decimalPlaces, value);
+  *this = buf;
+}
+
+String::~String() {
+  if (buffer)
+    Sim::HeapFree(buffer);
+}
+
+// Memory management
+bool String::reserve(unsigned int size) {
+  if (buffer && capacity >= size)
+    return true;
+  if (changeBuffer(size)) {
+    if (len == 0)
+      buffer[0] = 0;
+    return true;
+  }
+  return false;
+}
+
+// Copy and move
+String & String::operator=(const String & rhs) {
+  if (this == &rhs)
+    return *this;
+  if (rhs.buffer)
+    copy(rhs.buffer, rhs.len);
+  else
+    invalidate();
+  return *this;
+}
+
+String & String::operator=(String && rval) {
+  if (this != &rval)
+    move(rval);
+  return *this;
+}
+
+String & String::operator=(StringSumHelper && rval) {
+  if (this != &rval)
+    move(rval);
+  return *this;
+}
+
+String & String::operator=(const char * cstr) {
+  if (cstr)
+    copy(cstr, strlen(cstr));
+  else
+    invalidate();
+  return *this;
+}
+
+String & String::operator=(const __FlashStringHelper * pstr) {
+  if (pstr)
+    copy((const char *)pstr, strlen((const char *)pstr));
+  else
+    invalidate();
+  return *this;
+}
+
+// Concatenate
+bool String::concat(const String & s) {
+  return concat(s.buffer, s.len);
+}
+
+bool String::concat(const char * cstr, unsigned int length) {
+  unsigned int newlen = len + length;
+  if (!cstr)
+    return false;
+  if (length == 0)
+    return true;
+  if (!reserve(newlen))
+    return false;
+  memmove(buffer + len, cstr, length);
+  len = newlen;
+  buffer[len] = 0;
+  return true;
+}
+
+bool String::concat(const char * cstr) {
+  if (!cstr)
+    return false;
+  return concat(cstr, strlen(cstr));
+}
+
+bool String::concat(char c) {
+  char buf[2] = {c, 0};
+  return concat(buf, 1);
+}
+
+bool String::concat(unsigned char num) { String s(num); return concat(s); }
+bool String::concat(int num) { String s(num); return concat(s); }
+bool String::concat(unsigned int num) { String s(num); return concat(s); }
+bool String::concat(long num) { String s(num); return concat(s); }
+bool String::concat(unsigned long num) { String s(num); return concat(s); }
+bool String::concat(float num) { String s(num); return concat(s); }
+bool String::concat(double num) { String s(num); return concat(s); }
+
+bool String::concat(const __FlashStringHelper * str) {
+  if (!str)
+    return false;
+  return concat((const char *)str, strlen((const char *)str));
+}
+
+StringSumHelper & operator+(const StringSumHelper & lhs, const String & rhs) {
+  StringSumHelper & a = const_cast<StringSumHelper &>(lhs);
+  if (!a.concat(rhs.buffer, rhs.len))
+    a.invalidate();
+  return a;
+}
+
+StringSumHelper & operator+(const StringSumHelper & lhs, const char * cstr) {
+  StringSumHelper & a = const_cast<StringSumHelper &>(lhs);
+  if (!cstr || !a.concat(cstr, strlen(cstr)))
+    a.invalidate();
+  return a;
+}
+
+#define SUM_NUMBER(type) \
+  StringSumHelper & operator+(const StringSumHelper & lhs, type num) { \
+    StringSumHelper & a = const_cast<StringSumHelper &>(lhs); \
+    if (!a.concat(num)) \
+      a.invalidate(); \
+    return a; \
+  }
+SUM_NUMBER(char)
+SUM_NUMBER(unsigned char)
+SUM_NUMBER(int)
+SUM_NUMBER(unsigned int)
+SUM_NUMBER(long)
+SUM_NUMBER(unsigned long)
+SUM_NUMBER(float)
+SUM_NUMBER(double)
+SUM_NUMBER(const __FlashStringHelper *)
+
+// Comparison
+int String::compareTo(const String & s) const {
+  if (!buffer || !s.buffer) {
+    if (s.buffer && s.len > 0)
+      return 0 - *(unsigned char *)s.buffer;
+    if (buffer && len > 0)
+      return *(unsigned char *)buffer;
+    return 0;
+  }
+  return strcmp(buffer, s.buffer);
+}
+
+bool String::equals(const String & s2) const {
+  return len == s2.len && compareTo(s2) == 0;
+}
+
+bool String::equals(const char * cstr) const {
+  if (len == 0)
+    return cstr == NULL || *cstr == 0;
+  if (cstr == NULL)
+    return buffer[0] == 0;
+  return strcmp(buffer, cstr) == 0;
+}
+
+bool String::startsWith(const String & s2) const {
+  if (len < s2.len || !buffer || !s2.buffer)
+    return false;
+  return strncmp(buffer, s2.buffer, s2.len) == 0;
+}
+
+bool String::endsWith(const String & suffix) const {
+  if (len < suffix.len || !buffer || !suffix.buffer)
+    return false;
+  return strcmp(&buffer[len - suffix.len], suffix.buffer) == 0;
+}
+
+// Character access
+char String::charAt(unsigned int loc) const {
+  return operator[](loc);
+}
+
+void String::setCharAt(unsigned int loc, char c) {
+  if (loc < len)
+    buffer[loc] = c;
+}
+
+char & String::operator[](unsigned int index) {
+  static char dummy_writable_char;
+  if (index >= len || !buffer) {
+    dummy_writable_char = 0;
+    return dummy_writable_char;
+  }
+  return buffer[index];
+}
+
+char String::operator[](unsigned int index) const {
+  if (index >= len || !buffer)
+    return 0;
+  return buffer[index];
+}
+
+void String::getBytes(unsigned char * buf, unsigned int bufsize, unsigned int index) const {
+  if (!bufsize || !buf)
+    return;
+  if (index >= len) {
+    buf[0] = 0;
+    return;
+  }
+  unsigned int n = bufsize - 1;
+  if (n > len - index)
+    n = len - index;
+  strncpy((char *)buf, buffer + index, n);
+  buf[n] = 0;
+}
+
+// Search
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len)
+    return -1;
+  const char * temp = strchr(buffer + fromIndex, ch);
+  if (temp == NULL)
+    return -1;
+  return temp - buffer;
+}
+
+int String::indexOf(const String & s2, unsigned int fromIndex) const {
+  if (fromIndex >= len)
+    return -1;
+  const char * found = strstr(buffer + fromIndex, s2.buffer);
+  if (found == NULL)
+    return -1;
+  return found - buffer;
+}
+
+int String::lastIndexOf(char ch) const {
+  if (len == 0)
+    return -1;
+  const char * temp = strrchr(buffer, ch);
+  if (temp == NULL)
+    return -1;
+  return temp - buffer;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+  if (left > right) {
+    unsigned int temp = right;
+    right = left;
+    left = temp;
+  }
+  String out;
+  if (left >= len)
+    return out;
+  if (right > len)
+    right = len;
+  out.copy(buffer + left, right - left);
+  return out;
+}
+
+// Modification
+void String::replace(char find, char replace) {
+  if (!buffer)
+    return;
+  for (char * p = buffer; *p; p++)
+    if (*p == find)
+      *p = replace;
+}
+
+void String::replace(const String & find, const String & replace) {
+  if (len == 0 || find.len == 0)
+    return;
+  int diff = replace.len - find.len;
+  char * readFrom = buffer;
+  char * foundAt;
+  if (diff == 0) {
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      memcpy(foundAt, replace.buffer, replace.len);
+      readFrom = foundAt + replace.len;
+    }
+  } else if (diff < 0) {
+    unsigned int size = len;
+    char * writeTo = buffer;
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      unsigned int n = foundAt - readFrom;
+      memmove(writeTo, readFrom, n);
+      writeTo += n;
+      memmove(writeTo, replace.buffer, replace.len);
+      writeTo += replace.len;
+      readFrom = foundAt + find.len;
+      size += diff;
+    }
+    memmove(writeTo, readFrom, strlen(readFrom) + 1);
+    len = size;
+  } else {
+    unsigned int size = len;
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      readFrom = foundAt + find.len;
+      size += diff;
+    }
+    if (size == len)
+      return;
+    if (size > capacity && !changeBuffer(size))
+      return;
+    // The core shuffles the text up in place from the end - working from a copy comes to the same result
+    char * old = strdup(buffer);
+    char * writeTo = buffer;
+    readFrom = old;
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      unsigned int n = foundAt - readFrom;
+      memcpy(writeTo, readFrom, n);
+      writeTo += n;
+      memcpy(writeTo, replace.buffer, replace.len);
+      writeTo += replace.len;
+      readFrom = foundAt + find.len;
+    }
+    strcpy(writeTo, readFrom);
+    len = size;
+    free(old);
+  }
+}
+
+void String::remove(unsigned int index) {
+  remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len)
+    return;
+  if (count <= 0)
+    return;
+  if (count > len - index)
+    count = len - index;
+  char * writeTo = buffer + index;
+  len = len - count;
+  memmove(writeTo, buffer + index + count, len - index);
+  buffer[len] = 0;
+}
+
+void String::toLowerCase() {
+  if (!buffer)
+    return;
+  for (char * p = buffer; *p; p++)
+    *p = tolower(*p);
+}
+
+void String::toUpperCase() {
+  if (!buffer)
+    return;
+  for (char * p = buffer; *p; p++)
+    *p = toupper(*p);
+}
+
+void String::trim() {
+  if (!buffer || len == 0)
+    return;
+  char * begin = buffer;
+  while (isspace(*begin))
+    begin++;
+  char * end = buffer + len - 1;
+  while (isspace(*end) && end >= begin)
+    end--;
+  len = end + 1 - begin;
+  if (begin > buffer)
+    memmove(buffer, begin, len);
+  buffer[len] = 0;
+}
+
+// Parsing
+long String::toInt() const {
+  if (buffer)
+    return atol(buffer);
+  return 0;
+}
+
+float String::toFloat() const {
+  if (buffer)
+    return atof(buffer);
+  return 0;
+}
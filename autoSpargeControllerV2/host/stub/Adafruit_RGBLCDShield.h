@@ -0,0 +1,33 @@
+/*
+  Adafruit_RGBLCDShield.h - Host stand-in for the Adafruit RGB LCD shield library.  The sketch only uses it to bring the LCD up
+  and for the welcome message before FastLcd takes over, so its drawing takes the library's time but does not reach the
+  simulated LCD.
+  Created by Tom Wallace.
+*/
+#ifndef Adafruit_RGBLCDShield_h
+#define Adafruit_RGBLCDShield_h
+
+#include "Arduino.h"
+#include "utility/Adafruit_MCP23017.h"
+
+#define BUTTON_UP 0x08
+#define BUTTON_DOWN 0x04
+#define BUTTON_LEFT 0x10
+#define BUTTON_RIGHT 0x02
+#define BUTTON_SELECT 0x01
+
+class Adafruit_RGBLCDShield : public Print {
+  public:
+	Adafruit_RGBLCDShield() {}
+	void begin(uint8_t cols, uint8_t rows);
+	void clear();
+	void home();
+	void setCursor(uint8_t col, uint8_t row);
+	void setBacklight(uint8_t status);
+	void createChar(uint8_t location, uint8_t charmap[]);
+	uint8_t readButtons();
+	virtual size_t write(uint8_t value);
+	using Print::write;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+  Arduino.h - Host stand-in for the Arduino AVR core, so the sketch and its classes build and run on a PC under the simulator.
+  Time only moves when the sketch calls into the core, which charges what the call would take on a 16 MHz Trinket Pro, and
+  Timer0 and watchdog interrupts fire as the simulated clock passes them.  See Sim.h for the side the harnesses drive.
+  Created by Tom Wallace.
+*/
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+#include "avr/io.h"
+#include "avr/interrupt.h"
+#include "avr/pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define SDA 18
+#define SCL 19
+
+// Functions rather than the core's macros, so standard headers included after this one still build
+template<class A, class B> inline typename std::common_type<A, B>::type min(const A & a, const B & b) { return a < b ? a : b; }
+template<class A, class B> inline typename std::common_type<A, B>::type max(const A & a, const B & b) { return a > b ? a : b; }
+template<class A, class L, class H> inline A constrain(const A & amount, const L & low, const H & high) {
+  return amount < low ? (A)low : (amount > high ? (A)high : amount);
+}
+template<class T> inline T abs(const T & x) { return x > 0 ? x : -x; }
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bit(b) (1UL << (b))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+void setup(void);
+void loop(void);
+
+#include "WString.h"
+#include "HardwareSerial.h"
+
+#endif
@@ -0,0 +1,33 @@
+/*
+  EEPROM.h - Host stand-in for the Arduino EEPROM library over the simulator's 1 KB EEPROM.  A write that changes a cell takes
+  the 3.3 ms the hardware does.
+  Created by Tom Wallace.
+*/
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include "Arduino.h"
+
+class EEPROMClass {
+  public:
+	uint8_t read(int address);
+	void write(int address, uint8_t value);
+	void update(int address, uint8_t value);
+	uint16_t length() { return 1024; }
+	template<class T> T & get(int address, T & value) {
+	  uint8_t * p = (uint8_t *)&value;
+	  for (unsigned int i = 0; i < sizeof(T); i++)
+	    p[i] = read(address + i);
+	  return value;
+	}
+	template<class T> const T & put(int address, const T & value) {
+	  const uint8_t * p = (const uint8_t *)&value;
+	  for (unsigned int i = 0; i < sizeof(T); i++)
+	    update(address + i, p[i]);
+	  return value;
+	}
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
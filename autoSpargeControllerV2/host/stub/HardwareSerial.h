@@ -0,0 +1,30 @@
+/*
+  HardwareSerial.h - Host stand-in for the ATmega328P UART, with the core's 64 byte receive and transmit buffers.  Bytes leave at
+  the baud rate, so a write to a full buffer waits for room and the sketch feels a slow port as it would on the board.
+  Created by Tom Wallace.
+*/
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Print.h"
+
+#define SERIAL_TX_BUFFER_SIZE 64
+#define SERIAL_RX_BUFFER_SIZE 64
+
+class HardwareSerial : public Stream {
+  public:
+	void begin(unsigned long baud);
+	void end() {}
+	virtual int available();
+	virtual int peek();
+	virtual int read();
+	virtual int availableForWrite();
+	virtual void flush();
+	virtual size_t write(uint8_t c);
+	using Print::write;
+	operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
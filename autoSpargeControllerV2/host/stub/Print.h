@@ -0,0 +1,54 @@
+/*
+  Print.h - Host stand-in for the Arduino Print and Stream classes, formatting numbers the way the AVR core does.
+  Created by Tom Wallace.
+*/
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+#ifndef DEC
+#define DEC 10
+#endif
+
+class Print {
+  private:
+	size_t printNumber(unsigned long n, uint8_t base);
+	size_t printFloat(double number, uint8_t digits);
+
+  public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t * buffer, size_t size);
+	size_t write(const char * str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
+	size_t write(const char * buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() {}
+
+	size_t print(const __FlashStringHelper * ifsh) { return write((const char *)ifsh); }
+	size_t print(const String & s) { return write(s.c_str(), s.length()); }
+	size_t print(const char * str) { return write(str); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(int n, int base = DEC) { return print((long)n, base); }
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2) { return printFloat(n, digits); }
+
+	size_t println() { return write("\r\n"); }
+	template<class T> size_t println(const T & value) { size_t n = print(value); return n + println(); }
+	template<class T> size_t println(const T & value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print {
+  public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+  WString.h - Host stand-in for the Arduino String class, following the AVR core's buffer handling - a String holds one heap
+  block of exactly its length plus the terminator, even when empty, and grows with realloc - so heap counts on the host track
+  the board's.  Allocations go through SimHeap so the harnesses can count them.
+  Created by Tom Wallace.
+*/
+#ifndef WString_h
+#define WString_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class __FlashStringHelper;
+#define F(string_literal) (__extension__({ static const char __c[] PROGMEM = (string_literal); reinterpret_cast<const __FlashStringHelper *>(&__c[0]); }))
+
+class StringSumHelper;
+
+class String {
+  protected:
+	char * buffer;
+	unsigned int capacity;
+	unsigned int len;
+
+	void init();
+	void invalidate();
+	bool changeBuffer(unsigned int maxStrLen);
+	String & copy(const char * cstr, unsigned int length);
+	void move(String & rhs);
+
+  public:
+	String(const char * cstr = "");
+	String(const String & str);
+	String(const __FlashStringHelper * str);
+	String(String && rval);
+	String(StringSumHelper && rval);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(float value, unsigned char decimalPlaces = 2);
+	explicit String(double value, unsigned char decimalPlaces = 2);
+	~String();
+
+	bool reserve(unsigned int size);
+	unsigned int length() const { return len; }
+
+	String & operator=(const String & rhs);
+	String & operator=(const char * cstr);
+	String & operator=(const __FlashStringHelper * str);
+	String & operator=(String && rval);
+	String & operator=(StringSumHelper && rval);
+
+	bool concat(const String & str);
+	bool concat(const char * cstr);
+	bool concat(const char * cstr, unsigned int length);
+	bool concat(char c);
+	bool concat(unsigned char num);
+	bool concat(int num);
+	bool concat(unsigned int num);
+	bool concat(long num);
+	bool concat(unsigned long num);
+	bool concat(float num);
+	bool concat(double num);
+	bool concat(const __FlashStringHelper * str);
+
+	template<class T> String & operator+=(const T & rhs) { concat(rhs); return *this; }
+
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, const String & rhs);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, const char * cstr);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, char c);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, unsigned char num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, int num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, unsigned int num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, long num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, unsigned long num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, float num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, double num);
+	friend StringSumHelper & operator+(const StringSumHelper & lhs, const __FlashStringHelper * rhs);
+
+	int compareTo(const String & s) const;
+	bool equals(const String & s) const;
+	bool equals(const char * cstr) const;
+	bool operator==(const String & rhs) const { return equals(rhs); }
+	bool operator==(const char * cstr) const { return equals(cstr); }
+	bool operator!=(const String & rhs) const { return !equals(rhs); }
+	bool operator!=(const char * cstr) const { return !equals(cstr); }
+	bool startsWith(const String & prefix) const;
+	bool endsWith(const String & suffix) const;
+
+	char charAt(unsigned int index) const;
+	void setCharAt(unsigned int index, char c);
+	char operator[](unsigned int index) const;
+	char & operator[](unsigned int index);
+	void getBytes(unsigned char * buf, unsigned int bufsize, unsigned int index = 0) const;
+	void toCharArray(char * buf, unsigned int bufsize, unsigned int index = 0) const { getBytes((unsigned char *)buf, bufsize, index); }
+	const char * c_str() const { return buffer; }
+
+	int indexOf(char ch, unsigned int fromIndex = 0) const;
+	int indexOf(const String & str, unsigned int fromIndex = 0) const;
+	int lastIndexOf(char ch) const;
+	String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+	String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+	void replace(char find, char replace);
+	void replace(const String & find, const String & replace);
+	void remove(unsigned int index);
+	void remove(unsigned int index, unsigned int count);
+	void toLowerCase();
+	void toUpperCase();
+	void trim();
+
+	long toInt() const;
+	float toFloat() const;
+};
+
+class StringSumHelper : public String {
+  public:
+	StringSumHelper(const String & s) : String(s) {}
+	StringSumHelper(const char * p) : String(p) {}
+	StringSumHelper(char c) : String(c) {}
+	StringSumHelper(unsigned char num) : String(num) {}
+	StringSumHelper(int num) : String(num) {}
+	StringSumHelper(unsigned int num) : String(num) {}
+	StringSumHelper(long num) : String(num) {}
+	StringSumHelper(unsigned long num) : String(num) {}
+	StringSumHelper(float num) : String(num) {}
+	StringSumHelper(double num) : String(num) {}
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+  Wire.h - Host stand-in for the Arduino TwoWire library, with its 32 byte buffers and its timeout, talking to the simulated
+  devices on the bus.  Each transaction takes the time its bits would at the set clock.
+  Created by Tom Wallace.
+*/
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH 32
+
+class TwoWire : public Stream {
+  private:
+	uint8_t _txAddress;
+	uint8_t _txBuffer[BUFFER_LENGTH];
+	uint8_t _txLength;
+	uint8_t _rxBuffer[BUFFER_LENGTH];
+	uint8_t _rxIndex;
+	uint8_t _rxLength;
+	bool _isTransmitting;
+
+  public:
+	void begin();
+	void end();
+	void setClock(uint32_t clock);
+	void setWireTimeout(uint32_t timeout = 25000, bool resetWithTimeout = false);
+	bool getWireTimeoutFlag();
+	void clearWireTimeoutFlag();
+	void beginTransmission(uint8_t address);
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	uint8_t endTransmission(uint8_t sendStop = true);
+	uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+	uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+	virtual size_t write(uint8_t data);
+	virtual size_t write(const uint8_t * data, size_t quantity);
+	using Print::write;
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+};
+
+extern TwoWire Wire;
+
+#endif
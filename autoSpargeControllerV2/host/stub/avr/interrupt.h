@@ -0,0 +1,16 @@
+/*
+  interrupt.h - Host stand-in for avr-libc's interrupt control.  An ISR is a plain function the simulator calls with the I bit
+  cleared, and sei() runs any interrupt that came due while they were off, as the hardware does.
+  Created by Tom Wallace.
+*/
+#ifndef avr_interrupt_h
+#define avr_interrupt_h
+
+#include "io.h"
+
+#define ISR(vector) extern "C" void vector(void)
+
+extern "C" void cli(void);
+extern "C" void sei(void);
+
+#endif
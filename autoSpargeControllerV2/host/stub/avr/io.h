@@ -0,0 +1,66 @@
+/*
+  io.h - Host stand-in for the ATmega328P registers the sketch touches.  They are plain memory the simulator reads as it runs,
+  so a write lands the next time the simulated clock moves, which is close enough at a microsecond grain.
+  Created by Tom Wallace.
+*/
+#ifndef avr_io_h
+#define avr_io_h
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+#define RAMEND 0x8FF
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t WDTCSR;
+extern volatile uint8_t TIMSK0;
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t OCR0B;
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t TCNT1;
+extern volatile uint8_t GPIOR0;
+extern volatile uintptr_t SP;
+
+// SREG
+#define SREG_I 7
+
+// MCUSR
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+
+// WDTCSR
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+
+// TIMSK0
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+
+// TCCR1A and TCCR1B
+#define WGM10 0
+#define WGM11 1
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+
+#endif
@@ -0,0 +1,27 @@
+/*
+  pgmspace.h - Host stand-in for avr-libc's program memory access.  A PC has one address space, so flash reads are plain reads.
+  Created by Tom Wallace.
+*/
+#ifndef avr_pgmspace_h
+#define avr_pgmspace_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM __attribute__((section(".progmem.data")))  // Where avr-gcc puts it, so host/ram_budget.py can leave it out
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_float(address) (*(const float *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+
+#endif
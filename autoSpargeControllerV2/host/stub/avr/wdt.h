@@ -0,0 +1,32 @@
+/*
+  wdt.h - Host stand-in for avr-libc's watchdog control, backed by the simulator's watchdog.
+  Created by Tom Wallace.
+*/
+#ifndef avr_wdt_h
+#define avr_wdt_h
+
+#include "io.h"
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define WDTO_4S 8
+#define WDTO_8S 9
+
+void wdt_reset(void);
+
+inline void wdt_enable(uint8_t timeout) {
+  WDTCSR = _BV(WDE) | (timeout & 0x08 ? _BV(WDP3) : 0) | (timeout & 0x07);
+  wdt_reset();
+}
+
+inline void wdt_disable(void) {
+  WDTCSR = 0;
+}
+
+#endif
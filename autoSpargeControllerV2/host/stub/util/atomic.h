@@ -0,0 +1,44 @@
+/*
+  atomic.h - Host stand-in for avr-libc's ATOMIC_BLOCK.  The block clears the I bit on entry and puts SREG back on the way out,
+  however it is left, so an interrupt that came due inside runs straight after it as on the AVR.
+  Created by Tom Wallace.
+*/
+#ifndef util_atomic_h
+#define util_atomic_h
+
+#include "../avr/interrupt.h"
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+
+void SimRestoreSreg(uint8_t sreg);
+
+class AtomicGuard {
+  private:
+	uint8_t _sreg;
+	bool _isForceOn;
+	bool _isDone;
+
+  public:
+	AtomicGuard(int type) {
+	  _sreg = SREG;
+	  _isForceOn = type == ATOMIC_FORCEON;
+	  _isDone = false;
+	  cli();
+	}
+	~AtomicGuard() {
+	  if (_isForceOn)
+	    sei();
+	  else
+	    SimRestoreSreg(_sreg);
+	}
+	bool Next() {
+	  bool isFirst = !_isDone;
+	  _isDone = true;
+	  return isFirst;
+	}
+};
+
+#define ATOMIC_BLOCK(type) for (AtomicGuard _atomicGuard(type); _atomicGuard.Next(); )
+
+#endif
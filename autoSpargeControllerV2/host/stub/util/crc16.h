@@ -0,0 +1,41 @@
+/*
+  crc16.h - Host stand-in for avr-libc's CRC helpers, written out from the equivalent C code in the avr-libc manual.
+  Created by Tom Wallace.
+*/
+#ifndef util_crc16_h
+#define util_crc16_h
+
+#include <stdint.h>
+
+// Table driven, as the harnesses run it over the settings every loop - the same results as the manual's bit loop
+struct Crc16Table {
+	uint16_t entries[256];
+	Crc16Table() {
+	  for (int a = 0; a < 256; a++) {
+	    uint16_t crc = a;
+	    for (int i = 0; i < 8; ++i)
+	      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	    entries[a] = crc;
+	  }
+	}
+};
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+  static const Crc16Table table;
+  return (crc >> 8) ^ table.entries[(crc ^ a) & 0xFF];
+}
+
+inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+  data ^= crc & 0xff;
+  data ^= data << 4;
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for (int i = 0; i < 8; i++)
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+  return crc;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/*
+  Adafruit_MCP23017.h - Host stand-in for the Adafruit MCP23017 library, which the sketch includes but drives through FastLcd.
+  Created by Tom Wallace.
+*/
+#ifndef Adafruit_MCP23017_h
+#define Adafruit_MCP23017_h
+
+#include "../Arduino.h"
+
+class Adafruit_MCP23017 {
+  public:
+	void begin(uint8_t address = 0) {}
+	void pinMode(uint8_t pin, uint8_t mode) {}
+	void digitalWrite(uint8_t pin, uint8_t value) {}
+	uint8_t digitalRead(uint8_t pin) { return 0; }
+	void pullUp(uint8_t pin, uint8_t value) {}
+	void writeGPIOAB(uint16_t value) {}
+	uint16_t readGPIOAB() { return 0; }
+};
+
+#endif